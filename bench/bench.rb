@@ -0,0 +1,270 @@
+require "json"
+require "fileutils"
+require "tmpdir"
+require "rbconfig"
+
+##
+# Benchmarks of the simulators, run by "rake bench".
+#
+# Each benchmark of the suite is simulated in mute mode by each engine
+# (rcsim with --sim, csim with --csim and rsim with --rsim), the best of
+# several runs being kept. The csim engine is not run by default since
+# the core of the standalone C simulator does not compile in this version
+# (its VCD output uses the structures of the hybrid simulator). For each run are measured the wall time of the
+# whole process and its peak resident memory, and, for the engines that
+# provide runtime metrics (rcsim and csim), the simulated time and the
+# events per second of the simulation kernel.
+# The results are written to results.json and results.csv, and compared
+# with the baseline stored by "rake bench:baseline": a metric worse than
+# the baseline by more than the threshold is a regression, and the task
+# fails, as it does when a benchmark fails. Without baseline the task only reports the results, unless run
+# in continuous integration (CI environment variable set) where it fails.
+#
+# The following environment variables configure the benchmarks:
+#  - BENCH_ENGINES: the engines to use (default: rcsim,rsim)
+#  - BENCH_ONLY: the names of the benchmarks to run (default: all)
+#  - BENCH_REPEAT: the number of runs of each benchmark (default: 3)
+#  - BENCH_THRESHOLD: the relative threshold of the regressions
+#    (default: 0.15)
+#  - BENCH_OUTPUT: the directory of the results (default: bench)
+#  - BENCH_BASELINE: the baseline file (default: bench/baseline.json)
+########################################################################
+module HDLRuby
+    module Bench
+
+        ROOT = File.expand_path("..",__dir__)
+        LIB = File.join(ROOT,"lib")
+        SAMPLES = File.join(LIB,"HDLRuby","hdr_samples")
+
+        ## The engines and their hdrcc options.
+        ENGINES = { "rcsim" => "--sim", "csim" => "--csim", "rsim" => "--rsim" }
+
+        ## The engines run by default.
+        DEFAULT_ENGINES = [ "rcsim", "rsim" ]
+
+        ## The engines that provide runtime metrics.
+        METRICS_ENGINES = [ "rcsim", "csim" ]
+
+        ## The benchmarks, with the data files they read: the samples are
+        #  mostly front-end bound, the long running designs measure the
+        #  simulation kernels, with a number of cycles per engine.
+        SUITE = [
+            { name: "adder_bench",       file: "#{SAMPLES}/adder_bench.rb" },
+            { name: "arith_bench",       file: "#{SAMPLES}/arith_bench.rb" },
+            { name: "counter_bench",     file: "#{SAMPLES}/counter_bench.rb" },
+            { name: "dff_bench",         file: "#{SAMPLES}/dff_bench.rb" },
+            { name: "mei8_bench",        file: "#{SAMPLES}/mei8_bench.rb",
+              data: [ "#{SAMPLES}/prog.obj" ] },
+            { name: "multi_timed_bench", file: "#{SAMPLES}/multi_timed_bench.rb" },
+            { name: "with_clocks",       file: "#{SAMPLES}/with_clocks.rb" },
+            { name: "long_counters",     file: "#{__dir__}/long_counters.rb",
+              cycles: { "rcsim" => 1_000_000, "csim" => 1_000_000,
+                        "rsim" => 20_000 } }
+        ]
+
+        ## The metrics compared with the baseline, with true if greater
+        #  is better.
+        COMPARED = { "wall" => false, "rss_peak" => false,
+                     "time_per_s" => true, "events_per_s" => true }
+
+        ## The minimal wall time of the simulation kernel (in s) for
+        #  computing the rates, the shorter ones being too noisy.
+        MIN_SIM_WALL = 0.05
+
+        ## The columns of the CSV results.
+        COLUMNS = [ "name", "engine", "status", "wall", "rss_peak",
+                    "sim_wall", "time", "time_per_s", "events",
+                    "events_per_s" ]
+
+
+        ## Gets the peak resident memory of process +pid+ in bytes, nil
+        #  if unknown.
+        def self.peak_rss(pid)
+            File.foreach("/proc/#{pid}/status") do |line|
+                return line.split[1].to_i * 1024 if line.start_with?("VmHWM:")
+            end
+            return nil
+        rescue SystemCallError
+            return nil
+        end
+
+        ## Runs once benchmark +bench+ with +engine+ in directory +dir+.
+        #  Returns the measures.
+        def self.run_once(bench, engine, dir)
+            out = File.join(dir,"out")
+            FileUtils.rm_rf(out)
+            metrics = File.join(dir,"metrics.jsonl")
+            FileUtils.rm_f(metrics)
+            cmd = [ RbConfig.ruby, "-I", LIB, "-I", File.join(LIB,"HDLRuby"),
+                    File.join(LIB,"HDLRuby","hdrcc.rb"),
+                    ENGINES[engine], "--mute" ]
+            if METRICS_ENGINES.include?(engine) then
+                cmd += [ "--metrics", metrics, "--metrics-period", "0" ]
+            end
+            # The input files are looked up from the current directory.
+            FileUtils.cp([ bench[:file], *bench[:data] ],dir)
+            cmd += [ File.basename(bench[:file]), out ]
+            env = {}
+            if bench[:cycles] then
+                env["HDLRUBY_BENCH_CYCLES"] = bench[:cycles][engine].to_s
+            end
+            log = File.join(dir,"#{bench[:name]}_#{engine}.log")
+            start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+            pid = Process.spawn(env,*cmd, chdir: dir, [:out,:err] => log)
+            # Sample the peak memory of the front end until it ends.
+            peak = 0
+            sampler = Thread.new do
+                loop do
+                    rss = peak_rss(pid)
+                    peak = rss if rss && rss > peak
+                    sleep(0.02)
+                end
+            end
+            _, status = Process.wait2(pid)
+            wall = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+            sampler.kill
+            res = { "name" => bench[:name], "engine" => engine,
+                    "status" => status.success? ? "ok" : "failed",
+                    "wall" => wall.round(4), "rss_peak" => peak }
+            if METRICS_ENGINES.include?(engine) then
+                # The last metrics are the ones of the end of the simulation,
+                # none means the simulator did not run.
+                last = File.exist?(metrics) && File.readlines(metrics).last
+                if last then
+                    m = JSON.parse(last)
+                    res["rss_peak"] = [ peak, m["rss_peak"] ].max
+                    res["sim_wall"] = m["wall"]
+                    res["time"] = m["time"]
+                    res["events"] = m["events"]
+                    if m["wall"] >= MIN_SIM_WALL then
+                        res["time_per_s"] = (m["time"] / m["wall"]).round(1)
+                        res["events_per_s"] = (m["events"] / m["wall"]).round(1)
+                    end
+                else
+                    res["status"] = "failed"
+                end
+            end
+            res["log"] = log if res["status"] == "failed"
+            return res
+        end
+
+        ## Runs benchmark +bench+ with +engine+ +repeat+ times in directory
+        #  +dir+, keeping the fastest run.
+        def self.run(bench, engine, repeat, dir)
+            runs = repeat.times.map { run_once(bench,engine,dir) }
+            ok = runs.select { |run| run["status"] == "ok" }
+            return runs.last if ok.empty?
+            return ok.min_by { |run| run["wall"] }
+        end
+
+        ## Writes +results+ as JSON and CSV in directory +dir+.
+        def self.save(results, dir)
+            File.write(File.join(dir,"results.json"),
+                       JSON.pretty_generate(results) + "\n")
+            File.open(File.join(dir,"results.csv"),"w") do |file|
+                file << COLUMNS.join(",") << "\n"
+                results.each do |res|
+                    file << COLUMNS.map { |col| res[col] }.join(",") << "\n"
+                end
+            end
+        end
+
+        ## Compares +results+ with +baseline+ using relative +threshold+.
+        #  Returns the regressions as strings.
+        def self.compare(results, baseline, threshold)
+            regressions = []
+            results.each do |res|
+                base = baseline.find do |b|
+                    b["name"] == res["name"] && b["engine"] == res["engine"]
+                end
+                next unless base && base["status"] == "ok"
+                label = "#{res["name"]} (#{res["engine"]})"
+                if res["status"] != "ok" then
+                    regressions << "#{label}: failed, see #{res["log"]}"
+                    next
+                end
+                COMPARED.each do |metric,greater|
+                    b, r = base[metric], res[metric]
+                    next unless b && r && b > 0 && r > 0
+                    # Also skip the rates of the older baselines computed
+                    # from too short simulations.
+                    if greater then
+                        next unless base["sim_wall"] >= MIN_SIM_WALL
+                    end
+                    ratio = greater ? b.to_f / r : r.to_f / b
+                    next unless ratio > 1.0 + threshold
+                    regressions << "#{label}: #{metric} #{b} -> #{r} " +
+                                   "(#{((ratio-1)*100).round(1)}% worse)"
+                end
+            end
+            return regressions
+        end
+
+        ## Runs the benchmarks, storing them as the new baseline if
+        #  +baseline+ is true, otherwise comparing them with it.
+        #  Returns true if there is no regression.
+        def self.main(baseline = false)
+            engines = (ENV["BENCH_ENGINES"] || DEFAULT_ENGINES.join(",")).split(",")
+            only = ENV["BENCH_ONLY"] && ENV["BENCH_ONLY"].split(",")
+            repeat = (ENV["BENCH_REPEAT"] || 3).to_i
+            threshold = (ENV["BENCH_THRESHOLD"] || 0.15).to_f
+            output = File.expand_path(ENV["BENCH_OUTPUT"] || __dir__)
+            baseline_file = File.expand_path(ENV["BENCH_BASELINE"] ||
+                                             File.join(__dir__,"baseline.json"))
+            unknown = engines - ENGINES.keys
+            raise "Unknown engines: #{unknown.join(",")}." unless unknown.empty?
+            suite = SUITE.select { |bench| !only || only.include?(bench[:name]) }
+            results = []
+            FileUtils.mkdir_p(output)
+            Dir.mktmpdir("hdrbench") do |dir|
+                suite.each do |bench|
+                    engines.each do |engine|
+                        res = run(bench,engine,repeat,dir)
+                        puts "%-18s %-6s %-7s wall %8.3fs  rss %7.1fMB%s" %
+                            [ res["name"], engine, res["status"], res["wall"],
+                              res["rss_peak"] / 1048576.0,
+                              res["time_per_s"] ? "  %.3g ps/s  %.3g events/s" %
+                              [ res["time_per_s"], res["events_per_s"] ] : "" ]
+                        # Keep the log of the failures.
+                        if res["log"] then
+                            FileUtils.cp(res["log"],output)
+                            res["log"] = File.join(output,File.basename(res["log"]))
+                        end
+                        results << res
+                    end
+                end
+            end
+            save(results,output)
+            failures = results.select { |res| res["status"] != "ok" }
+            unless failures.empty? then
+                puts "FAILED BENCHMARKS:"
+                failures.each do |res|
+                    puts "  #{res["name"]} (#{res["engine"]}), see #{res["log"]}"
+                end
+            end
+            if baseline then
+                File.write(baseline_file,JSON.pretty_generate(results) + "\n")
+                puts "Baseline stored in #{baseline_file}."
+                return failures.empty?
+            end
+            unless File.exist?(baseline_file) then
+                puts "No baseline to compare with, store one with rake bench:baseline."
+                # In continuous integration, nothing compared is a failure.
+                return failures.empty? && (!ENV["CI"] || ENV["CI"].empty?)
+            end
+            regressions = compare(results,JSON.parse(File.read(baseline_file)),
+                                  threshold)
+            if regressions.empty? then
+                puts "No regression compared with #{baseline_file}."
+                return failures.empty?
+            end
+            puts "PERFORMANCE REGRESSIONS (threshold #{(threshold*100).round(1)}%):"
+            regressions.each { |reg| puts "  #{reg}" }
+            return false
+        end
+    end
+end
+
+if __FILE__ == $0 then
+    exit(HDLRuby::Bench.main(ARGV.include?("--baseline")) ? 0 : 1)
+end
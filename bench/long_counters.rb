@@ -0,0 +1,31 @@
+# Long running design for the simulator benchmarks: a few counters and a
+# small memory updated on each rising edge of a clock, for a number of
+# cycles given by the HDLRUBY_BENCH_CYCLES environment variable.
+# The final state is printed so that the counters are not pruned away
+# when simulating in mute mode.
+cycles = (ENV["HDLRUBY_BENCH_CYCLES"] || 100000).to_i
+
+system :long_counters do
+    [32].inner cnt0: 0, cnt1: 0, acc: 0
+    bit[8][-256].inner :mem
+    [8].inner :rd
+    inner :clk
+
+    par(clk.posedge) do
+        cnt0 <= cnt0 + 1
+        cnt1 <= cnt1 * 5 + 1
+        acc  <= acc ^ cnt1
+        mem[cnt0[7..0]] <= acc[7..0]
+        rd <= mem[(cnt0+1)[7..0]]
+    end
+
+    timed do
+        clk <= 0
+        repeat(cycles) { !10.ns; clk <= 1; !10.ns; clk <= 0 }
+    end
+
+    timed do
+        !(cycles * 20).ns
+        hprint("cnt0=",cnt0," cnt1=",cnt1," acc=",acc," rd=",rd,"\n")
+    end
+end
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../hruby_sim.h"
+
+
+/**
+ *  The microbenchmarks of the HDLRuby value computation engine
+ *  (hruby_sim_calc.c), built by "make -f Makefile_csim calc_bench".
+ *  Each operator is timed alone for representative widths, with numeric
+ *  inputs (up to 64 bits), and with defined and with x-containing
+ *  bitstring inputs, giving the time, the heap allocations and the
+ *  values taken from the pool per operation.
+ *  The heap allocations and the values taken from the pool are counted
+ *  by wrapping malloc, calloc, realloc and get_value at link time (GNU
+ *  ld --wrap option).
+ *
+ *  Usage: hruby_calc_bench [-t <seconds per case>] [-c] [operator...]
+ *  Where -c gives the results as CSV.
+ **/
+
+
+/* The counters of the wrapped allocations. */
+static unsigned long long bench_allocs = 0;
+static unsigned long long bench_pool_values = 0;
+
+extern void* __real_malloc(size_t size);
+extern void* __real_calloc(size_t num, size_t size);
+extern void* __real_realloc(void* ptr, size_t size);
+extern Value __real_get_value();
+
+void* __wrap_malloc(size_t size) {
+    ++bench_allocs;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t num, size_t size) {
+    ++bench_allocs;
+    return __real_calloc(num,size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    ++bench_allocs;
+    return __real_realloc(ptr,size);
+}
+
+Value __wrap_get_value() {
+    ++bench_pool_values;
+    return __real_get_value();
+}
+
+
+/* The kinds of inputs. */
+typedef enum { NUMERIC, DEFINED, UNDEFINED } InputKind;
+static const char* input_kind_names[] = { "numeric", "defined", "x" };
+
+/* The widths to benchmark. */
+static unsigned long long bench_widths[] = { 1, 8, 32, 64, 65, 128, 1024 };
+
+/* The operands of a benchmark case. */
+typedef struct {
+    unsigned long long width;  /* The width of the operands. */
+    Value src0;                /* The first source. */
+    Value src1;                /* The second source. */
+    Value small;               /* A small source, e.g., a shift amount. */
+    Value target;              /* The target of the range writes. */
+    Value dst;                 /* The destination. */
+    Type wide;                 /* The type twice as wide as the sources. */
+} OperandsS;
+
+/* Prevents the results of the comparisons from being optimized out. */
+static volatile int bench_sink = 0;
+
+
+/** Fills a value with a bit pattern.
+ *  @param value the value to fill
+ *  @param kind the kind of input
+ *  @param bits the pattern of the 64 lower bits
+ *  @param repeat tells if the pattern is repeated over the upper bits,
+ *         otherwise they are 0 */
+static void fill_value(Value value, InputKind kind,
+                       unsigned long long bits, int repeat) {
+    unsigned long long width = type_width(value->type);
+    unsigned long long i;
+    if (kind == NUMERIC) {
+        value->numeric = 1;
+        value->data_int = width < 64 ? bits & ~(-1LL << width) : bits;
+        return;
+    }
+    value->numeric = 0;
+    for(i=0; i<width; ++i) {
+        int bit = i < 64 || repeat ? (bits >> (i%64)) & 1 : 0;
+        value->data_str[i] = bit + '0';
+    }
+    if (kind == UNDEFINED) value->data_str[width/2] = 'x';
+}
+
+/** Makes a value for a benchmark.
+ *  @param type the type of the value
+ *  @param kind the kind of input
+ *  @param bits the pattern of the 64 lower bits
+ *  @param repeat tells if the pattern is repeated over the upper bits */
+static Value bench_value(Type type, InputKind kind,
+                         unsigned long long bits, int repeat) {
+    Value value = make_value(type,kind == NUMERIC);
+    fill_value(value,kind,bits,repeat);
+    return value;
+}
+
+/** Sets up the operands of a case.
+ *  @param ops the operands to set up
+ *  @param width the width of the operands
+ *  @param kind the kind of input */
+static void bench_operands(OperandsS* ops, unsigned long long width,
+                           InputKind kind) {
+    Type type = get_type_vector(get_type_bit(),width);
+    ops->width = width;
+    ops->src0 = bench_value(type,kind,0x9E3779B97F4A7C15ULL,1);
+    ops->src1 = bench_value(type,kind,0x6A09E667F3BCC909ULL|1,1);
+    ops->small = bench_value(type,kind == NUMERIC ? NUMERIC : DEFINED,3,0);
+    ops->target = bench_value(type,kind,0,1);
+    ops->dst = make_value(type,kind == NUMERIC);
+    ops->wide = get_type_vector(get_type_bit(),width*2);
+}
+
+
+/* The operators. */
+
+static void op_add(OperandsS* o) { add_value(o->src0,o->src1,o->dst); }
+static void op_sub(OperandsS* o) { sub_value(o->src0,o->src1,o->dst); }
+static void op_mul(OperandsS* o) { mul_value(o->src0,o->src1,o->dst); }
+static void op_div(OperandsS* o) { div_value(o->src0,o->src1,o->dst); }
+static void op_and(OperandsS* o) { and_value(o->src0,o->src1,o->dst); }
+static void op_or(OperandsS* o)  { or_value(o->src0,o->src1,o->dst); }
+static void op_xor(OperandsS* o) { xor_value(o->src0,o->src1,o->dst); }
+static void op_not(OperandsS* o) { not_value(o->src0,o->dst); }
+static void op_shl(OperandsS* o) { shift_left_value(o->src0,o->small,o->dst); }
+static void op_shr(OperandsS* o) { shift_right_value(o->src0,o->small,o->dst); }
+static void op_eq(OperandsS* o)  { equal_value(o->src0,o->src1,o->dst); }
+static void op_lt(OperandsS* o)  { lesser_value(o->src0,o->src1,o->dst); }
+static void op_gt(OperandsS* o)  { greater_value(o->src0,o->src1,o->dst); }
+static void op_concat(OperandsS* o) {
+    concat_value(2,0,o->dst,o->src0,o->src1);
+}
+static void op_cast(OperandsS* o) { cast_value(o->src0,o->wide,o->dst); }
+static void op_read_range(OperandsS* o) {
+    read_range(o->src0,o->width/4,(o->width-1)/2,get_type_bit(),o->dst);
+}
+static void op_write_range(OperandsS* o) {
+    write_range(o->src1,o->width/4,(o->width-1)/2,get_type_bit(),o->target);
+}
+static void op_same(OperandsS* o) {
+    bench_sink += same_content_value(o->src0,o->src1);
+}
+
+/* The table of the operators. */
+typedef struct {
+    const char* name;
+    void (*run)(OperandsS*);
+} OperatorS;
+
+static OperatorS bench_operators[] = {
+    { "add", op_add }, { "sub", op_sub }, { "mul", op_mul },
+    { "div", op_div }, { "and", op_and }, { "or", op_or },
+    { "xor", op_xor }, { "not", op_not }, { "shl", op_shl },
+    { "shr", op_shr }, { "eq", op_eq }, { "lt", op_lt }, { "gt", op_gt },
+    { "concat", op_concat }, { "cast", op_cast },
+    { "read_range", op_read_range }, { "write_range", op_write_range },
+    { "same_content", op_same }
+};
+
+
+/** Gets the current time in seconds. */
+static double bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/** Runs an operator a number of times, restoring the pool of values
+ *  after each operation like the simulation kernels do.
+ *  @param op the operator
+ *  @param ops the operands
+ *  @param count the number of operations
+ *  @return the elapsed time in seconds */
+static double bench_run(OperatorS* op, OperandsS* ops, unsigned long long count) {
+    unsigned long long i;
+    double start = bench_now();
+    for(i=0; i<count; ++i) {
+        save_value_pos();
+        op->run(ops);
+        restore_value_pos();
+    }
+    return bench_now() - start;
+}
+
+/** Benchmarks a case: runs it for at least a given duration and prints
+ *  the results.
+ *  @param op the operator
+ *  @param width the width of the operands
+ *  @param kind the kind of input
+ *  @param duration the minimal duration in seconds
+ *  @param csv tells if the results are printed as CSV */
+static void bench_case(OperatorS* op, unsigned long long width,
+                       InputKind kind, double duration, int csv) {
+    OperandsS ops;
+    unsigned long long count = 1;
+    bench_operands(&ops,width,kind);
+    /* Warm up, e.g., for the resizing of the destination. */
+    bench_run(op,&ops,16);
+    /* Calibrate the number of operations. */
+    while(bench_run(op,&ops,count) < duration / 10) count *= 2;
+    count *= 10;
+    /* Measure. */
+    bench_allocs = bench_pool_values = 0;
+    double elapsed = bench_run(op,&ops,count);
+    double allocs = (double)bench_allocs / count;
+    double pool = (double)bench_pool_values / count;
+    if (csv) {
+        printf("%s,%llu,%s,%.2f,%.3f,%.3f\n",op->name,width,
+               input_kind_names[kind],elapsed*1e9/count,allocs,pool);
+    } else {
+        printf("%-13s %5llu %-8s %10.2f ns/op %8.3f allocs/op %8.3f pool/op\n",
+               op->name,width,input_kind_names[kind],elapsed*1e9/count,
+               allocs,pool);
+    }
+    fflush(stdout);
+}
+
+
+int main(int argc, char* argv[]) {
+    double duration = 0.05;
+    int csv = 0;
+    int num_selected = 0;
+    char** selected = calloc(argc,sizeof(char*));
+    int i, o, w, k;
+    for(i=1; i<argc; ++i) {
+        if (strcmp(argv[i],"-t") == 0 && i+1 < argc) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i],"-c") == 0) {
+            csv = 1;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr,"Usage: %s [-t <seconds per case>] [-c] "
+                    "[operator...]\n",argv[0]);
+            return 1;
+        } else {
+            selected[num_selected++] = argv[i];
+        }
+    }
+    if (csv) printf("operator,width,input,ns_per_op,allocs_per_op,"
+                    "pool_per_op\n");
+    int num_operators = sizeof(bench_operators)/sizeof(OperatorS);
+    int num_widths = sizeof(bench_widths)/sizeof(unsigned long long);
+    for(o=0; o<num_operators; ++o) {
+        OperatorS* op = &bench_operators[o];
+        if (num_selected > 0) {
+            for(i=0; i<num_selected; ++i)
+                if (strcmp(selected[i],op->name) == 0) break;
+            if (i == num_selected) continue;
+        }
+        for(w=0; w<num_widths; ++w) {
+            for(k=NUMERIC; k<=UNDEFINED; ++k) {
+                /* Numeric values are at most 64-bit wide. */
+                if (k == NUMERIC && bench_widths[w] > 64) continue;
+                bench_case(op,bench_widths[w],k,duration,csv);
+            }
+        }
+    }
+    return 0;
+}
@@ -9,5 +9,10 @@ append_cflags(["-g"])
 abort "missing malloc()" unless have_func "malloc"
 abort "missing free()"   unless have_func "free"
 
+# For compressing the waveform files.
+if have_library("z","deflateInit2_","zlib.h") then
+    append_cppflags(["-DHAVE_ZLIB"])
+end
+
 create_header
 create_makefile 'hruby_sim/hruby_sim'
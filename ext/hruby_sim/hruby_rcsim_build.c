@@ -201,17 +201,18 @@ VALUE rcsim_get_type_vector(VALUE mod, VALUE baseV, VALUE numV) {
 
 /*#### Creating the C simulation objects. ####*/
 
+/* NOTE: the C objects are created by the build_ functions, which are
+ * shared by the rcsim_make_ functions of the Ruby interface and by the
+ * builder from a serialized buffer (rcsim_build_from_buffer). */
+
 /* Creating a systemT C object. */
-VALUE rcsim_make_systemT(VALUE mod, VALUE name) {
-    // printf("rcsim_make_systemT\n");
+static SystemT build_systemT(const char* name) {
     /* Allocates the systemT. */
     SystemT systemT = (SystemT)malloc(sizeof(SystemTS));
-    // printf("systemT=%p\n",systemT);
     /* Set it up. */
     systemT->kind = SYSTEMT;
     systemT->owner = NULL;
-    systemT->name = strdup(StringValueCStr(name));
-    // printf("systemT->name=%p\n",systemT->name);
+    systemT->name = strdup(name);
     systemT->num_inputs = 0;
     systemT->inputs = NULL;
     systemT->num_outputs = 0;
@@ -219,25 +220,25 @@ VALUE rcsim_make_systemT(VALUE mod, VALUE name) {
     systemT->num_inouts = 0;
     systemT->inouts = NULL;
     systemT->scope = NULL;
-    // printf("Created systemT with kind=%d and name=%s\n",systemT->kind,systemT->name);
+    return systemT;
+}
+
+VALUE rcsim_make_systemT(VALUE mod, VALUE name) {
     /* Returns the C systemT embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(SystemTS,systemT,res);
+    rcsim_to_value(SystemTS,build_systemT(StringValueCStr(name)),res);
     return res;
 }
 
 
 /* Creating a scope C object. */
-VALUE rcsim_make_scope(VALUE mod, VALUE name) {
-    // printf("rcsim_make_scope\n");
+static Scope build_scope(const char* name) {
     /* Allocates the scope. */
     Scope scope = (Scope)malloc(sizeof(ScopeS));
-    // printf("scope=%p\n",scope);
     /* Set it up. */
     scope->kind = SCOPE;
     scope->owner = NULL;
-    scope->name = strdup(StringValueCStr(name));
-    // printf("scope->name=%p\n",scope->name);
+    scope->name = strdup(name);
     scope->num_systemIs = 0;
     scope->systemIs = NULL;
     scope->num_inners = 0;
@@ -248,19 +249,21 @@ VALUE rcsim_make_scope(VALUE mod, VALUE name) {
     scope->behaviors = NULL;
     scope->num_codes = 0;
     scope->codes = NULL;
+    return scope;
+}
+
+VALUE rcsim_make_scope(VALUE mod, VALUE name) {
     /* Returns the C scope embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(ScopeS,scope,res);
+    rcsim_to_value(ScopeS,build_scope(StringValueCStr(name)),res);
     return res;
 }
 
 
 /* Creating a behavior C object. */
-VALUE rcsim_make_behavior(VALUE mod, VALUE timed) {
-    // printf("rcsim_make_behavior\n");
+static Behavior build_behavior(int timed) {
     /* Allocates the behavior. */
     Behavior behavior = (Behavior)malloc(sizeof(BehaviorS));
-    // printf("behavior=%p\n",behavior);
     /* Set it up. */
     behavior->kind = BEHAVIOR;
     behavior->owner = NULL;
@@ -269,7 +272,10 @@ VALUE rcsim_make_behavior(VALUE mod, VALUE timed) {
     behavior->block = NULL;
     behavior->enabled = 0;
     behavior->activated = 0;
-    if (TYPE(timed) == T_TRUE) {
+    behavior->activations = 0;
+    behavior->profile_time = 0;
+    behavior->profile_samples = 0;
+    if (timed) {
         /* The behavior is timed, set it up and register it. */
         behavior->timed = 1;
         register_timed_behavior(behavior);
@@ -282,135 +288,145 @@ VALUE rcsim_make_behavior(VALUE mod, VALUE timed) {
     behavior->active_time = 0;
     // behavior->thread = NULL;
     behavior->thread = 0;
+    return behavior;
+}
+
+VALUE rcsim_make_behavior(VALUE mod, VALUE timed) {
     /* Returns the C behavior embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(BehaviorS,behavior,res);
+    rcsim_to_value(BehaviorS,build_behavior(TYPE(timed) == T_TRUE),res);
     return res;
 }
 
 
-/* Creating an event C object. */
-VALUE rcsim_make_event(VALUE mod, VALUE typeV, VALUE sigV) {
-    // printf("rcsim_make_event\n");
+/* Creating an event C object.
+ * NOTE: the edge is given by the first character of its name. */
+static Event build_event(char edge, SignalI signal) {
     /* Allocates the event. */
     Event event = (Event)malloc(sizeof(EventS));
-    // printf("event=%p\n",event);
     /* Set it up. */
     event->kind = EVENT;
     event->owner = NULL;
     /* Its type. */
-    ID id_edge = SYM2ID(typeV);
-    if      (id_edge == id_POSEDGE) { event->edge = POSEDGE; }
-    else if (id_edge == id_NEGEDGE) { event->edge = NEGEDGE; }
-    else if (id_edge == id_ANYEDGE) { event->edge = ANYEDGE; }
-    else  { perror("Invalid edge type."); }
+    switch(edge) {
+        case 'p': event->edge = POSEDGE; break;
+        case 'n': event->edge = NEGEDGE; break;
+        case 'a': event->edge = ANYEDGE; break;
+        default:  perror("Invalid edge type.");
+    }
     /* Its signal. */
-    value_to_rcsim(SignalIS,sigV,event->signal);
+    event->signal = signal;
+    return event;
+}
+
+VALUE rcsim_make_event(VALUE mod, VALUE typeV, VALUE sigV) {
+    /* Get the signal. */
+    SignalI signal;
+    value_to_rcsim(SignalIS,sigV,signal);
+    /* Get the edge. */
+    ID id_edge = SYM2ID(typeV);
+    char edge = id_edge == id_POSEDGE ? 'p' :
+                id_edge == id_NEGEDGE ? 'n' :
+                id_edge == id_ANYEDGE ? 'a' : 0;
     /* Returns the C event embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(EventS,event,res);
+    rcsim_to_value(EventS,build_event(edge,signal),res);
     return res;
 }
 
 
-static size_t last_signal_id = 0;
-
 /* Creating a signal C object. */
-VALUE rcsim_make_signal(VALUE mod, VALUE name, VALUE type) {
-    // printf("rcsim_make_signal\n");
+static SignalI build_signal(const char* name, Type type) {
     /* Allocates the signal. */
     SignalI signal = (SignalI)malloc(sizeof(SignalIS));
-    signal->id = last_signal_id++;
-    // printf("signal=%p\n",signal);
+    signal->id = make_signal_id();
+    signal->dump = 1;
+    signal->check = 0;
     /* Set it up. */
     signal->kind = SIGNALI;
     signal->owner = NULL;
-    signal->name = strdup(StringValueCStr(name));
-    // printf("signal->name=%p\n",signal->name);
-    // printf("Creating signal named=%s\n",signal->name);
-    value_to_rcsim(TypeS,type,signal->type);
-    // printf("&type=%p type=%p width=%llu\n",&(signal->type),signal->type,type_width(signal->type));
+    signal->name = strdup(name);
+    signal->type = type;
     signal->num_signals= 0;
     signal->signals = NULL;
 
     signal->c_value = make_value(signal->type,0);
-    // printf("signal->c_value=%p\n",signal->c_value);
     signal->c_value->signal = signal;
-    // printf("c_value=%p type=%p\n",signal->c_value,signal->c_value->type);
-    // printf("c_value type width=%llu\n",type_width(signal->c_value->type));
     signal->f_value = make_value(signal->type,0);
-    // printf("signal->f_value=%p\n",signal->f_value);
     signal->f_value->signal = signal;
     signal->fading = 1; /* Initially the signal can be overwritten by anything.*/
     signal->num_any = 0;
     signal->any = NULL;
-    // signal->any = (SignalI*)calloc(32,sizeof(SignalI));
     signal->num_pos = 0;
     signal->pos = NULL;
-    // signal->pos = (SignalI*)calloc(32,sizeof(SignalI));
     signal->num_neg = 0;
     signal->neg = NULL;
-    // signal->neg = (SignalI*)calloc(32,sizeof(SignalI));
     /* Register the signal. */
     register_signal(signal);
+    return signal;
+}
+
+VALUE rcsim_make_signal(VALUE mod, VALUE name, VALUE typeV) {
+    /* Get the type. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
     /* Returns the C signal embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(SignalIS,signal,res);
+    rcsim_to_value(SignalIS,build_signal(StringValueCStr(name),type),res);
     return res;
 }
 
 
 /* Creating a system instance C object. */
-VALUE rcsim_make_systemI(VALUE mod, VALUE name, VALUE systemT) {
-    // printf("rcsim_make_systemI\n");
+static SystemI build_systemI(const char* name, SystemT systemT) {
     /* Allocates the system instance. */
     SystemI systemI = (SystemI)malloc(sizeof(SystemIS));
-    // printf("systemI=%p\n",systemI);
     /* Set it up. */
     systemI->kind = SYSTEMI;
     systemI->owner = NULL;
-    systemI->name = strdup(StringValueCStr(name));
-    // printf("systemI->name=%p\n",systemI->name);
+    systemI->name = strdup(name);
     // /* Name is made empty since redundant with Eigen system. */
     // systemI->name = "";
-    value_to_rcsim(SystemTS,systemT,systemI->system);
+    systemI->system = systemT;
     systemI->num_systems = 1;
     systemI->systems = (SystemT*)malloc(sizeof(SystemT[1]));
-    // printf("systemI->systems=%p\n",systemI->systems); fflush(stdout);
     systemI->systems[0] = systemI->system;
     /* Configure the systemI to execute the default systemT. */
     configure(systemI,0);
+    return systemI;
+}
+
+VALUE rcsim_make_systemI(VALUE mod, VALUE name, VALUE systemTV) {
+    /* Get the system type. */
+    SystemT systemT;
+    value_to_rcsim(SystemTS,systemTV,systemT);
     /* Returns the C system instance embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(SystemIS,systemI,res);
+    rcsim_to_value(SystemIS,build_systemI(StringValueCStr(name),systemT),res);
     return res;
 }
 
 
 void ruby_function_wrap(Code);
 
-/* Creating a system code C object. 
+/* Creating a system code C object.
  * Note: HDLRuby Code object are actually refactored to Program object,
  *       but the low-level simulation still use Code as data structure.
  *       Hence, it may change in the future. */
-VALUE rcsim_make_code(VALUE mod, VALUE lang, VALUE funcname) {
-    // printf("rcsim_make_code\n");
+static Code build_code(const char* lang, const char* funcname) {
     /* Allocates the code. */
     Code code = (Code)malloc(sizeof(CodeS));
-    // printf("code=%p\n",code);
     /* Set it up. */
     code->kind  = CODE;
     code->owner = NULL;
-    code->name = strdup(StringValueCStr(funcname));
-    // printf("code->name=%p\n",code->name);
+    code->name = strdup(funcname);
     code->num_events = 0;
     code->events = NULL;
     code->function = NULL;
-    char* langStr = StringValueCStr(lang);
-    if(strncmp(langStr,"ruby",4) == 0) {
+    if(strncmp(lang,"ruby",4) == 0) {
         /* Ruby function. */
         code->function = ruby_function_wrap;
-    } else if (strncmp(langStr,"c",1) == 0) {
+    } else if (strncmp(lang,"c",1) == 0) {
         /* C or C-compatible dynamically compiled code: it will be loaded
          * afterward */
         code->function = NULL;
@@ -421,9 +437,17 @@ VALUE rcsim_make_code(VALUE mod, VALUE lang, VALUE funcname) {
     }
     code->enabled = 0;
     code->activated = 0;
+    code->activations = 0;
+    code->profile_time = 0;
+    code->profile_samples = 0;
+    return code;
+}
+
+VALUE rcsim_make_code(VALUE mod, VALUE lang, VALUE funcname) {
     /* Returns the C code embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(CodeS,code,res);
+    rcsim_to_value(CodeS,build_code(StringValueCStr(lang),
+                                    StringValueCStr(funcname)),res);
     return res;
 }
 
@@ -431,23 +455,17 @@ VALUE rcsim_make_code(VALUE mod, VALUE lang, VALUE funcname) {
 
 
 #if defined(_WIN32) || defined(_WIN64)
-/** Loads a C program dynamic library (called from HDLRuby) for a code. */
-VALUE rcsim_load_c(VALUE mod, VALUE codeV, VALUE libnameV, VALUE funcnameV) {
-    char* libname;
-    char* funcname;
-    Code code;
+/** Loads a C program dynamic library for a code. */
+static void load_c_code(Code code, const char* libname, const char* funcname) {
     HINSTANCE handle;
 
-    libname  = StringValueCStr(libnameV);
-    funcname = StringValueCStr(funcnameV);
-
     char path[1024];
 
     if (getcwd(path, sizeof(path)) != NULL) {
         printf("Current working directory: %s\n", path);
     } else {
         perror("getcwd error");
-        return 1;
+        return;
     }
 
     if(strlen(path) + strlen(libname) >= 1023) {
@@ -456,9 +474,7 @@ VALUE rcsim_load_c(VALUE mod, VALUE codeV, VALUE libnameV, VALUE funcnameV) {
     strcat(path,"/");
     strcat(path,libname);
     // printf("Loading c program at: %s\n",path);
-   
-    /* Get the code. */ 
-    value_to_rcsim(CodeS,codeV,code);
+
     /* Load the library. */
     handle = LoadLibrary(TEXT(path));
     if (handle == NULL) {
@@ -473,21 +489,12 @@ VALUE rcsim_load_c(VALUE mod, VALUE codeV, VALUE libnameV, VALUE funcnameV) {
         fprintf(stderr,"Unable to get function: %s\n",code->name);
         exit(-1);
     }
-    return codeV;
 }
 #else
-/** Loads a C program dynamic library (called from HDLRuby) for a code. */
-VALUE rcsim_load_c(VALUE mod, VALUE codeV, VALUE libnameV, VALUE funcnameV) {
-    char* libname;
-    char* funcname;
-    Code code;
+/** Loads a C program dynamic library for a code. */
+static void load_c_code(Code code, const char* libname, const char* funcname) {
     void* handle;
 
-    libname  = StringValueCStr(libnameV);
-    funcname = StringValueCStr(funcnameV);
-   
-    /* Get the code. */ 
-    value_to_rcsim(CodeS,codeV,code);
     /* Load the library. */
     handle = dlopen(libname,RTLD_NOW | RTLD_GLOBAL);
     if (handle == NULL) {
@@ -499,63 +506,76 @@ VALUE rcsim_load_c(VALUE mod, VALUE codeV, VALUE libnameV, VALUE funcnameV) {
         fprintf(stderr,"Unable to get function: %s\n",code->name);
         exit(-1);
     }
-    return codeV;
 }
 #endif
 
+/** Loads a C program dynamic library (called from HDLRuby) for a code. */
+VALUE rcsim_load_c(VALUE mod, VALUE codeV, VALUE libnameV, VALUE funcnameV) {
+    /* Get the code. */
+    Code code;
+    value_to_rcsim(CodeS,codeV,code);
+    /* Load the library. */
+    load_c_code(code,StringValueCStr(libnameV),StringValueCStr(funcnameV));
+    return codeV;
+}
+
 
 
 /* Creating a transmit C object. */
-VALUE rcsim_make_transmit(VALUE mod, VALUE left, VALUE right) {
-    // printf("rcsim_make_transmit\n");
+static Transmit build_transmit(Reference left, Expression right) {
     /* Allocates the transmit. */
     Transmit transmit = (Transmit)malloc(sizeof(TransmitS));
-    // printf("transmit=%p\n",transmit);
     /* Set it up. */
     transmit->kind = TRANSMIT;
     transmit->owner = NULL;
-    value_to_rcsim(ReferenceS,left,transmit->left);
-    value_to_rcsim(ExpressionS,right,transmit->right);
+    transmit->left = left;
+    transmit->right = right;
+    return transmit;
+}
+
+VALUE rcsim_make_transmit(VALUE mod, VALUE leftV, VALUE rightV) {
+    /* Get the left and right sides. */
+    Reference left;
+    value_to_rcsim(ReferenceS,leftV,left);
+    Expression right;
+    value_to_rcsim(ExpressionS,rightV,right);
     /* Returns the C transmit embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(TransmitS,transmit,res);
+    rcsim_to_value(TransmitS,build_transmit(left,right),res);
     return res;
 }
 
 
 /* Creating a print C object. */
-VALUE rcsim_make_print(VALUE mod) {
-    // printf("rcsim_make_print\n");
+static Print build_print() {
     /* Allocates the print. */
     Print print = (Print)malloc(sizeof(PrintS));
-    // printf("print=%p\n",print);
     /* Set it up. */
     print->kind = PRINT;
     print->owner = NULL;
     print->num_args = 0;
     print->args = NULL;
+    return print;
+}
+
+VALUE rcsim_make_print(VALUE mod) {
     /* Returns the C print embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(PrintS,print,res);
+    rcsim_to_value(PrintS,build_print(),res);
     return res;
 }
 
 
-/* Creating a time wait C object. */
-VALUE rcsim_make_timeWait(VALUE mod, VALUE unitV, VALUE delayV) {
-    // printf("rcsim_make_timeWait\n");
+/* Creating a time wait C object.
+ * NOTE: the unit is given by the first character of its name. */
+static TimeWait build_timeWait(char unit, unsigned long long delay) {
     /* Allocates the time wait. */
     TimeWait timeWait = (TimeWait)malloc(sizeof(TimeWaitS));
-    // printf("timeWait=%p\n",timeWait);
     /* Set it up. */
     timeWait->kind = TIME_WAIT;
     timeWait->owner = NULL;
-    /* Compute the delay. */
-    unsigned long long delay;
-    delay = NUM2LL(delayV);
     /* Adjust the delay depending on the unit. */
-    const char* unit = rb_id2name(SYM2ID(unitV));
-    switch(unit[0]) {
+    switch(unit) {
         case 'f': delay /= 1000;          break;
         case 'p': /* Ok as is. */         break;
         case 'n': delay *= 1000;          break;
@@ -566,106 +586,159 @@ VALUE rcsim_make_timeWait(VALUE mod, VALUE unitV, VALUE delayV) {
                   perror("Invalid delay unit.");
     }
     timeWait->delay = delay;
+    return timeWait;
+}
+
+VALUE rcsim_make_timeWait(VALUE mod, VALUE unitV, VALUE delayV) {
+    const char* unit = rb_id2name(SYM2ID(unitV));
     /* Returns the C time wait embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(TimeWaitS,timeWait,res);
+    rcsim_to_value(TimeWaitS,build_timeWait(unit[0],NUM2LL(delayV)),res);
     return res;
 }
 
 /* Creating a time repeat C object. */
-VALUE rcsim_make_timeRepeat(VALUE mod, VALUE numberV, VALUE statementV) {
-    // printf("rcsim_make_timeRepeat\n"); fflush(stdout);
+static TimeRepeat build_timeRepeat(long long number, Statement statement) {
     /* Allocates the time repeat. */
     TimeRepeat timeRepeat = (TimeRepeat)malloc(sizeof(TimeRepeatS));
-    // printf("timeRepeat=%p\n",timeRepeat); fflush(stdout);
     /* Set it up. */
     timeRepeat->kind = TIME_REPEAT;
     timeRepeat->owner = NULL;
-    /* Get and set the number of repeatition. */
-    long long number;
-    number = NUM2LL(numberV);
-    // printf("number=%lld\n",number); fflush(stdout);
     timeRepeat->number = number;
-    /* Get and set the statement. */
-    value_to_rcsim(StatementS,statementV,timeRepeat->statement);
-    /* Returns the C time wait embedded into a ruby VALUE. */
+    timeRepeat->statement = statement;
+    return timeRepeat;
+}
+
+VALUE rcsim_make_timeRepeat(VALUE mod, VALUE numberV, VALUE statementV) {
+    /* Get the statement. */
+    Statement statement;
+    value_to_rcsim(StatementS,statementV,statement);
+    /* Returns the C time repeat embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(TimeRepeatS,timeRepeat,res);
+    rcsim_to_value(TimeRepeatS,build_timeRepeat(NUM2LL(numberV),statement),
+                   res);
     return res;
 }
 
 
 /* Creating a time terminate C object. */
-VALUE rcsim_make_timeTerminate(VALUE mod) {
-    // printf("rcsim_make_timeTerminate\n");
+static TimeTerminate build_timeTerminate() {
     /* Allocates the time terminate. */
     TimeTerminate timeTerminate = (TimeTerminate)malloc(sizeof(TimeTerminateS));
-    // printf("timeTerminate=%p\n",timeTerminate);
     /* Set it up. */
     timeTerminate->kind = TIME_TERMINATE;
     timeTerminate->owner = NULL;
+    return timeTerminate;
+}
+
+VALUE rcsim_make_timeTerminate(VALUE mod) {
     /* Returns the C time terminate embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(TimeTerminateS,timeTerminate,res);
+    rcsim_to_value(TimeTerminateS,build_timeTerminate(),res);
+    return res;
+}
+
+/* Creating a time dump switch C object. */
+static TimeDump build_timeDump(int on) {
+    /* Allocates the time dump switch. */
+    TimeDump timeDump = (TimeDump)malloc(sizeof(TimeDumpS));
+    /* Set it up. */
+    timeDump->kind = TIME_DUMP;
+    timeDump->owner = NULL;
+    timeDump->on = on;
+    return timeDump;
+}
+
+VALUE rcsim_make_timeDump(VALUE mod, VALUE onV) {
+    /* Returns the C time dump switch embedded into a ruby VALUE. */
+    VALUE res;
+    rcsim_to_value(TimeDumpS,build_timeDump(NUM2INT(onV)),res);
+    return res;
+}
+
+/* Creating a clock generator C object.
+ * NOTE: the times are given in ps. */
+VALUE rcsim_make_clock(VALUE mod, VALUE sigV, VALUE periodV, VALUE dutyV,
+                       VALUE phaseV, VALUE startV, VALUE numberV) {
+    // printf("rcsim_make_clock\n");
+    /* Get the driven signal. */
+    SignalI signal;
+    value_to_rcsim(SignalIS,sigV,signal);
+    /* Creates and registers the clock. */
+    Clock clock = make_clock(signal,NUM2ULL(periodV),NUM2ULL(dutyV),
+                             NUM2ULL(phaseV),NUM2INT(startV),
+                             NUM2LL(numberV));
+    /* Returns the C clock embedded into a ruby VALUE. */
+    VALUE res;
+    rcsim_to_value(ClockS,clock,res);
     return res;
 }
 
 
 /* Creating a hardware if C object. */
-VALUE rcsim_make_hif(VALUE mod, VALUE conditionV, VALUE yesV, VALUE noV) {
-    // printf("rcsim_make_hif\n");
+static HIf build_hif(Expression condition, Statement yes, Statement no) {
     /* Allocates the hardware if. */
     HIf hif = (HIf)malloc(sizeof(HIfS));
-    // printf("hif=%p\n",hif);
     /* Set it up. */
     hif->kind = HIF;
     hif->owner = NULL;
-    value_to_rcsim(ExpressionS,conditionV,hif->condition);
-    value_to_rcsim(StatementS,yesV,hif->yes);
-    if (TYPE(noV) == T_NIL)
-        hif->no = NULL;
-    else
-        value_to_rcsim(StatementS,noV,hif->no);
+    hif->condition = condition;
+    hif->yes = yes;
+    hif->no = no;
     hif->num_noifs = 0;
     hif->noconds = NULL;
     hif->nostmnts = NULL;
+    return hif;
+}
+
+VALUE rcsim_make_hif(VALUE mod, VALUE conditionV, VALUE yesV, VALUE noV) {
+    /* Get the condition and the statements. */
+    Expression condition;
+    value_to_rcsim(ExpressionS,conditionV,condition);
+    Statement yes, no = NULL;
+    value_to_rcsim(StatementS,yesV,yes);
+    if (TYPE(noV) != T_NIL)
+        value_to_rcsim(StatementS,noV,no);
     /* Returns the C hardware if embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(HIfS,hif,res);
+    rcsim_to_value(HIfS,build_hif(condition,yes,no),res);
     return res;
 }
 
 
 /* Creating a hardware case C object. */
-VALUE rcsim_make_hcase(VALUE mod, VALUE valueV, VALUE defoltV) {
-    // printf("rcsim_make_hcase\n");
+static HCase build_hcase(Expression value, Statement defolt) {
     /* Allocates the hardware case. */
     HCase hcase = (HCase)malloc(sizeof(HCaseS));
-    // printf("hcase=%p\n",hcase);
     /* Set it up. */
     hcase->kind = HCASE;
     hcase->owner = NULL;
-    value_to_rcsim(ExpressionS,valueV,hcase->value);
+    hcase->value = value;
     hcase->num_whens = 0;
     hcase->matches = NULL;
     hcase->stmnts = NULL;
-    if (TYPE(defoltV) == T_NIL)
-        hcase->defolt = NULL;
-    else
-        value_to_rcsim(StatementS,defoltV,hcase->defolt);
+    hcase->defolt = defolt;
+    return hcase;
+}
+
+VALUE rcsim_make_hcase(VALUE mod, VALUE valueV, VALUE defoltV) {
+    /* Get the value and the default statement. */
+    Expression value;
+    value_to_rcsim(ExpressionS,valueV,value);
+    Statement defolt = NULL;
+    if (TYPE(defoltV) != T_NIL)
+        value_to_rcsim(StatementS,defoltV,defolt);
     /* Returns the C hardware case embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(HCaseS,hcase,res);
+    rcsim_to_value(HCaseS,build_hcase(value,defolt),res);
     return res;
 }
 
 
 /* Creating a block C object. */
-VALUE rcsim_make_block(VALUE mod, VALUE modeV) {
-    // printf("rcsim_make_block\n");
+static Block build_block(Mode mode) {
     /* Allocates the block. */
     Block block = (Block)malloc(sizeof(BlockS));
-    // printf("block=%p\n",block);
     /* Set it up. */
     block->kind = BLOCK;
     block->owner = NULL;
@@ -674,112 +747,224 @@ VALUE rcsim_make_block(VALUE mod, VALUE modeV) {
     block->inners = NULL;
     block->num_stmnts = 0;
     block->stmnts = NULL;
-    block->mode = SYM2ID(modeV) == id_PAR ? PAR : SEQ;
+    block->mode = mode;
+    return block;
+}
+
+VALUE rcsim_make_block(VALUE mod, VALUE modeV) {
     /* Returns the C block embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(BlockS,block,res);
+    rcsim_to_value(BlockS,build_block(SYM2ID(modeV) == id_PAR ? PAR : SEQ),
+                   res);
     return res;
 }
 
 
+/*#### The pool of interned constant values. ####*/
+
+/* The constant values are shared among all the expressions using them,
+ * they are indexed by type and content. */
+#define CONST_POOL_SIZE 4096
+static List const_pool[CONST_POOL_SIZE] = {};
+
+/* The statistics of the pool. */
+static unsigned long long const_pool_hits = 0;
+static unsigned long long const_pool_misses = 0;
+
+/** Computes the hash value of a constant.
+ *  @param type the type of the constant
+ *  @param numeric tells if the constant is numeric
+ *  @param data_int the content of a numeric constant
+ *  @param data_str the content of a bitstring constant
+ *  @return the resulting hash value. */
+static int const_hash_value(Type type, int numeric,
+                            unsigned long long data_int,
+                            const char* data_str) {
+    unsigned long long hvalue = (unsigned long long)type;
+    if (numeric) {
+        hvalue ^= data_int * 0x9E3779B97F4A7C15ULL;
+    } else {
+        for(; *data_str; ++data_str) hvalue = hvalue*31 + *data_str;
+    }
+    return (hvalue ^ (hvalue >> 17)) & (CONST_POOL_SIZE-1);
+}
+
+/** Gets a constant from the pool.
+ *  @param hvalue the hash value of the constant
+ *  @param type the type of the constant
+ *  @param numeric tells if the constant is numeric
+ *  @param data_int the content of a numeric constant
+ *  @param data_str the content of a bitstring constant
+ *  @return the constant if found, NULL otherwise. */
+static Value get_const_value(int hvalue, Type type, int numeric,
+                             unsigned long long data_int,
+                             const char* data_str) {
+    List entry = const_pool[hvalue];
+    if (entry) {
+        Elem elem = entry->head;
+        while(elem) {
+            Value value = elem->data;
+            if (value->type == type && value->numeric == numeric &&
+                (numeric ? value->data_int == data_int :
+                           strcmp(value->data_str,data_str) == 0)) {
+                /* The constant is found. */
+                ++const_pool_hits;
+                return value;
+            }
+            elem = elem->next;
+        }
+    }
+    /* The constant is not found. */
+    ++const_pool_misses;
+    return NULL;
+}
+
+/** Adds a constant to the pool.
+ *  @param hvalue the hash value of the constant
+ *  @param value the constant to add */
+static void add_const_value(int hvalue, Value value) {
+    List entry = const_pool[hvalue];
+    if (!entry) {
+        /* No entry, create a new one. */
+        entry = (List)malloc(sizeof(ListS));
+        entry = build_list(entry);
+        const_pool[hvalue] = entry;
+    }
+    add_list(entry,get_element(value));
+}
+
+
 /* Creating a numeric value C object. */
+static Value build_value_numeric(Type type, unsigned long long content) {
+    /* Look for the value in the pool of constants. */
+    int hvalue = const_hash_value(type,1,content,NULL);
+    Value value = get_const_value(hvalue,type,1,content,NULL);
+    if (!value) {
+        /* Not found, create the value. */
+        value = make_value(type,1);
+        /* Set it to numeric. */
+        value->numeric = 1;
+        value->capacity = 0;
+        value->data_str = NULL;
+        value->data_int = content;
+        add_const_value(hvalue,value);
+    }
+    return value;
+}
+
 VALUE rcsim_make_value_numeric(VALUE mod, VALUE typeV, VALUE contentV) {
-    // printf("rcsim_make_value_numeric\n");
     /* Get the type. */
     Type type;
     value_to_rcsim(TypeS,typeV,type);
-    /* Create the value. */
-    Value value = make_value(type,0);
-    // printf("value=%p\n",value);
-    /* Set it to numeric. */
-    value->numeric = 1;
-    value->capacity = 0;
-    value->data_str = NULL;
-    value->data_int = NUM2LL(contentV);
-    // printf("value->data_int=%lld\n",value->data_int);
     /* Returns the C value embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(ValueS,value,res);
+    rcsim_to_value(ValueS,build_value_numeric(type,NUM2LL(contentV)),res);
     return res;
 }
 
 
 /* Creating a bitstring value C object. */
+static Value build_value_bitstring(Type type, const char* str) {
+    /* Look for the value in the pool of constants. */
+    int hvalue = const_hash_value(type,0,0,str);
+    Value value = get_const_value(hvalue,type,0,0,str);
+    if (!value) {
+        /* Not found, create the value. */
+        value = make_value(type,1);
+        /* Set it to bitstring. */
+        value->numeric = 0;
+        value->capacity = strlen(str)+1;
+        value->data_str = calloc(value->capacity,sizeof(char));
+        strcpy(value->data_str,str);
+        add_const_value(hvalue,value);
+    }
+    return value;
+}
+
 VALUE rcsim_make_value_bitstring(VALUE mod, VALUE typeV, VALUE contentV) {
-    // printf("rcsim_make_value_bitstring\n");
     /* Get the type. */
     Type type;
     value_to_rcsim(TypeS,typeV,type);
-    /* Create the value. */
-    Value value = make_value(type,0);
-    // printf("value=%p\n",value);
-    // printf("Created from bitstring value=%p with type=%p\n",value,value->type);
-    // printf("and width=%llu\n",type_width(value->type));
-    /* Set it to bitstring. */
-    value->numeric = 0;
-    /* Generate the string of the content. */
-    char* str = StringValueCStr(contentV);
-    value->capacity = strlen(str)+1;
-    value->data_str = calloc(value->capacity,sizeof(char));
-    // printf("value->data_str=%p\n",value->data_str);
-    strcpy(value->data_str,str);
     /* Returns the C value embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(ValueS,value,res);
+    rcsim_to_value(ValueS,build_value_bitstring(type,StringValueCStr(contentV)),
+                   res);
     return res;
 }
 
+/** Gets the statistics of the pool of constants as an array giving the
+ *  number of reused constants (hits) and of created ones (misses). */
+VALUE rcsim_get_const_pool_stats(VALUE mod) {
+    return rb_ary_new_from_args(2,ULL2NUM(const_pool_hits),
+                                  ULL2NUM(const_pool_misses));
+}
+
 
 /* Creating a cast C object. */
-VALUE rcsim_make_cast(VALUE mod, VALUE type, VALUE child) {
-    // printf("rcsim_make_cast\n");
+static Cast build_cast(Type type, Expression child) {
     /* Allocates the cast. */
     Cast cast = (Cast)malloc(sizeof(CastS));
-    // printf("cast=%p\n",cast);
     /* Set it up. */
     cast->kind = CAST;
     cast->owner = NULL;
-    value_to_rcsim(TypeS,type,cast->type);
-    value_to_rcsim(ExpressionS,child,cast->child);
+    cast->type = type;
+    cast->child = child;
+    return cast;
+}
+
+VALUE rcsim_make_cast(VALUE mod, VALUE typeV, VALUE childV) {
+    /* Get the type and the child. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
+    Expression child;
+    value_to_rcsim(ExpressionS,childV,child);
     /* Returns the C cast embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(CastS,cast,res);
+    rcsim_to_value(CastS,build_cast(type,child),res);
     return res;
 }
 
-/* Creating a unary value C object. */
-VALUE rcsim_make_unary(VALUE mod, VALUE type, VALUE operator, VALUE child) {
-    // printf("rcsim_make_unary\n");
+/* Creating a unary value C object.
+ * NOTE: the operator is given by its sym_to_char code. */
+static Unary build_unary(Type type, unsigned char operator, Expression child) {
     /* Allocates the unary. */
     Unary unary= (Unary)malloc(sizeof(UnaryS));
-    // printf("unary=%p\n",unary);
     /* Set it up. */
     unary->kind = UNARY;
     unary->owner = NULL;
-    value_to_rcsim(TypeS,type,unary->type);
-    switch(sym_to_char(operator)) {
+    unary->type = type;
+    switch(operator) {
         case (unsigned char)'~':         unary->oper = not_value; break;
         case (unsigned char)('-'+'@'*2): unary->oper = neg_value; break;
         default: perror("Invalid operator for unary.");
     }
-    value_to_rcsim(ExpressionS,child,unary->child);
+    unary->child = child;
+    return unary;
+}
+
+VALUE rcsim_make_unary(VALUE mod, VALUE typeV, VALUE operator, VALUE childV) {
+    /* Get the type and the child. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
+    Expression child;
+    value_to_rcsim(ExpressionS,childV,child);
     /* Returns the C unary embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(UnaryS,unary,res);
+    rcsim_to_value(UnaryS,build_unary(type,sym_to_char(operator),child),res);
     return res;
 }
 
-/* Creating a binary value C object. */
-VALUE rcsim_make_binary(VALUE mod, VALUE type, VALUE operator, VALUE left, VALUE right) {
-    // printf("rcsim_make_binary\n");
+/* Creating a binary value C object.
+ * NOTE: the operator is given by its sym_to_char code. */
+static Binary build_binary(Type type, unsigned char operator,
+                           Expression left, Expression right) {
     /* Allocates the binary. */
     Binary binary = (Binary)malloc(sizeof(BinaryS));
-    // printf("binary=%p\n",binary);
     /* Set it up. */
     binary->kind = BINARY;
     binary->owner = NULL;
-    value_to_rcsim(TypeS,type,binary->type);
-    switch(sym_to_char(operator)) {
+    binary->type = type;
+    switch(operator) {
         case (unsigned char)'+':         binary->oper = add_value; break;
         case (unsigned char)'-':         binary->oper = sub_value; break;
         case (unsigned char)'*':         binary->oper = mul_value; break;
@@ -798,127 +983,209 @@ VALUE rcsim_make_binary(VALUE mod, VALUE type, VALUE operator, VALUE left, VALUE
         case (unsigned char)('>'+'='*2): binary->oper = greater_equal_value; break;
         default: perror("Invalid operator for binary.");
     }
-    value_to_rcsim(ExpressionS,left,binary->left);
-    value_to_rcsim(ExpressionS,right,binary->right);
+    binary->left = left;
+    binary->right = right;
+    return binary;
+}
+
+VALUE rcsim_make_binary(VALUE mod, VALUE typeV, VALUE operator,
+                        VALUE leftV, VALUE rightV) {
+    /* Get the type and the operands. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
+    Expression left, right;
+    value_to_rcsim(ExpressionS,leftV,left);
+    value_to_rcsim(ExpressionS,rightV,right);
     /* Returns the C binary embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(BinaryS,binary,res);
+    rcsim_to_value(BinaryS,build_binary(type,sym_to_char(operator),left,right),
+                   res);
     return res;
 }
 
 /* Creating a select C object. */
-VALUE rcsim_make_select(VALUE mod, VALUE type, VALUE sel) {
-    // printf("rcsim_make_select\n");
+static Select build_select(Type type, Expression sel) {
     /* Allocates the select. */
     Select select = (Select)malloc(sizeof(SelectS));
-    // printf("select=%p\n",select);
     /* Set it up. */
     select->kind = SELECT;
     select->owner = NULL;
-    value_to_rcsim(TypeS,type,select->type);
-    value_to_rcsim(ExpressionS,sel,select->select);
+    select->type = type;
+    select->select = sel;
     select->num_choices = 0;
     select->choices = NULL;
+    return select;
+}
+
+VALUE rcsim_make_select(VALUE mod, VALUE typeV, VALUE selV) {
+    /* Get the type and the selection expression. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
+    Expression sel;
+    value_to_rcsim(ExpressionS,selV,sel);
     /* Returns the C select embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(SelectS,select,res);
+    rcsim_to_value(SelectS,build_select(type,sel),res);
     return res;
 }
 
-/* Creating a concat C object. */
-VALUE rcsim_make_concat(VALUE mod, VALUE type, VALUE dirV) {
-    // printf("rcsim_make_concat\n");
+/* Creating a concat C object.
+ * NOTE: the direction is given by the first character of its name. */
+static Concat build_concat(Type type, char dir) {
     /* Allocates the concat. */
     Concat concat = (Concat)malloc(sizeof(ConcatS));
-    // printf("concat=%p\n",concat);
     /* Set it up. */
     concat->kind = CONCAT;
     concat->owner = NULL;
-    value_to_rcsim(TypeS,type,concat->type);
+    concat->type = type;
     concat->num_exprs = 0;
     concat->exprs = NULL;
-    concat->dir = rb_id2name(SYM2ID(dirV))[0]=='l' ? 1 : 0;
+    concat->dir = dir=='l' ? 1 : 0;
+    return concat;
+}
+
+VALUE rcsim_make_concat(VALUE mod, VALUE typeV, VALUE dirV) {
+    /* Get the type. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
     /* Returns the C concat embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(ConcatS,concat,res);
+    rcsim_to_value(ConcatS,build_concat(type,rb_id2name(SYM2ID(dirV))[0]),res);
     return res;
 }
 
-/* Creating a ref concat C object. */
-VALUE rcsim_make_refConcat(VALUE mod, VALUE type, VALUE dirV) {
-    // printf("rcsim_make_refConcat\n");
+/* Creating a ref concat C object.
+ * NOTE: the direction is given by the first character of its name. */
+static RefConcat build_refConcat(Type type, char dir) {
     /* Allocates the ref concat. */
     RefConcat refConcat = (RefConcat)malloc(sizeof(RefConcatS));
-    // printf("refConcat=%p\n",refConcat);
     /* Set it up. */
     refConcat->kind = REF_CONCAT;
     refConcat->owner = NULL;
-    value_to_rcsim(TypeS,type,refConcat->type);
+    refConcat->type = type;
     refConcat->num_refs = 0;
     refConcat->refs = NULL;
-    refConcat->dir = rb_id2name(SYM2ID(dirV))[0]=='l' ? 0 : 1;
+    refConcat->dir = dir=='l' ? 0 : 1;
+    return refConcat;
+}
+
+VALUE rcsim_make_refConcat(VALUE mod, VALUE typeV, VALUE dirV) {
+    /* Get the type. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
     /* Returns the C ref concat embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(RefConcatS,refConcat,res);
+    rcsim_to_value(RefConcatS,
+                   build_refConcat(type,rb_id2name(SYM2ID(dirV))[0]),res);
     return res;
 }
 
 /* Creating a ref index C object. */
-VALUE rcsim_make_refIndex(VALUE mod, VALUE type, VALUE index, VALUE ref) {
-    // printf("rcsim_make_refIndex\n");
+static RefIndex build_refIndex(Type type, Expression index, Reference ref) {
     /* Allocates the ref index. */
     RefIndex refIndex = (RefIndex)malloc(sizeof(RefIndexS));
-    // printf("refIndex=%p\n",refIndex);
     /* Set it up. */
     refIndex->kind = REF_INDEX;
     refIndex->owner = NULL;
-    value_to_rcsim(TypeS,type,refIndex->type);
-    value_to_rcsim(ExpressionS,index,refIndex->index);
-    value_to_rcsim(ReferenceS,ref,refIndex->ref);
+    refIndex->type = type;
+    refIndex->index = index;
+    refIndex->ref = ref;
+    return refIndex;
+}
+
+VALUE rcsim_make_refIndex(VALUE mod, VALUE typeV, VALUE indexV, VALUE refV) {
+    /* Get the type, the index and the reference. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
+    Expression index;
+    value_to_rcsim(ExpressionS,indexV,index);
+    Reference ref;
+    value_to_rcsim(ReferenceS,refV,ref);
     /* Returns the C ref index embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(RefIndexS,refIndex,res);
+    rcsim_to_value(RefIndexS,build_refIndex(type,index,ref),res);
     return res;
 }
 
 /* Creating a ref range C object. */
-VALUE rcsim_make_refRange(VALUE mod, VALUE type, VALUE first, VALUE last, VALUE ref) {
-    // printf("rcsim_make_refRange\n");
+static RefRangeE build_refRange(Type type, Expression first, Expression last,
+                                Reference ref) {
     /* Allocates the ref range. */
     RefRangeE refRange = (RefRangeE)malloc(sizeof(RefRangeES));
-    // printf("refRange=%p\n",refRange);
     /* Set it up. */
     refRange->kind = REF_RANGE;
     refRange->owner = NULL;
-    value_to_rcsim(TypeS,type,refRange->type);
-    value_to_rcsim(ExpressionS,first,refRange->first);
-    value_to_rcsim(ExpressionS,last,refRange->last);
-    value_to_rcsim(ReferenceS,ref,refRange->ref);
+    refRange->type = type;
+    refRange->first = first;
+    refRange->last = last;
+    refRange->ref = ref;
+    return refRange;
+}
+
+VALUE rcsim_make_refRange(VALUE mod, VALUE typeV, VALUE firstV, VALUE lastV,
+                          VALUE refV) {
+    /* Get the type, the bounds and the reference. */
+    Type type;
+    value_to_rcsim(TypeS,typeV,type);
+    Expression first, last;
+    value_to_rcsim(ExpressionS,firstV,first);
+    value_to_rcsim(ExpressionS,lastV,last);
+    Reference ref;
+    value_to_rcsim(ReferenceS,refV,ref);
     /* Returns the C ref range embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(RefRangeES,refRange,res);
+    rcsim_to_value(RefRangeES,build_refRange(type,first,last,ref),res);
     return res;
 }
 
 
 /* Creating a character string C object. */
-VALUE rcsim_make_stringE(VALUE mod, VALUE strV) {
-    // printf("rcsim_make_stringE\n");
+static StringE build_stringE(const char* str) {
     /* Allocates the string. */
     StringE stringE = (StringE)malloc(sizeof(StringES));
-    // printf("stringE=%p\n",stringE);
     /* Set it up. */
     stringE->kind = STRINGE;
     stringE->owner = NULL;
-    stringE->str   = strdup(StringValueCStr(strV));
+    stringE->str   = strdup(str);
+    return stringE;
+}
+
+VALUE rcsim_make_stringE(VALUE mod, VALUE strV) {
     /* Returns the C character string embedded into a ruby VALUE. */
     VALUE res;
-    rcsim_to_value(StringES,stringE,res);
+    rcsim_to_value(StringES,build_stringE(StringValueCStr(strV)),res);
     return res;
 }
 
+
 /*#### Adding elements to C simulation objects. ####*/
 
+/** Updates the signal of an event to say it activates a target.
+ *  @param event the event
+ *  @param target the activated behavior or code */
+static void add_event_target(Event event, Object target) {
+    SignalI sig = event->signal;
+    switch(event->edge) {
+        case ANYEDGE:
+            sig->num_any++;
+            sig->any = realloc(sig->any,sizeof(Object[sig->num_any]));
+            sig->any[sig->num_any-1] = target;
+            break;
+        case POSEDGE:
+            sig->num_pos++;
+            sig->pos = realloc(sig->pos,sizeof(Object[sig->num_pos]));
+            sig->pos[sig->num_pos-1] = target;
+            break;
+        case NEGEDGE:
+            sig->num_neg++;
+            sig->neg = realloc(sig->neg,sizeof(Object[sig->num_neg]));
+            sig->neg[sig->num_neg-1] = target;
+            break;
+        default:
+            perror("Invalid value for an edge.");
+    }
+}
+
 /* Adds inputs to a C systemT. */
 VALUE rcsim_add_systemT_inputs(VALUE mod, VALUE systemTV, VALUE sigVs) {
     /* Get the C systemT from the Ruby value. */
@@ -1160,47 +1427,7 @@ VALUE rcsim_add_behavior_events(VALUE mod, VALUE behaviorV, VALUE eventVs) {
         value_to_rcsim(EventS,rb_ary_entry(eventVs,i),event);
         behavior->events[old_num + i] = event;
         /* Update the signal of the event to say it activates the behavior. */
-        SignalI sig = event->signal;
-        switch(event->edge) {
-            case ANYEDGE:
-                sig->num_any++;
-    // printf("first sig->any=%p\n",sig->any); fflush(stdout);
-                sig->any = realloc(sig->any,sizeof(Object[sig->num_any]));
-                // sig->any = (Object*)my_realloc(sig->any,
-                //     sizeof(Object[sig->num_any-1]),sizeof(Object[sig->num_any]));
-    // printf("now sig->any=%p\n",sig->any); fflush(stdout);
-    // printf("access test: %p\n",sig->any[0]); fflush(stdout);
-        // show_access(sig->any,sig->num_any-1);
-                // printf("sig->any=%p\n",sig->any);
-                sig->any[sig->num_any-1] = (Object)behavior;
-                break;
-            case POSEDGE:
-                sig->num_pos++;
-    // printf("first sig->pos=%p\n",sig->pos); fflush(stdout);
-                sig->pos = realloc(sig->pos,sizeof(Object[sig->num_pos]));
-                // sig->pos = (Object*)my_realloc(sig->pos,
-                //     sizeof(Object[sig->num_pos-1]),sizeof(Object[sig->num_pos]));
-    // printf("now sig->pos=%p\n",sig->pos); fflush(stdout);
-    // printf("access test: %p\n",sig->pos[0]); fflush(stdout);
-        // show_access(sig->pos,sig->num_pos-1);
-                // printf("sig->pos=%p\n",sig->pos);
-                sig->pos[sig->num_pos-1] = (Object)behavior;
-                break;
-            case NEGEDGE:
-                sig->num_neg++;
-    // printf("first sig->neg=%p\n",sig->neg); fflush(stdout);
-                sig->neg = realloc(sig->neg,sizeof(Object[sig->num_neg]));
-                // sig->neg = (Object*)my_realloc(sig->neg,
-                //     sizeof(Object[sig->num_neg-1]),sizeof(Object[sig->num_neg]));
-    // printf("now sig->neg=%p\n",sig->neg); fflush(stdout);
-    // printf("access test: %p\n",sig->neg[0]); fflush(stdout);
-        // show_access(sig->neg,sig->num_neg-1);
-                // printf("sig->neg=%p\n",sig->neg);
-                sig->neg[sig->num_neg-1] = (Object)behavior;
-                break;
-            default:
-                perror("Invalid value for an edge.");
-        }
+        add_event_target(event,(Object)behavior);
     }
     return behaviorV;
 }
@@ -1227,26 +1454,7 @@ VALUE rcsim_add_code_events(VALUE mod, VALUE codeV, VALUE eventVs) {
         value_to_rcsim(EventS,rb_ary_entry(eventVs,i),event);
         code->events[old_num + i] = event;
         /* Update the signal of the event to say it activates the code. */
-        SignalI sig = event->signal;
-        switch(event->edge) {
-            case ANYEDGE:
-                sig->num_any++;
-                sig->any = realloc(sig->any,sizeof(Object[sig->num_any]));
-                sig->any[sig->num_any-1] = (Object)code;
-                break;
-            case POSEDGE:
-                sig->num_pos++;
-                sig->pos = realloc(sig->pos,sizeof(Object[sig->num_pos]));
-                sig->pos[sig->num_pos-1] = (Object)code;
-                break;
-            case NEGEDGE:
-                sig->num_neg++;
-                sig->neg = realloc(sig->neg,sizeof(Object[sig->num_neg]));
-                sig->neg[sig->num_neg-1] = (Object)code;
-                break;
-            default:
-                perror("Invalid value for an edge.");
-        }
+        add_event_target(event,(Object)code);
     }
     return codeV;
 }
@@ -1586,24 +1794,71 @@ VALUE rcsim_set_behavior_block(VALUE mod, VALUE behaviorV, VALUE blockV) {
  *  NOTE: for initialization only (the simulator events are not updated),
  *  otherwise, please use rcsim_transmit_to_signal or
  *  rc_sim_transmit_to_signal_seq. */
+static void set_signal_value(SignalI signal, Expression expr) {
+    /* Compute the value from the expression. */
+    Value value = get_value();
+    value = calc_expression(expr,value);
+    /* Copies the value. */
+    signal->f_value = copy_value(value,signal->f_value);
+    signal->c_value = copy_value(value,signal->c_value);
+    free_value();
+}
+
 VALUE rcsim_set_signal_value(VALUE mod, VALUE signalV, VALUE exprV) {
     /* Get the C signal from the Ruby value. */
     SignalI signal;
     value_to_rcsim(SignalIS,signalV,signal);
-    // printf("rc_sim_set_signal_value for signal=%s\n",signal->name);
     /* Get the C expression from the Ruby value. */
     Expression expr;
     value_to_rcsim(ExpressionS,exprV,expr);
-    /* Compute the value from it. */
-    Value value = get_value();
-    value = calc_expression(expr,value);
-    /* Copies the value. */
-    signal->f_value = copy_value(value,signal->f_value);
-    signal->c_value = copy_value(value,signal->c_value);
-    free_value();
+    /* Set the value. */
+    set_signal_value(signal,expr);
     return signalV;
 }
 
+/** Loads a memory image file into a C signal, raising a Ruby exception
+ *  in case of error.
+ *  @param signal the signal to load
+ *  @param filename the name of the image file
+ *  @param format the format given by the first character of its name:
+ *         'h' (hexadecimal text), 'b' (binary text) or 'r' (raw binary
+ *         data)
+ *  @return the number of loaded words */
+static long long load_memory_image_file(SignalI signal, const char* filename,
+                                        char format) {
+    MemFormat mformat = MEM_HEX;
+    switch(format) {
+        case 'h': mformat = MEM_HEX; break;
+        case 'b': mformat = MEM_BIN; break;
+        case 'r': mformat = MEM_RAW; break;
+        default:
+                  rb_raise(rb_eArgError,"Invalid memory image format: %c",
+                           format);
+    }
+    /* Load the image. */
+    long long count = load_memory_image(signal,filename,mformat);
+    if (count < 0) {
+        rb_raise(rb_eIOError,"Could not load memory image: %s",filename);
+    }
+    return count;
+}
+
+/** Loads a memory image file into a C signal.
+ *  The format is given by symbol :h (hexadecimal text), :b (binary text)
+ *  or :raw (raw binary data).
+ *  Returns the number of loaded words. */
+VALUE rcsim_load_memory_image(VALUE mod, VALUE signalV, VALUE filenameV,
+                              VALUE formatV) {
+    /* Get the C signal from the Ruby value. */
+    SignalI signal;
+    value_to_rcsim(SignalIS,signalV,signal);
+    /* Get the format. */
+    const char* format = rb_id2name(SYM2ID(formatV));
+    /* Load the image. */
+    return LL2NUM(load_memory_image_file(signal,StringValueCStr(filenameV),
+                                         format[0]));
+}
+
 /** Gets the value of a C signal. */
 VALUE rcsim_get_signal_value(VALUE mod, VALUE signalV) {
     VALUE res;
@@ -1769,6 +2024,463 @@ VALUE rcsim_write_index_fixnum_seq(VALUE mod, VALUE signalV, VALUE idxV, VALUE v
 
 
 
+/*#### Building the C simulation objects from a serialized buffer. ####*/
+
+/* The buffer is produced by the RCSimBuffer Ruby class and is made of:
+ *  - the "HDRB" magic followed by the version, the number of nodes and the
+ *    number of strings,
+ *  - the strings, each given by its length, its bytes and a NUL character,
+ *  - the operations up to the end, each given by its code followed by its
+ *    arguments.
+ * The codes, the lengths and the arguments are little-endian 32-bit words,
+ * except the integer arguments which are 64-bit (low word first), the
+ * signed ones being zigzag encoded. The nodes are the objects created by
+ * the operations and are referred to by their 1-based index in the order
+ * of their creation, 0 meaning none, and the strings by their 0-based
+ * index. The symbols are given by their first character, except the
+ * operators given by their sym_to_char code.
+ * NOTE: the codes must match RCSimBuffer::OPERATIONS. */
+typedef enum {
+    OP_TYPE_BIT, OP_TYPE_SIGNED, OP_TYPE_VECTOR,
+    OP_SYSTEMT, OP_SCOPE, OP_BEHAVIOR, OP_EVENT, OP_SIGNAL, OP_SYSTEMI,
+    OP_CODE, OP_LOAD_C, OP_TRANSMIT, OP_PRINT, OP_TIME_WAIT, OP_TIME_REPEAT,
+    OP_TIME_TERMINATE, OP_TIME_DUMP, OP_CLOCK, OP_HIF, OP_HCASE, OP_BLOCK,
+    OP_VALUE_NUMERIC, OP_VALUE_BITSTRING, OP_CAST, OP_UNARY, OP_BINARY,
+    OP_SELECT, OP_CONCAT, OP_REF_CONCAT, OP_REF_INDEX, OP_REF_RANGE,
+    OP_STRINGE,
+    OP_SYSTEMT_INPUTS, OP_SYSTEMT_OUTPUTS, OP_SYSTEMT_INOUTS,
+    OP_SCOPE_INNERS, OP_SCOPE_BEHAVIORS, OP_SCOPE_SYSTEMIS, OP_SCOPE_CODES,
+    OP_SCOPE_SCOPES, OP_BEHAVIOR_EVENTS, OP_CODE_EVENTS, OP_SYSTEMI_SYSTEMTS,
+    OP_SIGNAL_SIGNALS, OP_PRINT_ARGS, OP_HIF_NOIFS, OP_HCASE_WHENS,
+    OP_BLOCK_INNERS, OP_BLOCK_STATEMENTS, OP_SELECT_CHOICES,
+    OP_CONCAT_EXPRESSIONS, OP_REF_CONCAT_REFS,
+    OP_OWNER, OP_SYSTEMT_SCOPE, OP_BEHAVIOR_BLOCK, OP_SIGNAL_VALUE,
+    OP_MEMORY_IMAGE
+} BufferOp;
+
+/* The version of the buffer format. */
+#define BUFFER_VERSION 1
+
+/* The state of the decoding of a buffer. */
+typedef struct {
+    const unsigned char* pos;       /* The current position. */
+    const unsigned char* end;       /* The end of the buffer. */
+    void** nodes;                   /* The nodes created so far. */
+    unsigned long long num_nodes;   /* The number of nodes to create. */
+    unsigned long long next;        /* The number of nodes created so far. */
+    const char** strings;           /* The strings. */
+    unsigned long long num_strings; /* The number of strings. */
+} BufferS;
+typedef BufferS* Buffer;
+
+/** Stops the decoding of a buffer with an error.
+ *  @param buf the buffer
+ *  @param msg the error message */
+static void buffer_error(Buffer buf, const char* msg) {
+    free(buf->nodes);
+    free(buf->strings);
+    rb_raise(rb_eArgError,"Invalid simulator buffer: %s.",msg);
+}
+
+/** Reads a 32-bit word from a buffer. */
+static unsigned long buffer_word(Buffer buf) {
+    if (buf->end - buf->pos < 4) buffer_error(buf,"truncated");
+    const unsigned char* p = buf->pos;
+    buf->pos += 4;
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) |
+           ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+/** Reads a 64-bit unsigned integer from a buffer. */
+static unsigned long long buffer_uint(Buffer buf) {
+    unsigned long long low = buffer_word(buf);
+    return low | ((unsigned long long)buffer_word(buf) << 32);
+}
+
+/** Reads a 64-bit signed integer from a buffer. */
+static long long buffer_int(Buffer buf) {
+    unsigned long long zz = buffer_uint(buf);
+    return (long long)(zz >> 1) ^ -(long long)(zz & 1);
+}
+
+/** Reads a string from a buffer. */
+static const char* buffer_string(Buffer buf) {
+    unsigned long long idx = buffer_word(buf);
+    if (idx >= buf->num_strings) buffer_error(buf,"unknown string");
+    return buf->strings[idx];
+}
+
+/** Reads a node, possibly none, from a buffer. */
+static void* buffer_node_or_null(Buffer buf) {
+    unsigned long long idx = buffer_word(buf);
+    if (idx > buf->next) buffer_error(buf,"unknown node");
+    return idx == 0 ? NULL : buf->nodes[idx-1];
+}
+
+/** Reads a node from a buffer. */
+static void* buffer_node(Buffer buf) {
+    void* node = buffer_node_or_null(buf);
+    if (!node) buffer_error(buf,"missing node");
+    return node;
+}
+
+/** Adds a node created by an operation of a buffer. */
+static void buffer_add(Buffer buf, void* node) {
+    if (buf->next >= buf->num_nodes) buffer_error(buf,"too many nodes");
+    buf->nodes[buf->next++] = node;
+}
+
+/* Reads a list of nodes from a buffer and appends them to an array of an
+ * object. */
+#define buffer_append(BUF,TYPE,ARRAY,NUM) { \
+    unsigned long long num_ = buffer_word(BUF); \
+    (ARRAY) = realloc((ARRAY),sizeof(TYPE[(NUM)+num_])); \
+    for(unsigned long long i_=0; i_<num_; ++i_) \
+        (ARRAY)[(NUM)+i_] = (TYPE)buffer_node(BUF); \
+    (NUM) += num_; }
+
+/** Reads and executes an operation from a buffer. */
+static void buffer_operation(Buffer buf) {
+    /* The arguments, read in order. */
+    void *obj, *node0, *node1, *node2;
+    const char *str0, *str1;
+    unsigned long long uint0, uint1, uint2;
+    long long int0, int1;
+    int old_num;
+    switch(buffer_word(buf)) {
+        /* Getting the types. */
+        case OP_TYPE_BIT:
+            buffer_add(buf,get_type_bit());
+            break;
+        case OP_TYPE_SIGNED:
+            buffer_add(buf,get_type_signed());
+            break;
+        case OP_TYPE_VECTOR:
+            node0 = buffer_node(buf); uint0 = buffer_uint(buf);
+            buffer_add(buf,get_type_vector(node0,uint0));
+            break;
+        /* Creating the objects. */
+        case OP_SYSTEMT:
+            buffer_add(buf,build_systemT(buffer_string(buf)));
+            break;
+        case OP_SCOPE:
+            buffer_add(buf,build_scope(buffer_string(buf)));
+            break;
+        case OP_BEHAVIOR:
+            buffer_add(buf,build_behavior(buffer_word(buf)));
+            break;
+        case OP_EVENT:
+            uint0 = buffer_word(buf); node0 = buffer_node(buf);
+            buffer_add(buf,build_event(uint0,node0));
+            break;
+        case OP_SIGNAL:
+            str0 = buffer_string(buf); node0 = buffer_node(buf);
+            buffer_add(buf,build_signal(str0,node0));
+            break;
+        case OP_SYSTEMI:
+            str0 = buffer_string(buf); node0 = buffer_node(buf);
+            buffer_add(buf,build_systemI(str0,node0));
+            break;
+        case OP_CODE:
+            str0 = buffer_string(buf); str1 = buffer_string(buf);
+            buffer_add(buf,build_code(str0,str1));
+            break;
+        case OP_LOAD_C:
+            obj = buffer_node(buf);
+            str0 = buffer_string(buf); str1 = buffer_string(buf);
+            load_c_code(obj,str0,str1);
+            break;
+        case OP_TRANSMIT:
+            node0 = buffer_node(buf); node1 = buffer_node(buf);
+            buffer_add(buf,build_transmit(node0,node1));
+            break;
+        case OP_PRINT:
+            buffer_add(buf,build_print());
+            break;
+        case OP_TIME_WAIT:
+            uint0 = buffer_word(buf); int0 = buffer_int(buf);
+            buffer_add(buf,build_timeWait(uint0,int0));
+            break;
+        case OP_TIME_REPEAT:
+            int0 = buffer_int(buf); node0 = buffer_node(buf);
+            buffer_add(buf,build_timeRepeat(int0,node0));
+            break;
+        case OP_TIME_TERMINATE:
+            buffer_add(buf,build_timeTerminate());
+            break;
+        case OP_TIME_DUMP:
+            buffer_add(buf,build_timeDump(buffer_int(buf)));
+            break;
+        case OP_CLOCK:
+            node0 = buffer_node(buf); uint0 = buffer_uint(buf);
+            uint1 = buffer_uint(buf); uint2 = buffer_uint(buf);
+            int0 = buffer_int(buf); int1 = buffer_int(buf);
+            buffer_add(buf,make_clock(node0,uint0,uint1,uint2,int0,int1));
+            break;
+        case OP_HIF:
+            node0 = buffer_node(buf); node1 = buffer_node(buf);
+            node2 = buffer_node_or_null(buf);
+            buffer_add(buf,build_hif(node0,node1,node2));
+            break;
+        case OP_HCASE:
+            node0 = buffer_node(buf); node1 = buffer_node_or_null(buf);
+            buffer_add(buf,build_hcase(node0,node1));
+            break;
+        case OP_BLOCK:
+            buffer_add(buf,build_block(buffer_word(buf) == 'p' ? PAR : SEQ));
+            break;
+        case OP_VALUE_NUMERIC:
+            node0 = buffer_node(buf); int0 = buffer_int(buf);
+            buffer_add(buf,build_value_numeric(node0,int0));
+            break;
+        case OP_VALUE_BITSTRING:
+            node0 = buffer_node(buf); str0 = buffer_string(buf);
+            buffer_add(buf,build_value_bitstring(node0,str0));
+            break;
+        case OP_CAST:
+            node0 = buffer_node(buf); node1 = buffer_node(buf);
+            buffer_add(buf,build_cast(node0,node1));
+            break;
+        case OP_UNARY:
+            node0 = buffer_node(buf); uint0 = buffer_word(buf);
+            node1 = buffer_node(buf);
+            buffer_add(buf,build_unary(node0,uint0,node1));
+            break;
+        case OP_BINARY:
+            node0 = buffer_node(buf); uint0 = buffer_word(buf);
+            node1 = buffer_node(buf); node2 = buffer_node(buf);
+            buffer_add(buf,build_binary(node0,uint0,node1,node2));
+            break;
+        case OP_SELECT:
+            node0 = buffer_node(buf); node1 = buffer_node(buf);
+            buffer_add(buf,build_select(node0,node1));
+            break;
+        case OP_CONCAT:
+            node0 = buffer_node(buf); uint0 = buffer_word(buf);
+            buffer_add(buf,build_concat(node0,uint0));
+            break;
+        case OP_REF_CONCAT:
+            node0 = buffer_node(buf); uint0 = buffer_word(buf);
+            buffer_add(buf,build_refConcat(node0,uint0));
+            break;
+        case OP_REF_INDEX:
+            node0 = buffer_node(buf); node1 = buffer_node(buf);
+            node2 = buffer_node(buf);
+            buffer_add(buf,build_refIndex(node0,node1,node2));
+            break;
+        case OP_REF_RANGE:
+            obj = buffer_node(buf); node0 = buffer_node(buf);
+            node1 = buffer_node(buf); node2 = buffer_node(buf);
+            buffer_add(buf,build_refRange(obj,node0,node1,node2));
+            break;
+        case OP_STRINGE:
+            buffer_add(buf,build_stringE(buffer_string(buf)));
+            break;
+        /* Adding elements to the objects. */
+        case OP_SYSTEMT_INPUTS:
+            obj = buffer_node(buf);
+            buffer_append(buf,SignalI,((SystemT)obj)->inputs,
+                          ((SystemT)obj)->num_inputs);
+            break;
+        case OP_SYSTEMT_OUTPUTS:
+            obj = buffer_node(buf);
+            buffer_append(buf,SignalI,((SystemT)obj)->outputs,
+                          ((SystemT)obj)->num_outputs);
+            break;
+        case OP_SYSTEMT_INOUTS:
+            obj = buffer_node(buf);
+            buffer_append(buf,SignalI,((SystemT)obj)->inouts,
+                          ((SystemT)obj)->num_inouts);
+            break;
+        case OP_SCOPE_INNERS:
+            obj = buffer_node(buf);
+            buffer_append(buf,SignalI,((Scope)obj)->inners,
+                          ((Scope)obj)->num_inners);
+            break;
+        case OP_SCOPE_BEHAVIORS:
+            obj = buffer_node(buf);
+            buffer_append(buf,Behavior,((Scope)obj)->behaviors,
+                          ((Scope)obj)->num_behaviors);
+            break;
+        case OP_SCOPE_SYSTEMIS:
+            obj = buffer_node(buf);
+            buffer_append(buf,SystemI,((Scope)obj)->systemIs,
+                          ((Scope)obj)->num_systemIs);
+            break;
+        case OP_SCOPE_CODES:
+            obj = buffer_node(buf);
+            buffer_append(buf,Code,((Scope)obj)->codes,
+                          ((Scope)obj)->num_codes);
+            break;
+        case OP_SCOPE_SCOPES:
+            obj = buffer_node(buf);
+            buffer_append(buf,Scope,((Scope)obj)->scopes,
+                          ((Scope)obj)->num_scopes);
+            break;
+        case OP_BEHAVIOR_EVENTS:
+            obj = buffer_node(buf);
+            old_num = ((Behavior)obj)->num_events;
+            buffer_append(buf,Event,((Behavior)obj)->events,
+                          ((Behavior)obj)->num_events);
+            /* Update the signals of the events to say they activate the
+             * behavior. */
+            for(; old_num < ((Behavior)obj)->num_events; ++old_num)
+                add_event_target(((Behavior)obj)->events[old_num],obj);
+            break;
+        case OP_CODE_EVENTS:
+            obj = buffer_node(buf);
+            old_num = ((Code)obj)->num_events;
+            buffer_append(buf,Event,((Code)obj)->events,
+                          ((Code)obj)->num_events);
+            /* Update the signals of the events to say they activate the
+             * code. */
+            for(; old_num < ((Code)obj)->num_events; ++old_num)
+                add_event_target(((Code)obj)->events[old_num],obj);
+            break;
+        case OP_SYSTEMI_SYSTEMTS:
+            obj = buffer_node(buf);
+            buffer_append(buf,SystemT,((SystemI)obj)->systems,
+                          ((SystemI)obj)->num_systems);
+            break;
+        case OP_SIGNAL_SIGNALS:
+            obj = buffer_node(buf);
+            buffer_append(buf,SignalI,((SignalI)obj)->signals,
+                          ((SignalI)obj)->num_signals);
+            break;
+        case OP_PRINT_ARGS:
+            obj = buffer_node(buf);
+            buffer_append(buf,Expression,((Print)obj)->args,
+                          ((Print)obj)->num_args);
+            break;
+        case OP_HIF_NOIFS:
+            /* The conditions and the statements are two lists of the same
+             * size. */
+            obj = buffer_node(buf);
+            old_num = ((HIf)obj)->num_noifs;
+            buffer_append(buf,Expression,((HIf)obj)->noconds,
+                          ((HIf)obj)->num_noifs);
+            ((HIf)obj)->num_noifs = old_num;
+            buffer_append(buf,Statement,((HIf)obj)->nostmnts,
+                          ((HIf)obj)->num_noifs);
+            break;
+        case OP_HCASE_WHENS:
+            /* The matches and the statements are two lists of the same
+             * size. */
+            obj = buffer_node(buf);
+            old_num = ((HCase)obj)->num_whens;
+            buffer_append(buf,Expression,((HCase)obj)->matches,
+                          ((HCase)obj)->num_whens);
+            ((HCase)obj)->num_whens = old_num;
+            buffer_append(buf,Statement,((HCase)obj)->stmnts,
+                          ((HCase)obj)->num_whens);
+            break;
+        case OP_BLOCK_INNERS:
+            obj = buffer_node(buf);
+            buffer_append(buf,SignalI,((Block)obj)->inners,
+                          ((Block)obj)->num_inners);
+            break;
+        case OP_BLOCK_STATEMENTS:
+            obj = buffer_node(buf);
+            buffer_append(buf,Statement,((Block)obj)->stmnts,
+                          ((Block)obj)->num_stmnts);
+            break;
+        case OP_SELECT_CHOICES:
+            obj = buffer_node(buf);
+            buffer_append(buf,Expression,((Select)obj)->choices,
+                          ((Select)obj)->num_choices);
+            break;
+        case OP_CONCAT_EXPRESSIONS:
+            obj = buffer_node(buf);
+            buffer_append(buf,Expression,((Concat)obj)->exprs,
+                          ((Concat)obj)->num_exprs);
+            break;
+        case OP_REF_CONCAT_REFS:
+            obj = buffer_node(buf);
+            buffer_append(buf,Reference,((RefConcat)obj)->refs,
+                          ((RefConcat)obj)->num_refs);
+            break;
+        /* Modifying the objects. */
+        case OP_OWNER:
+            obj = buffer_node(buf); node0 = buffer_node(buf);
+            ((Object)obj)->owner = node0;
+            break;
+        case OP_SYSTEMT_SCOPE:
+            obj = buffer_node(buf); node0 = buffer_node(buf);
+            ((SystemT)obj)->scope = node0;
+            break;
+        case OP_BEHAVIOR_BLOCK:
+            obj = buffer_node(buf); node0 = buffer_node(buf);
+            ((Behavior)obj)->block = node0;
+            break;
+        case OP_SIGNAL_VALUE:
+            obj = buffer_node(buf); node0 = buffer_node(buf);
+            set_signal_value(obj,node0);
+            break;
+        case OP_MEMORY_IMAGE:
+            obj = buffer_node(buf); str0 = buffer_string(buf);
+            uint0 = buffer_word(buf);
+            load_memory_image_file(obj,str0,uint0);
+            break;
+        default:
+            buffer_error(buf,"unknown operation");
+    }
+}
+
+/** Builds the C simulation objects serialized in a buffer with a single
+ *  call, instead of one call per object.
+ *  @param bufferV the buffer as a Ruby string
+ *  @param indexVs the indexes of the nodes to return
+ *  @return the array of the requested C objects */
+VALUE rcsim_build_from_buffer(VALUE mod, VALUE bufferV, VALUE indexVs) {
+    BufferS buf;
+    StringValue(bufferV);
+    Check_Type(indexVs,T_ARRAY);
+    buf.pos = (const unsigned char*)RSTRING_PTR(bufferV);
+    buf.end = buf.pos + RSTRING_LEN(bufferV);
+    buf.nodes = NULL;
+    buf.strings = NULL;
+    buf.num_nodes = buf.next = buf.num_strings = 0;
+    /* Read the header. */
+    if (buf.end - buf.pos < 4 || memcmp(buf.pos,"HDRB",4) != 0)
+        buffer_error(&buf,"bad magic");
+    buf.pos += 4;
+    if (buffer_word(&buf) != BUFFER_VERSION)
+        buffer_error(&buf,"unsupported version");
+    buf.num_nodes = buffer_word(&buf);
+    buf.num_strings = buffer_word(&buf);
+    if (buf.num_nodes > (unsigned long long)(buf.end - buf.pos) ||
+        buf.num_strings > (unsigned long long)(buf.end - buf.pos))
+        buffer_error(&buf,"truncated");
+    buf.nodes = calloc(buf.num_nodes+1,sizeof(void*));
+    buf.strings = calloc(buf.num_strings+1,sizeof(char*));
+    /* Read the strings, they are used in place. */
+    for(unsigned long long i=0; i<buf.num_strings; ++i) {
+        unsigned long long len = buffer_word(&buf);
+        if (len >= (unsigned long long)(buf.end - buf.pos) || buf.pos[len])
+            buffer_error(&buf,"bad string");
+        buf.strings[i] = (const char*)buf.pos;
+        buf.pos += len + 1;
+    }
+    /* Execute the operations. */
+    while(buf.pos < buf.end) buffer_operation(&buf);
+    /* Return the requested nodes. */
+    long num = RARRAY_LEN(indexVs);
+    VALUE res = rb_ary_new_capa(num);
+    for(long i=0; i<num; ++i) {
+        unsigned long long idx = NUM2ULL(rb_ary_entry(indexVs,i));
+        if (idx == 0 || idx > buf.next) buffer_error(&buf,"unknown node");
+        VALUE nodeV;
+        rcsim_to_value(ObjectS,buf.nodes[idx-1],nodeV);
+        rb_ary_push(res,nodeV);
+    }
+    free(buf.nodes);
+    free(buf.strings);
+    RB_GC_GUARD(bufferV);
+    return res;
+}
+
+
+
 /** Starts the C-Ruby hybrid simulation.
  *  @param systemTV the top system type. 
  *  @param name the name of the simulation.
@@ -1794,12 +2506,148 @@ VALUE rcsim_main(VALUE mod, VALUE systemTV, VALUE name, VALUE outmodeV) {
                 break;
         case 2: hruby_sim_core(StringValueCStr(name),init_vcd_visualizer,-1);
                 break;
+        case 3: hruby_sim_core(StringValueCStr(name),init_hbw_visualizer,-1);
+                break;
         default:hruby_sim_core(StringValueCStr(name),init_default_visualizer,-1);
     }
     return systemTV;
 }
 
 
+/* Configuring the dump: to call before starting the simulation. */
+
+/** Adds a pattern of the signals to dump. */
+VALUE rcsim_dump_include(VALUE mod, VALUE patternV) {
+    dump_include(StringValueCStr(patternV));
+    return patternV;
+}
+
+/** Adds a pattern of the signals not to dump. */
+VALUE rcsim_dump_exclude(VALUE mod, VALUE patternV) {
+    dump_exclude(StringValueCStr(patternV));
+    return patternV;
+}
+
+/** Sets the time window of the dump (in ps), a nil stop meaning the
+ *  end of the simulation. */
+VALUE rcsim_dump_window(VALUE mod, VALUE startV, VALUE stopV) {
+    dump_window(NUM2ULL(startV), NIL_P(stopV) ? ULLONG_MAX : NUM2ULL(stopV));
+    return Qnil;
+}
+
+/** Adds a VCD file whose value changes are to be replayed. */
+VALUE rcsim_replay_file(VALUE mod, VALUE filenameV) {
+    replay_file(StringValueCStr(filenameV));
+    return filenameV;
+}
+
+/** Adds a pattern of the signals to replay. */
+VALUE rcsim_replay_include(VALUE mod, VALUE patternV) {
+    replay_include(StringValueCStr(patternV));
+    return patternV;
+}
+
+/** Adds a VCD file to use as golden trace. */
+VALUE rcsim_golden_file(VALUE mod, VALUE filenameV) {
+    golden_file(StringValueCStr(filenameV));
+    return filenameV;
+}
+
+/** Adds a pattern of the signals to check against the golden traces. */
+VALUE rcsim_golden_include(VALUE mod, VALUE patternV) {
+    golden_include(StringValueCStr(patternV));
+    return patternV;
+}
+
+/** Sets the file where to save the coverage, enabling its collection. */
+VALUE rcsim_coverage_file(VALUE mod, VALUE filenameV) {
+    coverage_file(StringValueCStr(filenameV));
+    return filenameV;
+}
+
+/** Enables the profiling of the simulation, writing the folded stacks
+ *  to a file. */
+VALUE rcsim_profile_enable(VALUE mod, VALUE filenameV, VALUE samplingV) {
+    profile_enable(StringValueCStr(filenameV),NUM2INT(samplingV));
+    return filenameV;
+}
+
+/** Sets where to write the runtime metrics and their period in seconds. */
+VALUE rcsim_metrics_output(VALUE mod, VALUE destinationV, VALUE periodV) {
+    metrics_output(StringValueCStr(destinationV),NUM2DBL(periodV));
+    return destinationV;
+}
+
+/** Gets the current runtime metrics as a hash. */
+VALUE rcsim_get_metrics(VALUE mod) {
+    MetricsS metrics;
+    metrics_get(&metrics);
+    VALUE res = rb_hash_new();
+    rb_hash_aset(res,ID2SYM(rb_intern("wall")),DBL2NUM(metrics.wall));
+    rb_hash_aset(res,ID2SYM(rb_intern("time")),ULL2NUM(metrics.time));
+    rb_hash_aset(res,ID2SYM(rb_intern("events")),ULL2NUM(metrics.events));
+    rb_hash_aset(res,ID2SYM(rb_intern("deltas")),ULL2NUM(metrics.deltas));
+    rb_hash_aset(res,ID2SYM(rb_intern("executions")),
+                 ULL2NUM(metrics.executions));
+    rb_hash_aset(res,ID2SYM(rb_intern("value_pool")),
+                 UINT2NUM(metrics.value_pool));
+    rb_hash_aset(res,ID2SYM(rb_intern("value_pool_capacity")),
+                 UINT2NUM(metrics.value_pool_capacity));
+    rb_hash_aset(res,ID2SYM(rb_intern("element_pool")),
+                 ULL2NUM(metrics.element_pool));
+    rb_hash_aset(res,ID2SYM(rb_intern("rss")),ULL2NUM(metrics.rss));
+    rb_hash_aset(res,ID2SYM(rb_intern("rss_peak")),ULL2NUM(metrics.rss_peak));
+    rb_hash_aset(res,ID2SYM(rb_intern("wave_bytes")),
+                 ULL2NUM(metrics.wave_bytes));
+    return res;
+}
+
+/** Sets the directory of the sockets of the checkpoints, enabling them. */
+VALUE rcsim_checkpoint_dir(VALUE mod, VALUE dirV) {
+    checkpoint_dir(StringValueCStr(dirV));
+    return dirV;
+}
+
+/** Adds a time (in ps) when to take a checkpoint. */
+VALUE rcsim_checkpoint_at(VALUE mod, VALUE timeV) {
+    checkpoint_at(NUM2ULL(timeV));
+    return timeV;
+}
+
+/** Requests a checkpoint at the end of the current time step. */
+VALUE rcsim_checkpoint(VALUE mod) {
+    checkpoint_request();
+    return Qnil;
+}
+
+/** Sets the file where to save the state of the signals, at the end of
+ *  the first time step at or after a time in ps, or at the end of the
+ *  simulation if the time is nil. */
+VALUE rcsim_snapshot_output(VALUE mod, VALUE filenameV, VALUE timeV) {
+    snapshot_output(StringValueCStr(filenameV),
+                    NIL_P(timeV) ? ULLONG_MAX : NUM2ULL(timeV));
+    return filenameV;
+}
+
+/** Sets the file of the snapshot to restore at the start. */
+VALUE rcsim_snapshot_input(VALUE mod, VALUE filenameV) {
+    snapshot_input(StringValueCStr(filenameV));
+    return filenameV;
+}
+
+/** Saves the state of the signals to a file now. */
+VALUE rcsim_snapshot_save(VALUE mod, VALUE filenameV) {
+    return snapshot_save(StringValueCStr(filenameV)) ? Qtrue : Qfalse;
+}
+
+/** Sets the gzip compression level (0 for none) of the output files and
+ *  the number of compression threads. */
+VALUE rcsim_set_output_compression(VALUE mod, VALUE levelV, VALUE threadsV) {
+    output_compression(NUM2INT(levelV),NUM2INT(threadsV));
+    return Qnil;
+}
+
+
 /** The wrapper for calling Ruby functions from the simulator. */
 void ruby_function_wrap(Code code) {
     /* Convert the C code object to a Ruby VALUE. */
@@ -1900,6 +2748,8 @@ void Init_hruby_sim() {
     rb_define_singleton_method(mod,"rcsim_make_timeWait",rcsim_make_timeWait,2);
     rb_define_singleton_method(mod,"rcsim_make_timeRepeat",rcsim_make_timeRepeat,2);
     rb_define_singleton_method(mod,"rcsim_make_timeTerminate",rcsim_make_timeTerminate,0);
+    rb_define_singleton_method(mod,"rcsim_make_timeDump",rcsim_make_timeDump,1);
+    rb_define_singleton_method(mod,"rcsim_make_clock",rcsim_make_clock,6);
     rb_define_singleton_method(mod,"rcsim_make_hif",rcsim_make_hif,3);
     rb_define_singleton_method(mod,"rcsim_make_hcase",rcsim_make_hcase,2);
     rb_define_singleton_method(mod,"rcsim_make_block",rcsim_make_block,1);
@@ -1940,8 +2790,30 @@ void Init_hruby_sim() {
     rb_define_singleton_method(mod,"rcsim_set_systemT_scope",rcsim_set_systemT_scope,2);
     rb_define_singleton_method(mod,"rcsim_set_behavior_block",rcsim_set_behavior_block,2);
     rb_define_singleton_method(mod,"rcsim_set_signal_value",rcsim_set_signal_value,2);
+    rb_define_singleton_method(mod,"rcsim_load_memory_image",rcsim_load_memory_image,3);
+    /* Building the C simulation objects from a serialized buffer. */
+    rb_define_singleton_method(mod,"rcsim_build_from_buffer",rcsim_build_from_buffer,2);
     /* Starting the simulation. */
     rb_define_singleton_method(mod,"rcsim_main",rcsim_main,3);
+    rb_define_singleton_method(mod,"rcsim_dump_include",rcsim_dump_include,1);
+    rb_define_singleton_method(mod,"rcsim_dump_exclude",rcsim_dump_exclude,1);
+    rb_define_singleton_method(mod,"rcsim_dump_window",rcsim_dump_window,2);
+    rb_define_singleton_method(mod,"rcsim_set_output_compression",rcsim_set_output_compression,2);
+    rb_define_singleton_method(mod,"rcsim_replay_file",rcsim_replay_file,1);
+    rb_define_singleton_method(mod,"rcsim_replay_include",rcsim_replay_include,1);
+    rb_define_singleton_method(mod,"rcsim_golden_file",rcsim_golden_file,1);
+    rb_define_singleton_method(mod,"rcsim_golden_include",rcsim_golden_include,1);
+    rb_define_singleton_method(mod,"rcsim_coverage_file",rcsim_coverage_file,1);
+    rb_define_singleton_method(mod,"rcsim_profile_enable",rcsim_profile_enable,2);
+    rb_define_singleton_method(mod,"rcsim_metrics_output",rcsim_metrics_output,2);
+    rb_define_singleton_method(mod,"rcsim_get_metrics",rcsim_get_metrics,0);
+    rb_define_singleton_method(mod,"rcsim_checkpoint_dir",rcsim_checkpoint_dir,1);
+    rb_define_singleton_method(mod,"rcsim_checkpoint_at",rcsim_checkpoint_at,1);
+    rb_define_singleton_method(mod,"rcsim_checkpoint",rcsim_checkpoint,0);
+    rb_define_singleton_method(mod,"rcsim_snapshot_output",rcsim_snapshot_output,2);
+    rb_define_singleton_method(mod,"rcsim_snapshot_input",rcsim_snapshot_input,1);
+    rb_define_singleton_method(mod,"rcsim_snapshot_save",rcsim_snapshot_save,1);
+    rb_define_singleton_method(mod,"rcsim_get_const_pool_stats",rcsim_get_const_pool_stats,0);
     /* The Ruby software interface. */
     rb_define_singleton_method(mod,"rcsim_get_signal_fixnum",rcsim_get_signal_fixnum,1);
     rb_define_singleton_method(mod,"rcsim_transmit_fixnum_to_signal_seq",rcsim_transmit_fixnum_to_signal_seq,2);
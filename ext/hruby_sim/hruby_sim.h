@@ -5,6 +5,7 @@
 
 #include <pthread.h>
 #include <stdarg.h>
+#include <sys/types.h>
 
 
 /* The interface to the HDLRuby objects C models. */
@@ -30,6 +31,7 @@ typedef struct HCaseS_ HCaseS;
 typedef struct TimeWaitS_ TimeWaitS;
 typedef struct TimeRepeatS_ TimeRepeatS;
 typedef struct TimeTerminateS_ TimeTerminateS;
+typedef struct TimeDumpS_ TimeDumpS;
 typedef struct ExpressionS_ ExpressionS;
 typedef struct UnaryS_ UnaryS;
 typedef struct BinaryS_ BinaryS;
@@ -66,6 +68,7 @@ typedef struct HCaseS_* HCase;
 typedef struct TimeWaitS_* TimeWait;
 typedef struct TimeRepeatS_* TimeRepeat;
 typedef struct TimeTerminateS_* TimeTerminate;
+typedef struct TimeDumpS_* TimeDump;
 typedef struct ExpressionS_* Expression;
 typedef struct UnaryS_* Unary;
 typedef struct BinaryS_* Binary;
@@ -92,7 +95,7 @@ typedef enum {
     OBJECT, SYSTEMT, SIGNALI, SCOPE, BEHAVIOR, SYSTEMI, CODE, BLOCK, EVENT,
 #ifdef RCSIM
     /* Statements */  TRANSMIT, PRINT, HIF, HCASE, 
-                      TIME_WAIT, TIME_REPEAT, TIME_TERMINATE,
+                      TIME_WAIT, TIME_REPEAT, TIME_TERMINATE, TIME_DUMP,
     /* Expressions */ UNARY, BINARY, SELECT, CONCAT, CAST,
     /* References */  REF_OBJECT, REF_INDEX, REF_RANGE, REF_CONCAT,
     /* Non-hardware*/ STRINGE,
@@ -441,6 +444,9 @@ extern Elem get_element(void* data);
   *  @param elem the element to delete */
 void delete_element(Elem elem);
 
+/** Gets the number of list elements allocated, in use or in the pool. */
+extern unsigned long long get_element_pool_size();
+
 /** Tells if a list is empty.
  *  @param list the list to check. */
 #define empty_list(list) ((list)->head == NULL)
@@ -483,6 +489,11 @@ extern unsigned int get_value_pos();
  *  @param pos the new position in the pool */
 extern void set_value_pos(unsigned int pos);
 
+/** Gets the high-water marks of the value pool.
+ *  @param peak where to put the highest number of values in use
+ *  @param capacity where to put the capacity of the pool */
+extern void get_value_pool_stats(unsigned int* peak, unsigned int* capacity);
+
 /** Saves the current state+1 of the value pool to the pool state stack. */
 extern void save_value_pos();
 
@@ -543,6 +554,8 @@ typedef struct SignalIS_ {
     Object* neg;        /* The objects actvated on neg edge. */
 
     size_t id;          /* The identity of the signal. */
+    int dump;           /* Tells if the changes of the signal are dumped. */
+    int check;          /* Tells if the changes of the signal are checked. */
 } SignalIS;
 
 
@@ -590,6 +603,9 @@ typedef struct BehaviorS_ {
     int enabled;        /* Tells if the behavior is enabled or not. */
 
     int activated;      /* Tells if the behavior is activated or not. */
+    unsigned long long activations; /* The number of executions. */
+    unsigned long long profile_time; /* The profiled execution time (ns). */
+    unsigned long long profile_samples; /* The number of profiled executions. */
 
     int timed;          /* Tell if the behavior is timed or not:
                            - 0: not timed
@@ -613,6 +629,9 @@ typedef struct CodeS_ {
     int enabled;        /* Tells if the behavior is enabled or not. */
 
     int activated;      /* Tells if the code is activated or not. */
+    unsigned long long activations; /* The number of executions. */
+    unsigned long long profile_time; /* The profiled execution time (ns). */
+    unsigned long long profile_samples; /* The number of profiled executions. */
 } CodeS;
 
 
@@ -719,6 +738,14 @@ typedef struct TimeTerminateS_ {
     Object owner;       /* The owner of the object if any. */
 } TimeTerminateS;
 
+/** The C model of a time dump switch statement. */
+typedef struct TimeDumpS_ {
+    Kind kind;          /* The kind of object. */
+    Object owner;       /* The owner of the object if any. */
+
+    int on;             /* Tells if the dump is switched on or off. */
+} TimeDumpS;
+
 
 /** The C model of an expression. */
 typedef struct ExpressionS_ {
@@ -847,7 +874,33 @@ typedef enum { S, MS, US, NS, PS } Unit;
 /** The top system. */
 extern SystemT top_system;
 
-/** Adds a timed behavior for processing. 
+/** The C model of a clock generator directly toggled by the simulator. */
+typedef struct ClockS_ {
+    SignalI signal;     /* The signal driven by the clock. */
+    unsigned long long period; /* The period of the clock in ps. */
+    unsigned long long duty;   /* The duration of the high level in ps. */
+    unsigned long long phase;  /* The time of the first edge in ps. */
+    int start;          /* The level set by the first edge. */
+    long long number;   /* The number of edges left, negative means infinity. */
+    unsigned long long next_time; /* The time of the next edge. */
+    int level;          /* The level set by the next edge. */
+} ClockS;
+
+typedef ClockS* Clock;
+
+/** Creates and registers a clock generator.
+ *  @param signal the signal driven by the clock
+ *  @param period the period of the clock in ps
+ *  @param duty the duration of the high level in ps
+ *  @param phase the time of the first edge in ps
+ *  @param start the level set by the first edge
+ *  @param number the number of edges to generate, negative means infinity
+ *  @return the resulting clock */
+extern Clock make_clock(SignalI signal, unsigned long long period,
+                        unsigned long long duty, unsigned long long phase,
+                        int start, long long number);
+
+/** Adds a timed behavior for processing.
  *  @param behavior the timed behavior to register */
 extern void register_timed_behavior(Behavior behavior);
 
@@ -859,6 +912,11 @@ extern void register_init_behavior(Behavior beh);
  *  @param signal the signal to register  */
 extern void register_signal(SignalI signal);
 
+/** Gives the identity of a new signal: the signals are numbered in their
+ *  creation order.
+ *  @return the new identity. */
+extern size_t make_signal_id();
+
 /** Makes the behavior wait for a given time.
  *  @param delay the delay to wait in ps.
  *  @param behavior the current behavior. */
@@ -929,6 +987,21 @@ extern unsigned long long make_delay(int value, Unit unit);
 extern void each_all_signal(void (*func)(SignalI));
 
 
+/** The formats of the memory image files. */
+typedef enum { MEM_HEX, MEM_BIN, MEM_RAW } MemFormat;
+
+/** Loads a memory image file into the current and future values of a
+ *  signal, the words of the file filling the elements of the signal
+ *  starting from index 0.
+ *  @param signal the memory signal to fill
+ *  @param filename the name of the image file
+ *  @param format the format of the file: MEM_HEX and MEM_BIN for text
+ *         files like $readmemh and $readmemb, MEM_RAW for little-endian
+ *         binary words
+ *  @return the number of loaded words, or -1 in case of error */
+extern long long load_memory_image(SignalI signal, const char* filename,
+                                   MemFormat format);
+
 /** Configure a system instance.
  *  @param systemI the system instance to configure.
  *  @param idx the index of the target system. */
@@ -1009,6 +1082,398 @@ extern void default_print_string(const char* str);
 // //  *  @param signal the signal to show */
 // // extern void println_signal(SignalI signal);
 
+/* The selection of the dumped signals. */
+
+/** Tells if the dump is currently active. */
+extern int dump_active;
+
+/** Adds a pattern of the signals to dump, by default all are dumped.
+ *  @param pattern the glob pattern matching the full name of a signal
+ *         or of one of its enclosing scopes, e.g. "cpu.alu.*" */
+extern void dump_include(const char* pattern);
+
+/** Adds a pattern of the signals not to dump.
+ *  @param pattern the glob pattern matching the full name of a signal
+ *         or of one of its enclosing scopes */
+extern void dump_exclude(const char* pattern);
+
+/** Sets the time window of the dump.
+ *  @param start the start time of the dump (in ps)
+ *  @param stop the time when the dump stops (in ps) */
+extern void dump_window(unsigned long long start, unsigned long long stop);
+
+/** Switches the dump on or off from the next time step.
+ *  @param on the new status of the dump */
+extern void dump_switch(int on);
+
+/** Selects the signals to dump under a top system.
+ *  @param top the top system */
+extern void dump_select(SystemT top);
+
+/** Advances the dump to a new time step.
+ *  @param time the new time (in ps) */
+extern void dump_step(unsigned long long time);
+
+/* The kinds of ports of the signals. */
+#define PORT_INPUT  1
+#define PORT_OUTPUT 2
+#define PORT_INOUT  3
+
+/** Applies a function to each signal of the hierarchy under a top system
+ *  with its full name (the names of the enclosing instances, scopes and
+ *  blocks separated by '.' from the top system excluded).
+ *  @param top the top system
+ *  @param func the function to apply, also given the kind of port of the
+ *         signal (PORT_INPUT, PORT_OUTPUT, PORT_INOUT, 0 if not a port) */
+extern void each_signal_path(SystemT top,
+                             void (*func)(SignalI signal, const char* path,
+                                          int kind));
+
+/** Tells if the signal being walked by each_signal_path or one of its
+ *  enclosing scopes matches a list of patterns.
+ *  @param patterns the glob patterns to match
+ *  @param num the number of patterns */
+extern int walk_matches(char** patterns, int num);
+
+/** Applies a function to each behavior and non-HDLRuby code of the
+ *  hierarchy under a top system with its full name: the full name of its
+ *  scope followed by the name of its block, or "behavior" and its index
+ *  in the scope if the block is not named, or by the name of the
+ *  function of the code.
+ *  @param top the top system
+ *  @param func the function to apply to the behaviors and the codes */
+extern void each_code_path(SystemT top,
+                           void (*func)(Object code, const char* path));
+
+/* The stimulus replay from recorded waveforms. */
+
+/** Adds a VCD or HBW file whose value changes are to be replayed.
+ *  @param filename the name of the VCD or HBW file */
+extern void replay_file(const char* filename);
+
+/** Adds a pattern of the signals to replay, by default all the input
+ *  ports found in the replayed files are replayed.
+ *  @param pattern the glob pattern matching the full name of a signal
+ *         or of one of its enclosing scopes */
+extern void replay_include(const char* pattern);
+
+/** Binds the replayed files to the signals of a top system.
+ *  @param top the top system */
+extern void replay_start(SystemT top);
+
+/** Gets the time of the next replayed value changes.
+ *  @return the time, ULLONG_MAX if there is none */
+extern unsigned long long replay_next_time();
+
+/** Transmits the replayed value changes that are due at a time.
+ *  @param time the current time (in ps) */
+extern void replay_step(unsigned long long time);
+
+/** Replaces the replayed files by another one during the simulation.
+ *  The changes of the new file until the current time are transmitted
+ *  at once.
+ *  @param filename the name of the new VCD or HBW file
+ *  @param top the top system
+ *  @param time the current time (in ps) */
+extern void replay_switch(const char* filename, SystemT top,
+                          unsigned long long time);
+
+/** Adds a VCD or HBW file to use as golden trace.
+ *  @param filename the name of the VCD or HBW file */
+extern void golden_file(const char* filename);
+
+/** Adds a pattern of the signals to check against the golden traces, by
+ *  default all the signals found in the golden traces are checked.
+ *  @param pattern the glob pattern matching the full name of a signal
+ *         or of one of its enclosing scopes */
+extern void golden_include(const char* pattern);
+
+/** Marks a signal whose value changed for checking against the golden
+ *  traces at the end of the time step.
+ *  @param signal the signal to check */
+extern void golden_mark(SignalI signal);
+
+/** Checks the signals changed during a time step against the golden
+ *  traces, stopping the simulation on the first mismatch.
+ *  @param time the time of the step (in ps) */
+extern void golden_step(unsigned long long time);
+
+/** Ends the check against the golden traces.
+ *  @param time the end time of the simulation (in ps) */
+extern void golden_end(unsigned long long time);
+
+/* The coverage collection. */
+
+/** Tells if the coverage is collected. */
+extern int coverage_active;
+
+/** Sets the file where to save the coverage, enabling its collection.
+ *  @param filename the name of the file */
+extern void coverage_file(const char* filename);
+
+/** Sets up the coverage of the signals of a top system.
+ *  @param top the top system */
+extern void coverage_start(SystemT top);
+
+/** Counts the bit toggles of a signal whose value has just been updated.
+ *  @param signal the updated signal */
+extern void coverage_toggle(SignalI signal);
+
+/** Saves the coverage.
+ *  @param time the end time of the simulation (in ps) */
+extern void coverage_end(unsigned long long time);
+
+/* The simulation profiler. */
+
+/** Tells if the simulation is profiled. */
+extern int profile_active;
+
+/** Enables the profiling of the simulation.
+ *  @param filename the name of the file where to write the profile as
+ *         folded stacks for flame graphs, NULL for none
+ *  @param sampling the execution time of the behaviors is measured one
+ *         time out of sampling */
+extern void profile_enable(const char* filename, int sampling);
+
+/** Sets up the profiling of a top system.
+ *  @param top the top system */
+extern void profile_start(SystemT top);
+
+/** Starts measuring the execution of a behavior or code.
+ *  @return the start time, 0 if the execution is not sampled */
+extern unsigned long long profile_begin();
+
+/** Ends measuring the execution of a behavior or code.
+ *  @param code the executed behavior or code
+ *  @param start the start time given by profile_begin */
+extern void profile_end(Object code, unsigned long long start);
+
+/** Counts a delta cycle of the current time step. */
+extern void profile_delta();
+
+/** Counts the activations caused by a change of a signal.
+ *  @param signal the changed signal */
+extern void profile_signal(SignalI signal);
+
+/** Ends a time step.
+ *  @param time the time of the step (in ps) */
+extern void profile_step(unsigned long long time);
+
+/** Writes the profile report and the folded stacks.
+ *  @param time the end time of the simulation (in ps) */
+extern void profile_report(unsigned long long time);
+
+/* The runtime metrics. */
+
+/** The counters of the simulation kept by the kernel. */
+typedef struct SimCountersS_ {
+    unsigned long long events;     /* The committed signal changes. */
+    unsigned long long deltas;     /* The delta cycles. */
+    unsigned long long executions; /* The executed behaviors and codes. */
+} SimCountersS;
+
+extern SimCountersS sim_counters;
+
+/** The runtime metrics of the simulation. */
+typedef struct MetricsS_ {
+    double wall;                    /* The wall time since the start (s). */
+    unsigned long long time;        /* The simulated time (ps). */
+    unsigned long long events;      /* The committed signal changes. */
+    unsigned long long deltas;      /* The delta cycles. */
+    unsigned long long executions;  /* The executed behaviors and codes. */
+    unsigned int value_pool;        /* The values in use in the pool. */
+    unsigned int value_pool_capacity; /* The capacity of the value pool. */
+    unsigned long long element_pool;/* The list elements allocated. */
+    unsigned long long rss;         /* The resident memory (bytes). */
+    unsigned long long rss_peak;    /* The peak resident memory (bytes). */
+    unsigned long long wave_bytes;  /* The waveform bytes written. */
+} MetricsS;
+
+/** Gets the current runtime metrics, without stopping the simulation.
+ *  @param metrics where to put the metrics */
+extern void metrics_get(MetricsS* metrics);
+
+/** Sets where to write the runtime metrics periodically.
+ *  @param destination the name of the file, or "unix:" followed by the
+ *         path of a Unix socket to create for the clients to connect to
+ *  @param period the period of the writes in seconds, 0 for writing only
+ *         on SIGUSR1 */
+extern void metrics_output(const char* destination, double period);
+
+/** Starts writing the runtime metrics if an output is set. */
+extern void metrics_start();
+
+/** Stops writing the runtime metrics, after writing the last ones. */
+extern void metrics_stop();
+
+/** Drops the runtime metrics in a forked process, where the thread
+ *  writing them does not exist: the destination is closed, but left to
+ *  the original process. */
+extern void metrics_drop();
+
+/* The simulation checkpoints. */
+
+/** Tells if checkpoints may be taken. */
+extern int checkpoint_active;
+
+/** Sets the directory where to create the sockets of the checkpoints,
+ *  enabling them.
+ *  @param dir the directory */
+extern void checkpoint_dir(const char* dir);
+
+/** Adds a time when to take a checkpoint.
+ *  @param time the time (in ps), the checkpoint being taken at the end of
+ *         the first time step at or after it */
+extern void checkpoint_at(unsigned long long time);
+
+/** Requests a checkpoint at the end of the current time step. */
+extern void checkpoint_request();
+
+/** Starts the checkpoints if a directory is set. */
+extern void checkpoint_start();
+
+/** Takes the checkpoints due at the end of a time step.
+ *  @param time the time of the step (in ps)
+ *  @param single tells if the simulator runs a single timed behavior */
+extern void checkpoint_step(unsigned long long time, int single);
+
+/** Gets the name of a file written at the end of the simulation, in the
+ *  output directory of a continuation if in one.
+ *  @param filename the name of the file
+ *  @return the name to use, valid until the next call */
+extern const char* checkpoint_path(const char* filename);
+
+/* The snapshots of the signal state. */
+
+/** Tells if a snapshot is to save. */
+extern int snapshot_active;
+
+/** Sets the file where to save the state of the signals.
+ *  @param filename the name of the file
+ *  @param time the snapshot is saved at the end of the first time step
+ *         at or after this time (in ps), ULLONG_MAX for the end of the
+ *         simulation */
+extern void snapshot_output(const char* filename, unsigned long long time);
+
+/** Sets the file of the snapshot to restore at the start of the
+ *  simulation.
+ *  @param filename the name of the file */
+extern void snapshot_input(const char* filename);
+
+/** Saves the state of the signals to a file.
+ *  NOTE: must be called while the timed behaviors are not running.
+ *  @param filename the name of the file
+ *  @return 1 if success, 0 otherwise */
+extern int snapshot_save(const char* filename);
+
+/** Saves the snapshot if due at the end of a time step.
+ *  @param time the time of the step (in ps) */
+extern void snapshot_step(unsigned long long time);
+
+/** Saves the snapshot at the end of the simulation if not done yet.
+ *  @param time the end time of the simulation (in ps) */
+extern void snapshot_end(unsigned long long time);
+
+/** Restores the state of the signals from the snapshot set with
+ *  snapshot_input if any, reporting the signals that do not match.
+ *  @param top the top system
+ *  @return the time of the snapshot (in ps), 0 if none */
+extern unsigned long long snapshot_restore(SystemT top);
+
+/* The buffered output of the visualization engines. */
+
+typedef struct OutputS_* Output;
+
+/* The maximum size that can be reserved at once in an output. */
+#define OUTPUT_RESERVE_MAX 65536
+
+/** Compresses data into a complete gzip member.
+ *  @param level the compression level (1 to 9)
+ *  @param data the data to compress
+ *  @param size the size of the data
+ *  @param zdata the destination, reallocated if too small
+ *  @param zcapacity the capacity of the destination, updated if
+ *         reallocated
+ *  @return the size of the compressed data, 0 if not supported */
+extern size_t gzip_compress(int level, const char* data, size_t size,
+                            char** zdata, size_t* zcapacity);
+
+/** Compresses data into a zlib stream, used for the blocks of the
+ *  binary waveform files.
+ *  @param level the compression level (1 to 9)
+ *  @param data the data to compress
+ *  @param size the size of the data
+ *  @param zdata the destination, reallocated if too small
+ *  @param zcapacity the capacity of the destination, updated if
+ *         reallocated
+ *  @return the size of the compressed data, 0 if not supported or in
+ *          case of error */
+extern size_t zlib_compress(int level, const char* data, size_t size,
+                            char** zdata, size_t* zcapacity);
+
+/** Decompresses a zlib stream, used for the blocks of the binary
+ *  waveform files.
+ *  @param zdata the data to decompress
+ *  @param zsize the size of the data to decompress
+ *  @param data the destination
+ *  @param size the size of the decompressed data
+ *  @return 1 in case of success, 0 if not supported or in case of
+ *          error */
+extern int zlib_uncompress(const char* zdata, size_t zsize,
+                           char* data, size_t size);
+
+/** Sets the compression of the outputs opened afterward.
+ *  @param level the gzip compression level (1 to 9), 0 for none
+ *  @param threads the number of compression threads */
+extern void output_compression(int level, int threads);
+
+/** Opens a buffered output to a file.
+ *  @param filename the name of the file, extended with ".gz" when
+ *         compressed
+ *  @return the output, or NULL in case of error */
+extern Output open_output(const char* filename);
+
+/** Reserves room in an output.
+ *  @param out the output
+ *  @param len the size to reserve, at most OUTPUT_RESERVE_MAX
+ *  @return the place where to write */
+extern char* output_reserve(Output out, size_t len);
+
+/** Commits data written in reserved room of an output.
+ *  @param out the output
+ *  @param len the size of the written data */
+extern void output_commit(Output out, size_t len);
+
+/** Writes data to an output.
+ *  @param out the output
+ *  @param data the data to write
+ *  @param len the size of the data */
+extern void output_write(Output out, const char* data, size_t len);
+
+/** Closes an output: writes the remaining data and waits for the threads
+ *  to finish.
+ *  @param out the output */
+extern void close_output(Output out);
+
+/** Gets the number of bytes written by all the outputs. */
+extern unsigned long long output_written();
+
+/** Prepares the outputs for a fork of the process: waits until the full
+ *  buffers are written and keeps the outputs locked so that their
+ *  threads stay idle during the fork. */
+extern void outputs_prefork();
+
+/** Resumes the outputs after a fork of the process.
+ *  @param child tells if in the child process */
+extern void outputs_postfork(int child);
+
+/** Redirects the outputs of a forked process to files with the same
+ *  names in another directory, starting with the content the original
+ *  files had at the fork.
+ *  @param dir the directory of the new files
+ *  @return 1 if success, 0 otherwise */
+extern int outputs_redirect(const char* dir);
+
 /** Sets up the default vizualization engine.
  *  @param name the name of the vizualization. */
 extern void init_default_visualizer(char* name);
@@ -1021,6 +1486,10 @@ extern void init_mute_visualizer(char* name);
  *  @param name the name of the vizualization. */
 extern void init_vcd_visualizer(char* name);
 
+/** Sets up the binary waveform (hbw) vizualization engine.
+ *  @param name the name of the vizualization. */
+extern void init_hbw_visualizer(char* name);
+
 /* The interface to the simulator core. */
 
 /** Sets the enable status of the behaviors of a system type. 
@@ -1035,6 +1504,9 @@ extern void set_enable_system(SystemT systemT, int status);
 extern void hruby_sim_core(char* name, void (*init_vizualizer)(char*),
                            unsigned long long limit);
 
+/** Gets the current simulation time (in ps). */
+extern unsigned long long hruby_sim_get_time();
+
 
 
 /* Access and conversion functions. */
@@ -1178,3 +1650,13 @@ extern void transmitR(RefRangeS ref);
  * @param ref the ref to the range of the signal to transmit to. */
 extern void transmitR_seq(RefRangeS ref);
 #endif
+
+
+/* The POSIX functions used by the simulator.
+ * NOTE: unistd.h is not included since it conflicts with the dup of the
+ * stack-based computations. */
+extern int close(int fd);
+extern int dup2(int oldfd, int newfd);
+extern pid_t fork(void);
+extern pid_t setsid(void);
+extern void _exit(int status);
@@ -91,6 +91,7 @@ static void add_hash_type(Type type) {
         /* No entry, create a new one. */
         entry = (List)malloc(sizeof(ListS));
         entry = build_list(entry);
+        hash_type[hvalue] = entry;
     }
     /* Adds the type to the entry. */
     Elem elem = get_element(type);
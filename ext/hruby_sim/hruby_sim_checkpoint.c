@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation checkpoints, to be used with C code generated
+ *  by the csim engine or by the rcsim engine.
+ *  At chosen times, or when requested (by SIGUSR2 or by the simulated
+ *  program), the simulator forks at the end of a time step: the child is
+ *  a paused copy-on-write copy of the whole simulation state while the
+ *  parent goes on simulating.
+ *  The child waits for requests on a Unix socket: each "resume" request
+ *  forks again a continuation that runs the rest of the simulation from
+ *  the checkpoint, writing its outputs in a given directory and possibly
+ *  replaying another stimulus file or with other environment variables
+ *  for the programs, so that the same checkpoint can be resumed any
+ *  number of times until a "quit" request.
+ *  Since only the forking thread exists in the child, the checkpoints
+ *  are only supported when the simulator runs a single timed behavior,
+ *  in which case the whole state is in this thread.
+ **/
+
+/* The maximum size of a request. */
+#define CHECKPOINT_REQUEST_MAX 4096
+
+/* Tells if checkpoints may be taken. */
+int checkpoint_active = 0;
+
+/* The directory of the sockets of the checkpoints. */
+static char* checkpoint_directory = NULL;
+
+/* The times of the checkpoints to take, sorted, and the next one. */
+static unsigned long long* checkpoint_times = NULL;
+static int num_checkpoint_times = 0;
+static int next_checkpoint_time = 0;
+
+/* Tells if a checkpoint is requested for the end of the time step. */
+static volatile sig_atomic_t checkpoint_requested = 0;
+
+/* The directory of the outputs of a continuation, NULL if not in a
+ * continuation. */
+static char* checkpoint_output_dir = NULL;
+
+
+/** Sets the directory where to create the sockets of the checkpoints,
+ *  enabling them.
+ *  @param dir the directory */
+void checkpoint_dir(const char* dir) {
+    free(checkpoint_directory);
+    checkpoint_directory = strdup(dir);
+}
+
+/** Adds a time when to take a checkpoint.
+ *  @param time the time (in ps), the checkpoint being taken at the end of
+ *         the first time step at or after it */
+void checkpoint_at(unsigned long long time) {
+    int i = num_checkpoint_times;
+    checkpoint_times = realloc(checkpoint_times,
+                               (num_checkpoint_times+1)*sizeof(*checkpoint_times));
+    /* Keep the times sorted. */
+    while(i > 0 && checkpoint_times[i-1] > time) {
+        checkpoint_times[i] = checkpoint_times[i-1];
+        --i;
+    }
+    checkpoint_times[i] = time;
+    ++num_checkpoint_times;
+}
+
+/** Requests a checkpoint at the end of the current time step. */
+void checkpoint_request() {
+    checkpoint_requested = 1;
+}
+
+/** The SIGUSR2 handler: requests a checkpoint.
+ *  @param sig the signal */
+static void checkpoint_signal(int sig) {
+    checkpoint_requested = 1;
+}
+
+/** Starts the checkpoints if a directory is set. */
+void checkpoint_start() {
+    if (!checkpoint_directory) return;
+    checkpoint_active = 1;
+    /* Take a checkpoint on SIGUSR2 too. */
+    struct sigaction action;
+    memset(&action,0,sizeof(action));
+    action.sa_handler = &checkpoint_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR2,&action,NULL);
+}
+
+
+/** Gets the name of a file written at the end of the simulation, in the
+ *  output directory of a continuation if in one.
+ *  @param filename the name of the file
+ *  @return the name to use, valid until the next call */
+const char* checkpoint_path(const char* filename) {
+    static char* path = NULL;
+    if (!checkpoint_output_dir) return filename;
+    const char* base = strrchr(filename,'/');
+    base = base ? base+1 : filename;
+    free(path);
+    path = malloc(strlen(checkpoint_output_dir)+strlen(base)+2);
+    sprintf(path,"%s/%s",checkpoint_output_dir,base);
+    return path;
+}
+
+
+/** Sends a reply to the client of a checkpoint.
+ *  @param fd the connection to the client
+ *  @param reply the reply */
+static void checkpoint_reply(int fd, const char* reply) {
+    send(fd,reply,strlen(reply),MSG_NOSIGNAL);
+}
+
+/** Reads a request line from the client of a checkpoint.
+ *  @param fd the connection to the client
+ *  @param request where to put the request
+ *  @return 1 if success, 0 otherwise */
+static int checkpoint_read(int fd, char* request) {
+    size_t len = 0;
+    while(len < CHECKPOINT_REQUEST_MAX-1) {
+        ssize_t size = recv(fd,request+len,1,0);
+        if (size < 0 && errno == EINTR) continue;
+        if (size <= 0) return 0;
+        if (request[len] == '\n') break;
+        ++len;
+    }
+    request[len] = 0;
+    return 1;
+}
+
+/** Sets up a continuation, in the process forked from the checkpoint.
+ *  @param time the time of the checkpoint (in ps)
+ *  @param args the arguments of the resume request */
+static void checkpoint_continue(unsigned long long time, char* args) {
+    char* save = NULL;
+    char* dir = strtok_r(args," \t",&save);
+    char* token;
+    /* No checkpoint from a continuation. */
+    checkpoint_active = 0;
+    signal(SIGUSR2,SIG_IGN);
+    /* The outputs go to the directory of the continuation. */
+    mkdir(dir,0777);
+    char log[strlen(dir)+32];
+    sprintf(log,"%s/hruby_simulator.log",dir);
+    if (freopen(log,"w",stdout)) dup2(fileno(stdout),2);
+    checkpoint_output_dir = strdup(dir);
+    if (!outputs_redirect(dir)) _exit(1);
+    printf("# Resuming from checkpoint at %llups\n",time);
+    /* Apply the options of the continuation. */
+    while((token = strtok_r(NULL," \t",&save))) {
+        if (strcmp(token,"replay") == 0) {
+            char* filename = strtok_r(NULL," \t",&save);
+            if (filename) replay_switch(filename,top_system,time);
+        } else if (strcmp(token,"env") == 0) {
+            char* def = strtok_r(NULL," \t",&save);
+            char* eq = def ? strchr(def,'=') : NULL;
+            if (eq) {
+                *eq = 0;
+                setenv(def,eq+1,1);
+            }
+        }
+    }
+}
+
+/** Serves the requests for a checkpoint, in the paused child process.
+ *  Returns only in the continuations.
+ *  @param sock the listening socket of the checkpoint
+ *  @param path the path of the socket
+ *  @param time the time of the checkpoint (in ps) */
+static void checkpoint_serve(int sock, const char* path,
+                             unsigned long long time) {
+    char request[CHECKPOINT_REQUEST_MAX];
+    char reply[64];
+    /* The checkpoint outlives the original simulation. */
+    setsid();
+    signal(SIGINT,SIG_IGN);
+    signal(SIGUSR2,SIG_IGN);
+    /* Release the outputs of the original simulation so that their
+     * readers (e.g., a pipe) are not kept waiting for the checkpoint: it
+     * logs next to its socket, and each continuation in its own output
+     * directory. */
+    char log[strlen(path)+8];
+    sprintf(log,"%.*s.log",(int)(strlen(path)-5),path);
+    if (!freopen(log,"w",stdout) && !freopen("/dev/null","w",stdout))
+        _exit(1);
+    dup2(fileno(stdout),2);
+    for(;;) {
+        int fd = accept(sock,NULL,NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (!checkpoint_read(fd,request)) {
+            close(fd);
+            continue;
+        }
+        if (strncmp(request,"resume ",7) == 0) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(sock);
+                close(fd);
+                checkpoint_continue(time,request+7);
+                return;
+            }
+            if (pid < 0) {
+                checkpoint_reply(fd,"error fork failed\n");
+                close(fd);
+                continue;
+            }
+            sprintf(reply,"started %d\n",(int)pid);
+            checkpoint_reply(fd,reply);
+            /* Wait for the end of the continuation. */
+            int status = 0;
+            while(waitpid(pid,&status,0) < 0 && errno == EINTR);
+            sprintf(reply,"exited %d\n",WIFEXITED(status) ?
+                    WEXITSTATUS(status) : 128 + WTERMSIG(status));
+            checkpoint_reply(fd,reply);
+        } else if (strcmp(request,"quit") == 0) {
+            checkpoint_reply(fd,"quit\n");
+            close(fd);
+            break;
+        } else {
+            checkpoint_reply(fd,"error unknown request\n");
+        }
+        close(fd);
+    }
+    close(sock);
+    remove(path);
+    _exit(0);
+}
+
+/** Takes a checkpoint: forks a paused copy of the simulation.
+ *  @param time the current time (in ps) */
+static void checkpoint_take(unsigned long long time) {
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    int len = snprintf(addr.sun_path,sizeof(addr.sun_path),
+                       "%s/checkpoint_%llu.sock",checkpoint_directory,time);
+    if (len >= (int)sizeof(addr.sun_path)) {
+        fprintf(stderr,"Checkpoint directory name too long: %s\n",
+                checkpoint_directory);
+        return;
+    }
+    /* Create the socket first so that the checkpoint can be resumed as
+     * soon as the simulation goes on. */
+    int sock = socket(AF_UNIX,SOCK_STREAM,0);
+    if (sock < 0) {
+        perror(addr.sun_path);
+        return;
+    }
+    remove(addr.sun_path);
+    if (bind(sock,(struct sockaddr*)&addr,sizeof(addr)) < 0 ||
+        listen(sock,4) < 0) {
+        perror(addr.sun_path);
+        close(sock);
+        return;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    outputs_prefork();
+    pid_t pid = fork();
+    if (pid == 0) {
+        /* The checkpoint. */
+        outputs_postfork(1);
+        metrics_drop();
+        checkpoint_serve(sock,addr.sun_path,time);
+        return;
+    }
+    outputs_postfork(0);
+    close(sock);
+    if (pid < 0) {
+        perror("checkpoint");
+        remove(addr.sun_path);
+        return;
+    }
+    fprintf(stderr,"Checkpoint at %llups: %s (process %d)\n",
+            time,addr.sun_path,(int)pid);
+}
+
+/** Takes the checkpoints due at the end of a time step.
+ *  @param time the time of the step (in ps)
+ *  @param single tells if the simulator runs a single timed behavior */
+void checkpoint_step(unsigned long long time, int single) {
+    int due = checkpoint_requested;
+    while(next_checkpoint_time < num_checkpoint_times &&
+          checkpoint_times[next_checkpoint_time] <= time) {
+        ++next_checkpoint_time;
+        due = 1;
+    }
+    if (!due) return;
+    checkpoint_requested = 0;
+    if (!single) {
+        fprintf(stderr,"Checkpoints need a single timed behavior, "
+                "none taken.\n");
+        checkpoint_active = 0;
+        return;
+    }
+    checkpoint_take(time);
+}
@@ -51,6 +51,13 @@ static int cap_timed_behaviors = 0;
 /** The timed behaviors. */
 static Behavior* timed_behaviors = NULL;
 
+/** The number of clock generators. */
+static int num_clocks = 0;
+/** The capacity of the clock generators. */
+static int cap_clocks = 0;
+/** The clock generators. */
+static Clock* clocks = NULL;
+
 /** The number of running behaviors. */
 static int num_run_behaviors = 0;
 /** The number of activated behaviors. */
@@ -97,6 +104,28 @@ void register_timed_behavior(Behavior behavior) {
 }
 
 
+/** Adds a clock generator for processing.
+ *  @param clock the clock generator to register */
+static void register_clock(Clock clock) {
+    if (num_clocks == cap_clocks) {
+        if (cap_clocks == 0) {
+            /* Need to create the array containing the clocks. */
+            cap_clocks = 5;
+            clocks = calloc(cap_clocks,sizeof(Clock));
+        } else {
+            /* Need to increase the capacity. */
+            Clock* new_clocks = calloc(cap_clocks*2,sizeof(Clock));
+            memcpy(new_clocks,clocks,sizeof(Clock[cap_clocks]));
+            free(clocks);
+            clocks = new_clocks;
+            cap_clocks *= 2;
+        }
+    }
+    /* Add the clock. */
+    clocks[num_clocks++] = clock;
+}
+
+
 /** Adds a behavior for initialization (not timed!).
  *  @param beh the behavior to register. */
 void register_init_behavior(Behavior beh) {
@@ -141,18 +170,33 @@ void register_signal(SignalI signal) {
 }
 
 
+/** The number of identities given to signals. */
+static size_t num_signal_ids = 0;
+
+/** Gives the identity of a new signal: the signals are numbered in their
+ *  creation order.
+ *  @return the new identity. */
+size_t make_signal_id() {
+    return num_signal_ids++;
+}
+
+
 
 /** Initial run of the behaviors to init. */
 void run_init_behaviors() {
     int i;
     for(i = 0; i<num_init_behaviors; ++i) {
         Behavior beh = init_behaviors[i];
+        ++beh->activations;
+        ++sim_counters.executions;
+        unsigned long long start = profile_active ? profile_begin() : 0;
 #ifdef RCSIM
         // printf("Going to initialize behavior=%p with block=%p\n",beh,beh->block);fflush(stdout);
         execute_statement((Statement)(beh->block),0,beh);
 #else
         beh->block->function();
 #endif
+        if (start) profile_end((Object)beh,start);
     }
 }
 
@@ -165,6 +209,8 @@ void hruby_sim_update_signals() {
     // printf("hruby_sim_update_signals...\n");fflush(stdout);
     /* As long as the list of touched signals is not empty go on computing. */
     while(!empty_list(touched_signals) || !empty_list(touched_signals_seq)) {
+        ++sim_counters.deltas;
+        if (profile_active) profile_delta();
         // printf("## Checking touched signals.\n");fflush(stdout);
         /* Sets the new signals values and mark the signals as activating. */
         /* For the case of the parallel execution model. */
@@ -176,12 +222,16 @@ void hruby_sim_update_signals() {
             /* Is there a change? */
             if (same_content_value(sig->c_value,sig->f_value)) continue;
             /* Yes, process the signal. */
-            printer.print_signal(sig);
+            if (dump_active && sig->dump) printer.print_signal(sig);
+            if (sig->check) golden_mark(sig);
             // printf("c_value="); printer.print_value(sig->c_value);
             // printf("\nf_value="); printer.print_value(sig->f_value); printf("\n");
             // printf("Touched signal: %p (%s)\n",sig,sig->name);fflush(stdout);
             /* Update the current value of the signal. */
             copy_value(sig->f_value,sig->c_value);
+            ++sim_counters.events;
+            if (coverage_active) coverage_toggle(sig);
+            if (profile_active) profile_signal(sig);
             // /* Mark the signal as activated. */
             // add_list(activate_signals,e);
             /* Mark the corresponding code as activated. */
@@ -246,7 +296,11 @@ void hruby_sim_update_signals() {
             delete_element(e);
             /* Yes, process the signal. */
             // println_signal(sig);
-            printer.print_signal(sig);
+            if (dump_active && sig->dump) printer.print_signal(sig);
+            if (sig->check) golden_mark(sig);
+            ++sim_counters.events;
+            if (coverage_active) coverage_toggle(sig);
+            if (profile_active) profile_signal(sig);
             /* Update the current value of the signal. */
             /* Mark the corresponding code as activated. */
             /* Any edge activation. */
@@ -315,6 +369,10 @@ void hruby_sim_update_signals() {
                 /* Is the code really enabled and activated? */
                 if (beh->enabled && beh->activated) {
                     /* Yes, execute it. */
+                    ++beh->activations;
+                    ++sim_counters.executions;
+                    unsigned long long start =
+                        profile_active ? profile_begin() : 0;
 #ifdef RCSIM
                     // printf("going to execute with beh=%p\n",beh);
                     // printf("going to execute: %p with kind=%d\n",beh->block,beh->block->kind);
@@ -322,6 +380,7 @@ void hruby_sim_update_signals() {
 #else
                     beh->block->function();
 #endif
+                    if (start) profile_end((Object)beh,start);
                     /* And deactivate it. */
                     beh->activated = 0;
                 }
@@ -331,8 +390,13 @@ void hruby_sim_update_signals() {
                 /* Is the code really activated? */
                 if (cod->enabled && cod->activated) {
                     /* Yes, execute it. */
+                    ++cod->activations;
+                    ++sim_counters.executions;
+                    unsigned long long start =
+                        profile_active ? profile_begin() : 0;
                     // cod->function();
                     cod->function(cod); // NOTE: cod argument is required for identification.
+                    if (start) profile_end((Object)cod,start);
                     /* And deactivate it. */
                     cod->activated = 0;
                 }
@@ -342,25 +406,116 @@ void hruby_sim_update_signals() {
 }
 
 
+/** Transmits the edges of the clock generators that are due at the
+ *  current time.
+ *  NOTE: must be called while the timed behaviors are not running. */
+static void hruby_sim_toggle_clocks() {
+    int i;
+    for(i=0; i<num_clocks; ++i) {
+        Clock clock = clocks[i];
+        if (clock->number == 0 || clock->next_time != hruby_sim_time)
+            continue;
+        /* Transmit the new level. */
+        Value value = get_value();
+        value->type = clock->signal->type;
+        value->numeric = 1;
+        value->data_int = clock->level;
+        transmit_to_signal(value,clock->signal);
+        free_value();
+        /* Prepare the next edge. */
+        clock->next_time += clock->level ? clock->duty :
+                                           clock->period - clock->duty;
+        clock->level = !clock->level;
+        if (clock->number > 0) clock->number -= 1;
+    }
+}
+
+
 /** Advance time to the next time step. */
 void hruby_sim_advance_time() {
     /* Collects the activation time of all the timed behaviors and find
      * the shortest one. */
     unsigned long long next_time = ULLONG_MAX;
     int i;
+    /* The current time step is over, check it against the golden
+     * traces and profile it. */
+    golden_step(hruby_sim_time);
+    profile_step(hruby_sim_time);
+    /* The state is consistent, the snapshot and the checkpoints can be
+     * taken. */
+    if (snapshot_active) snapshot_step(hruby_sim_time);
+    if (checkpoint_active) checkpoint_step(hruby_sim_time,sim_single_flag);
     for(i=0; i<num_timed_behaviors; ++i) {
         unsigned long long beh_time = timed_behaviors[i]->active_time;
         // printf("beh_time=%llu\n",beh_time);
         if (timed_behaviors[i]->timed == 1)
             if (beh_time < next_time) next_time = beh_time;
     }
+    /* Same for the next edges of the clock generators. */
+    for(i=0; i<num_clocks; ++i) {
+        if (clocks[i]->number != 0 && clocks[i]->next_time < next_time)
+            next_time = clocks[i]->next_time;
+    }
+    /* Same for the replayed value changes. */
+    unsigned long long replay_time = replay_next_time();
+    if (replay_time < next_time) next_time = replay_time;
     /* Mark again all the signals as fading. */
     for(i=0; i<num_all_signals; ++i) all_signals[i]->fading = 1;
     // printf("hruby_sim_time=%llu next_time=%llu\n",hruby_sim_time,next_time);
     /* Sets the new activation time. */
     hruby_sim_time = next_time;
     // println_time(hruby_sim_time);
-    printer.print_time(hruby_sim_time);
+    dump_step(hruby_sim_time);
+    /* Apply the clock edges and the replayed changes of the new time. */
+    hruby_sim_toggle_clocks();
+    replay_step(hruby_sim_time);
+}
+
+
+/** Starts the simulation at a time other than 0, e.g., from a snapshot:
+ *  the timed behaviors start at this time and the clock edges until
+ *  this time are skipped.
+ *  @param time the start time (in ps) */
+static void hruby_sim_start_at(unsigned long long time) {
+    int i;
+    hruby_sim_time = time;
+    dump_step(time);
+    for(i=0; i<num_timed_behaviors; ++i)
+        timed_behaviors[i]->active_time = time;
+    for(i=0; i<num_clocks; ++i) {
+        Clock clock = clocks[i];
+        while(clock->number != 0 && clock->next_time <= time) {
+            clock->next_time += clock->level ? clock->duty :
+                                               clock->period - clock->duty;
+            clock->level = !clock->level;
+            if (clock->number > 0) clock->number -= 1;
+        }
+    }
+}
+
+
+/** Tells if there are still clock generators with edges to produce
+ *  or value changes to replay. */
+static int hruby_sim_clocks_active() {
+    int i;
+    for(i=0; i<num_clocks; ++i) {
+        if (clocks[i]->number != 0) return 1;
+    }
+    return replay_next_time() != ULLONG_MAX;
+}
+
+
+/** Runs the clock generators alone until they end or the time limit
+ *  is reached.
+ *  @param limit the time limit. */
+static void hruby_sim_run_clocks(unsigned long long limit) {
+    if (!hruby_sim_clocks_active()) return;
+    while(hruby_sim_time<limit) {
+        hruby_sim_update_signals();
+        /* The last edge is committed, end. */
+        if (!hruby_sim_clocks_active()) break;
+        hruby_sim_advance_time();
+    }
 }
 
 
@@ -462,6 +617,8 @@ void* behavior_run(void* arg) {
     pthread_mutex_unlock(&hruby_sim_mutex);
     /* Now can start the execution of the behavior. */
     if (behavior->enabled) {
+        ++behavior->activations;
+        ++sim_counters.executions;
 #ifdef RCSIM
         // printf("going to execute with behavior=%p\n",behavior);
         // printf("going to execute: %p with kind=%d\n",behavior->block,behavior->block->kind);
@@ -491,6 +648,8 @@ void hruby_sim_start_single_timed_behavior() {
     sim_single_flag = 1;
     Behavior behavior = timed_behaviors[0];
     /* Simply run the timed behavior. */
+    ++behavior->activations;
+    ++sim_counters.executions;
 #ifdef RCSIM
         execute_statement((Statement)(behavior->block),0,behavior);
 #else
@@ -534,6 +693,12 @@ void hruby_sim_end_timed_behaviors() {
 
 
 
+/** Gets the current simulation time (in ps). */
+unsigned long long hruby_sim_get_time() {
+    return hruby_sim_time;
+}
+
+
 // /** The simulation core function.
 //  *  @param limit the time limit in fs. */
 // void hruby_sim_core(unsigned long long limit) {
@@ -543,25 +708,53 @@ void hruby_sim_end_timed_behaviors() {
  *  @param limit the time limit in fs. */
 void hruby_sim_core(char* name, void (*init_vizualizer)(char*),
                            unsigned long long limit) {
+    /* Select the signals to dump. */
+    dump_select(top_system);
+    /* Bind the signals to replay. */
+    replay_start(top_system);
+    /* Set up the coverage collection and the profiling. */
+    coverage_start(top_system);
+    profile_start(top_system);
+    /* Start writing the runtime metrics. */
+    metrics_start();
+    /* Enable the checkpoints. */
+    checkpoint_start();
+    /* Restore the signals from a snapshot if any. */
+    unsigned long long start = snapshot_restore(top_system);
+
     /* Initilize the vizualizer. */
     init_vizualizer(name);
 
-    /* Initialize the time to 0. */
+    /* Initialize the time to 0, or to the time of the snapshot, starting
+     * its step before the initial values and the first clock edges. */
     hruby_sim_time = 0;
+    if (start > 0) hruby_sim_start_at(start);
+    else dump_step(0);
 
     if (num_timed_behaviors == 1) {
         /* Initialize and touch all the signals. */
         hruby_sim_update_signals(); 
         // each_all_signal(&touch_signal);
-        run_init_behaviors();
+        /* The behaviors are not initialized again on a snapshot. */
+        if (start == 0) run_init_behaviors();
+        /* Apply the clock edges and the replayed changes of the start. */
+        hruby_sim_toggle_clocks();
+        replay_step(hruby_sim_time);
         /* Only one timed behavior, no need of the multi-threaded engine. */
         hruby_sim_start_single_timed_behavior();
+        /* The clocks may outlive the timed behavior. */
+        timed_behaviors[0]->timed = 2;
+        hruby_sim_run_clocks(limit);
     } else {
         /* Use the multi-threaded engine. */
         /* Initialize and touch all the signals. */
         hruby_sim_update_signals(); 
         // each_all_signal(&touch_signal);
-        run_init_behaviors();
+        /* The behaviors are not initialized again on a snapshot. */
+        if (start == 0) run_init_behaviors();
+        /* Apply the clock edges and the replayed changes of the start. */
+        hruby_sim_toggle_clocks();
+        replay_step(hruby_sim_time);
         /* Start all the timed behaviors. */
         hruby_sim_start_timed_behaviors();
         // /* Activate the timed behavior that are on time. */
@@ -577,12 +770,12 @@ void hruby_sim_core(char* name, void (*init_vizualizer)(char*),
             /* Update the signal values (recursively executing blocks locked
              * on the signals). */
             hruby_sim_update_signals(); 
-            if (hruby_sim_time == 0) {
+            if (hruby_sim_time == start) {
                 /* Initially touch all the signals. */
                 each_all_signal(&touch_signal);
             }
             // printf("num_run_behavior=%d\n",num_run_behaviors);
-            if (num_run_behaviors <= 0) break;
+            if (num_run_behaviors <= 0 && !hruby_sim_clocks_active()) break;
             /* Advance time to next timestep. */
             hruby_sim_advance_time();
 
@@ -595,6 +788,14 @@ void hruby_sim_core(char* name, void (*init_vizualizer)(char*),
             hruby_sim_activate_behaviors_on_time();
         }
     }
+    /* Save the snapshot of the end if required. */
+    snapshot_end(hruby_sim_time);
+    /* Check the last time step against the golden traces. */
+    golden_end(hruby_sim_time);
+    /* Save the coverage and the profile. */
+    coverage_end(hruby_sim_time);
+    profile_report(hruby_sim_time);
+    metrics_stop();
 }
 
 
@@ -617,6 +818,11 @@ void hw_wait(unsigned long long delay, Behavior behavior) {
         behavior->active_time += delay;
         hruby_sim_update_signals(); 
         hruby_sim_advance_time();
+        /* Process the clock edges that occur before the end of the wait. */
+        while(behavior->active_time > hruby_sim_time) {
+            hruby_sim_update_signals();
+            hruby_sim_advance_time();
+        }
     } else {
         /* No, handle the multi-threading. */
         /* Maybe the thread is to end immediatly. */
@@ -792,6 +998,36 @@ Event make_event(Edge edge, SignalI signal) {
 }
 
 
+/** Creates and registers a clock generator.
+ *  @param signal the signal driven by the clock
+ *  @param period the period of the clock in ps
+ *  @param duty the duration of the high level in ps
+ *  @param phase the time of the first edge in ps
+ *  @param start the level set by the first edge
+ *  @param number the number of edges to generate, negative means infinity
+ *  @return the resulting clock */
+Clock make_clock(SignalI signal, unsigned long long period,
+                 unsigned long long duty, unsigned long long phase,
+                 int start, long long number) {
+    if (duty == 0 || duty >= period) {
+        perror("Invalid duty cycle for a clock.");
+        exit(1);
+    }
+    Clock clock = malloc(sizeof(ClockS));
+    clock->signal = signal;
+    clock->period = period;
+    clock->duty = duty;
+    clock->phase = phase;
+    clock->start = start ? 1 : 0;
+    clock->number = number;
+    clock->next_time = phase;
+    clock->level = clock->start;
+    register_clock(clock);
+
+    return clock;
+}
+
+
 /** Creates a delay.
  *  Actually generates an unsigned long long giving the corresponding
  *  delay in the base unit of the simulator. 
@@ -843,5 +1079,10 @@ void configure(SystemI systemI, int idx) {
 
 /** Terminates the simulation. */
 void terminate() {
+    snapshot_end(hruby_sim_time);
+    golden_end(hruby_sim_time);
+    coverage_end(hruby_sim_time);
+    profile_report(hruby_sim_time);
+    metrics_stop();
     exit(0);
 }
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation coverage collection, to be used with C code
+ *  generated by the csim engine or by the rcsim engine.
+ *  For each bit of the signals of the hierarchy, the numbers of rising
+ *  (0 to 1) and falling (1 to 0) toggles are counted when the signals
+ *  are updated by the kernel, using the last value seen for each signal:
+ *  for two-state values of up to 64 bits only the bits set in the XOR of
+ *  the last and the new values are visited.
+ *  The behaviors and the non-HDLRuby codes count their executions
+ *  themselves.
+ *  The coverage is saved at the end of the simulation as a JSON file
+ *  that can be merged with the ones of other runs using hdrcov.
+ **/
+
+/** The coverage of a signal. */
+typedef struct CoverSignalS_ {
+    char* name;                 /* The full name of the signal. */
+    unsigned long long width;   /* The width of the signal. */
+    unsigned long long mask;    /* The mask of the bits of the signal. */
+    unsigned long long changes; /* The number of value changes. */
+    int known;                  /* Tells if the last value is two-state and
+                                   in last (otherwise it is in last_str). */
+    unsigned long long last;    /* The last value if two-state. */
+    char* last_str;             /* The last value as bits, lsb first. */
+    unsigned long long* rises;  /* The rising toggles per bit, lsb first. */
+    unsigned long long* falls;  /* The falling toggles per bit, lsb first. */
+} CoverSignalS;
+
+typedef CoverSignalS* CoverSignal;
+
+/* Tells if the coverage is collected. */
+int coverage_active = 0;
+
+/* The file where to save the coverage. */
+static char* coverage_filename = NULL;
+
+/* The coverage of the signals indexed by signal id. */
+static CoverSignal* cover_signals = NULL;
+static size_t num_cover_signals = 0;
+
+/* The top system whose coverage is collected. */
+static SystemT coverage_top = NULL;
+
+/* The file being written. */
+static FILE* coverage_out = NULL;
+static int coverage_first = 1;
+
+
+/** Sets the file where to save the coverage, enabling its collection.
+ *  @param filename the name of the file */
+void coverage_file(const char* filename) {
+    free(coverage_filename);
+    coverage_filename = strdup(filename);
+}
+
+
+/** Gets bit i of a value as a character.
+ *  @param value the value
+ *  @param i the index of the bit */
+static char coverage_bit(Value value, unsigned long long i) {
+    if (value->numeric)
+        return i < 64 && ((value->data_int >> i) & 1) ? '1' : '0';
+    return value->data_str[i];
+}
+
+/** Sets the last value of a signal coverage.
+ *  @param cov the signal coverage
+ *  @param value the new value */
+static void coverage_set_last(CoverSignal cov, Value value) {
+    unsigned long long i;
+    if (value->numeric && cov->width <= 64) {
+        cov->known = 1;
+        cov->last = value->data_int & cov->mask;
+        return;
+    }
+    cov->known = 0;
+    if (!cov->last_str) cov->last_str = malloc(cov->width);
+    for(i=0; i<cov->width; ++i) cov->last_str[i] = coverage_bit(value,i);
+}
+
+/** Adds a signal of the hierarchy to the coverage.
+ *  @param signal the signal to add
+ *  @param path the full name of the signal
+ *  @param kind the kind of port of the signal */
+static void coverage_add_signal(SignalI signal, const char* path, int kind) {
+    /* Only the flat signals are covered. */
+    if (signal->num_signals > 0 || !signal->c_value) return;
+    if (signal->id >= num_cover_signals) {
+        size_t num = (signal->id+1)*2;
+        cover_signals = realloc(cover_signals,num*sizeof(CoverSignal));
+        memset(cover_signals+num_cover_signals,0,
+               (num-num_cover_signals)*sizeof(CoverSignal));
+        num_cover_signals = num;
+    }
+    if (cover_signals[signal->id]) return;
+    CoverSignal cov = calloc(1,sizeof(CoverSignalS));
+    cov->name = strdup(path);
+    cov->width = type_width(signal->type);
+    cov->mask = cov->width >= 64 ? ~0ULL : (1ULL << cov->width) - 1;
+    cov->rises = calloc(cov->width,sizeof(unsigned long long));
+    cov->falls = calloc(cov->width,sizeof(unsigned long long));
+    coverage_set_last(cov,signal->c_value);
+    cover_signals[signal->id] = cov;
+}
+
+/** Sets up the coverage of the signals of a top system.
+ *  @param top the top system */
+void coverage_start(SystemT top) {
+    if (!coverage_filename) return;
+    coverage_top = top;
+    each_signal_path(top,&coverage_add_signal);
+    coverage_active = 1;
+}
+
+
+/** Counts the bit toggles of a signal whose value has just been updated.
+ *  @param signal the updated signal */
+void coverage_toggle(SignalI signal) {
+    if (signal->id >= num_cover_signals) return;
+    CoverSignal cov = cover_signals[signal->id];
+    if (!cov) return;
+    Value value = signal->c_value;
+    ++cov->changes;
+    if (cov->known && value->numeric && cov->width <= 64) {
+        /* Fast path: only visit the toggled bits. */
+        unsigned long long data = value->data_int & cov->mask;
+        unsigned long long diff = cov->last ^ data;
+        while(diff) {
+            int i = __builtin_ctzll(diff);
+            if ((data >> i) & 1) ++cov->rises[i];
+            else                 ++cov->falls[i];
+            diff &= diff - 1;
+        }
+        cov->last = data;
+        return;
+    }
+    /* General case, bit by bit. */
+    unsigned long long i;
+    for(i=0; i<cov->width; ++i) {
+        char prev = cov->known ? ((cov->last >> i) & 1 ? '1' : '0') :
+                                 cov->last_str[i];
+        char next = coverage_bit(value,i);
+        if (prev == '0' && next == '1') ++cov->rises[i];
+        else if (prev == '1' && next == '0') ++cov->falls[i];
+    }
+    coverage_set_last(cov,value);
+}
+
+
+/** Writes a name as a JSON string.
+ *  @param name the name to write */
+static void coverage_print_name(const char* name) {
+    fputc('"',coverage_out);
+    for(; *name; ++name) {
+        if (*name == '"' || *name == '\\') fputc('\\',coverage_out);
+        fputc(*name,coverage_out);
+    }
+    fputc('"',coverage_out);
+}
+
+/** Writes the counts of a signal coverage as a JSON array.
+ *  @param counts the counts to write
+ *  @param width the number of counts */
+static void coverage_print_counts(unsigned long long* counts,
+                                  unsigned long long width) {
+    unsigned long long i;
+    fputc('[',coverage_out);
+    for(i=0; i<width; ++i)
+        fprintf(coverage_out,i ? ",%llu" : "%llu",counts[i]);
+    fputc(']',coverage_out);
+}
+
+/** Writes the activation count of a behavior or a code.
+ *  @param code the behavior or code to write
+ *  @param path the full name of the behavior or code */
+static void coverage_print_code(Object code, const char* path) {
+    unsigned long long activations = code->kind == BEHAVIOR ?
+        ((Behavior)code)->activations : ((Code)code)->activations;
+    fputs(coverage_first ? "\n  " : ",\n  ",coverage_out);
+    coverage_first = 0;
+    fputs("{\"name\":",coverage_out);
+    coverage_print_name(path);
+    fprintf(coverage_out,",\"activations\":%llu}",activations);
+}
+
+/** Saves the coverage.
+ *  @param time the end time of the simulation (in ps) */
+void coverage_end(unsigned long long time) {
+    size_t i;
+    if (!coverage_active) return;
+    coverage_active = 0;
+    const char* filename = checkpoint_path(coverage_filename);
+    coverage_out = fopen(filename,"w");
+    if (!coverage_out) {
+        perror(filename);
+        return;
+    }
+    fprintf(coverage_out,"{\"format\":\"hdlruby-coverage\",\"version\":1,"
+            "\"runs\":1,\"time\":%llu,\n\"signals\":[",time);
+    coverage_first = 1;
+    for(i=0; i<num_cover_signals; ++i) {
+        CoverSignal cov = cover_signals[i];
+        if (!cov) continue;
+        fputs(coverage_first ? "\n  " : ",\n  ",coverage_out);
+        coverage_first = 0;
+        fputs("{\"name\":",coverage_out);
+        coverage_print_name(cov->name);
+        fprintf(coverage_out,",\"width\":%llu,\"changes\":%llu,\"rises\":",
+                cov->width,cov->changes);
+        coverage_print_counts(cov->rises,cov->width);
+        fputs(",\"falls\":",coverage_out);
+        coverage_print_counts(cov->falls,cov->width);
+        fputc('}',coverage_out);
+    }
+    fputs("],\n\"behaviors\":[",coverage_out);
+    coverage_first = 1;
+    each_code_path(coverage_top,&coverage_print_code);
+    fputs("]}\n",coverage_out);
+    fclose(coverage_out);
+    coverage_out = NULL;
+}
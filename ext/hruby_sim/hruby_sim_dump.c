@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fnmatch.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation dump selection, to be used with C code
+ *  generated by the csim engine or by the rcsim engine.
+ *  The signals to dump are selected once before the simulation starts
+ *  by matching their full names (the names of the enclosing instances,
+ *  scopes and blocks separated by '.' from the top system excluded)
+ *  against glob patterns. The dump can also be restricted to a time
+ *  window and switched on and off by the design.
+ *  The walk of the hierarchy with the full names is also used for
+ *  binding the signals of the stimulus replay and for naming the
+ *  coverage.
+ **/
+
+/* Tells if the dump is currently active. */
+int dump_active = 1;
+
+/* The include and exclude patterns. */
+static char** dump_includes = NULL;
+static int num_dump_includes = 0;
+static char** dump_excludes = NULL;
+static int num_dump_excludes = 0;
+
+/* The time window of the dump. */
+static unsigned long long dump_start = 0;
+static unsigned long long dump_stop = ULLONG_MAX;
+
+/* The dump status set by the design. */
+static int dump_on = 1;
+
+/* The full name of the currently visited object. */
+#define DUMP_PATH_SIZE 4096
+static char dump_path[DUMP_PATH_SIZE];
+
+
+/** Adds a pattern to a list of patterns.
+ *  @param patterns the list to add to
+ *  @param num the number of patterns of the list
+ *  @param pattern the pattern to add */
+static void add_pattern(char*** patterns, int* num, const char* pattern) {
+    *patterns = realloc(*patterns,(*num+1)*sizeof(char*));
+    (*patterns)[(*num)++] = strdup(pattern);
+}
+
+/** Adds a pattern of the signals to dump, by default all are dumped.
+ *  @param pattern the glob pattern matching the full name of a signal
+ *         or of one of its enclosing scopes, e.g. "cpu.alu.*" */
+void dump_include(const char* pattern) {
+    add_pattern(&dump_includes,&num_dump_includes,pattern);
+}
+
+/** Adds a pattern of the signals not to dump.
+ *  @param pattern the glob pattern matching the full name of a signal
+ *         or of one of its enclosing scopes */
+void dump_exclude(const char* pattern) {
+    add_pattern(&dump_excludes,&num_dump_excludes,pattern);
+}
+
+/** Sets the time window of the dump.
+ *  @param start the start time of the dump (in ps)
+ *  @param stop the time when the dump stops (in ps) */
+void dump_window(unsigned long long start, unsigned long long stop) {
+    dump_start = start;
+    dump_stop = stop;
+}
+
+/** Switches the dump on or off from the next time step.
+ *  @param on the new status of the dump */
+void dump_switch(int on) {
+    dump_on = on;
+}
+
+
+/** Tells if the current path or one of its enclosing scopes matches a
+ *  list of patterns.
+ *  @param patterns the patterns to match
+ *  @param num the number of patterns
+ *  @param len the length of the current path */
+static int match_path(char** patterns, int num, size_t len) {
+    int i;
+    size_t j;
+    for(i=0; i<num; ++i) {
+        if (fnmatch(patterns[i],dump_path,0) == 0) return 1;
+        /* Try the enclosing scopes. */
+        for(j=len; j>0; --j) {
+            if (dump_path[j-1] != '.') continue;
+            dump_path[j-1] = 0;
+            int res = fnmatch(patterns[i],dump_path,0) == 0;
+            dump_path[j-1] = '.';
+            if (res) return 1;
+        }
+    }
+    return 0;
+}
+
+/** Adds a name to the current path.
+ *  @param len the length of the current path
+ *  @param name the name to add, unnamed objects are not part of the path
+ *  @return the new length of the path */
+static size_t push_path(size_t len, const char* name) {
+    if (name == NULL || name[0] == 0) return len;
+    size_t size = strlen(name);
+    if (len + size + 2 > DUMP_PATH_SIZE) return len;
+    if (len > 0) dump_path[len++] = '.';
+    memcpy(dump_path+len,name,size+1);
+    return len + size;
+}
+
+
+/* The function applied to the signals while walking the hierarchy. */
+static void (*walk_func)(SignalI signal, const char* path, int kind);
+
+/** Walks a signal and its sub signals.
+ *  @param signal the signal to walk
+ *  @param len the length of the path of the enclosing scope
+ *  @param kind the kind of port of the signal, 0 if not a port */
+static void walk_signal(SignalI signal, size_t len, int kind) {
+    int i;
+    len = push_path(len,signal->name);
+    walk_func(signal,dump_path,kind);
+    for(i=0; i<signal->num_signals; ++i)
+        walk_signal(signal->signals[i],len,kind);
+    dump_path[len] = 0;
+}
+
+static void walk_systemT(SystemT system, size_t len);
+static void walk_scope(Scope scope, size_t len);
+
+#ifdef RCSIM
+/** Walks the signals declared in a statement.
+ *  @param stmnt the statement to process
+ *  @param len the length of the path of the enclosing scope */
+static void walk_statement(Statement stmnt, size_t len) {
+    int i;
+    switch(stmnt->kind) {
+        case HIF:
+            {
+                HIf hif = (HIf)stmnt;
+                walk_statement(hif->yes,len);
+                for(i=0; i<hif->num_noifs; ++i)
+                    walk_statement(hif->nostmnts[i],len);
+                if (hif->no) walk_statement(hif->no,len);
+                break;
+            }
+        case HCASE:
+            {
+                HCase hcase = (HCase)stmnt;
+                for(i=0; i<hcase->num_whens; ++i)
+                    walk_statement(hcase->stmnts[i],len);
+                if (hcase->defolt) walk_statement(hcase->defolt,len);
+                break;
+            }
+        case TIME_REPEAT:
+            walk_statement(((TimeRepeat)stmnt)->statement,len);
+            break;
+        case BLOCK:
+            {
+                Block block = (Block)stmnt;
+                size_t blen = push_path(len,block->name);
+                for(i=0; i<block->num_inners; ++i)
+                    walk_signal(block->inners[i],blen,0);
+                for(i=0; i<block->num_stmnts; ++i)
+                    walk_statement(block->stmnts[i],blen);
+                dump_path[len] = 0;
+                break;
+            }
+        default: /* No declaration. */
+            break;
+    }
+}
+#endif
+
+/** Walks the signals of a scope.
+ *  @param scope the scope to process
+ *  @param len the length of the path of the enclosing scope */
+static void walk_scope(Scope scope, size_t len) {
+    int i;
+    for(i=0; i<scope->num_inners; ++i)
+        walk_signal(scope->inners[i],len,0);
+    for(i=0; i<scope->num_systemIs; ++i) {
+        SystemI systemI = scope->systemIs[i];
+        walk_systemT(systemI->system,push_path(len,systemI->name));
+        dump_path[len] = 0;
+    }
+    for(i=0; i<scope->num_scopes; ++i) {
+        Scope sub = scope->scopes[i];
+        walk_scope(sub,push_path(len,sub->name));
+        dump_path[len] = 0;
+    }
+    for(i=0; i<scope->num_behaviors; ++i) {
+        Block block = scope->behaviors[i]->block;
+        size_t blen = push_path(len,block->name);
+        int j;
+        for(j=0; j<block->num_inners; ++j)
+            walk_signal(block->inners[j],blen,0);
+#ifdef RCSIM
+        for(j=0; j<block->num_stmnts; ++j)
+            walk_statement(block->stmnts[j],blen);
+#endif
+        dump_path[len] = 0;
+    }
+}
+
+/** Walks the signals of a system.
+ *  @param system the system to process
+ *  @param len the length of the path of the system */
+static void walk_systemT(SystemT system, size_t len) {
+    int i;
+    for(i=0; i<system->num_inputs; ++i)
+        walk_signal(system->inputs[i],len,PORT_INPUT);
+    for(i=0; i<system->num_outputs; ++i)
+        walk_signal(system->outputs[i],len,PORT_OUTPUT);
+    for(i=0; i<system->num_inouts; ++i)
+        walk_signal(system->inouts[i],len,PORT_INOUT);
+    walk_scope(system->scope,len);
+}
+
+/** Applies a function to each signal of the hierarchy under a top system
+ *  with its full name (the names of the enclosing instances, scopes and
+ *  blocks separated by '.' from the top system excluded).
+ *  @param top the top system
+ *  @param func the function to apply, also given the kind of port of the
+ *         signal (PORT_INPUT, PORT_OUTPUT, PORT_INOUT, 0 if not a port) */
+void each_signal_path(SystemT top,
+                      void (*func)(SignalI signal, const char* path,
+                                   int kind)) {
+    walk_func = func;
+    dump_path[0] = 0;
+    walk_systemT(top,0);
+}
+
+
+/** Tells if the signal being walked by each_signal_path or one of its
+ *  enclosing scopes matches a list of patterns.
+ *  @param patterns the glob patterns to match
+ *  @param num the number of patterns */
+int walk_matches(char** patterns, int num) {
+    return match_path(patterns,num,strlen(dump_path));
+}
+
+
+/* The function applied to the behaviors and codes while walking the
+ * hierarchy. */
+static void (*walk_code_func)(Object code, const char* path);
+
+static void walk_code_scope(Scope scope, size_t len);
+
+/** Walks the behaviors and codes of a system.
+ *  @param system the system to process
+ *  @param len the length of the path of the system */
+static void walk_code_systemT(SystemT system, size_t len) {
+    walk_code_scope(system->scope,len);
+}
+
+/** Walks the behaviors and codes of a scope.
+ *  @param scope the scope to process
+ *  @param len the length of the path of the enclosing scope */
+static void walk_code_scope(Scope scope, size_t len) {
+    int i;
+    char name[32];
+    for(i=0; i<scope->num_systemIs; ++i) {
+        SystemI systemI = scope->systemIs[i];
+        walk_code_systemT(systemI->system,push_path(len,systemI->name));
+        dump_path[len] = 0;
+    }
+    for(i=0; i<scope->num_scopes; ++i) {
+        Scope sub = scope->scopes[i];
+        walk_code_scope(sub,push_path(len,sub->name));
+        dump_path[len] = 0;
+    }
+    for(i=0; i<scope->num_behaviors; ++i) {
+        Block block = scope->behaviors[i]->block;
+        if (block->name && block->name[0]) {
+            push_path(len,block->name);
+        } else {
+            snprintf(name,sizeof(name),"behavior%d",i);
+            push_path(len,name);
+        }
+        walk_code_func((Object)scope->behaviors[i],dump_path);
+        dump_path[len] = 0;
+    }
+    for(i=0; i<scope->num_codes; ++i) {
+        push_path(len,scope->codes[i]->name);
+        walk_code_func((Object)scope->codes[i],dump_path);
+        dump_path[len] = 0;
+    }
+}
+
+/** Applies a function to each behavior and non-HDLRuby code of the
+ *  hierarchy under a top system with its full name.
+ *  @param top the top system
+ *  @param func the function to apply to the behaviors and the codes */
+void each_code_path(SystemT top, void (*func)(Object code, const char* path)) {
+    walk_code_func = func;
+    dump_path[0] = 0;
+    walk_code_systemT(top,0);
+}
+
+
+/** Selects a signal for dumping if it matches the patterns.
+ *  @param signal the signal to select
+ *  @param path the full name of the signal
+ *  @param kind the kind of port of the signal */
+static void select_signal(SignalI signal, const char* path, int kind) {
+    size_t len = strlen(path);
+    signal->dump = (num_dump_includes == 0 ||
+                    match_path(dump_includes,num_dump_includes,len)) &&
+                   !match_path(dump_excludes,num_dump_excludes,len);
+}
+
+/** Sets the dump status of a signal to the default.
+ *  @param signal the signal to set */
+static void unselect_signal(SignalI signal) {
+    signal->dump = 0;
+}
+
+/** Selects the signals to dump under a top system.
+ *  @param top the top system */
+void dump_select(SystemT top) {
+    /* The dump status at time 0. */
+    dump_active = dump_on && dump_start == 0 && dump_stop > 0;
+    /* Without pattern, all the signals are dumped. */
+    if (num_dump_includes == 0 && num_dump_excludes == 0) return;
+    /* Only the signals in the hierarchy can be selected. */
+    each_all_signal(&unselect_signal);
+    each_signal_path(top,&select_signal);
+}
+
+
+/** Dumps the current value of a signal if selected.
+ *  @param signal the signal to dump */
+static void dump_signal(SignalI signal) {
+    if (signal->dump && signal->num_signals == 0 && signal->c_value)
+        printer.print_signal(signal);
+}
+
+/** Advances the dump to a new time step.
+ *  @param time the new time (in ps) */
+void dump_step(unsigned long long time) {
+    int active = dump_on && time >= dump_start && time < dump_stop;
+    if (!active) {
+        /* The dump stops, close its last time step. */
+        if (dump_active) printer.print_time(time);
+        dump_active = 0;
+        return;
+    }
+    printer.print_time(time);
+    if (!dump_active) {
+        /* The dump restarts, dump the current values of all the
+         * selected signals. */
+        dump_active = 1;
+        each_all_signal(&dump_signal);
+    }
+}
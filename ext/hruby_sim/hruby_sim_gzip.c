@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+
+/**
+ *  The HDLRuby simulation gzip compression of the output buffers.
+ *  NOTE: hruby_sim.h is not included here since zlib.h includes unistd.h
+ *  that conflicts with the simulator interface.
+ **/
+
+#ifdef HAVE_ZLIB
+/* The maximum size of a stored deflate block. */
+#define GZIP_STORED_MAX 65535
+
+/** Stores data without compression into a complete gzip member, used
+ *  when the compressor cannot be used, so that the data is kept and the
+ *  file remains a valid gzip file.
+ *  @param data the data to store
+ *  @param size the size of the data
+ *  @param zdata the destination, reallocated if too small
+ *  @param zcapacity the capacity of the destination, updated if
+ *         reallocated
+ *  @return the size of the gzip member */
+static size_t gzip_store(const char* data, size_t size,
+                         char** zdata, size_t* zcapacity) {
+    size_t num_blocks = size == 0 ? 1 :
+        (size + GZIP_STORED_MAX - 1) / GZIP_STORED_MAX;
+    size_t bound = 10 + num_blocks*5 + size + 8;
+    if (*zcapacity < bound) {
+        *zdata = realloc(*zdata,bound);
+        *zcapacity = bound;
+    }
+    unsigned char* dst = (unsigned char*)*zdata;
+    /* The header: magic, deflate, no flag, no time, unknown OS. */
+    static const unsigned char header[10] =
+        { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255 };
+    memcpy(dst,header,sizeof(header));
+    dst += sizeof(header);
+    /* The stored blocks. */
+    size_t pos = 0;
+    do {
+        size_t len = size - pos < GZIP_STORED_MAX ?
+            size - pos : GZIP_STORED_MAX;
+        *dst++ = pos + len == size; /* Last block flag, stored type. */
+        *dst++ = len & 0xff;
+        *dst++ = len >> 8;
+        *dst++ = ~len & 0xff;
+        *dst++ = (~len >> 8) & 0xff;
+        memcpy(dst,data+pos,len);
+        dst += len;
+        pos += len;
+    } while(pos < size);
+    /* The trailer: CRC32 and size, little endian. */
+    unsigned long crc = crc32(0L,(const Bytef*)data,size);
+    for(int i=0; i<4; ++i) *dst++ = (crc >> (8*i)) & 0xff;
+    for(int i=0; i<4; ++i) *dst++ = (size >> (8*i)) & 0xff;
+    return (char*)dst - *zdata;
+}
+#endif
+
+/** Compresses data into a complete gzip member.
+ *  If the compressor fails, the error is reported and the data is stored
+ *  uncompressed in the member instead.
+ *  @param level the compression level (1 to 9)
+ *  @param data the data to compress
+ *  @param size the size of the data
+ *  @param zdata the destination, reallocated if too small
+ *  @param zcapacity the capacity of the destination, updated if
+ *         reallocated
+ *  @return the size of the compressed data, 0 if not supported */
+size_t gzip_compress(int level, const char* data, size_t size,
+                     char** zdata, size_t* zcapacity) {
+#ifdef HAVE_ZLIB
+    z_stream zs;
+    memset(&zs,0,sizeof(zs));
+    /* 16 added to the window bits for a gzip wrapper. */
+    int ret = deflateInit2(&zs,level,Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY);
+    if (ret == Z_OK) {
+        size_t bound = deflateBound(&zs,size);
+        if (*zcapacity < bound) {
+            *zdata = realloc(*zdata,bound);
+            *zcapacity = bound;
+        }
+        zs.next_in = (Bytef*)data;
+        zs.avail_in = size;
+        zs.next_out = (Bytef*)*zdata;
+        zs.avail_out = bound;
+        ret = deflate(&zs,Z_FINISH);
+        deflateEnd(&zs);
+        if (ret == Z_STREAM_END) return bound - zs.avail_out;
+    }
+    /* Report the error once and keep the data uncompressed. */
+    static int reported = 0;
+    if (!__atomic_exchange_n(&reported,1,__ATOMIC_RELAXED))
+        fprintf(stderr,"Compression error (%d), output is stored uncompressed.\n",ret);
+    return gzip_store(data,size,zdata,zcapacity);
+#else
+    return 0;
+#endif
+}
+
+
+/** Compresses data into a zlib stream, used for the blocks of the
+ *  binary waveform files.
+ *  @param level the compression level (1 to 9)
+ *  @param data the data to compress
+ *  @param size the size of the data
+ *  @param zdata the destination, reallocated if too small
+ *  @param zcapacity the capacity of the destination, updated if
+ *         reallocated
+ *  @return the size of the compressed data, 0 if not supported or in
+ *          case of error */
+size_t zlib_compress(int level, const char* data, size_t size,
+                     char** zdata, size_t* zcapacity) {
+#ifdef HAVE_ZLIB
+    uLongf zsize = compressBound(size);
+    if (*zcapacity < zsize) {
+        *zdata = realloc(*zdata,zsize);
+        *zcapacity = zsize;
+    }
+    if (compress2((Bytef*)*zdata,&zsize,(const Bytef*)data,size,level) != Z_OK)
+        return 0;
+    return zsize;
+#else
+    return 0;
+#endif
+}
+
+/** Decompresses a zlib stream, used for the blocks of the binary
+ *  waveform files.
+ *  @param zdata the data to decompress
+ *  @param zsize the size of the data to decompress
+ *  @param data the destination
+ *  @param size the size of the decompressed data
+ *  @return 1 in case of success, 0 if not supported or in case of
+ *          error */
+int zlib_uncompress(const char* zdata, size_t zsize, char* data, size_t size) {
+#ifdef HAVE_ZLIB
+    uLongf dsize = size;
+    if (uncompress((Bytef*)data,&dsize,(const Bytef*)zdata,zsize) != Z_OK)
+        return 0;
+    return dsize == size;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,584 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation binary waveform (HBW) generation engine, to be
+ *  used with C code generated by the csim engine or by the rcsim engine.
+ *
+ *  The HBW format is a compact alternative to VCD. All the integers are
+ *  unsigned LEB128 varints, and the strings are a varint length followed
+ *  by the characters:
+ *
+ *    file   := "HBW1" decls block* index
+ *    decls  := { 'V' id width depth string^(depth+1) } 'E'
+ *    block  := 'B' start_delta duration encoding raw_size size payload
+ *    payload:= num_traces { id num_changes size change* }
+ *    change := (time_delta << 1 | four_state) value
+ *    index  := 'I' num_blocks { start_delta offset_delta }
+ *              index_offset(8 bytes, little endian) "HBW1"
+ *
+ *  'V' declares a signal with the names of its enclosing objects from
+ *  the top (as in the VCD hierarchy) followed by its own name. The time deltas of a block are
+ *  relative to the previous block and the ones of a change to the
+ *  previous change of the same signal in the block (or to the block
+ *  start). A two-state value is packed 8 bits per byte lsb first, a
+ *  four-state value uses one character per bit lsb first. The encoding
+ *  of the payload is 0 for raw and 1 for a zlib stream (deflate), used
+ *  when the simulator supports it, raw_size being the size of the
+ *  payload once inflated and size the size stored in the file.
+ **/
+
+/* The target output. */
+static Output hbw_out;
+
+/* The number of bytes written so far, for indexing the blocks. */
+static unsigned long long hbw_offset = 0;
+
+/* The target size of the payload of a block. */
+#define HBW_BLOCK_SIZE (256*1024)
+
+/* The compression level of the blocks: the fastest since the blocks are
+ * compressed while simulating. */
+#define HBW_BLOCK_LEVEL 1
+
+/* The encodings of the payload of a block. */
+#define HBW_RAW  0
+#define HBW_ZLIB 1
+
+
+/* Low-end writing functions. */
+
+/** Writes data.
+ *  @param data the data to write
+ *  @param len the size of the data */
+static void hbw_write(const char* data, size_t len) {
+    output_write(hbw_out,data,len);
+    hbw_offset += len;
+}
+
+/** Writes a byte.
+ *  @param byte the byte to write */
+static void hbw_write_byte(unsigned char byte) {
+    hbw_write((char*)&byte,1);
+}
+
+/** Encodes a varint.
+ *  @param num the integer to encode
+ *  @param dst where to encode, at least 10 bytes
+ *  @return the size of the encoding */
+static inline size_t hbw_varint(unsigned long long num, unsigned char* dst) {
+    size_t len = 0;
+    while(num >= 0x80) {
+        dst[len++] = (num & 0x7F) | 0x80;
+        num >>= 7;
+    }
+    dst[len++] = num;
+    return len;
+}
+
+/** Writes a varint.
+ *  @param num the integer to write */
+static void hbw_write_varint(unsigned long long num) {
+    unsigned char text[10];
+    hbw_write((char*)text,hbw_varint(num,text));
+}
+
+/** Writes a string.
+ *  @param str the string to write */
+static void hbw_write_string(const char* str) {
+    size_t len = strlen(str);
+    hbw_write_varint(len);
+    hbw_write(str,len);
+}
+
+/** Writes the name of an object.
+ *  @param object the object to write the name of */
+static void hbw_write_name(Object object) {
+    /* Trick: SystemT, Block, Scope and SystemI have the
+     * field name at the same place. */
+    char* name = object->kind == SIGNALI ?
+        ((SignalI)object)->name : ((Block)object)->name;
+    if (name != NULL && strlen(name) > 0) {
+        hbw_write_string(name);
+    } else {
+        /* No name, use the address of the object as name generator.*/
+        char text[32];
+        snprintf(text,32,"x$%p",(void*)object);
+        hbw_write_string(text);
+    }
+}
+
+
+/* The traces of the signals in the current block. */
+
+/** The changes of a signal within the current block. */
+typedef struct {
+    unsigned char* data;      /* The encoded changes. */
+    size_t size;              /* The size of the encoded changes. */
+    size_t capacity;          /* The capacity of the data. */
+    unsigned long long last;  /* The time of the last change. */
+    unsigned long long num;   /* The number of changes. */
+    int declared;             /* Tells if the signal is declared. */
+} HbwTraceS;
+
+/* The traces indexed by signal id. */
+static HbwTraceS* hbw_traces = NULL;
+static size_t hbw_cap_traces = 0;
+
+/* The ids of the signals with changes in the current block. */
+static size_t* hbw_active = NULL;
+static size_t hbw_num_active = 0;
+static size_t hbw_cap_active = 0;
+
+/* The current block: its start, its last time and its size. */
+static unsigned long long hbw_block_start = 0;
+static unsigned long long hbw_block_end = 0;
+static size_t hbw_block_size = 0;
+
+/* The payload of the current block once assembled, and compressed. */
+static char* hbw_payload = NULL;
+static size_t hbw_cap_payload = 0;
+static char* hbw_zpayload = NULL;
+static size_t hbw_cap_zpayload = 0;
+
+/* The index of the blocks: their start times and offsets. */
+static unsigned long long* hbw_index_times = NULL;
+static unsigned long long* hbw_index_offsets = NULL;
+static size_t hbw_num_blocks = 0;
+static size_t hbw_cap_blocks = 0;
+
+/** Gets the trace of a signal.
+ *  @param id the id of the signal
+ *  @return the trace */
+static HbwTraceS* hbw_trace(size_t id) {
+    /* Ensure there is room for the trace. */
+    if (id >= hbw_cap_traces) {
+        size_t cap = hbw_cap_traces ? hbw_cap_traces : 256;
+        while(cap <= id) cap *= 2;
+        hbw_traces = realloc(hbw_traces,cap*sizeof(HbwTraceS));
+        memset(hbw_traces+hbw_cap_traces,0,
+               (cap-hbw_cap_traces)*sizeof(HbwTraceS));
+        hbw_cap_traces = cap;
+    }
+    return &hbw_traces[id];
+}
+
+/** Records the current value of a signal in its trace.
+ *  @param signal the signal to record
+ *  @param time the time of the change */
+static void hbw_record(SignalI signal, unsigned long long time) {
+    Value value = signal->c_value;
+    unsigned long long width = type_width(value->type);
+    HbwTraceS* trace = hbw_trace(signal->id);
+    unsigned long long i;
+    int four_state = 0;
+    /* Check the kind of value. */
+    if (!value->numeric) {
+        if (value->capacity == 0) four_state = 1;
+        else {
+            for(i=0; i<width; ++i) {
+                char c = value->data_str[i];
+                if (c != '0' && c != '1') { four_state = 1; break; }
+            }
+        }
+    }
+    /* Ensure there is room for the change. */
+    size_t max = 10 + (four_state ? width : (width+7)/8);
+    if (trace->size + max > trace->capacity) {
+        size_t cap = trace->capacity ? trace->capacity : 64;
+        while(cap < trace->size + max) cap *= 2;
+        trace->data = realloc(trace->data,cap);
+        trace->capacity = cap;
+    }
+    /* Is it the first change of the signal in the block? */
+    if (trace->num == 0) {
+        /* Yes, it becomes active. */
+        trace->last = hbw_block_start;
+        if (hbw_num_active == hbw_cap_active) {
+            hbw_cap_active = hbw_cap_active ? hbw_cap_active*2 : 256;
+            hbw_active = realloc(hbw_active,hbw_cap_active*sizeof(size_t));
+        }
+        hbw_active[hbw_num_active++] = signal->id;
+    }
+    /* Encode the change. */
+    size_t start = trace->size;
+    unsigned char* dst = trace->data + trace->size;
+    dst += hbw_varint(((time - trace->last) << 1) | four_state, dst);
+    if (four_state) {
+        if (value->capacity == 0) memset(dst,'u',width);
+        else memcpy(dst,value->data_str,width);
+        dst += width;
+    } else if (value->numeric) {
+        unsigned long long data = value->data_int;
+        for(i=0; i<width; i+=8) {
+            *(dst++) = i < 64 ? (data >> i) & 0xFF : 0;
+        }
+    } else {
+        memset(dst,0,(width+7)/8);
+        for(i=0; i<width; ++i) {
+            if (value->data_str[i] == '1') dst[i/8] |= 1 << (i%8);
+        }
+        dst += (width+7)/8;
+    }
+    trace->size = dst - trace->data;
+    trace->last = time;
+    ++trace->num;
+    hbw_block_size += trace->size - start;
+}
+
+/** Appends data to the payload of the current block.
+ *  @param pos the position where to append, updated
+ *  @param data the data to append
+ *  @param len the size of the data */
+static void hbw_payload_append(size_t* pos, const void* data, size_t len) {
+    memcpy(hbw_payload + *pos,data,len);
+    *pos += len;
+}
+
+/** Appends a varint to the payload of the current block.
+ *  @param pos the position where to append, updated
+ *  @param num the integer to append */
+static void hbw_payload_varint(size_t* pos, unsigned long long num) {
+    *pos += hbw_varint(num,(unsigned char*)hbw_payload + *pos);
+}
+
+/** Writes the current block and starts a new one. */
+static void hbw_write_block() {
+    size_t i;
+    unsigned char text[10];
+    if (hbw_num_active == 0) return;
+    /* Compute the size of the payload. */
+    size_t size = hbw_varint(hbw_num_active,text);
+    for(i=0; i<hbw_num_active; ++i) {
+        size_t id = hbw_active[i];
+        HbwTraceS* trace = &hbw_traces[id];
+        size += hbw_varint(id,text) + hbw_varint(trace->num,text)
+            + hbw_varint(trace->size,text) + trace->size;
+    }
+    /* Assemble the payload. */
+    if (hbw_cap_payload < size) {
+        hbw_payload = realloc(hbw_payload,size);
+        hbw_cap_payload = size;
+    }
+    size_t pos = 0;
+    hbw_payload_varint(&pos,hbw_num_active);
+    for(i=0; i<hbw_num_active; ++i) {
+        size_t id = hbw_active[i];
+        HbwTraceS* trace = &hbw_traces[id];
+        hbw_payload_varint(&pos,id);
+        hbw_payload_varint(&pos,trace->num);
+        hbw_payload_varint(&pos,trace->size);
+        hbw_payload_append(&pos,trace->data,trace->size);
+        /* Reset the trace for the next block. */
+        trace->size = 0;
+        trace->num = 0;
+    }
+    /* Compress it if possible and worth it. */
+    size_t zsize = zlib_compress(HBW_BLOCK_LEVEL,hbw_payload,size,
+                                 &hbw_zpayload,&hbw_cap_zpayload);
+    int encoding = zsize > 0 && zsize < size ? HBW_ZLIB : HBW_RAW;
+    /* Index the block. */
+    if (hbw_num_blocks == hbw_cap_blocks) {
+        hbw_cap_blocks = hbw_cap_blocks ? hbw_cap_blocks*2 : 256;
+        hbw_index_times = realloc(hbw_index_times,
+                hbw_cap_blocks*sizeof(unsigned long long));
+        hbw_index_offsets = realloc(hbw_index_offsets,
+                hbw_cap_blocks*sizeof(unsigned long long));
+    }
+    unsigned long long prev_start = hbw_num_blocks > 0 ?
+        hbw_index_times[hbw_num_blocks-1] : 0;
+    hbw_index_times[hbw_num_blocks] = hbw_block_start;
+    hbw_index_offsets[hbw_num_blocks] = hbw_offset;
+    ++hbw_num_blocks;
+    /* Write the block header. */
+    hbw_write_byte('B');
+    hbw_write_varint(hbw_block_start - prev_start);
+    hbw_write_varint(hbw_block_end - hbw_block_start);
+    hbw_write_varint(encoding);
+    hbw_write_varint(size);
+    /* Write the payload. */
+    if (encoding == HBW_ZLIB) {
+        hbw_write_varint(zsize);
+        hbw_write(hbw_zpayload,zsize);
+    } else {
+        hbw_write_varint(size);
+        hbw_write(hbw_payload,size);
+    }
+    hbw_num_active = 0;
+    hbw_block_size = 0;
+}
+
+
+/* Coalescing of the signal changes: the signals changed during a time
+ * step are only marked, and their final values are recorded once when
+ * time advances. */
+
+/* The signals changed during the current time step. */
+static SignalI* hbw_changed = NULL;
+static size_t hbw_num_changed = 0;
+static size_t hbw_cap_changed = 0;
+
+/* The marks of the changed signals, indexed by signal id. */
+static char* hbw_marks = NULL;
+static size_t hbw_cap_marks = 0;
+
+/* The current time step. */
+static unsigned long long hbw_cur_time = 0;
+
+/** Marks a signal as changed during the current time step.
+ *  @param signal the changed signal */
+static void hbw_mark_signal(SignalI signal) {
+    size_t id = signal->id;
+    /* Ensure there is room for the mark. */
+    if (id >= hbw_cap_marks) {
+        size_t cap = hbw_cap_marks ? hbw_cap_marks : 256;
+        while(cap <= id) cap *= 2;
+        hbw_marks = realloc(hbw_marks,cap);
+        memset(hbw_marks+hbw_cap_marks,0,cap-hbw_cap_marks);
+        hbw_cap_marks = cap;
+    }
+    /* Already marked? */
+    if (hbw_marks[id]) return;
+    /* No, add it to the changed signals. */
+    if (hbw_num_changed == hbw_cap_changed) {
+        hbw_cap_changed = hbw_cap_changed ? hbw_cap_changed*2 : 256;
+        hbw_changed = realloc(hbw_changed,hbw_cap_changed*sizeof(SignalI));
+    }
+    hbw_changed[hbw_num_changed++] = signal;
+    hbw_marks[id] = 1;
+}
+
+/** Records the final values of the signals changed during the current
+ *  time step. */
+static void hbw_flush_changes() {
+    size_t i;
+    if (hbw_num_changed == 0) return;
+    for(i=0; i<hbw_num_changed; ++i) {
+        SignalI signal = hbw_changed[i];
+        hbw_record(signal,hbw_cur_time);
+        hbw_marks[signal->id] = 0;
+    }
+    hbw_num_changed = 0;
+    hbw_block_end = hbw_cur_time;
+}
+
+/** Advances to a new time step.
+ *  @param time the time of the new step (given in ps). */
+static void hbw_step_time(unsigned long long time) {
+    /* Still in the same time step? */
+    if (time == hbw_cur_time) return;
+    /* No, record the previous step and start the new one. */
+    hbw_flush_changes();
+    /* Is the block full? */
+    if (hbw_block_size >= HBW_BLOCK_SIZE) {
+        hbw_write_block();
+        hbw_block_start = time;
+        hbw_block_end = time;
+    }
+    hbw_cur_time = time;
+}
+
+/** Ends the waveform file at the end of the simulation. */
+static void hbw_close() {
+    size_t i;
+    hbw_flush_changes();
+    hbw_write_block();
+    /* Write the index. */
+    unsigned long long index_offset = hbw_offset;
+    hbw_write_byte('I');
+    hbw_write_varint(hbw_num_blocks);
+    for(i=0; i<hbw_num_blocks; ++i) {
+        hbw_write_varint(hbw_index_times[i] -
+                         (i > 0 ? hbw_index_times[i-1] : 0));
+        hbw_write_varint(hbw_index_offsets[i] -
+                         (i > 0 ? hbw_index_offsets[i-1] : 0));
+    }
+    for(i=0; i<8; ++i) hbw_write_byte((index_offset >> (i*8)) & 0xFF);
+    hbw_write("HBW1",4);
+    close_output(hbw_out);
+}
+
+
+/* The declarations of the signals. */
+
+/* The enclosing objects of the currently declared signals, from the top:
+ * the same hierarchy as the one of the VCD files. */
+#define HBW_MAX_DEPTH 1024
+static Object hbw_path[HBW_MAX_DEPTH];
+static int hbw_path_len = 0;
+
+/** Enters an object of the hierarchy.
+ *  @param object the object to enter */
+static void hbw_push(Object object) {
+    if (hbw_path_len < HBW_MAX_DEPTH) hbw_path[hbw_path_len] = object;
+    ++hbw_path_len;
+}
+
+/** Leaves the current object of the hierarchy. */
+static void hbw_pop() {
+    --hbw_path_len;
+}
+
+/** Declares a signal, and records its initial value.
+ *  @param signal the signal to declare */
+static void hbw_declare_signal(SignalI signal) {
+    int i;
+    if (signal->num_signals > 0) {
+        /* Hierarchical signal, declare its sub signals. */
+        hbw_push((Object)signal);
+        for(i=0; i<signal->num_signals; ++i)
+            hbw_declare_signal(signal->signals[i]);
+        hbw_pop();
+        return;
+    }
+    /* Only the selected signals are dumped. */
+    if (!signal->dump) return;
+    /* Declare each signal once. */
+    HbwTraceS* trace = hbw_trace(signal->id);
+    if (trace->declared || !signal->c_value) return;
+    trace->declared = 1;
+    int depth = hbw_path_len < HBW_MAX_DEPTH ? hbw_path_len : HBW_MAX_DEPTH;
+    hbw_write_byte('V');
+    hbw_write_varint(signal->id);
+    hbw_write_varint(type_width(signal->type));
+    hbw_write_varint(depth);
+    for(i=0; i<depth; ++i) hbw_write_name(hbw_path[i]);
+    hbw_write_name((Object)signal);
+    /* The initial value. */
+    if (dump_active) hbw_record(signal,0);
+}
+
+static void hbw_declare_systemT(SystemT system);
+static void hbw_declare_scope(Scope scope);
+#ifdef RCSIM
+static void hbw_declare_statement(Statement stmnt);
+#endif
+
+/** Declares the signals of a block and of its sub blocks.
+ *  @param block the block to declare */
+static void hbw_declare_block(Block block) {
+    int i;
+    hbw_push((Object)block);
+    for(i=0; i<block->num_inners; ++i)
+        hbw_declare_signal(block->inners[i]);
+#ifdef RCSIM
+    for(i=0; i<block->num_stmnts; ++i)
+        hbw_declare_statement(block->stmnts[i]);
+#endif
+    hbw_pop();
+}
+
+#ifdef RCSIM
+/** Declares the signals of the blocks within a statement.
+ *  @param stmnt the statement to process */
+static void hbw_declare_statement(Statement stmnt) {
+    int i;
+    switch(stmnt->kind) {
+        case HIF:
+            {
+                HIf hif = (HIf)stmnt;
+                hbw_declare_statement(hif->yes);
+                for(i=0; i<hif->num_noifs; ++i)
+                    hbw_declare_statement(hif->nostmnts[i]);
+                if (hif->no) hbw_declare_statement(hif->no);
+                break;
+            }
+        case HCASE:
+            {
+                HCase hcase = (HCase)stmnt;
+                for(i=0; i<hcase->num_whens; ++i)
+                    hbw_declare_statement(hcase->stmnts[i]);
+                if (hcase->defolt) hbw_declare_statement(hcase->defolt);
+                break;
+            }
+        case TIME_REPEAT:
+            hbw_declare_statement(((TimeRepeat)stmnt)->statement);
+            break;
+        case BLOCK:
+            hbw_declare_block((Block)stmnt);
+            break;
+        default: /* No declaration. */
+            break;
+    }
+}
+#endif
+
+/** Declares the signals of the content of a scope.
+ *  @param scope the scope to declare the content of */
+static void hbw_declare_scope_content(Scope scope) {
+    int i;
+    for(i=0; i<scope->num_inners; ++i)
+        hbw_declare_signal(scope->inners[i]);
+    for(i=0; i<scope->num_systemIs; ++i) {
+        SystemI systemI = scope->systemIs[i];
+        hbw_push((Object)systemI);
+        hbw_declare_systemT(systemI->system);
+        hbw_pop();
+    }
+    for(i=0; i<scope->num_scopes; ++i)
+        hbw_declare_scope(scope->scopes[i]);
+    for(i=0; i<scope->num_behaviors; ++i)
+        hbw_declare_block(scope->behaviors[i]->block);
+}
+
+/** Declares the signals of a scope.
+ *  @param scope the scope to declare */
+static void hbw_declare_scope(Scope scope) {
+    hbw_push((Object)scope);
+    hbw_declare_scope_content(scope);
+    hbw_pop();
+}
+
+/** Declares the signals of a system (its scope header is the system).
+ *  @param system the system to declare */
+static void hbw_declare_systemT(SystemT system) {
+    int i;
+    for(i=0; i<system->num_inputs; ++i)
+        hbw_declare_signal(system->inputs[i]);
+    for(i=0; i<system->num_outputs; ++i)
+        hbw_declare_signal(system->outputs[i]);
+    for(i=0; i<system->num_inouts; ++i)
+        hbw_declare_signal(system->inouts[i]);
+    hbw_declare_scope_content(system->scope);
+}
+
+
+/* The configuration and initialization of the hbw vizualizer. */
+
+
+/** Sets up the hbw vizualization engine.
+ *  @param name the name of the vizualization. */
+extern void init_hbw_visualizer(char* name) {
+    /* Open the resulting file with name: <name>.hbw */
+    char filename[256];
+    strncpy(filename,name,255);
+    strncat(filename,".hbw",255);
+    hbw_out = open_output(filename);
+    if (!hbw_out) {
+        /* Cannot dump, simulate without output. */
+        init_mute_visualizer(name);
+        return;
+    }
+
+    /* Initialize the vizualizer printer engine. */
+    init_visualizer(&hbw_step_time,
+                    &default_print_name,
+                    &default_print_value,
+                    &hbw_mark_signal,
+                    &default_print_string,
+                    &default_print_name,
+                    &default_print_value);
+
+    /* Writes the declarations with the initial values. */
+    hbw_write("HBW1",4);
+    hbw_push((Object)top_system);
+    hbw_declare_systemT(top_system);
+    hbw_pop();
+    hbw_write_byte('E');
+
+    /* The last changes are written when the simulation ends. */
+    atexit(&hbw_close);
+}
@@ -11,6 +11,9 @@
 /* The pool of list elements to reduce number of memory allocations. */
 static ListS pool_elements = { NULL, NULL };
 
+/* The number of list elements allocated. */
+static unsigned long long num_elements = 0;
+
 /** Get a list element for containing some data.
  *  @param data the data of the element
  *  @return the resulting element */
@@ -20,6 +23,7 @@ Elem get_element(void* data) {
     if (empty_list(&pool_elements)) {
         /* Yes, allocates a new element. */
         elem = (Elem)malloc(sizeof(ElemS));
+        ++num_elements;
         elem->data = data;
         elem->next = NULL;
     } else {
@@ -42,6 +46,12 @@ void delete_element(Elem elem) {
 }
 
 
+/** Gets the number of list elements allocated, in use or in the pool. */
+unsigned long long get_element_pool_size() {
+    return num_elements;
+}
+
+
 /** Builds a list.
  *  @param list the place where to build the list
  *  @return the resulting list */
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation memory image loader, to be used with C code
+ *  generated by hruby_low2c.
+ *  The image file is mapped in memory and decoded directly into the
+ *  storage of the signal.
+ *  */
+
+
+/** Gets the value of an hexadecimal digit, -1 if not a digit. */
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/** Tells if a character can be part of a word of a memory image text.
+ *  @param c the character to check
+ *  @param format the format of the text */
+static int word_char(char c, MemFormat format) {
+    switch(c) {
+        case '_': case 'x': case 'X': case 'z': case 'Z':
+            return 1;
+        default:
+            if (format == MEM_BIN) return c == '0' || c == '1';
+            return hex_digit(c) >= 0;
+    }
+}
+
+/** Decodes a word of a memory image text into bitstring data.
+ *  @param word the start of the text of the word
+ *  @param len the length of the text of the word
+ *  @param format the format of the text
+ *  @param width the width of the word in bits
+ *  @param data the destination bitstring data, lsb first */
+static void decode_word(const char* word, size_t len, MemFormat format,
+                        unsigned long long width, char* data) {
+    unsigned long long pos = 0;
+    int step = format == MEM_BIN ? 1 : 4;
+    size_t i;
+    /* Fill from the least significant digit. */
+    for(i = len; i > 0 && pos < width; --i) {
+        char c = word[i-1];
+        int j;
+        if (c == '_') continue;
+        for(j=0; j<step && pos < width; ++j, ++pos) {
+            switch(c) {
+                case 'x': case 'X': data[pos] = 'x'; break;
+                case 'z': case 'Z': data[pos] = 'z'; break;
+                default:
+                    data[pos] = ((hex_digit(c) >> j) & 1) ? '1' : '0';
+            }
+        }
+    }
+    /* The missing upper bits are 0. */
+    for(; pos < width; ++pos) data[pos] = '0';
+}
+
+/** Decodes a memory image text into bitstring data.
+ *  @param text the text to decode
+ *  @param size the size of the text
+ *  @param format the format of the text
+ *  @param width the width of the words
+ *  @param number the number of words of the destination
+ *  @param data the destination bitstring data
+ *  @return the number of loaded words, or -1 in case of error */
+static long long decode_text(const char* text, size_t size, MemFormat format,
+                             unsigned long long width,
+                             unsigned long long number, char* data) {
+    long long count = 0;
+    unsigned long long addr = 0;
+    size_t i = 0;
+    while(i < size) {
+        char c = text[i];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+            ++i;
+        } else if (c == '/' && i+1 < size && text[i+1] == '/') {
+            /* Line comment. */
+            while(i < size && text[i] != '\n') ++i;
+        } else if (c == '/' && i+1 < size && text[i+1] == '*') {
+            /* Block comment. */
+            for(i += 2; i+1 < size; ++i) {
+                if (text[i] == '*' && text[i+1] == '/') break;
+            }
+            i += 2;
+        } else if (c == '@') {
+            /* Address change, always in hexadecimal. */
+            addr = 0;
+            for(++i; i < size && hex_digit(text[i]) >= 0; ++i) {
+                addr = addr*16 + hex_digit(text[i]);
+            }
+        } else if (word_char(c,format)) {
+            /* A word. */
+            size_t start = i;
+            while(i < size && word_char(text[i],format)) ++i;
+            if (addr >= number) {
+                fprintf(stderr,"Memory image exceeds the memory size.\n");
+                return count;
+            }
+            decode_word(text+start,i-start,format,width,data+addr*width);
+            ++addr;
+            ++count;
+        } else {
+            fprintf(stderr,"Invalid character in memory image: '%c'.\n",c);
+            return -1;
+        }
+    }
+    return count;
+}
+
+/** Decodes a raw memory image into bitstring data.
+ *  @param raw the raw data to decode
+ *  @param size the size of the raw data
+ *  @param width the width of the words
+ *  @param number the number of words of the destination
+ *  @param data the destination bitstring data
+ *  @return the number of loaded words */
+static long long decode_raw(const unsigned char* raw, size_t size,
+                            unsigned long long width,
+                            unsigned long long number, char* data) {
+    /* The words are stored in full bytes, little-endian. */
+    unsigned long long bytes = (width+7)/8;
+    unsigned long long count = size / bytes;
+    unsigned long long i,j;
+    if (count > number) count = number;
+    for(i=0; i<count; ++i) {
+        const unsigned char* word = raw + i*bytes;
+        char* dst = data + i*width;
+        for(j=0; j<width; ++j) {
+            dst[j] = ((word[j/8] >> (j%8)) & 1) ? '1' : '0';
+        }
+    }
+    return count;
+}
+
+
+/** Loads a memory image file into the current and future values of a
+ *  signal, the words of the file filling the elements of the signal
+ *  starting from index 0.
+ *  @param signal the memory signal to fill
+ *  @param filename the name of the image file
+ *  @param format the format of the file: MEM_HEX and MEM_BIN for text
+ *         files like $readmemh and $readmemb, MEM_RAW for little-endian
+ *         binary words
+ *  @return the number of loaded words, or -1 in case of error */
+long long load_memory_image(SignalI signal, const char* filename,
+                            MemFormat format) {
+    Value value = signal->c_value;
+    unsigned long long width = signal->type->base;
+    unsigned long long number = signal->type->number;
+    unsigned long long i;
+    long long count;
+    /* Map the file.
+     * NOTE: stdio is used for opening since unistd.h conflicts with the
+     * simulator interface. */
+    FILE* file = fopen(filename,"rb");
+    if (!file) {
+        perror(filename);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fileno(file),&st) < 0) {
+        perror(filename);
+        fclose(file);
+        return -1;
+    }
+    size_t size = st.st_size;
+    void* content = NULL;
+    if (size > 0) {
+        content = mmap(NULL,size,PROT_READ,MAP_PRIVATE,fileno(file),0);
+        if (content == MAP_FAILED) {
+            perror(filename);
+            fclose(file);
+            return -1;
+        }
+    }
+    fclose(file);
+
+    /* Ensure the current value of the signal is a bitstring. */
+    if (value->numeric) {
+        unsigned long long data = value->data_int;
+        unsigned long long total = type_width(value->type);
+        resize_value(value,total+1);
+        for(i=0; i<total; ++i)
+            value->data_str[i] = ((i < 64) && ((data >> i) & 1)) ? '1' : '0';
+        value->data_str[total] = 0;
+        value->numeric = 0;
+    }
+
+    /* Decode the image in place. */
+    if (size == 0) {
+        count = 0;
+    } else if (format == MEM_RAW) {
+        count = decode_raw(content,size,width,number,value->data_str);
+    } else {
+        count = decode_text(content,size,format,width,number,
+                            value->data_str);
+    }
+    if (size > 0) munmap(content,size);
+
+    /* Update the future value too. */
+    if (count > 0) signal->f_value = copy_value(value,signal->f_value);
+    return count;
+}
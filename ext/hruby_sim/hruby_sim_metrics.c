@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <pthread.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation runtime metrics, to be used with C code
+ *  generated by the csim engine or by the rcsim engine.
+ *  The kernel keeps a few counters that are cheap to update, and the
+ *  metrics are built from them and from the state of the pools and of
+ *  the outputs when requested.
+ *  The metrics can be written as JSON lines to a file or to the clients
+ *  of a Unix socket by a separate thread, periodically and on SIGUSR1,
+ *  without pausing the simulation: the counters are read while they are
+ *  being updated, so that the metrics are approximate.
+ **/
+
+/* The maximum number of clients of the Unix socket. */
+#define METRICS_MAX_CLIENTS 16
+
+/* The counters of the simulation. */
+SimCountersS sim_counters = { 0, 0, 0 };
+
+/* The wall time of the start of the simulation. */
+static struct timespec metrics_start_time;
+static int metrics_started = 0;
+
+/* The destination of the metrics. */
+static char* metrics_destination = NULL;
+static double metrics_period = 0;
+
+/* The file or the listening socket of the destination. */
+static FILE* metrics_file = NULL;
+static int metrics_socket = -1;
+static int metrics_clients[METRICS_MAX_CLIENTS];
+static int num_metrics_clients = 0;
+
+/* The thread writing the metrics and its wake up semaphore. */
+static pthread_t metrics_thread;
+static sem_t metrics_sem;
+static int metrics_running = 0;
+static volatile int metrics_stopping = 0;
+
+/* The previous SIGUSR1 handler. */
+static struct sigaction metrics_old_action;
+
+/* The last metrics written, for computing the rates. */
+static MetricsS metrics_last;
+
+
+/** Gets the current and the peak resident memory of the process.
+ *  @param rss where to put the current size in bytes, 0 if unknown
+ *  @param peak where to put the peak size in bytes, 0 if unknown */
+static void metrics_rss(unsigned long long* rss, unsigned long long* peak) {
+    char line[256];
+    unsigned long long size;
+    *rss = *peak = 0;
+    FILE* file = fopen("/proc/self/status","r");
+    if (!file) return;
+    while(fgets(line,sizeof(line),file)) {
+        if (sscanf(line,"VmHWM: %llu kB",&size) == 1) *peak = size * 1024;
+        else if (sscanf(line,"VmRSS: %llu kB",&size) == 1) {
+            *rss = size * 1024;
+            break;
+        }
+    }
+    fclose(file);
+}
+
+/** Gets the current runtime metrics, without stopping the simulation.
+ *  @param metrics where to put the metrics */
+void metrics_get(MetricsS* metrics) {
+    struct timespec now;
+    if (!metrics_started) {
+        clock_gettime(CLOCK_MONOTONIC,&metrics_start_time);
+        metrics_started = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    metrics->wall = (now.tv_sec - metrics_start_time.tv_sec) +
+                    (now.tv_nsec - metrics_start_time.tv_nsec) / 1e9;
+    metrics->time = hruby_sim_get_time();
+    metrics->events = sim_counters.events;
+    metrics->deltas = sim_counters.deltas;
+    metrics->executions = sim_counters.executions;
+    metrics->value_pool = get_value_pos();
+    unsigned int peak;
+    get_value_pool_stats(&peak,&metrics->value_pool_capacity);
+    metrics->element_pool = get_element_pool_size();
+    metrics_rss(&metrics->rss,&metrics->rss_peak);
+    metrics->wave_bytes = output_written();
+}
+
+
+/** Sets where to write the runtime metrics periodically.
+ *  @param destination the name of the file, or "unix:" followed by the
+ *         path of a Unix socket to create for the clients to connect to
+ *  @param period the period of the writes in seconds, 0 for writing only
+ *         on SIGUSR1 */
+void metrics_output(const char* destination, double period) {
+    free(metrics_destination);
+    metrics_destination = strdup(destination);
+    metrics_period = period < 0 ? 0 : period;
+}
+
+
+/** Sends a line to the clients of the Unix socket, accepting the new
+ *  ones first.
+ *  @param line the line to send
+ *  @param len the length of the line */
+static void metrics_send(const char* line, size_t len) {
+    int fd, i;
+    while((fd = accept(metrics_socket,NULL,NULL)) >= 0) {
+        if (num_metrics_clients == METRICS_MAX_CLIENTS) close(fd);
+        else metrics_clients[num_metrics_clients++] = fd;
+    }
+    for(i=0; i<num_metrics_clients; ) {
+        if (send(metrics_clients[i],line,len,MSG_NOSIGNAL|MSG_DONTWAIT) < 0
+            && errno != EAGAIN) {
+            /* The client is gone. */
+            close(metrics_clients[i]);
+            metrics_clients[i] = metrics_clients[--num_metrics_clients];
+        } else {
+            ++i;
+        }
+    }
+}
+
+/** Writes the current metrics as a JSON line. */
+static void metrics_write() {
+    MetricsS m;
+    char line[1024];
+    metrics_get(&m);
+    double elapsed = m.wall - metrics_last.wall;
+    if (elapsed <= 0) elapsed = 1e-9;
+    int len = snprintf(line,sizeof(line),
+        "{\"wall\":%.3f,\"time\":%llu,\"time_per_s\":%.1f,"
+        "\"events\":%llu,\"events_per_s\":%.1f,"
+        "\"deltas\":%llu,\"deltas_per_s\":%.1f,"
+        "\"executions\":%llu,\"executions_per_s\":%.1f,"
+        "\"value_pool\":%u,\"value_pool_capacity\":%u,"
+        "\"element_pool\":%llu,\"rss\":%llu,\"rss_peak\":%llu,"
+        "\"wave_bytes\":%llu}\n",
+        m.wall, m.time, (m.time - metrics_last.time) / elapsed,
+        m.events, (m.events - metrics_last.events) / elapsed,
+        m.deltas, (m.deltas - metrics_last.deltas) / elapsed,
+        m.executions, (m.executions - metrics_last.executions) / elapsed,
+        m.value_pool, m.value_pool_capacity,
+        m.element_pool, m.rss, m.rss_peak, m.wave_bytes);
+    metrics_last = m;
+    if (metrics_file) {
+        fputs(line,metrics_file);
+        fflush(metrics_file);
+    } else {
+        metrics_send(line,len);
+    }
+}
+
+/** The SIGUSR1 handler: wakes up the thread writing the metrics.
+ *  @param sig the signal */
+static void metrics_signal(int sig) {
+    sem_post(&metrics_sem);
+}
+
+/** The thread writing the metrics periodically and when woken up.
+ *  @param arg unused */
+static void* metrics_run(void* arg) {
+    struct timespec next;
+    long long period = (long long)(metrics_period * 1e9);
+    clock_gettime(CLOCK_REALTIME,&next);
+    for(;;) {
+        int timeout = 0;
+        if (period > 0) {
+            /* Wait until the next period or a wake up. */
+            while(!timeout && sem_timedwait(&metrics_sem,&next) < 0) {
+                if (errno != EINTR) timeout = 1;
+            }
+        } else {
+            while(sem_wait(&metrics_sem) < 0 && errno == EINTR);
+        }
+        if (metrics_stopping) break;
+        metrics_write();
+        if (timeout) {
+            /* A wake up does not shift the periodic writes. */
+            next.tv_sec += period / 1000000000LL;
+            next.tv_nsec += period % 1000000000LL;
+            if (next.tv_nsec >= 1000000000L) {
+                ++next.tv_sec;
+                next.tv_nsec -= 1000000000L;
+            }
+        }
+    }
+    return NULL;
+}
+
+
+/** Opens the destination of the metrics.
+ *  @return 1 if success, 0 otherwise */
+static int metrics_open() {
+    const char* prefix = "unix:";
+    if (strncmp(metrics_destination,prefix,strlen(prefix)) != 0) {
+        metrics_file = fopen(metrics_destination,"w");
+        if (!metrics_file) perror(metrics_destination);
+        return metrics_file != NULL;
+    }
+    const char* path = metrics_destination + strlen(prefix);
+    struct sockaddr_un addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path,path,sizeof(addr.sun_path)-1);
+    metrics_socket = socket(AF_UNIX,SOCK_STREAM,0);
+    if (metrics_socket < 0) {
+        perror(path);
+        return 0;
+    }
+    remove(path);
+    if (bind(metrics_socket,(struct sockaddr*)&addr,sizeof(addr)) < 0 ||
+        listen(metrics_socket,METRICS_MAX_CLIENTS) < 0) {
+        perror(path);
+        close(metrics_socket);
+        metrics_socket = -1;
+        return 0;
+    }
+    /* The clients are accepted without blocking when writing. */
+    fcntl(metrics_socket,F_SETFL,fcntl(metrics_socket,F_GETFL) | O_NONBLOCK);
+    return 1;
+}
+
+/** Starts writing the runtime metrics if an output is set. */
+void metrics_start() {
+    clock_gettime(CLOCK_MONOTONIC,&metrics_start_time);
+    metrics_started = 1;
+    memset(&metrics_last,0,sizeof(metrics_last));
+    if (!metrics_destination || metrics_running) return;
+    if (!metrics_open()) return;
+    sem_init(&metrics_sem,0,0);
+    metrics_stopping = 0;
+    if (pthread_create(&metrics_thread,NULL,&metrics_run,NULL) != 0) return;
+    metrics_running = 1;
+    /* Write the metrics on SIGUSR1 too. */
+    struct sigaction action;
+    memset(&action,0,sizeof(action));
+    action.sa_handler = &metrics_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1,&action,&metrics_old_action);
+}
+
+/** Stops writing the runtime metrics, after writing the last ones. */
+void metrics_stop() {
+    int i;
+    if (!metrics_running) return;
+    metrics_running = 0;
+    sigaction(SIGUSR1,&metrics_old_action,NULL);
+    metrics_stopping = 1;
+    sem_post(&metrics_sem);
+    pthread_join(metrics_thread,NULL);
+    sem_destroy(&metrics_sem);
+    /* The final metrics. */
+    metrics_write();
+    if (metrics_file) {
+        fclose(metrics_file);
+        metrics_file = NULL;
+    } else {
+        for(i=0; i<num_metrics_clients; ++i) close(metrics_clients[i]);
+        num_metrics_clients = 0;
+        close(metrics_socket);
+        metrics_socket = -1;
+        remove(metrics_destination + strlen("unix:"));
+    }
+}
+
+/** Drops the runtime metrics in a forked process, where the thread
+ *  writing them does not exist: the destination is closed, but left to
+ *  the original process. */
+void metrics_drop() {
+    int i;
+    if (!metrics_running) return;
+    metrics_running = 0;
+    sigaction(SIGUSR1,&metrics_old_action,NULL);
+    if (metrics_file) {
+        fclose(metrics_file);
+        metrics_file = NULL;
+    } else {
+        for(i=0; i<num_metrics_clients; ++i) close(metrics_clients[i]);
+        num_metrics_clients = 0;
+        close(metrics_socket);
+        metrics_socket = -1;
+    }
+}
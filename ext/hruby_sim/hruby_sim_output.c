@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation buffered output, used by the visualization
+ *  engines for writing their files.
+ *  The data is written into large in-memory buffers that are handed in
+ *  turn to a writer thread, so that the simulation never waits for the
+ *  disk.
+ *  When compression is enabled, the full buffers are first compressed
+ *  by a pool of threads, each buffer becoming an independent gzip member
+ *  of the file (a sequence of gzip members is a valid gzip file), then
+ *  written in order.
+ *  The open outputs are registered so that they can be brought to a
+ *  consistent state before the simulator forks for a checkpoint.
+ **/
+
+#define OUTPUT_BUFFER_SIZE (1024*1024)
+#define OUTPUT_NUM_BUFFERS 3
+
+/** The states of a buffer. */
+typedef enum { BUF_FREE, BUF_FULL, BUF_COMPRESSING, BUF_READY } BufState;
+
+/** The structure of a buffered output. */
+struct OutputS_ {
+    FILE* file;                 /* The target file. */
+    char* filename;             /* The name of the target file. */
+    long long fork_pos;         /* The size of the file at the last fork. */
+    int num_buffers;            /* The number of buffers. */
+    char** buffers;             /* The buffers, used in turn. */
+    size_t* sizes;              /* The filled sizes. */
+    BufState* states;           /* The states of the buffers. */
+    char** zbuffers;            /* The compressed buffers if any. */
+    size_t* zcapacities;        /* The capacities of the compressed buffers. */
+    size_t* zsizes;             /* The sizes of the compressed buffers. */
+    int fill;                   /* The buffer being filled. */
+    int next_compress;          /* The next buffer to compress. */
+    int next_write;             /* The next buffer to write. */
+    int num_pending;            /* The number of buffers not written yet. */
+    int level;                  /* The compression level, 0 for none. */
+    int num_workers;            /* The number of compression threads. */
+    pthread_t* workers;         /* The compression threads. */
+    int stop;                   /* Tells if the threads are to stop. */
+    int running;                /* Tells if the writer runs. */
+    pthread_t writer;           /* The writer thread. */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+/* The compression configuration of the next outputs. */
+static int output_level = 0;
+static int output_threads = 2;
+
+/* The number of bytes written by all the outputs. */
+static unsigned long long output_bytes = 0;
+
+/* The open outputs. */
+static Output* outputs = NULL;
+static int num_outputs = 0;
+
+/** Sets the compression of the outputs opened afterward.
+ *  @param level the gzip compression level (1 to 9), 0 for none
+ *  @param threads the number of compression threads */
+void output_compression(int level, int threads) {
+#ifdef HAVE_ZLIB
+    output_level = level < 0 ? 0 : level > 9 ? 9 : level;
+    output_threads = threads < 1 ? 1 : threads;
+#else
+    if (level > 0)
+        fprintf(stderr,"Compression not supported, output is not compressed.\n");
+#endif
+}
+
+
+#ifdef HAVE_ZLIB
+/** Compresses a buffer into a gzip member.
+ *  @param out the output
+ *  @param idx the index of the buffer */
+static void output_compress(Output out, int idx) {
+    out->zsizes[idx] = gzip_compress(out->level,
+                                     out->buffers[idx],out->sizes[idx],
+                                     &out->zbuffers[idx],
+                                     &out->zcapacities[idx]);
+}
+
+/** A compression thread: compresses the full buffers in order.
+ *  @param arg the output to compress */
+static void* output_compressor(void* arg) {
+    Output out = (Output)arg;
+    pthread_mutex_lock(&out->mutex);
+    for(;;) {
+        while(out->states[out->next_compress] != BUF_FULL && !out->stop)
+            pthread_cond_wait(&out->cond,&out->mutex);
+        if (out->states[out->next_compress] != BUF_FULL) break;
+        /* Take the buffer. */
+        int idx = out->next_compress;
+        out->states[idx] = BUF_COMPRESSING;
+        out->next_compress = (idx+1) % out->num_buffers;
+        pthread_mutex_unlock(&out->mutex);
+        output_compress(out,idx);
+        pthread_mutex_lock(&out->mutex);
+        out->states[idx] = BUF_READY;
+        pthread_cond_broadcast(&out->cond);
+    }
+    pthread_mutex_unlock(&out->mutex);
+    return NULL;
+}
+#endif
+
+/** Writes a buffer to the file.
+ *  @param out the output
+ *  @param idx the index of the buffer */
+static void output_flush_buffer(Output out, int idx) {
+    size_t size;
+    if (out->level > 0)
+        size = fwrite(out->zbuffers[idx],1,out->zsizes[idx],out->file);
+    else
+        size = fwrite(out->buffers[idx],1,out->sizes[idx],out->file);
+    __atomic_fetch_add(&output_bytes,size,__ATOMIC_RELAXED);
+    out->sizes[idx] = 0;
+}
+
+/** Gets the number of bytes written by all the outputs. */
+unsigned long long output_written() {
+    return __atomic_load_n(&output_bytes,__ATOMIC_RELAXED);
+}
+
+/** The writer thread: writes the buffers to the file in order.
+ *  @param arg the output to write */
+static void* output_writer(void* arg) {
+    Output out = (Output)arg;
+    /* Without compression, the full buffers are ready to write. */
+    BufState ready = out->level > 0 ? BUF_READY : BUF_FULL;
+    pthread_mutex_lock(&out->mutex);
+    for(;;) {
+        while(out->states[out->next_write] != ready &&
+              !(out->stop && out->num_pending == 0))
+            pthread_cond_wait(&out->cond,&out->mutex);
+        if (out->states[out->next_write] != ready) break;
+        int idx = out->next_write;
+        pthread_mutex_unlock(&out->mutex);
+        /* Write outside the lock so that filling can go on. */
+        output_flush_buffer(out,idx);
+        pthread_mutex_lock(&out->mutex);
+        out->states[idx] = BUF_FREE;
+        out->next_write = (idx+1) % out->num_buffers;
+        --out->num_pending;
+        pthread_cond_broadcast(&out->cond);
+    }
+    pthread_mutex_unlock(&out->mutex);
+    return NULL;
+}
+
+
+/** Starts the threads of an output.
+ *  @param out the output */
+static void output_start(Output out) {
+    pthread_mutex_init(&out->mutex,NULL);
+    pthread_cond_init(&out->cond,NULL);
+    out->stop = 0;
+    /* Without writer thread, the buffers are written directly. */
+    out->running = pthread_create(&out->writer,NULL,&output_writer,out) == 0;
+#ifdef HAVE_ZLIB
+    if (out->running) {
+        free(out->workers);
+        out->workers = malloc(out->num_workers*sizeof(pthread_t));
+        for(int i=0; i<out->num_workers; ++i)
+            pthread_create(&out->workers[i],NULL,&output_compressor,out);
+    }
+#endif
+}
+
+/** Opens a buffered output to a file.
+ *  @param filename the name of the file, extended with ".gz" when
+ *         compressed
+ *  @return the output, or NULL in case of error */
+Output open_output(const char* filename) {
+    char gzname[strlen(filename)+4];
+    if (output_level > 0) {
+        strcpy(gzname,filename);
+        strcat(gzname,".gz");
+        filename = gzname;
+    }
+    FILE* file = fopen(filename,"wb");
+    if (!file) {
+        perror(filename);
+        return NULL;
+    }
+    Output out = calloc(1,sizeof(struct OutputS_));
+    out->file = file;
+    out->level = output_level;
+    /* With compression, enough buffers to keep all the threads busy. */
+    out->num_workers = out->level > 0 ? output_threads : 0;
+    out->num_buffers = OUTPUT_NUM_BUFFERS + out->num_workers;
+    out->buffers = malloc(out->num_buffers*sizeof(char*));
+    for(int i=0; i<out->num_buffers; ++i)
+        out->buffers[i] = malloc(OUTPUT_BUFFER_SIZE);
+    out->sizes = calloc(out->num_buffers,sizeof(size_t));
+    out->states = calloc(out->num_buffers,sizeof(BufState));
+    out->zbuffers = calloc(out->num_buffers,sizeof(char*));
+    out->zcapacities = calloc(out->num_buffers,sizeof(size_t));
+    out->zsizes = calloc(out->num_buffers,sizeof(size_t));
+    out->filename = strdup(filename);
+    output_start(out);
+    outputs = realloc(outputs,(num_outputs+1)*sizeof(Output));
+    outputs[num_outputs++] = out;
+    return out;
+}
+
+
+/** Hands the buffer being filled to the threads and goes to the next one.
+ *  @param out the output */
+static void output_handoff(Output out) {
+    if (!out->running) {
+        /* No writer thread, write directly. */
+#ifdef HAVE_ZLIB
+        if (out->level > 0) output_compress(out,out->fill);
+#endif
+        output_flush_buffer(out,out->fill);
+        return;
+    }
+    pthread_mutex_lock(&out->mutex);
+    out->states[out->fill] = BUF_FULL;
+    ++out->num_pending;
+    pthread_cond_broadcast(&out->cond);
+    /* Wait for a free buffer, only if the disk is really behind. */
+    while(out->num_pending == out->num_buffers)
+        pthread_cond_wait(&out->cond,&out->mutex);
+    pthread_mutex_unlock(&out->mutex);
+    out->fill = (out->fill+1) % out->num_buffers;
+}
+
+
+/** Reserves room in an output.
+ *  @param out the output
+ *  @param len the size to reserve, at most OUTPUT_RESERVE_MAX
+ *  @return the place where to write */
+char* output_reserve(Output out, size_t len) {
+    if (out->sizes[out->fill] + len > OUTPUT_BUFFER_SIZE) output_handoff(out);
+    return out->buffers[out->fill] + out->sizes[out->fill];
+}
+
+/** Commits data written in reserved room of an output.
+ *  @param out the output
+ *  @param len the size of the written data */
+void output_commit(Output out, size_t len) {
+    out->sizes[out->fill] += len;
+}
+
+/** Writes data to an output.
+ *  @param out the output
+ *  @param data the data to write
+ *  @param len the size of the data */
+void output_write(Output out, const char* data, size_t len) {
+    while(len > 0) {
+        size_t chunk = len < OUTPUT_RESERVE_MAX ? len : OUTPUT_RESERVE_MAX;
+        memcpy(output_reserve(out,chunk),data,chunk);
+        output_commit(out,chunk);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+
+/** Closes an output: writes the remaining data and waits for the threads
+ *  to finish.
+ *  @param out the output */
+void close_output(Output out) {
+    int i;
+    if (out->running) {
+        pthread_mutex_lock(&out->mutex);
+        if (out->sizes[out->fill] > 0) {
+            out->states[out->fill] = BUF_FULL;
+            ++out->num_pending;
+        }
+        out->stop = 1;
+        pthread_cond_broadcast(&out->cond);
+        pthread_mutex_unlock(&out->mutex);
+        for(i=0; i<out->num_workers; ++i) pthread_join(out->workers[i],NULL);
+        pthread_join(out->writer,NULL);
+        out->running = 0;
+    } else if (out->sizes[out->fill] > 0) {
+        output_handoff(out);
+    }
+    fclose(out->file);
+    for(i=0; i<num_outputs; ++i) {
+        if (outputs[i] == out) {
+            outputs[i] = outputs[--num_outputs];
+            break;
+        }
+    }
+    free(out->filename);
+    for(i=0; i<out->num_buffers; ++i) {
+        free(out->buffers[i]);
+        free(out->zbuffers[i]);
+    }
+    free(out->buffers);
+    free(out->sizes);
+    free(out->states);
+    free(out->zbuffers);
+    free(out->zcapacities);
+    free(out->zsizes);
+    free(out->workers);
+    free(out);
+}
+
+
+/** Prepares the outputs for a fork of the process: waits until the full
+ *  buffers are written and keeps the outputs locked so that their
+ *  threads stay idle during the fork.
+ *  NOTE: the buffers being filled are kept in memory. */
+void outputs_prefork() {
+    int i;
+    for(i=0; i<num_outputs; ++i) {
+        Output out = outputs[i];
+        if (out->running) {
+            pthread_mutex_lock(&out->mutex);
+            while(out->num_pending > 0)
+                pthread_cond_wait(&out->cond,&out->mutex);
+        }
+        fflush(out->file);
+        out->fork_pos = ftello(out->file);
+    }
+}
+
+/** Resumes the outputs after a fork of the process.
+ *  @param child tells if in the child process, where the threads of the
+ *         outputs do not exist and the buffers are then written directly */
+void outputs_postfork(int child) {
+    int i;
+    for(i=0; i<num_outputs; ++i) {
+        Output out = outputs[i];
+        if (!out->running) continue;
+        if (child) {
+            pthread_mutex_init(&out->mutex,NULL);
+            pthread_cond_init(&out->cond,NULL);
+            out->running = 0;
+        } else {
+            pthread_mutex_unlock(&out->mutex);
+        }
+    }
+}
+
+/** Redirects the outputs of a forked process to files with the same
+ *  names in another directory, starting with the content the original
+ *  files had at the fork.
+ *  @param dir the directory of the new files
+ *  @return 1 if success, 0 otherwise */
+int outputs_redirect(const char* dir) {
+    int i;
+    char chunk[65536];
+    for(i=0; i<num_outputs; ++i) {
+        Output out = outputs[i];
+        const char* base = strrchr(out->filename,'/');
+        base = base ? base+1 : out->filename;
+        char filename[strlen(dir)+strlen(base)+2];
+        sprintf(filename,"%s/%s",dir,base);
+        FILE* src = fopen(out->filename,"rb");
+        FILE* file = fopen(filename,"wb");
+        if (!src || !file) {
+            perror(!src ? out->filename : filename);
+            if (src) fclose(src);
+            if (file) fclose(file);
+            return 0;
+        }
+        /* Copy what was written before the fork. */
+        long long left = out->fork_pos;
+        while(left > 0) {
+            size_t n = left < (long long)sizeof(chunk) ?
+                (size_t)left : sizeof(chunk);
+            size_t size = fread(chunk,1,n,src);
+            if (size == 0) break;
+            fwrite(chunk,1,size,file);
+            left -= size;
+        }
+        fclose(src);
+        fclose(out->file);
+        out->file = file;
+        free(out->filename);
+        out->filename = strdup(filename);
+        output_start(out);
+    }
+    return 1;
+}
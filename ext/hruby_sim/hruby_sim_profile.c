@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation profiler, to be used with C code generated by
+ *  the csim engine or by the rcsim engine.
+ *  The profiler measures the wall time of the executions of the
+ *  behaviors and codes activated by the signals (all of them or one out
+ *  of a sampling period, the total time being then estimated from the
+ *  number of executions), counts the delta cycles of each time step and
+ *  the activations caused by the changes of each signal.
+ *  The timed behaviors run for the whole simulation and are only counted.
+ *  At the end of the simulation a sorted report is printed on the error
+ *  output and the estimated times are written as folded stacks that can
+ *  be given to flame graph tools.
+ **/
+
+/* The number of behaviors and signals shown in the report. */
+#define PROFILE_TOP_BEHAVIORS 20
+#define PROFILE_TOP_SIGNALS 10
+
+/** The profile of a signal. */
+typedef struct ProfileSignalS_ {
+    char* name;                     /* The full name of the signal. */
+    unsigned long long changes;     /* The number of value changes. */
+    unsigned long long activations; /* The activations caused. */
+    int fanout;                     /* The number of objects activated. */
+} ProfileSignalS;
+
+/** The profile of a behavior or code. */
+typedef struct ProfileCodeS_ {
+    char* name;                     /* The full name of the code. */
+    unsigned long long calls;       /* The number of executions. */
+    unsigned long long time;        /* The estimated execution time (ns). */
+    int timed;                      /* Tells if the code is timed. */
+} ProfileCodeS;
+
+/* Tells if the simulation is profiled. */
+int profile_active = 0;
+
+/* The file of the folded stacks. */
+static char* profile_filename = NULL;
+
+/* The sampling period and the executions since the last sample. */
+static int profile_sampling = 1;
+static int profile_count = 0;
+
+/* The profiled top system. */
+static SystemT profile_top = NULL;
+
+/* The profiles of the signals indexed by signal id. */
+static ProfileSignalS* profile_signals = NULL;
+static size_t num_profile_signals = 0;
+
+/* The statistics of the delta cycles. */
+static unsigned long long profile_deltas = 0;
+static unsigned long long profile_step_deltas = 0;
+static unsigned long long profile_steps = 0;
+static unsigned long long profile_max_deltas = 0;
+static unsigned long long profile_max_time = 0;
+
+/* The profiles of the behaviors and codes being collected. */
+static ProfileCodeS* profile_codes = NULL;
+static int num_profile_codes = 0;
+static int cap_profile_codes = 0;
+
+
+/** Enables the profiling of the simulation.
+ *  @param filename the name of the file where to write the profile as
+ *         folded stacks for flame graphs, NULL for none
+ *  @param sampling the execution time of the behaviors is measured one
+ *         time out of sampling */
+void profile_enable(const char* filename, int sampling) {
+    free(profile_filename);
+    profile_filename = filename ? strdup(filename) : NULL;
+    profile_sampling = sampling < 1 ? 1 : sampling;
+    profile_active = 1;
+}
+
+
+/** Adds a signal of the hierarchy to the profile.
+ *  @param signal the signal to add
+ *  @param path the full name of the signal
+ *  @param kind the kind of port of the signal */
+static void profile_add_signal(SignalI signal, const char* path, int kind) {
+    if (signal->id >= num_profile_signals) {
+        size_t num = (signal->id+1)*2;
+        profile_signals = realloc(profile_signals,num*sizeof(ProfileSignalS));
+        memset(profile_signals+num_profile_signals,0,
+               (num-num_profile_signals)*sizeof(ProfileSignalS));
+        num_profile_signals = num;
+    }
+    if (!profile_signals[signal->id].name)
+        profile_signals[signal->id].name = strdup(path);
+}
+
+/** Sets up the profiling of a top system.
+ *  @param top the top system */
+void profile_start(SystemT top) {
+    if (!profile_active) return;
+    profile_top = top;
+    each_signal_path(top,&profile_add_signal);
+}
+
+
+/** Gets the current wall time.
+ *  @return the time in ns */
+static unsigned long long profile_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+/** Starts measuring the execution of a behavior or code.
+ *  @return the start time, 0 if the execution is not sampled */
+unsigned long long profile_begin() {
+    if (++profile_count < profile_sampling) return 0;
+    profile_count = 0;
+    return profile_now();
+}
+
+/** Ends measuring the execution of a behavior or code.
+ *  @param code the executed behavior or code
+ *  @param start the start time given by profile_begin */
+void profile_end(Object code, unsigned long long start) {
+    unsigned long long elapsed = profile_now() - start;
+    if (code->kind == BEHAVIOR) {
+        ((Behavior)code)->profile_time += elapsed;
+        ++((Behavior)code)->profile_samples;
+    } else {
+        ((Code)code)->profile_time += elapsed;
+        ++((Code)code)->profile_samples;
+    }
+}
+
+
+/** Counts a delta cycle of the current time step. */
+void profile_delta() {
+    ++profile_step_deltas;
+}
+
+/** Counts the activations caused by a change of a signal.
+ *  @param signal the changed signal */
+void profile_signal(SignalI signal) {
+    if (signal->id >= num_profile_signals) return;
+    ProfileSignalS* prof = &profile_signals[signal->id];
+    int fanout = signal->num_any +
+        (zero_value(signal->c_value) ? signal->num_neg : signal->num_pos);
+    ++prof->changes;
+    prof->activations += fanout;
+    if (fanout > prof->fanout) prof->fanout = fanout;
+}
+
+/** Ends a time step.
+ *  @param time the time of the step (in ps) */
+void profile_step(unsigned long long time) {
+    if (!profile_active) return;
+    ++profile_steps;
+    profile_deltas += profile_step_deltas;
+    if (profile_step_deltas > profile_max_deltas) {
+        profile_max_deltas = profile_step_deltas;
+        profile_max_time = time;
+    }
+    profile_step_deltas = 0;
+}
+
+
+/** Adds the profile of a behavior or code.
+ *  @param code the behavior or code to add
+ *  @param path the full name of the behavior or code */
+static void profile_add_code(Object code, const char* path) {
+    unsigned long long calls, time, samples;
+    int timed = 0;
+    if (code->kind == BEHAVIOR) {
+        Behavior beh = (Behavior)code;
+        calls = beh->activations;
+        time = beh->profile_time;
+        samples = beh->profile_samples;
+        timed = beh->timed != 0;
+    } else {
+        Code cod = (Code)code;
+        calls = cod->activations;
+        time = cod->profile_time;
+        samples = cod->profile_samples;
+    }
+    if (num_profile_codes == cap_profile_codes) {
+        cap_profile_codes = cap_profile_codes ? cap_profile_codes*2 : 64;
+        profile_codes = realloc(profile_codes,
+                                cap_profile_codes*sizeof(ProfileCodeS));
+    }
+    ProfileCodeS* prof = &profile_codes[num_profile_codes++];
+    prof->name = strdup(path[0] ? path : "top");
+    prof->calls = calls;
+    /* Estimate the total time from the sampled executions. */
+    prof->time = samples ? (unsigned long long)
+        ((double)time * (double)calls / (double)samples) : 0;
+    prof->timed = timed;
+}
+
+/** Compares two behavior profiles by decreasing time then calls. */
+static int profile_code_cmp(const void* a, const void* b) {
+    const ProfileCodeS* pa = a;
+    const ProfileCodeS* pb = b;
+    if (pa->time != pb->time) return pa->time < pb->time ? 1 : -1;
+    if (pa->calls != pb->calls) return pa->calls < pb->calls ? 1 : -1;
+    return strcmp(pa->name,pb->name);
+}
+
+/** Compares two signal profiles by decreasing activations. */
+static int profile_signal_cmp(const void* a, const void* b) {
+    const ProfileSignalS* pa = *(const ProfileSignalS**)a;
+    const ProfileSignalS* pb = *(const ProfileSignalS**)b;
+    if (pa->activations != pb->activations)
+        return pa->activations < pb->activations ? 1 : -1;
+    return strcmp(pa->name,pb->name);
+}
+
+/** Writes the estimated times as folded stacks.
+ *  @param filename the name of the file to write */
+static void profile_write_folded(const char* filename) {
+    int i;
+    FILE* file = fopen(filename,"w");
+    if (!file) {
+        perror(filename);
+        return;
+    }
+    for(i=0; i<num_profile_codes; ++i) {
+        ProfileCodeS* prof = &profile_codes[i];
+        if (prof->time == 0) continue;
+        /* The levels of the hierarchy are separated by ';'. */
+        fputs("top;",file);
+        for(const char* c = prof->name; *c; ++c)
+            fputc(*c == '.' ? ';' : *c == ' ' ? '_' : *c, file);
+        fprintf(file," %llu\n",prof->time);
+    }
+    fclose(file);
+}
+
+/** Writes the profile report and the folded stacks.
+ *  @param time the end time of the simulation (in ps) */
+void profile_report(unsigned long long time) {
+    int i;
+    size_t j;
+    if (!profile_active) return;
+    profile_active = 0;
+    /* Collect and sort the behaviors and codes. */
+    each_code_path(profile_top,&profile_add_code);
+    qsort(profile_codes,num_profile_codes,sizeof(ProfileCodeS),
+          &profile_code_cmp);
+    unsigned long long total = 0;
+    for(i=0; i<num_profile_codes; ++i) total += profile_codes[i].time;
+    fprintf(stderr,"\nSimulation profile at %llups", time);
+    if (profile_sampling > 1)
+        fprintf(stderr," (times estimated from 1 execution out of %d)",
+                profile_sampling);
+    fprintf(stderr,":\n   %12s %7s %12s %10s  %s\n",
+            "time (ms)","%","calls","avg (us)","behavior");
+    for(i=0; i<num_profile_codes && i<PROFILE_TOP_BEHAVIORS; ++i) {
+        ProfileCodeS* prof = &profile_codes[i];
+        if (prof->timed) {
+            fprintf(stderr,"   %12s %7s %12llu %10s  %s (timed)\n",
+                    "-","-",prof->calls,"-",prof->name);
+            continue;
+        }
+        fprintf(stderr,"   %12.3f %7.2f %12llu %10.3f  %s\n",
+                prof->time / 1e6,
+                total ? prof->time * 100.0 / total : 0.0,
+                prof->calls,
+                prof->calls ? prof->time / 1e3 / prof->calls : 0.0,
+                prof->name);
+    }
+    if (num_profile_codes > PROFILE_TOP_BEHAVIORS)
+        fprintf(stderr,"   ... %d more\n",
+                num_profile_codes - PROFILE_TOP_BEHAVIORS);
+    /* The delta cycles. */
+    profile_step(time);
+    fprintf(stderr,"Time steps: %llu, delta cycles: %llu "
+            "(%.2f per step, at most %llu at %llups)\n",
+            profile_steps,profile_deltas,
+            profile_steps ? (double)profile_deltas / profile_steps : 0.0,
+            profile_max_deltas,profile_max_time);
+    /* The signals causing the most activations. */
+    ProfileSignalS** sigs = malloc(num_profile_signals*sizeof(ProfileSignalS*));
+    size_t num_sigs = 0;
+    for(j=0; j<num_profile_signals; ++j) {
+        if (profile_signals[j].name && profile_signals[j].activations > 0)
+            sigs[num_sigs++] = &profile_signals[j];
+    }
+    qsort(sigs,num_sigs,sizeof(ProfileSignalS*),&profile_signal_cmp);
+    fprintf(stderr,"Signals causing the most activations:\n"
+            "   %12s %12s %7s  %s\n","activations","changes","fan-out",
+            "signal");
+    for(j=0; j<num_sigs && j<PROFILE_TOP_SIGNALS; ++j)
+        fprintf(stderr,"   %12llu %12llu %7d  %s\n",sigs[j]->activations,
+                sigs[j]->changes,sigs[j]->fanout,sigs[j]->name);
+    free(sigs);
+    /* The value pool. */
+    unsigned int peak, capacity;
+    get_value_pool_stats(&peak,&capacity);
+    fprintf(stderr,"Value pool: at most %u values in use (capacity %u)\n",
+            peak,capacity);
+    if (profile_filename)
+        profile_write_folded(checkpoint_path(profile_filename));
+}
@@ -0,0 +1,996 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation stimulus replay, to be used with C code
+ *  generated by the csim engine or by the rcsim engine.
+ *  The value changes of a recorded VCD file are transmitted directly to
+ *  the signals of the design by the simulation kernel, like the edges of
+ *  the clock generators, without going through any timed behavior.
+ *  The file is read in chunks while the simulation advances, so that
+ *  replays of any length are supported.
+ *  The signals of the file are bound to the signals of the design with
+ *  the same full name, the top scope of the file excluded.
+ *
+ *  A file can also be used as a golden trace: its value changes are then
+ *  not transmitted but compared with the values of the bound signals at
+ *  the end of each time step, the simulation stopping with a report on
+ *  the first mismatch.
+ *
+ *  The files can also be binary waveform (HBW) files, recognized by their
+ *  magic number: they are then read one block at a time, only the
+ *  changes of the bound signals being decoded.
+ **/
+
+/* The size of the chunks read from the files. */
+#define REPLAY_CHUNK_SIZE (1024*1024)
+
+/* The size of the tables of the ids of a file. */
+#define REPLAY_TABLE_SIZE 4096
+
+/* The number of values kept in the history of a golden trace. */
+#define GOLDEN_HISTORY 4
+
+/** A binding of a VCD identifier to signals of the design. */
+typedef struct ReplayIdS_ {
+    char* id;               /* The VCD identifier. */
+    int num_signals;        /* The number of bound signals. */
+    SignalI* signals;       /* The bound signals. */
+    struct ReplayIdS_* next; /* The next binding with the same hash. */
+    /* For golden traces only. */
+    char* name;             /* The full name of the first bound signal. */
+    char* expected;         /* The expected value, msb first, NULL if none. */
+    size_t capacity;        /* The capacity of the expected value. */
+    int pending;            /* Tells if the binding is to check. */
+    int num_history;        /* The number of values in the history. */
+    unsigned long long history_times[GOLDEN_HISTORY]; /* Their times. */
+    char* history[GOLDEN_HISTORY]; /* The last checked values. */
+} ReplayIdS;
+
+/** A value change decoded from a block of a HBW file. */
+typedef struct HbwChangeS_ {
+    unsigned long long time; /* The time of the change. */
+    size_t order;           /* The order of the change in the block. */
+    ReplayIdS* bind;        /* The binding of the changed signal. */
+    size_t bits;            /* The position of the value in the bits. */
+    size_t len;             /* The number of bits of the value. */
+} HbwChangeS;
+
+/** A variable declared in a VCD file. */
+typedef struct ReplayVarS_ {
+    char* name;             /* The full name of the variable. */
+    char* id;               /* The VCD identifier of the variable. */
+} ReplayVarS;
+
+/** A replayed file. */
+typedef struct ReplayS_ {
+    char* filename;         /* The name of the file. */
+    int golden;             /* Tells if the file is a golden trace. */
+    FILE* file;             /* The file being read, NULL once finished. */
+    char* buffer;           /* The chunk being read. */
+    size_t capacity;        /* The capacity of the buffer. */
+    size_t size;            /* The size of the data in the buffer. */
+    size_t pos;             /* The current position in the buffer. */
+    int eof;                /* Tells if the end of the file is reached. */
+    char* value;            /* The value being replayed. */
+    size_t value_capacity;  /* The capacity of the value. */
+    unsigned long long mul; /* The multiplier of the times to ps. */
+    unsigned long long div; /* The divisor of the times to ps. */
+    unsigned long long next_time; /* The time of the next changes. */
+    ReplayIdS* table[REPLAY_TABLE_SIZE]; /* The bindings of the ids. */
+    int num_vars;           /* The number of declared variables. */
+    ReplayVarS* vars;       /* The declared variables sorted by name. */
+    /* For HBW files only. */
+    int hbw;                /* Tells if the file is a HBW file. */
+    size_t num_ids;         /* The number of signal ids. */
+    unsigned long long* widths; /* The widths of the signals by id. */
+    ReplayIdS** binds;      /* The bindings of the signals by id. */
+    unsigned long long block_start; /* The start time of the block. */
+    char* payload;          /* The payload of the block. */
+    size_t payload_capacity; /* The capacity of the payload. */
+    char* zpayload;         /* The compressed payload of the block. */
+    size_t zpayload_capacity; /* The capacity of the compressed payload. */
+    HbwChangeS* changes;    /* The decoded changes of the block. */
+    size_t num_changes;     /* The number of decoded changes. */
+    size_t cap_changes;     /* The capacity of the changes. */
+    size_t next_change;     /* The next change to replay. */
+    char* bits;             /* The values of the changes, msb first. */
+    size_t bits_size;       /* The size of the values. */
+    size_t bits_capacity;   /* The capacity of the values. */
+} ReplayS;
+
+typedef ReplayS* Replay;
+
+/* The replayed files. */
+static Replay* replays = NULL;
+static int num_replays = 0;
+
+/* The patterns of the signals to replay. */
+static char** replay_includes = NULL;
+static int num_replay_includes = 0;
+
+/* The patterns of the signals to check against golden traces. */
+static char** golden_includes = NULL;
+static int num_golden_includes = 0;
+
+/* The bindings of the golden traces to check at the end of the step. */
+static ReplayIdS** golden_pending = NULL;
+static int num_golden_pending = 0;
+static int cap_golden_pending = 0;
+
+/* The bindings of the golden traces indexed by signal id. */
+static ReplayIdS** golden_binds = NULL;
+static size_t num_golden_binds = 0;
+
+/* The statistics of the golden traces. */
+static unsigned long long golden_checks = 0;
+static int golden_signals = 0;
+
+/* The file being bound. */
+static Replay replay_binding = NULL;
+
+
+/** Adds a VCD or HBW file to read.
+ *  @param filename the name of the VCD or HBW file
+ *  @param golden tells if the file is a golden trace */
+static void add_replay(const char* filename, int golden) {
+    Replay replay = calloc(1,sizeof(ReplayS));
+    replay->filename = strdup(filename);
+    replay->golden = golden;
+    replay->next_time = ULLONG_MAX;
+    replays = realloc(replays,(num_replays+1)*sizeof(Replay));
+    replays[num_replays++] = replay;
+}
+
+/** Adds a VCD or HBW file whose value changes are to be replayed.
+ *  @param filename the name of the VCD or HBW file */
+void replay_file(const char* filename) {
+    add_replay(filename,0);
+}
+
+/** Adds a VCD or HBW file to use as golden trace.
+ *  @param filename the name of the VCD or HBW file */
+void golden_file(const char* filename) {
+    add_replay(filename,1);
+}
+
+/** Adds a pattern of the signals to replay, by default all the input
+ *  ports found in the replayed files are replayed.
+ *  @param pattern the glob pattern matching the full name of a signal
+ *         or of one of its enclosing scopes */
+void replay_include(const char* pattern) {
+    replay_includes = realloc(replay_includes,
+                              (num_replay_includes+1)*sizeof(char*));
+    replay_includes[num_replay_includes++] = strdup(pattern);
+}
+
+/** Adds a pattern of the signals to check against the golden traces, by
+ *  default all the signals found in the golden traces are checked.
+ *  @param pattern the glob pattern matching the full name of a signal
+ *         or of one of its enclosing scopes */
+void golden_include(const char* pattern) {
+    golden_includes = realloc(golden_includes,
+                              (num_golden_includes+1)*sizeof(char*));
+    golden_includes[num_golden_includes++] = strdup(pattern);
+}
+
+
+/* Reading the files. */
+
+/** Gets the next token of a replayed file.
+ *  @param replay the replayed file
+ *  @return the token, NULL at the end of the file
+ *  NOTE: the token is valid until the next token is read. */
+static char* replay_token(Replay replay) {
+    for(;;) {
+        char* buffer = replay->buffer;
+        /* Skip the spaces. */
+        while(replay->pos < replay->size && isspace(buffer[replay->pos]))
+            ++replay->pos;
+        /* Look for the end of the token. */
+        size_t end = replay->pos;
+        while(end < replay->size && !isspace(buffer[end])) ++end;
+        if (end < replay->size || (replay->eof && end > replay->pos)) {
+            /* Complete token (there is always room for the 0). */
+            char* token = buffer + replay->pos;
+            buffer[end] = 0;
+            replay->pos = end < replay->size ? end+1 : end;
+            return token;
+        }
+        if (replay->eof) return NULL;
+        /* Incomplete token, read the next chunk after it. */
+        replay->size -= replay->pos;
+        memmove(buffer,buffer+replay->pos,replay->size);
+        replay->pos = 0;
+        if (replay->size+1 >= replay->capacity) {
+            replay->capacity *= 2;
+            replay->buffer = realloc(replay->buffer,replay->capacity);
+        }
+        size_t num = fread(replay->buffer+replay->size,1,
+                           replay->capacity-replay->size-1,replay->file);
+        if (num == 0) replay->eof = 1;
+        replay->size += num;
+    }
+}
+
+/** Skips the tokens of a replayed file until "$end".
+ *  @param replay the replayed file */
+static void replay_skip(Replay replay) {
+    char* token;
+    while((token = replay_token(replay)) && strcmp(token,"$end") != 0);
+}
+
+
+/* Binding the signals. */
+
+/** Hashes a VCD identifier.
+ *  @param id the identifier to hash */
+static unsigned int replay_hash(const char* id) {
+    unsigned int hash = 0;
+    for(; *id; ++id) hash = hash*31 + (unsigned char)*id;
+    return hash % REPLAY_TABLE_SIZE;
+}
+
+/** Gets the binding of a VCD identifier.
+ *  @param replay the replayed file
+ *  @param id the identifier
+ *  @return the binding, NULL if the identifier is not bound */
+static ReplayIdS* replay_lookup(Replay replay, const char* id) {
+    ReplayIdS* bind = replay->table[replay_hash(id)];
+    while(bind && strcmp(bind->id,id) != 0) bind = bind->next;
+    return bind;
+}
+
+/** Compares two variables by name, for sorting and searching. */
+static int replay_var_cmp(const void* a, const void* b) {
+    return strcmp(((ReplayVarS*)a)->name,((ReplayVarS*)b)->name);
+}
+
+/** Binds a signal of the design to the variable of the same name in the
+ *  file being bound, if any.
+ *  @param signal the signal to bind
+ *  @param path the full name of the signal
+ *  @param kind the kind of port of the signal */
+static void replay_bind_signal(SignalI signal, const char* path, int kind) {
+    Replay replay = replay_binding;
+    /* Only the flat signals are bound. */
+    if (signal->num_signals > 0 || !signal->c_value) return;
+    if (replay->golden) {
+        /* By default all the signals are checked. */
+        if (num_golden_includes > 0 &&
+            !walk_matches(golden_includes,num_golden_includes))
+            return;
+    } else {
+        /* By default only the input ports are replayed. */
+        if (num_replay_includes == 0 ? kind != PORT_INPUT :
+            !walk_matches(replay_includes,num_replay_includes))
+            return;
+    }
+    /* Look for the variable, with names like in VCD files. */
+    char name[strlen(path)+1];
+    strcpy(name,path);
+    for(char* c = name; *c; ++c) if (*c == ':') *c = '$';
+    ReplayVarS key = { name, NULL };
+    ReplayVarS* var = bsearch(&key,replay->vars,replay->num_vars,
+                              sizeof(ReplayVarS),&replay_var_cmp);
+    if (!var) return;
+    /* Bind the signal. */
+    ReplayIdS* bind = replay_lookup(replay,var->id);
+    if (!bind) {
+        unsigned int hash = replay_hash(var->id);
+        bind = calloc(1,sizeof(ReplayIdS));
+        bind->id = strdup(var->id);
+        bind->next = replay->table[hash];
+        replay->table[hash] = bind;
+    }
+    bind->signals = realloc(bind->signals,
+                            (bind->num_signals+1)*sizeof(SignalI));
+    bind->signals[bind->num_signals++] = signal;
+    if (replay->golden) {
+        /* Mark the signal for checking its changes. */
+        if (!bind->name) bind->name = strdup(path);
+        signal->check = 1;
+        if (signal->id >= num_golden_binds) {
+            size_t num = (signal->id+1)*2;
+            golden_binds = realloc(golden_binds,num*sizeof(ReplayIdS*));
+            memset(golden_binds+num_golden_binds,0,
+                   (num-num_golden_binds)*sizeof(ReplayIdS*));
+            num_golden_binds = num;
+        }
+        golden_binds[signal->id] = bind;
+        ++golden_signals;
+    }
+}
+
+/** Sets the time unit of a replayed file.
+ *  @param replay the replayed file
+ *  @param scale the timescale of the file, e.g. "10ns" */
+static void replay_timescale(Replay replay, const char* scale) {
+    char* unit;
+    unsigned long long num = strtoull(scale,&unit,10);
+    if (num == 0) num = 1;
+    replay->mul = num;
+    replay->div = 1;
+    if (strcmp(unit,"s") == 0)       replay->mul *= 1000000000000ULL;
+    else if (strcmp(unit,"ms") == 0) replay->mul *= 1000000000ULL;
+    else if (strcmp(unit,"us") == 0) replay->mul *= 1000000ULL;
+    else if (strcmp(unit,"ns") == 0) replay->mul *= 1000ULL;
+    else if (strcmp(unit,"fs") == 0) replay->div = 1000ULL;
+}
+
+static int replay_bind_vars(Replay replay, SystemT top);
+
+/** Reads the header of a replayed file and binds its variables to the
+ *  signals of a top system.
+ *  @param replay the replayed file
+ *  @param top the top system
+ *  @return the number of bound signals */
+static int replay_bind(Replay replay, SystemT top) {
+    char* token;
+    char path[4096] = "";
+    size_t lens[256];
+    int depth = 0;
+    replay->mul = replay->div = 1;
+    while((token = replay_token(replay))) {
+        if (strcmp(token,"$scope") == 0) {
+            replay_token(replay); /* The kind of scope. */
+            token = replay_token(replay);
+            if (!token) break;
+            /* The top scope is not part of the names. */
+            if (depth < 256) lens[depth] = strlen(path);
+            if (depth > 0 && strlen(path) + strlen(token) + 2 < 4096) {
+                if (path[0]) strcat(path,".");
+                strcat(path,token);
+            }
+            ++depth;
+            replay_skip(replay);
+        } else if (strcmp(token,"$upscope") == 0) {
+            if (depth > 0) --depth;
+            if (depth < 256) path[lens[depth]] = 0;
+            replay_skip(replay);
+        } else if (strcmp(token,"$var") == 0) {
+            replay_token(replay); /* The kind of variable. */
+            replay_token(replay); /* The width. */
+            char* id = strdup(replay_token(replay));
+            token = replay_token(replay);
+            if (!token) { free(id); break; }
+            char* name = malloc(strlen(path)+strlen(token)+2);
+            strcpy(name,path);
+            if (path[0]) strcat(name,".");
+            strcat(name,token);
+            replay->vars = realloc(replay->vars,
+                                   (replay->num_vars+1)*sizeof(ReplayVarS));
+            replay->vars[replay->num_vars].name = name;
+            replay->vars[replay->num_vars++].id = id;
+            replay_skip(replay);
+        } else if (strcmp(token,"$timescale") == 0) {
+            char scale[64] = "";
+            while((token = replay_token(replay)) &&
+                  strcmp(token,"$end") != 0) {
+                if (strlen(scale) + strlen(token) < 64) strcat(scale,token);
+            }
+            replay_timescale(replay,scale);
+        } else if (strcmp(token,"$enddefinitions") == 0) {
+            replay_skip(replay);
+            break;
+        } else if (token[0] == '$') {
+            /* Other section, skip it. */
+            replay_skip(replay);
+        }
+    }
+    return replay_bind_vars(replay,top);
+}
+
+/** Binds the variables declared in a replayed file to the signals of a
+ *  top system, and frees them.
+ *  @param replay the replayed file
+ *  @param top the top system
+ *  @return the number of bound signals */
+static int replay_bind_vars(Replay replay, SystemT top) {
+    int num = 0;
+    /* Bind the signals of the design. */
+    qsort(replay->vars,replay->num_vars,sizeof(ReplayVarS),&replay_var_cmp);
+    replay_binding = replay;
+    each_signal_path(top,&replay_bind_signal);
+    for(int i=0; i<REPLAY_TABLE_SIZE; ++i) {
+        ReplayIdS* bind;
+        for(bind = replay->table[i]; bind; bind = bind->next)
+            num += bind->num_signals;
+    }
+    /* The variables are not needed any longer. */
+    for(int i=0; i<replay->num_vars; ++i) {
+        free(replay->vars[i].name);
+        free(replay->vars[i].id);
+    }
+    free(replay->vars);
+    replay->vars = NULL;
+    replay->num_vars = 0;
+    return num;
+}
+
+/* Reading the HBW files (see hruby_sim_hbw.c for their format). */
+
+/** Reads a varint from a HBW file.
+ *  @param replay the replayed file
+ *  @param num where to put the integer
+ *  @return 1 if success, 0 at the end of the file */
+static int hbw_read_varint(Replay replay, unsigned long long* num) {
+    int shift = 0;
+    int byte;
+    *num = 0;
+    do {
+        byte = getc(replay->file);
+        if (byte == EOF) return 0;
+        if (shift < 64) *num |= (unsigned long long)(byte & 0x7F) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+    return 1;
+}
+
+/** Reads a varint from the payload of a block of a HBW file.
+ *  @param data the payload
+ *  @param size the size of the payload
+ *  @param pos the position in the payload, updated
+ *  @param num where to put the integer
+ *  @return 1 if success, 0 if the payload is truncated */
+static int hbw_payload_varint(const char* data, size_t size, size_t* pos,
+                              unsigned long long* num) {
+    int shift = 0;
+    unsigned char byte;
+    *num = 0;
+    do {
+        if (*pos >= size) return 0;
+        byte = data[(*pos)++];
+        if (shift < 64) *num |= (unsigned long long)(byte & 0x7F) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+    return 1;
+}
+
+/** Reads the declarations of a HBW file and binds its variables to the
+ *  signals of a top system.
+ *  @param replay the replayed file
+ *  @param top the top system
+ *  @return the number of bound signals */
+static int replay_bind_hbw(Replay replay, SystemT top) {
+    int byte;
+    /* HBW files are in ps. */
+    replay->mul = replay->div = 1;
+    while((byte = getc(replay->file)) == 'V') {
+        unsigned long long id, width, depth, len;
+        if (!hbw_read_varint(replay,&id) || !hbw_read_varint(replay,&width)
+            || !hbw_read_varint(replay,&depth))
+            break;
+        /* The names of the enclosing objects then of the signal, the top
+         * one excluded like the top scope of the VCD files. */
+        char* name = NULL;
+        size_t size = 0;
+        int valid = 1;
+        for(unsigned long long i=0; valid && i<=depth; ++i) {
+            valid = hbw_read_varint(replay,&len) && len < 4096;
+            if (!valid) break;
+            char text[len+1];
+            valid = fread(text,1,len,replay->file) == len;
+            text[len] = 0;
+            if (i == 0) continue;
+            /* With names like in VCD files. */
+            for(char* c = text; *c; ++c) if (*c == ':') *c = '$';
+            name = realloc(name,size+len+2);
+            if (size > 0) name[size++] = '.';
+            memcpy(name+size,text,len+1);
+            size += len;
+        }
+        if (!valid) { free(name); break; }
+        if (!name) continue;
+        /* Record the width for decoding the values. */
+        if (id >= replay->num_ids) {
+            size_t num = (id+1)*2;
+            replay->widths = realloc(replay->widths,
+                                     num*sizeof(unsigned long long));
+            replay->binds = realloc(replay->binds,num*sizeof(ReplayIdS*));
+            memset(replay->binds+replay->num_ids,0,
+                   (num-replay->num_ids)*sizeof(ReplayIdS*));
+            replay->num_ids = num;
+        }
+        replay->widths[id] = width;
+        /* The identifiers of the variables are the ids in text. */
+        char text[32];
+        snprintf(text,32,"%llu",id);
+        replay->vars = realloc(replay->vars,
+                               (replay->num_vars+1)*sizeof(ReplayVarS));
+        replay->vars[replay->num_vars].name = name;
+        replay->vars[replay->num_vars++].id = strdup(text);
+    }
+    if (byte != 'E') {
+        fprintf(stderr,"Invalid HBW declarations in %s.\n",replay->filename);
+        return 0;
+    }
+    int num = replay_bind_vars(replay,top);
+    /* Index the bindings by id for decoding the blocks directly. */
+    for(int i=0; i<REPLAY_TABLE_SIZE; ++i) {
+        ReplayIdS* bind;
+        for(bind = replay->table[i]; bind; bind = bind->next)
+            replay->binds[strtoull(bind->id,NULL,10)] = bind;
+    }
+    return num;
+}
+
+/** Compares two changes decoded from a HBW block by time then by order,
+ *  for sorting them. */
+static int hbw_change_cmp(const void* a, const void* b) {
+    const HbwChangeS* ca = (const HbwChangeS*)a;
+    const HbwChangeS* cb = (const HbwChangeS*)b;
+    if (ca->time != cb->time) return ca->time < cb->time ? -1 : 1;
+    return ca->order < cb->order ? -1 : ca->order > cb->order;
+}
+
+/** Decodes the changes of the bound signals in the payload of a HBW
+ *  block, sorted by time.
+ *  @param replay the replayed file
+ *  @param size the size of the payload
+ *  @return 1 if success, 0 if the payload is invalid */
+static int hbw_decode_payload(Replay replay, size_t size) {
+    const char* data = replay->payload;
+    size_t pos = 0;
+    unsigned long long num_traces, id, num, len, delta, i, j;
+    replay->num_changes = replay->next_change = 0;
+    replay->bits_size = 0;
+    if (!hbw_payload_varint(data,size,&pos,&num_traces)) return 0;
+    for(i=0; i<num_traces; ++i) {
+        if (!hbw_payload_varint(data,size,&pos,&id) ||
+            !hbw_payload_varint(data,size,&pos,&num) ||
+            !hbw_payload_varint(data,size,&pos,&len) || pos + len > size)
+            return 0;
+        ReplayIdS* bind = id < replay->num_ids ? replay->binds[id] : NULL;
+        if (!bind) {
+            /* Not bound, skip the changes. */
+            pos += len;
+            continue;
+        }
+        unsigned long long width = replay->widths[id];
+        unsigned long long time = replay->block_start;
+        size_t end = pos + len;
+        for(j=0; j<num; ++j) {
+            if (!hbw_payload_varint(data,end,&pos,&delta)) return 0;
+            time += delta >> 1;
+            int four_state = delta & 1;
+            size_t vsize = four_state ? width : (width+7)/8;
+            if (pos + vsize > end) return 0;
+            /* Ensure there is room for the change. */
+            if (replay->num_changes == replay->cap_changes) {
+                replay->cap_changes = replay->cap_changes ?
+                    replay->cap_changes*2 : 1024;
+                replay->changes = realloc(replay->changes,
+                        replay->cap_changes*sizeof(HbwChangeS));
+            }
+            if (replay->bits_size + width + 1 > replay->bits_capacity) {
+                replay->bits_capacity = (replay->bits_size+width+1)*2;
+                replay->bits = realloc(replay->bits,replay->bits_capacity);
+            }
+            /* Decode the value msb first. */
+            char* bits = replay->bits + replay->bits_size;
+            for(unsigned long long k=0; k<width; ++k) {
+                bits[width-1-k] = four_state ? data[pos+k] :
+                    ((data[pos+k/8] >> (k%8)) & 1) ? '1' : '0';
+            }
+            bits[width] = 0;
+            pos += vsize;
+            HbwChangeS* change = &replay->changes[replay->num_changes];
+            change->time = time;
+            change->order = replay->num_changes++;
+            change->bind = bind;
+            change->bits = replay->bits_size;
+            change->len = width;
+            replay->bits_size += width + 1;
+        }
+        pos = end;
+    }
+    qsort(replay->changes,replay->num_changes,sizeof(HbwChangeS),
+          &hbw_change_cmp);
+    return 1;
+}
+
+/** Reads and decodes the next block of a HBW file.
+ *  @param replay the replayed file
+ *  @return 1 if success, 0 at the end of the changes */
+static int hbw_read_block(Replay replay) {
+    unsigned long long start, duration, encoding, raw_size, size;
+    /* The index follows the last block. */
+    if (getc(replay->file) != 'B') return 0;
+    if (!hbw_read_varint(replay,&start) ||
+        !hbw_read_varint(replay,&duration) ||
+        !hbw_read_varint(replay,&encoding) ||
+        !hbw_read_varint(replay,&raw_size) ||
+        !hbw_read_varint(replay,&size)) {
+        fprintf(stderr,"Truncated HBW file %s.\n",replay->filename);
+        return 0;
+    }
+    replay->block_start += start;
+    if (replay->payload_capacity < raw_size) {
+        replay->payload_capacity = raw_size;
+        replay->payload = realloc(replay->payload,raw_size);
+    }
+    int ok;
+    if (encoding == 0 && size == raw_size) {
+        ok = fread(replay->payload,1,size,replay->file) == size;
+    } else if (encoding == 1) {
+        if (replay->zpayload_capacity < size) {
+            replay->zpayload_capacity = size;
+            replay->zpayload = realloc(replay->zpayload,size);
+        }
+        ok = fread(replay->zpayload,1,size,replay->file) == size &&
+             zlib_uncompress(replay->zpayload,size,replay->payload,raw_size);
+    } else {
+        ok = 0;
+    }
+    if (!ok || !hbw_decode_payload(replay,raw_size)) {
+        fprintf(stderr,"Invalid HBW block in %s.\n",replay->filename);
+        return 0;
+    }
+    return 1;
+}
+
+
+/** Opens a replayed file and binds it to the signals of a top system.
+ *  @param replay the replayed file
+ *  @param top the top system
+ *  @return 1 if success, 0 otherwise */
+static int replay_open(Replay replay, SystemT top) {
+    replay->file = fopen(replay->filename,"rb");
+    if (!replay->file) {
+        perror(replay->filename);
+        return 0;
+    }
+    /* Recognize the HBW files by their magic number. */
+    char magic[4];
+    replay->hbw = fread(magic,1,4,replay->file) == 4 &&
+                  memcmp(magic,"HBW1",4) == 0;
+    if (!replay->hbw) rewind(replay->file);
+    replay->capacity = REPLAY_CHUNK_SIZE;
+    replay->buffer = malloc(replay->capacity);
+    if ((replay->hbw ? replay_bind_hbw(replay,top) :
+                       replay_bind(replay,top)) == 0) {
+        fprintf(stderr,"No signal to %s from %s.\n",
+                replay->golden ? "check" : "replay",replay->filename);
+        fclose(replay->file);
+        replay->file = NULL;
+        return 0;
+    }
+    /* The changes start at time 0. */
+    replay->next_time = 0;
+    return 1;
+}
+
+/** Binds the replayed files to the signals of a top system.
+ *  @param top the top system */
+void replay_start(SystemT top) {
+    int i;
+    for(i=0; i<num_replays; ++i) replay_open(replays[i],top);
+}
+
+
+/* Replaying the changes. */
+
+/** Transmits a value given as a string of bits to a signal.
+ *  @param signal the signal to transmit to
+ *  @param bits the value, msb first, extended like in VCD files
+ *  @param len the number of bits of the value */
+static void replay_transmit(SignalI signal, const char* bits, size_t len) {
+    unsigned long long width = type_width(signal->type);
+    unsigned long long i;
+    /* The bits missing on the left are 0, or x or z like the msb. */
+    char fill = (bits[0] == 'x' || bits[0] == 'z') ? bits[0] : '0';
+    Value value = get_value();
+    value->type = signal->type;
+    if (width <= 64 && strspn(bits,"01") == len) {
+        /* Two-state value, use the numeric form. */
+        unsigned long long data = 0;
+        for(i = len > width ? len-width : 0; i<len; ++i)
+            data = (data << 1) | (bits[i] == '1');
+        value->numeric = 1;
+        value->data_int = data;
+    } else {
+        /* Use the bitstring form, lsb first. */
+        value->numeric = 0;
+        resize_value(value,width+1);
+        for(i=0; i<width; ++i)
+            value->data_str[i] = i < len ? bits[len-1-i] : fill;
+        value->data_str[width] = 0;
+    }
+    transmit_to_signal(value,signal);
+    free_value();
+}
+
+/** Adds a binding of a golden trace to the ones to check.
+ *  @param bind the binding to add */
+static void golden_mark_bind(ReplayIdS* bind) {
+    if (bind->pending) return;
+    bind->pending = 1;
+    if (num_golden_pending == cap_golden_pending) {
+        cap_golden_pending = cap_golden_pending ? cap_golden_pending*2 : 64;
+        golden_pending = realloc(golden_pending,
+                                 cap_golden_pending*sizeof(ReplayIdS*));
+    }
+    golden_pending[num_golden_pending++] = bind;
+}
+
+/** Replays a change of a binding.
+ *  @param replay the replayed file
+ *  @param bind the binding
+ *  @param bits the value, msb first
+ *  @param len the number of bits of the value */
+static void replay_change_bind(Replay replay, ReplayIdS* bind,
+                               const char* bits, size_t len) {
+    if (replay->golden) {
+        /* Golden trace, set the expected value to check. */
+        if (len+1 > bind->capacity) {
+            bind->capacity = len+1;
+            bind->expected = realloc(bind->expected,len+1);
+        }
+        memcpy(bind->expected,bits,len);
+        bind->expected[len] = 0;
+        golden_mark_bind(bind);
+        return;
+    }
+    for(int i=0; i<bind->num_signals; ++i)
+        replay_transmit(bind->signals[i],bits,len);
+}
+
+/** Replays a change of a VCD identifier.
+ *  @param replay the replayed file
+ *  @param id the identifier
+ *  @param bits the value, msb first
+ *  @param len the number of bits of the value */
+static void replay_change(Replay replay, const char* id,
+                          const char* bits, size_t len) {
+    ReplayIdS* bind = replay_lookup(replay,id);
+    if (bind) replay_change_bind(replay,bind,bits,len);
+}
+
+/** Replays the changes of a HBW file until a time.
+ *  @param replay the replayed file
+ *  @param time the current time (in ps) */
+static void replay_advance_hbw(Replay replay, unsigned long long time) {
+    do {
+        while(replay->next_change < replay->num_changes) {
+            HbwChangeS* change = &replay->changes[replay->next_change];
+            if (change->time > time) {
+                replay->next_time = change->time;
+                return;
+            }
+            replay_change_bind(replay,change->bind,
+                               replay->bits+change->bits,change->len);
+            ++replay->next_change;
+        }
+    } while(hbw_read_block(replay));
+    /* The end of the file, the replay is over. */
+    fclose(replay->file);
+    replay->file = NULL;
+    replay->next_time = ULLONG_MAX;
+}
+
+/** Replays the changes of a file until a time.
+ *  @param replay the replayed file
+ *  @param time the current time (in ps) */
+static void replay_advance(Replay replay, unsigned long long time) {
+    char* token;
+    if (replay->hbw) {
+        replay_advance_hbw(replay,time);
+        return;
+    }
+    while((token = replay_token(replay))) {
+        switch(token[0]) {
+            case '#':
+                {
+                    unsigned long long next = strtoull(token+1,NULL,10)
+                        * replay->mul / replay->div;
+                    if (next > time) {
+                        replay->next_time = next;
+                        return;
+                    }
+                    break;
+                }
+            case 'b': case 'B':
+                {
+                    /* Keep the value while reading the identifier. */
+                    size_t len = strlen(token+1);
+                    if (len+1 > replay->value_capacity) {
+                        replay->value_capacity = len+1;
+                        replay->value = realloc(replay->value,len+1);
+                    }
+                    for(size_t i=0; i<=len; ++i)
+                        replay->value[i] = tolower(token[i+1]);
+                    token = replay_token(replay);
+                    if (token) replay_change(replay,token,replay->value,len);
+                    break;
+                }
+            case 'r': case 'R':
+                /* Real values are not supported. */
+                replay_token(replay);
+                break;
+            case '0': case '1':
+            case 'x': case 'X': case 'z': case 'Z':
+                {
+                    char bit = tolower(token[0]);
+                    replay_change(replay,token+1,&bit,1);
+                    break;
+                }
+            case '$':
+                /* Skip the comments, the other keywords are ignored. */
+                if (strcmp(token,"$comment") == 0) replay_skip(replay);
+                break;
+            default:
+                break;
+        }
+    }
+    /* The end of the file, the replay is over. */
+    fclose(replay->file);
+    replay->file = NULL;
+    replay->next_time = ULLONG_MAX;
+}
+
+/** Gets the time of the next replayed value changes.
+ *  @return the time, ULLONG_MAX if there is none */
+unsigned long long replay_next_time() {
+    unsigned long long next_time = ULLONG_MAX;
+    int i;
+    for(i=0; i<num_replays; ++i) {
+        /* The golden traces do not drive the time. */
+        if (!replays[i]->golden && replays[i]->next_time < next_time)
+            next_time = replays[i]->next_time;
+    }
+    return next_time;
+}
+
+/** Transmits the replayed value changes that are due at a time.
+ *  NOTE: must be called while the timed behaviors are not running.
+ *  @param time the current time (in ps) */
+void replay_step(unsigned long long time) {
+    int i;
+    for(i=0; i<num_replays; ++i) {
+        if (replays[i]->file && !replays[i]->golden &&
+            replays[i]->next_time <= time)
+            replay_advance(replays[i],time);
+    }
+}
+
+
+/** Replaces the replayed files by another one during the simulation.
+ *  The changes of the new file until the current time are transmitted
+ *  at once.
+ *  NOTE: must be called while the timed behaviors are not running.
+ *  @param filename the name of the new VCD or HBW file
+ *  @param top the top system
+ *  @param time the current time (in ps) */
+void replay_switch(const char* filename, SystemT top,
+                   unsigned long long time) {
+    int i;
+    for(i=0; i<num_replays; ++i) {
+        Replay replay = replays[i];
+        if (replay->golden || !replay->file) continue;
+        fclose(replay->file);
+        replay->file = NULL;
+        replay->next_time = ULLONG_MAX;
+    }
+    add_replay(filename,0);
+    if (replay_open(replays[num_replays-1],top))
+        replay_advance(replays[num_replays-1],time);
+}
+
+
+/* Checking the golden traces. */
+
+/** Marks a signal whose value changed for checking against the golden
+ *  traces at the end of the time step.
+ *  @param signal the signal to check */
+void golden_mark(SignalI signal) {
+    golden_mark_bind(golden_binds[signal->id]);
+}
+
+/** Gets the bits of a value, msb first.
+ *  @param value the value to convert
+ *  @param width the width of the value
+ *  @param bits the destination, of width+1 characters */
+static void golden_bits(Value value, unsigned long long width, char* bits) {
+    unsigned long long i;
+    for(i=0; i<width; ++i) {
+        if (value->numeric)
+            bits[width-1-i] = i < 64 && ((value->data_int >> i) & 1) ?
+                '1' : '0';
+        else
+            bits[width-1-i] = value->data_str[i];
+    }
+    bits[width] = 0;
+}
+
+/** Reports a mismatch with a golden trace and stops the simulation.
+ *  @param bind the binding of the mismatching signal
+ *  @param time the time of the mismatch (in ps)
+ *  @param expected the expected value
+ *  @param actual the actual value */
+static void golden_report(ReplayIdS* bind, unsigned long long time,
+                          const char* expected, const char* actual) {
+    int i;
+    fprintf(stderr,"Golden trace mismatch on %s at %llups:\n",
+            bind->name,time);
+    fprintf(stderr,"   expected: %s\n",expected);
+    fprintf(stderr,"   actual:   %s\n",actual);
+    if (bind->num_history > 0) {
+        fprintf(stderr,"   previous values:\n");
+        for(i=0; i<bind->num_history; ++i)
+            fprintf(stderr,"      %llups: %s\n",
+                    bind->history_times[i],bind->history[i]);
+    }
+    exit(1);
+}
+
+/** Checks a binding of a golden trace.
+ *  @param bind the binding to check
+ *  @param time the current time (in ps) */
+static void golden_check(ReplayIdS* bind, unsigned long long time) {
+    int i;
+    bind->pending = 0;
+    if (!bind->expected) return;
+    for(i=0; i<bind->num_signals; ++i) {
+        SignalI signal = bind->signals[i];
+        unsigned long long width = type_width(signal->type);
+        unsigned long long len = strlen(bind->expected);
+        unsigned long long j;
+        char expected[width+1];
+        char actual[width+1];
+        /* Extend the expected value like in VCD files. */
+        char fill = (bind->expected[0] == 'x' || bind->expected[0] == 'z') ?
+            bind->expected[0] : '0';
+        for(j=0; j<width; ++j)
+            expected[width-1-j] = j < len ? bind->expected[len-1-j] : fill;
+        expected[width] = 0;
+        golden_bits(signal->c_value,width,actual);
+        ++golden_checks;
+        if (strcmp(expected,actual) != 0)
+            golden_report(bind,time,expected,actual);
+    }
+    /* Update the history. */
+    if (bind->num_history == GOLDEN_HISTORY) {
+        free(bind->history[0]);
+        memmove(bind->history,bind->history+1,
+                (GOLDEN_HISTORY-1)*sizeof(char*));
+        memmove(bind->history_times,bind->history_times+1,
+                (GOLDEN_HISTORY-1)*sizeof(unsigned long long));
+        --bind->num_history;
+    }
+    bind->history[bind->num_history] = strdup(bind->expected);
+    bind->history_times[bind->num_history++] = time;
+}
+
+/** Checks the signals changed during a time step against the golden
+ *  traces, stopping the simulation on the first mismatch.
+ *  NOTE: must be called at the end of the time step.
+ *  @param time the time of the step (in ps) */
+void golden_step(unsigned long long time) {
+    int i;
+    /* Read the expected changes until the time. */
+    for(i=0; i<num_replays; ++i) {
+        if (replays[i]->file && replays[i]->golden &&
+            replays[i]->next_time <= time)
+            replay_advance(replays[i],time);
+    }
+    /* Check the changed signals and the expected changes. */
+    for(i=0; i<num_golden_pending; ++i)
+        golden_check(golden_pending[i],time);
+    num_golden_pending = 0;
+}
+
+/** Ends the check against the golden traces.
+ *  @param time the end time of the simulation (in ps) */
+void golden_end(unsigned long long time) {
+    if (golden_signals == 0) return;
+    golden_step(time);
+    fprintf(stderr,"Golden trace matched: %llu values of %d signals checked.\n",
+            golden_checks,golden_signals);
+    golden_signals = 0;
+}
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hruby_sim.h"
+
+
+/**
+ *  The HDLRuby simulation snapshots of the signal state, to be used with
+ *  C code generated by the csim engine or by the rcsim engine.
+ *  A snapshot holds the current time and the current (and if different
+ *  the future) value of every signal of the hierarchy, keyed by its full
+ *  name, so that another run of the same design can start from it in
+ *  place of the initial values.
+ *  The file is written sequentially and is made of 8-byte aligned
+ *  records in the native byte order, so that it is loaded by mapping it
+ *  in memory, each value being then set with a single copy:
+ *   - the header: "HDRSNAP\0", the version and unused (32-bit each), and
+ *     the time in ps (64-bit).
+ *   - for each signal: the length of the name (32-bit), the flags
+ *     (32-bit), the width (64-bit), the name and the values (8 bytes if
+ *     numeric, one character per bit lsb first otherwise), each padded
+ *     to 8 bytes.
+ *   - an empty record (name length 0) ends the file.
+ **/
+
+/* The version of the snapshot format. */
+#define SNAPSHOT_VERSION 1
+
+/* The flags of a snapshot record. */
+#define SNAPSHOT_NUMERIC        1 /* The current value is numeric. */
+#define SNAPSHOT_FUTURE         2 /* The future value follows. */
+#define SNAPSHOT_FUTURE_NUMERIC 4 /* The future value is numeric. */
+
+/** The header of a snapshot. */
+typedef struct SnapshotHeaderS_ {
+    char magic[8];              /* The identification of the format. */
+    unsigned int version;       /* The version of the format. */
+    unsigned int unused;        /* For alignment. */
+    unsigned long long time;    /* The time of the snapshot (ps). */
+} SnapshotHeaderS;
+
+/** The header of the record of a signal in a snapshot. */
+typedef struct SnapshotRecordS_ {
+    unsigned int name_len;      /* The length of the name, 0 at the end. */
+    unsigned int flags;         /* The flags of the record. */
+    unsigned long long width;   /* The width of the signal. */
+} SnapshotRecordS;
+
+/** A signal of the design to restore. */
+typedef struct SnapshotSignalS_ {
+    char* name;                 /* The full name of the signal. */
+    SignalI signal;             /* The signal. */
+    int restored;               /* Tells if the signal has been restored. */
+} SnapshotSignalS;
+
+/* Tells if a snapshot is to save. */
+int snapshot_active = 0;
+
+/* The file where to save the snapshot and when. */
+static char* snapshot_out_filename = NULL;
+static unsigned long long snapshot_time = ULLONG_MAX;
+
+/* The file of the snapshot to restore at the start. */
+static char* snapshot_in_filename = NULL;
+
+/* The file being written. */
+static FILE* snapshot_out = NULL;
+
+/* The signals already visited, indexed by signal id. */
+static char* snapshot_seen = NULL;
+static size_t num_snapshot_seen = 0;
+
+/* The signals of the design to restore. */
+static SnapshotSignalS* snapshot_signals = NULL;
+static int num_snapshot_signals = 0;
+static int cap_snapshot_signals = 0;
+
+
+/** Sets the file where to save the state of the signals.
+ *  @param filename the name of the file
+ *  @param time the snapshot is saved at the end of the first time step
+ *         at or after this time (in ps), ULLONG_MAX for the end of the
+ *         simulation */
+void snapshot_output(const char* filename, unsigned long long time) {
+    free(snapshot_out_filename);
+    snapshot_out_filename = strdup(filename);
+    snapshot_time = time;
+    snapshot_active = 1;
+}
+
+/** Sets the file of the snapshot to restore at the start of the
+ *  simulation.
+ *  @param filename the name of the file */
+void snapshot_input(const char* filename) {
+    free(snapshot_in_filename);
+    snapshot_in_filename = strdup(filename);
+}
+
+
+/** Tells if a signal is visited for the first time, the same signal
+ *  being reachable by several names.
+ *  @param signal the signal
+ *  @return 1 if first visited, 0 otherwise */
+static int snapshot_first(SignalI signal) {
+    if (signal->id >= num_snapshot_seen) {
+        size_t num = (signal->id+1)*2;
+        snapshot_seen = realloc(snapshot_seen,num);
+        memset(snapshot_seen+num_snapshot_seen,0,num-num_snapshot_seen);
+        num_snapshot_seen = num;
+    }
+    if (snapshot_seen[signal->id]) return 0;
+    snapshot_seen[signal->id] = 1;
+    return 1;
+}
+
+/** Writes data padded to 8 bytes.
+ *  @param data the data to write
+ *  @param size the size of the data */
+static void snapshot_write(const void* data, size_t size) {
+    static const char zeros[8] = { 0 };
+    fwrite(data,1,size,snapshot_out);
+    if (size % 8) fwrite(zeros,1,8 - size % 8,snapshot_out);
+}
+
+/** Writes a value.
+ *  @param value the value to write
+ *  @param width the width of the value */
+static void snapshot_write_value(Value value, unsigned long long width) {
+    if (value->numeric)
+        snapshot_write(&value->data_int,sizeof(value->data_int));
+    else
+        snapshot_write(value->data_str,width);
+}
+
+/** Writes the record of a signal.
+ *  @param signal the signal to write
+ *  @param path the full name of the signal
+ *  @param kind the kind of port of the signal */
+static void snapshot_write_signal(SignalI signal, const char* path, int kind) {
+    if (signal->num_signals > 0 || !signal->c_value) return;
+    if (!snapshot_first(signal)) return;
+    SnapshotRecordS record;
+    int future = signal->f_value &&
+                 !same_content_value(signal->c_value,signal->f_value);
+    record.name_len = strlen(path);
+    record.width = type_width(signal->type);
+    record.flags = (signal->c_value->numeric ? SNAPSHOT_NUMERIC : 0) |
+        (future ? SNAPSHOT_FUTURE : 0) |
+        (future && signal->f_value->numeric ? SNAPSHOT_FUTURE_NUMERIC : 0);
+    fwrite(&record,sizeof(record),1,snapshot_out);
+    snapshot_write(path,record.name_len+1);
+    snapshot_write_value(signal->c_value,record.width);
+    if (future) snapshot_write_value(signal->f_value,record.width);
+}
+
+/** Saves the state of the signals to a file.
+ *  NOTE: must be called while the timed behaviors are not running.
+ *  @param filename the name of the file
+ *  @return 1 if success, 0 otherwise */
+int snapshot_save(const char* filename) {
+    snapshot_out = fopen(filename,"wb");
+    if (!snapshot_out) {
+        perror(filename);
+        return 0;
+    }
+    setvbuf(snapshot_out,NULL,_IOFBF,1024*1024);
+    SnapshotHeaderS header;
+    memset(&header,0,sizeof(header));
+    strcpy(header.magic,"HDRSNAP");
+    header.version = SNAPSHOT_VERSION;
+    header.time = hruby_sim_get_time();
+    fwrite(&header,sizeof(header),1,snapshot_out);
+    if (snapshot_seen) memset(snapshot_seen,0,num_snapshot_seen);
+    each_signal_path(top_system,&snapshot_write_signal);
+    /* The end record. */
+    SnapshotRecordS end;
+    memset(&end,0,sizeof(end));
+    fwrite(&end,sizeof(end),1,snapshot_out);
+    int ok = !ferror(snapshot_out);
+    if (fclose(snapshot_out) != 0) ok = 0;
+    snapshot_out = NULL;
+    if (!ok) perror(filename);
+    return ok;
+}
+
+/** Saves the snapshot if due at the end of a time step.
+ *  @param time the time of the step (in ps) */
+void snapshot_step(unsigned long long time) {
+    if (time < snapshot_time) return;
+    snapshot_active = 0;
+    snapshot_save(snapshot_out_filename);
+}
+
+/** Saves the snapshot at the end of the simulation if not done yet.
+ *  @param time the end time of the simulation (in ps) */
+void snapshot_end(unsigned long long time) {
+    if (!snapshot_active) return;
+    snapshot_active = 0;
+    snapshot_save(snapshot_out_filename);
+}
+
+
+/** Adds a signal of the design to the ones to restore.
+ *  @param signal the signal to add
+ *  @param path the full name of the signal
+ *  @param kind the kind of port of the signal */
+static void snapshot_add_signal(SignalI signal, const char* path, int kind) {
+    if (signal->num_signals > 0 || !signal->c_value) return;
+    if (!snapshot_first(signal)) return;
+    if (num_snapshot_signals == cap_snapshot_signals) {
+        cap_snapshot_signals = cap_snapshot_signals ? cap_snapshot_signals*2 : 256;
+        snapshot_signals = realloc(snapshot_signals,
+                             cap_snapshot_signals*sizeof(SnapshotSignalS));
+    }
+    SnapshotSignalS* sig = &snapshot_signals[num_snapshot_signals++];
+    sig->name = strdup(path);
+    sig->signal = signal;
+    sig->restored = 0;
+}
+
+/** Compares two signals to restore by name. */
+static int snapshot_signal_cmp(const void* a, const void* b) {
+    return strcmp(((const SnapshotSignalS*)a)->name,
+                  ((const SnapshotSignalS*)b)->name);
+}
+
+/** Reports a difference between the snapshot and the design.
+ *  @param filename the name of the snapshot file
+ *  @param num the number of differences so far */
+static void snapshot_diff(const char* filename, int num) {
+    if (num == 0)
+        fprintf(stderr,"Snapshot %s does not match the design:\n",filename);
+}
+
+/** Sets a value from the data of a snapshot.
+ *  @param value the value to set
+ *  @param numeric tells if the data is numeric
+ *  @param data the data
+ *  @param width the width of the value */
+static void snapshot_set_value(Value value, int numeric, const char* data,
+                               unsigned long long width) {
+    if (numeric) {
+        value->numeric = 1;
+        memcpy(&value->data_int,data,sizeof(value->data_int));
+    } else {
+        value->numeric = 0;
+        resize_value(value,width+1);
+        memcpy(value->data_str,data,width);
+        value->data_str[width] = 0;
+    }
+}
+
+/** Gets the padded size of data in a snapshot.
+ *  @param size the size of the data */
+static size_t snapshot_padded(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+/** Restores the state of the signals from the snapshot set with
+ *  snapshot_input if any, reporting the signals that do not match.
+ *  @param top the top system
+ *  @return the time of the snapshot (in ps), 0 if none */
+unsigned long long snapshot_restore(SystemT top) {
+    int i;
+    if (!snapshot_in_filename) return 0;
+    const char* filename = snapshot_in_filename;
+    int fd = open(filename,O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd,&st) < 0) {
+        perror(filename);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    size_t size = st.st_size;
+    char* map = size > 0 ?
+        mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(filename);
+        return 0;
+    }
+    SnapshotHeaderS* header = (SnapshotHeaderS*)map;
+    if (size < sizeof(SnapshotHeaderS) ||
+        memcmp(header->magic,"HDRSNAP",8) != 0 ||
+        header->version != SNAPSHOT_VERSION) {
+        fprintf(stderr,"Not a snapshot file: %s\n",filename);
+        munmap(map,size);
+        return 0;
+    }
+    unsigned long long time = header->time;
+    /* Get the signals of the design sorted by name. */
+    if (snapshot_seen) memset(snapshot_seen,0,num_snapshot_seen);
+    each_signal_path(top,&snapshot_add_signal);
+    qsort(snapshot_signals,num_snapshot_signals,sizeof(SnapshotSignalS),
+          &snapshot_signal_cmp);
+    /* Restore the signals of the snapshot. */
+    int num_diffs = 0, num_restored = 0;
+    size_t pos = sizeof(SnapshotHeaderS);
+    for(;;) {
+        if (pos + sizeof(SnapshotRecordS) > size) break;
+        SnapshotRecordS* record = (SnapshotRecordS*)(map+pos);
+        if (record->name_len == 0) break;
+        const char* name = map + pos + sizeof(SnapshotRecordS);
+        size_t cur_size = record->flags & SNAPSHOT_NUMERIC ?
+            8 : snapshot_padded(record->width);
+        size_t fut_size = !(record->flags & SNAPSHOT_FUTURE) ? 0 :
+            record->flags & SNAPSHOT_FUTURE_NUMERIC ?
+            8 : snapshot_padded(record->width);
+        size_t next = pos + sizeof(SnapshotRecordS) +
+            snapshot_padded(record->name_len+1) + cur_size + fut_size;
+        if (next > size) break;
+        const char* cur = name + snapshot_padded(record->name_len+1);
+        SnapshotSignalS key;
+        key.name = (char*)name;
+        SnapshotSignalS* sig = bsearch(&key,snapshot_signals,
+                num_snapshot_signals,sizeof(SnapshotSignalS),
+                &snapshot_signal_cmp);
+        if (!sig) {
+            snapshot_diff(filename,num_diffs++);
+            fprintf(stderr,"  - %s: in the snapshot, not in the design\n",
+                    name);
+        } else if (record->width != type_width(sig->signal->type)) {
+            snapshot_diff(filename,num_diffs++);
+            fprintf(stderr,"  ! %s: %llu-bit in the snapshot, "
+                    "%llu-bit in the design\n", name, record->width,
+                    type_width(sig->signal->type));
+            sig->restored = 1;
+        } else {
+            SignalI signal = sig->signal;
+            snapshot_set_value(signal->c_value,
+                               record->flags & SNAPSHOT_NUMERIC,
+                               cur,record->width);
+            if (record->flags & SNAPSHOT_FUTURE)
+                snapshot_set_value(signal->f_value,
+                                   record->flags & SNAPSHOT_FUTURE_NUMERIC,
+                                   cur+cur_size,record->width);
+            else if (signal->f_value)
+                snapshot_set_value(signal->f_value,
+                                   record->flags & SNAPSHOT_NUMERIC,
+                                   cur,record->width);
+            sig->restored = 1;
+            ++num_restored;
+        }
+        pos = next;
+    }
+    munmap(map,size);
+    /* Report the signals of the design missing in the snapshot. */
+    for(i=0; i<num_snapshot_signals; ++i) {
+        if (!snapshot_signals[i].restored) {
+            snapshot_diff(filename,num_diffs++);
+            fprintf(stderr,"  + %s: in the design, not in the snapshot\n",
+                    snapshot_signals[i].name);
+        }
+        free(snapshot_signals[i].name);
+    }
+    free(snapshot_signals);
+    snapshot_signals = NULL;
+    num_snapshot_signals = cap_snapshot_signals = 0;
+    if (num_diffs > 0)
+        fprintf(stderr,"%d signals restored from %s, %d differences.\n",
+                num_restored,filename,num_diffs);
+    return time;
+}
@@ -498,6 +498,11 @@ void execute_statement(Statement stmnt, int mode, Behavior behavior) {
                 terminate();
                 break;
             }
+        case TIME_DUMP:
+            {
+                dump_switch(((TimeDump)stmnt)->on);
+                break;
+            }
         case BLOCK:
             {
                 Block block = (Block)stmnt;
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <stdarg.h>
@@ -12,31 +13,95 @@
 
 /* Global variables storing the configuration of the vcd generation. */
 
-/* The target file. */
-static FILE* vcd_file;
+/* The target output. */
+static Output vcd_out;
 
 /* The time scale unit in the ps. */
 static unsigned long long vcd_timeunit = 1;
 
+/* The emitter: the vcd text is formatted directly into the buffers of
+ * the output. */
+
+/** Emits a character.
+ *  @param c the character to emit */
+static inline void vcd_put_char(char c) {
+    *output_reserve(vcd_out,1) = c;
+    output_commit(vcd_out,1);
+}
+
+/** Emits a string.
+ *  @param str the string to emit
+ *  @param len the length of the string */
+static inline void vcd_put_str(const char* str, size_t len) {
+    output_write(vcd_out,str,len);
+}
+
+/* The pairs of decimal digits for converting integers. */
+static const char vcd_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+/** Emits an unsigned integer in decimal.
+ *  @param num the integer to emit */
+static void vcd_put_ull(unsigned long long num) {
+    char text[20];
+    char* ptr = text + 20;
+    while(num >= 100) {
+        ptr -= 2;
+        memcpy(ptr,vcd_digit_pairs + (num % 100)*2, 2);
+        num /= 100;
+    }
+    if (num >= 10) {
+        ptr -= 2;
+        memcpy(ptr,vcd_digit_pairs + num*2, 2);
+    } else {
+        *(--ptr) = '0' + num;
+    }
+    vcd_put_str(ptr,text+20-ptr);
+}
+
+/* The binary digits of each byte, msb first. */
+static char vcd_byte_bits[256][8];
+
+/** Fills the table of the binary digits of the bytes. */
+static void vcd_init_byte_bits() {
+    int b,i;
+    for(b=0; b<256; ++b)
+        for(i=0; i<8; ++i)
+            vcd_byte_bits[b][i] = ((b >> (7-i)) & 1) ? '1' : '0';
+}
+
+
 /* Accessing target file. */
 
 /** Prints to the vcd file.
  *  @param fmt the format for handling the variadic arguments. */
 static int vcd_print(const char* fmt, ...) {
     int ret;
+    char text[512];
 
     /* Declare a va_list type variable */
     va_list myargs;
 
-    /* Initialise the va_list variable with the ... after fmt */
+    /* Format into a local text first. */
     va_start(myargs, fmt);
-
-    /* Forward the '...' to vprintf */
-    ret = vfprintf(vcd_file, fmt, myargs);
-
-    /* Clean up the va_list */
+    ret = vsnprintf(text, sizeof(text), fmt, myargs);
     va_end(myargs);
 
+    if (ret < (int)sizeof(text)) {
+        if (ret > 0) vcd_put_str(text,ret);
+    } else {
+        /* Too long, format again in a large enough text. */
+        char* big = malloc(ret+1);
+        va_start(myargs, fmt);
+        vsnprintf(big, ret+1, fmt, myargs);
+        va_end(myargs);
+        vcd_put_str(big,ret);
+        free(big);
+    }
+
     return ret;
 }
 
@@ -60,7 +125,9 @@ static char* replace_char(char* str, char find, char replace){
 /** Prints the time.
  *  @param time the time to show (given in ps). */
 static void vcd_print_time(unsigned long long time) {
-    vcd_print("#%llu\n",time/vcd_timeunit);
+    vcd_put_char('#');
+    vcd_put_ull(time/vcd_timeunit);
+    vcd_put_char('\n');
 }
 
 
@@ -110,46 +177,87 @@ static void vcd_print_full_name(Object object) {
     vcd_print_name(object);
 }
 
+/* The vcd identifiers of the signals, indexed by signal id, computed
+ * once when first used (normally when declaring the signals). */
+static char** vcd_ids = NULL;
+static size_t vcd_cap_ids = 0;
+
+/** Gets the vcd identifier of a signal.
+ *  @param signal the signal to get the identifier of.
+ *  @return the identifier as a string. */
+static char* vcd_signal_id(SignalI signal) {
+    size_t id = signal->id;
+    /* Ensure there is room for the identifier. */
+    if (id >= vcd_cap_ids) {
+        size_t cap = vcd_cap_ids ? vcd_cap_ids : 256;
+        while(cap <= id) cap *= 2;
+        vcd_ids = realloc(vcd_ids,cap*sizeof(char*));
+        memset(vcd_ids+vcd_cap_ids,0,(cap-vcd_cap_ids)*sizeof(char*));
+        vcd_cap_ids = cap;
+    }
+    if (!vcd_ids[id]) {
+        /* Not computed yet, do it now. */
+        char text[16];
+        int len = 0;
+        do {
+            text[len++] = (id % (127-33)) + 33;
+            id = id / (127-33);
+        } while (id > 0);
+        text[len] = 0;
+        vcd_ids[signal->id] = strdup(text);
+    }
+    return vcd_ids[signal->id];
+}
+
 /** Prints the id of a signal in vcd indentifier format.
  *  @param signal the signal to print the id. */
 static void vcd_print_signal_id(SignalI signal) {
-    size_t id = signal->id;
-    do {
-        vcd_print("%c",(id % (127-33)) + 33);
-        id = id / (127-33);
-    } while (id > 0);
+    char* id = vcd_signal_id(signal);
+    vcd_put_str(id,strlen(id));
 }
 
 /** Prints a value.
  *  @param value the value to print */
 static void vcd_print_value(Value value) {
     unsigned long long width = type_width(value->type);
-    if (width > 1) vcd_print("b");
+    if (width > 1) vcd_put_char('b');
     if (value->numeric) {
-        // unsigned long long width = type_width(value->type);
-        unsigned long long mask = 1ULL << (width-1);
-        for(; mask > 0; mask >>= 1) {
-            vcd_print("%d",(value->data_int & mask) != 0);
+        /* Display the bits byte by byte using the table. */
+        unsigned long long data = value->data_int;
+        unsigned long long bytes = (width+7)/8;
+        unsigned long long head = width - (bytes-1)*8;
+        char* ptr = output_reserve(vcd_out,width);
+        long long i;
+        /* The most significant byte may be partial. */
+        memcpy(ptr,vcd_byte_bits[(bytes-1 < 8) ?
+                   (data >> ((bytes-1)*8)) & 0xFF : 0] + 8 - head, head);
+        ptr += head;
+        for(i=bytes-2; i>=0; --i) {
+            memcpy(ptr,vcd_byte_bits[i < 8 ? (data >> (i*8)) & 0xFF : 0],8);
+            ptr += 8;
         }
+        output_commit(vcd_out,width);
     } else {
         /* Display a bitstring value. */
         unsigned long long i;
-        // unsigned long long width = type_width(value->type);
         char* data = value->data_str;
-        if (value->capacity == 0) {
-            /* The value is empty, therefore undefined. */
-            for(i=width; i>0; --i) {
-                vcd_print("u");
+        while(width > 0) {
+            /* Fill by chunks for the very large values. */
+            unsigned long long chunk = width < 4096 ? width : 4096;
+            char* ptr = output_reserve(vcd_out,chunk);
+            if (value->capacity == 0) {
+                /* The value is empty, therefore undefined. */
+                memset(ptr,'u',chunk);
+            } else {
+                /* The value is not empty, msb first. */
+                for(i=0; i<chunk; ++i) ptr[i] = data[width-1-i];
             }
+            output_commit(vcd_out,chunk);
+            width -= chunk;
         }
-        else {
-            /* The value is not empty. */
-            for(i=width; i>0; --i) {
-                vcd_print("%c",data[i-1]);
-            } 
-        }
+        width = type_width(value->type);
     }
-    if (width > 1) vcd_print(" ");
+    if (width > 1) vcd_put_char(' ');
 }
 
 /** Prints a signal declaration.
@@ -168,8 +276,8 @@ static void vcd_print_var(SignalI signal) {
         }
         /* Close the hierarchy. */
         vcd_print("$upscope $end\n");
-    } else {
-        /* The signal is flat, can declarate it directly. */
+    } else if (signal->dump) {
+        /* The signal is flat and selected, can declarate it directly. */
         vcd_print("$var wire %d ",type_width(signal->type));
         // vcd_print_full_name((Object)signal);
         vcd_print_signal_id(signal);
@@ -180,11 +288,12 @@ static void vcd_print_var(SignalI signal) {
 }
 
 
-/** Prints a signal with its future value if any.
+/** Prints a signal with its current value if any
  *  @param signal the signal to show */
-static void vcd_print_signal_fvalue(SignalI signal) {
-    if (signal->f_value) {
-        vcd_print_value(signal->f_value);
+static void vcd_print_signal_cvalue(SignalI signal) {
+    if ((signal->num_signals == 0) && signal->dump && signal->c_value) {
+        /* The signal is not hierachical and has a current value. */
+        vcd_print_value(signal->c_value);
         // vcd_print(" ");
         // vcd_print_full_name((Object)signal);
         vcd_print_signal_id(signal);
@@ -193,17 +302,86 @@ static void vcd_print_signal_fvalue(SignalI signal) {
 }
 
 
-/** Prints a signal with its current value if any
- *  @param signal the signal to show */
-static void vcd_print_signal_cvalue(SignalI signal) {
-    if ((signal->num_signals == 0) && signal->c_value) {
-        /* The signal is not hierachical and has a current value. */
+/* Coalescing of the signal changes: the signals changed during a time
+ * step are only marked, and their final values are printed once when
+ * time advances. */
+
+/* The signals changed during the current time step. */
+static SignalI* vcd_changed = NULL;
+static size_t vcd_num_changed = 0;
+static size_t vcd_cap_changed = 0;
+
+/* The marks of the changed signals, indexed by signal id. */
+static char* vcd_marks = NULL;
+static size_t vcd_cap_marks = 0;
+
+/* The current time step and whether its time has been printed. */
+static unsigned long long vcd_cur_time = 0;
+static int vcd_time_printed = 0;
+
+/** Marks a signal as changed during the current time step.
+ *  @param signal the changed signal */
+static void vcd_mark_signal(SignalI signal) {
+    size_t id = signal->id;
+    /* Ensure there is room for the mark. */
+    if (id >= vcd_cap_marks) {
+        size_t cap = vcd_cap_marks ? vcd_cap_marks : 256;
+        while(cap <= id) cap *= 2;
+        char* marks = calloc(cap,sizeof(char));
+        if (vcd_marks) {
+            memcpy(marks,vcd_marks,vcd_cap_marks);
+            free(vcd_marks);
+        }
+        vcd_marks = marks;
+        vcd_cap_marks = cap;
+    }
+    /* Already marked? */
+    if (vcd_marks[id]) return;
+    /* No, add it to the changed signals. */
+    if (vcd_num_changed == vcd_cap_changed) {
+        vcd_cap_changed = vcd_cap_changed ? vcd_cap_changed*2 : 256;
+        vcd_changed = realloc(vcd_changed,vcd_cap_changed*sizeof(SignalI));
+    }
+    vcd_changed[vcd_num_changed++] = signal;
+    vcd_marks[id] = 1;
+}
+
+/** Prints the final values of the signals changed during the current
+ *  time step. */
+static void vcd_flush_changes() {
+    size_t i;
+    if (vcd_num_changed == 0) return;
+    /* The changes are to be preceded by their time. */
+    if (!vcd_time_printed) {
+        vcd_print_time(vcd_cur_time);
+        vcd_time_printed = 1;
+    }
+    for(i=0; i<vcd_num_changed; ++i) {
+        SignalI signal = vcd_changed[i];
         vcd_print_value(signal->c_value);
-        // vcd_print(" ");
-        // vcd_print_full_name((Object)signal);
         vcd_print_signal_id(signal);
-        vcd_print("\n");
+        vcd_put_char('\n');
+        vcd_marks[signal->id] = 0;
     }
+    vcd_num_changed = 0;
+}
+
+/** Advances to a new time step.
+ *  @param time the time of the new step (given in ps). */
+static void vcd_step_time(unsigned long long time) {
+    /* Still in the same time step? */
+    if (time == vcd_cur_time) return;
+    /* No, output the previous step and start the new one. */
+    vcd_flush_changes();
+    vcd_cur_time = time;
+    vcd_print_time(time);
+    vcd_time_printed = 1;
+}
+
+/** Ends the vcd file at the end of the simulation. */
+static void vcd_close() {
+    vcd_flush_changes();
+    close_output(vcd_out);
 }
 
 
@@ -255,6 +433,7 @@ static int vcd_statement_has_decl(Statement stmnt) {
                 return 0;
             }
         case TIME_TERMINATE:
+        case TIME_DUMP:
             /* No declaration. */
             return 0;
         case BLOCK:
@@ -331,6 +510,7 @@ static void vcd_print_statement(Statement stmnt) {
                 break;
             }
         case TIME_TERMINATE:
+        case TIME_DUMP:
             /* Nothing to do. */
             break;
         case BLOCK:
@@ -524,7 +704,7 @@ static void vcd_print_header() {
 
     /* Display the initializations. */
     vcd_print("$dumpvars\n");
-    each_all_signal(&vcd_print_signal_cvalue);
+    if (dump_active) each_all_signal(&vcd_print_signal_cvalue);
     vcd_print("$end\n");
 }
 
@@ -540,17 +720,28 @@ extern void init_vcd_visualizer(char* name) {
     char filename[256];
     strncpy(filename,name,255);
     strncat(filename,".vcd",255);
-    vcd_file = fopen(filename,"w");
+    vcd_out = open_output(filename);
+    if (!vcd_out) {
+        /* Cannot dump, simulate without output. */
+        init_mute_visualizer(name);
+        return;
+    }
+
+    /* Initialize the emitter. */
+    vcd_init_byte_bits();
 
     /* Initialize the vizualizer printer engine. */
-    init_visualizer(&vcd_print_time,
+    init_visualizer(&vcd_step_time,
                     &vcd_print_full_name,
                     &vcd_print_value,
-                    &vcd_print_signal_fvalue,
+                    &vcd_mark_signal,
                     &default_print_string,
                     &default_print_name,
                     &default_print_value);
 
     /* Prints the header of the vcd file. */
     vcd_print_header();
+
+    /* The last changes are output when the simulation ends. */
+    atexit(&vcd_close);
 }
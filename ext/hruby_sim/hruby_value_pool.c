@@ -14,6 +14,7 @@
 static Value* pool_values = NULL;
 static unsigned int pool_cap = 0; /* The capacity of the pool. */
 static unsigned int pool_pos = 0; /* The position in the pool. */
+static unsigned int pool_peak = 0; /* The highest position in the pool. */
 
 /** Get a fresh value. */
 Value get_value() {
@@ -53,6 +54,7 @@ Value get_value() {
     /* Readjust the position in the pool and return the value. */
     // return pool_values[pool_pos++];
     Value res = pool_values[pool_pos++];
+    if (pool_pos > pool_peak) pool_peak = pool_pos;
     return res;
 }
 
@@ -85,6 +87,15 @@ void set_value_pos(unsigned int pos) {
 }
 
 
+/** Gets the high-water marks of the value pool.
+ *  @param peak where to put the highest number of values in use
+ *  @param capacity where to put the capacity of the pool */
+void get_value_pool_stats(unsigned int* peak, unsigned int* capacity) {
+    *peak = pool_peak;
+    *capacity = pool_cap;
+}
+
+
 #define POOL_STATE_STACK_SIZE 0x10000
 /* The stack of pool states. */
 static unsigned int pool_state_stack[POOL_STATE_STACK_SIZE];
@@ -0,0 +1,34 @@
+require "HDLRuby/hruby_hbw.rb"
+require "HDLRuby/hruby_wave.rb"
+
+HELP = "Usage: hbw2vcd <input hbw or hbw.gz file name> [<output vcd file name>]"
+
+if ARGV[0] == "--help" then
+  puts HELP
+  exit
+end
+
+unless ARGV.size == 1 || ARGV.size == 2 then
+  puts HELP
+  exit(1)
+end
+
+if ARGV[0] == ARGV[1] then
+  puts "Error: input and output files are identical."
+  exit(1)
+end
+
+begin
+  File.open(ARGV[0],"rb") do |input|
+    # Compressed files are inflated on the fly.
+    input = HDLRuby::Wave.uncompress(input)
+    if ARGV[1] then
+      File.open(ARGV[1],"w") { |output| HDLRuby::HBW.to_vcd(input,output) }
+    else
+      HDLRuby::HBW.to_vcd(input,$stdout)
+    end
+  end
+rescue => error
+  puts error
+  exit(1)
+end
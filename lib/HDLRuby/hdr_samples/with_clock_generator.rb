@@ -0,0 +1,31 @@
+# A system for testing the native clock generators.
+system :with_clock_generator do
+    inner :clk0, :clk1, :clk2
+    [8].inner :cnt0, :cnt1, :cnt2
+
+    # Symmetric clock of 20ns.
+    make_clock_generator(clk0,20.ns)
+    # Clock of 30ns with 10ns high, starting after 5ns.
+    make_clock_generator(clk1,30.ns,10.ns,5.ns)
+    # Usual timed idiom, also lowered to a native clock.
+    timed do
+        clk2 <= 0
+        repeat(40) do
+            !7.ns
+            clk2 <= ~clk2
+        end
+    end
+
+    par(clk0.posedge) { cnt0 <= cnt0 + 1 }
+    par(clk1.posedge) { cnt1 <= cnt1 + 1 }
+    par(clk2.posedge) { cnt2 <= cnt2 + 1 }
+
+    timed do
+        cnt0 <= 0; cnt1 <= 0; cnt2 <= 0
+        !400.ns
+        hprint("cnt0=",cnt0," cnt1=",cnt1," cnt2=",cnt2,"\n")
+        !100.ns
+        hprint("cnt0=",cnt0," cnt1=",cnt1," cnt2=",cnt2,"\n")
+        terminate
+    end
+end
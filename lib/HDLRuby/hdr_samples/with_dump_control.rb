@@ -0,0 +1,46 @@
+# A system for testing the control of the waveform dump.
+# Simulate it for example with:
+#   hdrcc --sim --vcd --dump-include "counter.*" with_dump_control.rb out
+system :dump_counter do
+    input :clk, :rst
+    [8].output :q
+
+    par(clk.posedge) do
+        hif(rst) { q <= 0 }
+        helse    { q <= q + 1 }
+    end
+end
+
+system :with_dump_control do
+    inner :clk, :rst
+    [8].inner :q
+
+    dump_counter(:counter).(clk,rst,q)
+
+    timed do
+        clk <= 0
+        rst <= 1
+        !10.ns
+        clk <= 1
+        !10.ns
+        clk <= 0
+        rst <= 0
+        # Dump the first cycles only...
+        repeat(4) do
+            !10.ns
+            clk <= ~clk
+        end
+        dumpoff
+        repeat(20) do
+            !10.ns
+            clk <= ~clk
+        end
+        # ... and the last ones.
+        dumpon
+        repeat(4) do
+            !10.ns
+            clk <= ~clk
+        end
+        hprint("q=",q,"\n")
+    end
+end
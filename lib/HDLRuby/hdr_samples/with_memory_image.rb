@@ -0,0 +1,20 @@
+# A system for testing the loading of memory images.
+system :with_memory_image do
+    [3..0].inner :addr
+    [7..0].inner :data0, :data1
+    bit[7..0][-16].inner :mem0, :mem1
+
+    # Load the content of the memories from image files.
+    mem0.readmemh("with_memory_image.hex")
+    mem1.readmemb("with_memory_image.bin.txt")
+
+    data0 <= mem0[addr]
+    data1 <= mem1[addr]
+
+    timed do
+        16.times do |i|
+            addr <= i
+            !10.ns
+        end
+    end
+end
@@ -0,0 +1,43 @@
+# A system for testing the stimulus replay.
+# First simulate it with its testbench and record the waveform:
+#   hdrcc --sim --vcd with_replay.rb rec
+# Then simulate the counter alone, its inputs being replayed from the
+# recorded waveform by the simulator:
+#   HDR_REPLAY=1 hdrcc --sim --vcd --replay rec/hruby_simulator.vcd with_replay.rb play
+system :replay_counter do
+    input :clk, :rst, :en
+    [8].output :q
+
+    par(clk.posedge) do
+        hif(rst)     { q <= 0 }
+        helsif(en)   { q <= q + 1 }
+    end
+end
+
+system :with_replay do
+    inner :clk, :rst, :en
+    [8].inner :q
+
+    replay_counter(:counter).(clk,rst,en,q)
+
+    # The testbench, not required when replaying.
+    unless ENV["HDR_REPLAY"] then
+        timed do
+            clk <= 0
+            rst <= 1
+            en  <= 0
+            !10.ns
+            clk <= 1
+            !10.ns
+            clk <= 0
+            rst <= 0
+            100.times do |i|
+                !10.ns
+                clk <= 1
+                en <= (i % 3 != 0 ? 1 : 0)
+                !10.ns
+                clk <= 0
+            end
+        end
+    end
+end
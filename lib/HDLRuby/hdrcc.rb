@@ -52,35 +52,48 @@ end
 # end
 
 
+# Cache the compiled Ruby files of HDLRuby for starting faster, in the
+# directory given by HDLRUBY_ISEQ_CACHE if any (empty for disabling).
+require 'HDLRuby/hruby_iseq_cache'
+HDLRuby::ISeqCache.enable(ENV.fetch("HDLRUBY_ISEQ_CACHE") do
+    HDLRuby::ISeqCache.default_dir
+end)
+
 require 'fileutils'
 require 'tempfile'
 require 'HDLRuby'
 require 'HDLRuby/hruby_check.rb'
 # require 'ripper'
-require 'HDLRuby/hruby_low2hdr'
-require 'HDLRuby/hruby_low2c'
-require 'HDLRuby/hruby_low2vhd'
-require 'HDLRuby/hruby_low_without_subsignals'
-require 'HDLRuby/hruby_low_fix_types'
-# require 'HDLRuby/hruby_low_expand_types' # For now dormant
-require 'HDLRuby/hruby_low_without_outread'
-require 'HDLRuby/hruby_low_with_bool'
-require 'HDLRuby/hruby_low_bool2select'
-require 'HDLRuby/hruby_low_without_select'
-require 'HDLRuby/hruby_low_without_namespace'
-require 'HDLRuby/hruby_low_without_bit2vector'
-require 'HDLRuby/hruby_low_with_port'
-require 'HDLRuby/hruby_low_with_var'
-require 'HDLRuby/hruby_low_without_concat'
-require 'HDLRuby/hruby_low_without_connection'
-require 'HDLRuby/hruby_low_casts_without_expression'
 require 'hruby_low_without_parinseq'
-require 'HDLRuby/hruby_low_cleanup'
-
-require 'HDLRuby/hruby_verilog.rb'
 
-require 'HDLRuby/backend/hruby_allocator'
-require 'HDLRuby/backend/hruby_c_allocator'
+##
+# Loads the code generators and the passes they use: they are only loaded
+# when required since the simulators do not need them.
+def require_backends
+    require 'HDLRuby/hruby_low2hdr'
+    require 'HDLRuby/hruby_low2c'
+    require 'HDLRuby/hruby_low2vhd'
+    require 'HDLRuby/hruby_low_without_subsignals'
+    require 'HDLRuby/hruby_low_fix_types'
+    # require 'HDLRuby/hruby_low_expand_types' # For now dormant
+    require 'HDLRuby/hruby_low_without_outread'
+    require 'HDLRuby/hruby_low_with_bool'
+    require 'HDLRuby/hruby_low_bool2select'
+    require 'HDLRuby/hruby_low_without_select'
+    require 'HDLRuby/hruby_low_without_namespace'
+    require 'HDLRuby/hruby_low_without_bit2vector'
+    require 'HDLRuby/hruby_low_with_port'
+    require 'HDLRuby/hruby_low_with_var'
+    require 'HDLRuby/hruby_low_without_concat'
+    require 'HDLRuby/hruby_low_without_connection'
+    require 'HDLRuby/hruby_low_casts_without_expression'
+    require 'HDLRuby/hruby_low_cleanup'
+
+    require 'HDLRuby/hruby_verilog.rb'
+
+    require 'HDLRuby/backend/hruby_allocator'
+    require 'HDLRuby/backend/hruby_c_allocator'
+end
 
 require 'HDLRuby/version.rb'
 
@@ -109,6 +122,9 @@ module HDLRuby
         # The required files.
         attr_reader :requires
 
+        # The paths of the files read.
+        attr_reader :files
+
         # Creates a new loader for a +top_system+ system in file +top_file_name+
         # from directory +dir+ with generic parameters +params+.
         #
@@ -138,6 +154,9 @@ module HDLRuby
             # The list of required files.
             @requires = []
 
+            # The list of the paths of the files read.
+            @files = []
+
             # The list of the code texts (the first one should be the one
             # containing the top system).
             @texts = []
@@ -179,6 +198,7 @@ module HDLRuby
                 @checks << Checker.new(@texts[-1],found.path)
             else
                 @checks << Checker.new(@texts[-1])
+                @files << found
             end
             return true
         end
@@ -331,6 +351,78 @@ def which(cmd)
     nil
 end
 
+# Configure and execute the hybrid C-Ruby-level simulator whose top system
+# is the C object +rcsystemT+.
+def run_rcsim(rcsystemT)
+    hits, misses = RCSimCinterface.rcsim_get_const_pool_stats
+    HDLRuby.show "Constant pool: #{misses} constants, #{hits} reused."
+    # Configure the dump.
+    ($options[:dump_include] || []).each do |pattern|
+        RCSimCinterface.rcsim_dump_include(pattern)
+    end
+    ($options[:dump_exclude] || []).each do |pattern|
+        RCSimCinterface.rcsim_dump_exclude(pattern)
+    end
+    if $options[:dump_window] then
+        RCSimCinterface.rcsim_dump_window(*$options[:dump_window])
+    end
+    if $options[:gzip] then
+        RCSimCinterface.rcsim_set_output_compression($options[:gzip],
+                                              $options[:gzip_threads] || 2)
+    end
+    # Configure the stimulus replay.
+    ($options[:replay] || []).each do |filename|
+        RCSimCinterface.rcsim_replay_file(filename)
+    end
+    ($options[:replay_signals] || []).each do |pattern|
+        RCSimCinterface.rcsim_replay_include(pattern)
+    end
+    # Configure the check against golden traces.
+    ($options[:golden] || []).each do |filename|
+        RCSimCinterface.rcsim_golden_file(filename)
+    end
+    ($options[:golden_signals] || []).each do |pattern|
+        RCSimCinterface.rcsim_golden_include(pattern)
+    end
+    # Configure the coverage collection.
+    if $options[:coverage] then
+        RCSimCinterface.rcsim_coverage_file($options[:coverage])
+    end
+    # Configure the runtime metrics.
+    if $options[:metrics] then
+        RCSimCinterface.rcsim_metrics_output($options[:metrics],
+                                             $options[:metrics_period] || 10)
+    end
+    # Configure the snapshots.
+    if $options[:snapshot] then
+        RCSimCinterface.rcsim_snapshot_output($options[:snapshot],
+                                              $options[:snapshot_at])
+    end
+    if $options[:restore] then
+        RCSimCinterface.rcsim_snapshot_input($options[:restore])
+    end
+    # Configure the checkpoints.
+    if $checkpoint_dir then
+        RCSimCinterface.rcsim_checkpoint_dir($checkpoint_dir)
+        ($options[:checkpoint] || []).each do |time|
+            RCSimCinterface.rcsim_checkpoint_at(time)
+        end
+    end
+    # Configure the profiling.
+    if $options[:sim_profile] then
+        RCSimCinterface.rcsim_profile_enable(
+            File.expand_path($output + "/hruby_simulator.folded"),
+            $options[:sim_profile])
+    end
+    HDLRuby.show "Executing the hybrid C-Ruby-level simulator..."
+    HDLRuby.show "#{Time.now}#{show_mem}"
+    RCSimCinterface.rcsim_main(rcsystemT, $output + "/hruby_simulator",
+                               ($options[:mute] && 1) || ($options[:vcd] && 2) ||
+                               ($options[:hbw] && 3) || 0)
+    HDLRuby.show "End of hybrid C-Ruby-level simulation..."
+    HDLRuby.show "#{Time.now}#{show_mem}"
+end
+
 
 # Used standalone, check the files given in the standard input.
 include HDLRuby
@@ -404,9 +496,91 @@ $optparse = OptionParser.new do |opts|
     opts.on("--mute", "The simulator will not generate any output") do |v|
         $options[:mute] = v
     end
+    opts.on("--probe pattern", "With --mute, keep the logic driving the signals matching the pattern, can be repeated") do |p|
+        ($options[:probes] ||= []) << p
+    end
     opts.on("--vcd", "The simulator will generate a vcd file") do |v|
         $options[:vcd] = v
     end
+    opts.on("--hbw", "The simulator will generate a compact binary waveform file (convert it with hbw2vcd)") do |v|
+        $options[:hbw] = v
+    end
+    opts.on("--gzip", "Compress the waveform file on the fly with gzip") do |v|
+        $options[:gzip] ||= 6
+    end
+    opts.on("--gzip-level level", Integer, "Compression level of the waveform file (1 to 9, 6 by default)") do |l|
+        $options[:gzip] = l
+    end
+    opts.on("--gzip-threads n", Integer, "Number of threads for compressing the waveform file (2 by default)") do |n|
+        $options[:gzip_threads] = n
+    end
+    opts.on("--replay file", "Replay the value changes of a VCD or HBW file on the input ports of the design, can be repeated") do |f|
+        ($options[:replay] ||= []) << File.expand_path(f)
+    end
+    opts.on("--replay-signals pattern", "Replay on the signals matching the pattern instead of the input ports, can be repeated") do |p|
+        ($options[:replay_signals] ||= []) << p
+    end
+    opts.on("--golden file", "Check the signals against a reference VCD or HBW file, stopping on the first mismatch") do |f|
+        ($options[:golden] ||= []) << File.expand_path(f)
+    end
+    opts.on("--golden-signals pattern", "Only check the signals matching the pattern against the reference, can be repeated") do |p|
+        ($options[:golden_signals] ||= []) << p
+    end
+    opts.on("--sim-profile", "Profile the behaviors, delta cycles and signals of the simulation, also writing the profile as folded stacks for flame graphs") do |v|
+        $options[:sim_profile] ||= 1
+    end
+    opts.on("--sim-profile-sampling n", Integer, "With --sim-profile, only measure the execution time of one behavior execution out of n") do |n|
+        $options[:sim_profile] = n
+    end
+    opts.on("--sim-per-object", "Build the objects of the hybrid simulator one call at a time instead of all at once from a serialized model") do |v|
+        $options[:sim_per_object] = v
+    end
+    opts.on("--sim-cache dir", "Cache the serialized models of the hybrid simulator in dir, so that an unchanged design is simulated without being parsed nor transformed again, or the compiled files of the standalone C simulator") do |d|
+        $options[:sim_cache] = File.expand_path(d)
+    end
+    opts.on("--sim-cache-size MB", Integer, "With --sim-cache, limit the size of the cache, removing the least recently used models (default: 256)") do |s|
+        $options[:sim_cache_size] = s
+    end
+    opts.on("--sim-cache-invalidate", "With --sim-cache, remove all the cached models first") do |v|
+        $options[:sim_cache_invalidate] = v
+    end
+    opts.on("-j", "--jobs n", Integer, "Number of parallel processes for generating the files in multiple files mode and for compiling the standalone C simulator (default: the number of processors)") do |n|
+        $options[:jobs] = n
+    end
+    opts.on("--metrics destination", "Write the runtime metrics of the simulation as JSON lines to a file, or to the clients of a Unix socket with unix:path, periodically and on SIGUSR1") do |d|
+        $options[:metrics] = d.start_with?("unix:") ?
+            "unix:" + File.expand_path(d[5..-1]) : File.expand_path(d)
+    end
+    opts.on("--metrics-period seconds", Float, "With --metrics, the period of the writes, 0 for only on SIGUSR1 (default: 10)") do |p|
+        $options[:metrics_period] = p
+    end
+    opts.on("--checkpoint time", Integer, "Fork a paused copy of the simulation at the end of the first time step at or after time (in ps) that can be resumed with hdrcheckpoint, can be repeated") do |t|
+        ($options[:checkpoint] ||= []) << t
+    end
+    opts.on("--checkpoint-dir dir", "Create the sockets of the checkpoints in dir (default: the output directory), also taking a checkpoint on SIGUSR2") do |d|
+        $options[:checkpoint_dir] = File.expand_path(d)
+    end
+    opts.on("--snapshot file", "Save the state of the signals into file at the end of the simulation, or at --snapshot-at") do |f|
+        $options[:snapshot] = File.expand_path(f)
+    end
+    opts.on("--snapshot-at time", Integer, "With --snapshot, save the state at the end of the first time step at or after time (in ps)") do |t|
+        $options[:snapshot_at] = t
+    end
+    opts.on("--restore file", "Start the simulation from the state of the signals saved in file with --snapshot") do |f|
+        $options[:restore] = File.expand_path(f)
+    end
+    opts.on("--coverage file", "Collect the toggle coverage of the signals and the activations of the behaviors into a JSON file") do |f|
+        $options[:coverage] = File.expand_path(f)
+    end
+    opts.on("--dump-include pattern", "Only dump the signals matching the pattern (e.g., cpu.alu.*), can be repeated") do |p|
+        ($options[:dump_include] ||= []) << p
+    end
+    opts.on("--dump-exclude pattern", "Do not dump the signals matching the pattern, can be repeated") do |p|
+        ($options[:dump_exclude] ||= []) << p
+    end
+    opts.on("--dump-window start,stop", Array, "Only dump between start and stop (in ps, stop may be omitted)") do |w|
+        $options[:dump_window] = [w[0].to_i, w[1] && w[1].to_i]
+    end
     opts.on("--ch dir", "Generates the files for compiling a software extension") do |dir|
         # Check the target directory.
         if !dir or dir.empty? then
@@ -440,6 +614,7 @@ $optparse = OptionParser.new do |opts|
         $gen = true
     end
     opts.on("-V", "--vhdl","Output in VHDL format") do |v|
+        require_backends
         HDLRuby::Low::Low2VHDL.vhdl08 = false
         $options[:vhdl] = v
         $options[:multiple] = v
@@ -447,6 +622,7 @@ $optparse = OptionParser.new do |opts|
         $gen = true
     end
     opts.on("-A", "--alliance","Output in Alliance-compatible VHDL format") do |v|
+        require_backends
         HDLRuby::Low::Low2VHDL.vhdl08 = false
         HDLRuby::Low::Low2VHDL.alliance = true
         $options[:vhdl] = v
@@ -456,12 +632,16 @@ $optparse = OptionParser.new do |opts|
         $gen = true
     end
     opts.on("-U", "--vhdl08","Output in VHDL'08 format") do |v|
+        require_backends
         HDLRuby::Low::Low2VHDL.vhdl08 = true
         $options[:vhdl] = v
         $options[:multiple] = v
         $options[:vhdl08] = true
         $gen = true
     end
+    opts.on("--no-share", "Process and generate one system per instance for Verilog HDL, VHDL and the C simulator, even for the identical ones") do |v|
+        $options[:no_share] = true
+    end
     opts.on("--svg","Output a graphical representation of the RTL (SVG format)") do |v|
       $options[:svg] = v
       $options[:multiple] = v
@@ -635,6 +815,12 @@ else
     $output = $stdout
 end
 
+# Get the directory of the simulation checkpoints if any.
+if $options[:checkpoint] || $options[:checkpoint_dir] then
+    $checkpoint_dir = $options[:checkpoint_dir] ||
+        ($output.is_a?(String) && File.expand_path($output))
+end
+
 # Process non-HDLRuby files.
 if $input.end_with?(".v") then
   if $top.empty? then
@@ -650,8 +836,41 @@ if $input.end_with?(".v") then
   $input = rinput
 end
 
-# Load and process the HDLRuby files.
 $options[:directory] ||= "./"
+
+# In mute mode, the parts of the design that cannot be observed are pruned
+# from the hybrid simulator, unless they are checked against a golden
+# trace, covered or saved.
+$rcsim_prune = $options[:mute] && !($options[:golden] ||
+    $options[:coverage] || $options[:snapshot] || $options[:restore])
+
+# Look for the model of the hybrid simulator in the cache if any: on a hit,
+# it is simulated directly without loading nor processing the HDLRuby files.
+if $options[:rcsim] && $options[:sim_cache] &&
+   !$options[:sim_per_object] && !$test_file then
+    require 'HDLRuby/hruby_rcsim.rb'
+    require 'HDLRuby/hruby_rcsim_cache.rb'
+    $sim_cache = HDLRuby::High::RCSimCache.new($options[:sim_cache],
+                              ($options[:sim_cache_size] || 256)*1024*1024)
+    $sim_cache.invalidate if $options[:sim_cache_invalidate]
+    $sim_cache_key = $sim_cache.key($input, $top, $params, $options[:std],
+                          $options[:directory].to_s, $rcsim_prune,
+                          $options[:probes])
+    $sim_cache_entry = $sim_cache.fetch($sim_cache_key)
+    if $sim_cache_entry then
+        HDLRuby.show "Building the hybrid C-Ruby-level simulator from the cache..."
+        HDLRuby.show "#{Time.now}#{show_mem}"
+        run_rcsim(HDLRuby::High::RCSimBuffer.build($sim_cache_entry[:data],
+                                  $sim_cache_entry[:node], [],
+                                  $sim_cache_entry[:ports])[-1])
+        exit
+    end
+end
+
+# Load and process the HDLRuby files.
+# Record the environment variables read by the description, the model
+# depending on them.
+HDLRuby::High::RCSimCache.watch_env if $sim_cache
 $loader = HDRLoad.new($top,$input,$options[:directory].to_s,*$params)
 $loader.read_all
 $loader.check_all
@@ -683,6 +902,13 @@ end
 # Generate the result.
 # Get the top systemT.
 HDLRuby.show "#{Time.now}#{show_mem}"
+# When generating Verilog HDL or VHDL, the structurally identical instances
+# share the same system, so that it is processed and generated only once.
+# For the C simulator, they share it through the transformation passes only.
+if ($options[:verilog] || $options[:vhdl] || $options[:clang]) &&
+   !$options[:no_share] then
+    HDLRuby::High.share_systemTs = true
+end
 # Ruby simulation uses the HDLRuby::High tree, other the HDLRuby::Lowais used 
 if $top_instance then
   $top_system = ($options[:rsim] || $options[:rcsim]) ? $top_instance.systemT : $top_instance.to_low.systemT
@@ -721,6 +947,12 @@ $top_system.each_systemT_deep do |systemT|
         end
     end
 end
+# Load the code generators, unless only simulating a design without
+# non-HDLRuby code.
+unless ($options[:rsim] || $options[:rcsim]) &&
+       $non_hdlruby.empty? && !$options[:allocate] then
+    require_backends
+end
 # Applies the allocators if required.
 $allocate_range = $options[:allocate]
 if $allocate_range then
@@ -781,6 +1013,13 @@ elsif $options[:clang] then
         systemT.explicit_types!
         HDLRuby.show? "#{Time.now}#{show_mem}"
     end
+    # Each instance requires its own signals in the simulator: give its own
+    # copy of the shared systems to each instance.
+    unless $options[:no_share] then
+        HDLRuby.show? "unshare step..."
+        $top_system.unshare!
+        HDLRuby.show? "#{Time.now}#{show_mem}"
+    end
     # Generate the C.
     if $options[:multiple] then
         # Get the base name of the input file, it will be used for
@@ -839,6 +1078,7 @@ elsif $options[:clang] then
         # Select the vizualizer depending on the options.
         init_visualizer = $options[:mute] ? "init_mute_visualizer" :
                           $options[:vcd]  ? "init_vcd_visualizer" :
+                          $options[:hbw]  ? "init_hbw_visualizer" :
                                             "init_default_visualizer"
 
         # Gather the system to generate and sort them in the right order
@@ -853,10 +1093,37 @@ elsif $options[:clang] then
                                          init_visualizer,
                                          $top_system,
                                          c_systems,
-                                         $hnames)
+                                         $hnames,
+                                         include: $options[:dump_include],
+                                         exclude: $options[:dump_exclude],
+                                         window: $options[:dump_window],
+                                         compression: $options[:gzip] &&
+                                         [$options[:gzip],
+                                          $options[:gzip_threads] || 2],
+                                         replay: $options[:replay],
+                                         replay_signals: $options[:replay_signals],
+                                         golden: $options[:golden],
+                                         golden_signals: $options[:golden_signals],
+                                         coverage: $options[:coverage],
+                                         profile: $options[:sim_profile] &&
+                                         [$output + "/hruby_simulator.folded",
+                                          $options[:sim_profile]],
+                                         metrics: $options[:metrics] &&
+                                         [$options[:metrics],
+                                          $options[:metrics_period] || 10],
+                                         checkpoint: $checkpoint_dir &&
+                                         [$checkpoint_dir,
+                                          $options[:checkpoint] || []],
+                                         snapshot: $options[:snapshot] &&
+                                         [$options[:snapshot],
+                                          $options[:snapshot_at]],
+                                         restore: $options[:restore])
         $main.close
 
-        $top_system.each_systemT_deep do |systemT|
+        # Generate the files of the systemTs in parallel, each with its own
+        # name space so that the names do not depend on the other files.
+        HDLRuby.each_in_parallel($top_system.each_systemT_deep.to_a,
+                                 $options[:jobs]) do |systemT,i|
             # For the c file.
             name = $output + "/" +
                 HDLRuby::Low::Low2C.c_name(systemT.name) +
@@ -866,11 +1133,11 @@ elsif $options[:clang] then
             outfile = File.open(name,"w")
             # Generate the C code in to.
             # outfile << systemT.to_c(0,*$hnames)
-            systemT.to_c(outfile,0,*$hnames)
+            HDLRuby::Low::Low2C.with_name_space("#{i.to_s(36)}_") do
+                systemT.to_c(outfile,0,*$hnames)
+            end
             # Close the file.
             outfile.close
-            # Clears the name.
-            name = nil
         end
     else
         # Single file generation mode.
@@ -889,11 +1156,16 @@ elsif $options[:clang] then
         # Path of the simulator core files.
         # $simdir = $hdr_dir + "sim/"
         # puts "$hdr_dir=#{$hdr_dir}"
-        $simdir = $hdr_dir + "/../../ext/hruby_sim/"
+        # NOTE: expanded since the compilation is done from the output
+        # directory.
+        $simdir = File.expand_path($hdr_dir + "/../../ext/hruby_sim/")
         # Generate and execute the simulation commands.
         # Kernel.system("cp -n #{simdir}* #{$output}/; cd #{$output}/ ; make -s ; ./hruby_simulator")
+        # Only the headers are copied, the simulator core is compiled
+        # once into a library.
         Dir.entries($simdir).each do |filename| 
-            if !File.directory?(filename) && /\.[ch]$/ === filename then
+            if !File.directory?($simdir + "/" + filename) &&
+               /\.h$/ === filename then
                 FileUtils.cp($simdir + "/" + filename,$output)
             end
         end
@@ -906,12 +1178,31 @@ elsif $options[:clang] then
         unless cc_cmd then
             raise "Could not find any compiler, please compile by hand as follows:\n" +
                 "   In folder #{$output} execute:\n" +
+                "     cp #{$simdir}/*.c .\n" +
                 "     <my compiler> -o hruby_simulator *.c -lpthread\n" +
                 "   Then execute:\n   hruby_simulator"
         end
         # Use it.
         HDLRuby.show "Compiling C code of the simulator..."
-        Kernel.system("#{cc_cmd} -o3 -o hruby_simulator *.c -lpthread")
+        require 'HDLRuby/hruby_csim_build.rb'
+        # Zlib is required for compressing the waveform files and for
+        # reading the compressed HBW files.
+        $csim_zlib = $options[:gzip] || $options[:hbw] ||
+                     $options[:replay] || $options[:golden]
+        $csim_builder = HDLRuby::Low::CSimBuilder.new(cc_cmd, $simdir,
+            $options[:sim_cache] ? $options[:sim_cache] + "/csim" : "cache",
+            cflags: $csim_zlib ? ["-DHAVE_ZLIB"] : [],
+            libs: $csim_zlib ? ["-lpthread","-lz"] : ["-lpthread"],
+            jobs: $options[:jobs],
+            max_size: ($options[:sim_cache_size] || 256)*1024*1024)
+        $csim_builder.invalidate if $options[:sim_cache_invalidate]
+        $csim_lib = $csim_builder.build_core
+        # The C files of the design, skipping the copies of the core ones
+        # made by the previous versions.
+        $csim_sources = Dir.glob("*.c").sort - $csim_builder.core_sources
+        $csim_builder.link($csim_builder.build_design($csim_sources,
+                                                      Dir.glob("*.h")),
+                           $csim_lib,"hruby_simulator")
         HDLRuby.show "#{Time.now}#{show_mem}"
         HDLRuby.show "Executing the simulator..."
         Kernel.system("./hruby_simulator")
@@ -959,25 +1250,34 @@ elsif $options[:verilog] then
         $basename = $output + "/" + $basename
         # # File name counter.
         # $namecount = 0
-        # Prepare the initial name for the main file.
-        $name = $basename + ".v"
         # Multiple files generation mode.
-        $top_system.each_systemT_deep do |systemT|
-            # Generate the name if necessary.
-            unless $name
-                $name = $output + "/" +
-                    HDLRuby::Verilog.name_to_verilog(systemT.name) +
-                    ".v"
+        # Convert first the names shared by the files (the systems and
+        # their ports), then generate each file from these names only, so
+        # that the files can be generated in parallel.
+        $systemTs = $top_system.each_systemT_deep.to_a
+        $systemTs.each do |systemT|
+            HDLRuby::Verilog.name_to_verilog(systemT.name)
+            systemT.each_signal do |signal|
+                HDLRuby::Verilog.name_to_verilog(signal.name)
+            end
+        end
+        $verilog_names = HDLRuby::Verilog.names
+        HDLRuby.each_in_parallel($systemTs,$options[:jobs]) do |systemT,i|
+            HDLRuby::Verilog.names = $verilog_names
+            # Generate the name: the first file is the main one.
+            if i == 0 then
+                name = $basename + ".v"
+            else
+                name = $output + "/" +
+                    HDLRuby::Verilog.name_to_verilog(systemT.name) + ".v"
             end
             # Open the file for current systemT
-            outfile = File.open($name,"w")
+            outfile = File.open(name,"w")
             # Generate the Verilog code in to.
             # outfile << systemT.to_verilog
             outfile << systemT.to_verilog($options[:vcd])
             # Close the file.
             outfile.close
-            # Clears the name.
-            $name = nil
         end
     else
         # Single file generation mode.
@@ -1016,14 +1316,31 @@ elsif $options[:rcsim] then
     $top_system.merge_included!
     # Process par in seq.
     $top_system.par_in_seq2seq!
+    # In mute mode, prune the parts of the design that cannot be observed.
+    if $rcsim_prune then
+        $rcsim_pruned = HDLRuby::High.rcsim_prune($top_system,
+                                                  $options[:probes] || [])
+        HDLRuby.show "Pruned #{$rcsim_pruned.size} unobservable behaviors and connections."
+        $rcsim_pruned.each do |node|
+            HDLRuby.show? "  #{node.class.name.split("::")[-1]} in #{node.parent.fullname}"
+        end
+    end
     # Generate the C data structures.
+    HDLRuby::High::RCSim.buffered = !$options[:sim_per_object]
+    HDLRuby::High::RCSim.keep_buffer = !!$sim_cache
     $top_system.to_rcsim
-    HDLRuby.show "Executing the hybrid C-Ruby-level simulator..."
-    HDLRuby.show "#{Time.now}#{show_mem}"
-    HDLRuby::High.rcsim($top_system,"hruby_simulator",$output,
-                        ($options[:mute] && 1) || ($options[:vcd] && 2) || 0)
-    HDLRuby.show "End of hybrid C-Ruby-level simulation..."
-    HDLRuby.show "#{Time.now}#{show_mem}"
+    # Save the model into the cache if any.
+    if $sim_cache then
+        $sim_cache_buffer = HDLRuby::High::RCSim.last_buffer
+        if $sim_cache.store($sim_cache_key,$loader.files,
+                            $sim_cache_buffer,$sim_cache_buffer.node,
+                            HDLRuby::High::RCSimCache.unwatch_env) then
+            HDLRuby.show "Model saved into the cache."
+        else
+            HDLRuby.show "The model runs Ruby programs or depends on the whole environment, it is not cached."
+        end
+    end
+    run_rcsim($top_system.rcsystemT)
 elsif $options[:vhdl] then
     # top_system = $top_instance.to_low.systemT
     # top_system = $top_system
@@ -1053,24 +1370,23 @@ elsif $options[:vhdl] then
         $basename = $output + "/" + $basename
         # # File name counter.
         # $namecount = 0
-        # Prepare the initial name for the main file.
-        $name = $basename + ".vhd"
-        # Multiple files generation mode.
-        $top_system.each_systemT_deep do |systemT|
-            # Generate the name if necessary.
-            unless $name
-                $name = $output + "/" +
+        # Multiple files generation mode, in parallel.
+        HDLRuby.each_in_parallel($top_system.each_systemT_deep.to_a,
+                                 $options[:jobs]) do |systemT,i|
+            # Generate the name: the first file is the main one.
+            if i == 0 then
+                name = $basename + ".vhd"
+            else
+                name = $output + "/" +
                     HDLRuby::Low::Low2VHDL.entity_name(systemT.name) +
                     ".vhd"
             end
             # Open the file for current systemT
-            outfile = File.open($name,"w")
+            outfile = File.open(name,"w")
             # Generate the VHDL code in to.
             outfile << systemT.to_vhdl
             # Close the file.
             outfile.close
-            # Clears the name.
-            $name = nil
         end
     else
         # Single file generation mode.
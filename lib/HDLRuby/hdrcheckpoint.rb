@@ -0,0 +1,49 @@
+require "HDLRuby/hruby_checkpoint.rb"
+
+HELP = <<~HELP
+Usage: hdrcheckpoint <command> <arguments>
+  resume <checkpoint socket> <output directory> [--replay <VCD file>] [--env <name>=<value>]...
+  quit <checkpoint socket>
+HELP
+
+if ARGV[0] == "--help" then
+  puts HELP
+  exit
+end
+
+begin
+  case ARGV[0]
+  when "resume" then
+    raise HELP unless ARGV.size >= 3
+    replay = nil
+    env = {}
+    args = ARGV[3..-1]
+    until args.empty?
+      case args.shift
+      when "--replay" then
+        replay = args.shift or raise HELP
+      when "--env" then
+        name, value = (args.shift or raise HELP).split("=",2)
+        raise HELP unless value
+        env[name] = value
+      else
+        raise HELP
+      end
+    end
+    status = HDLRuby::Checkpoint.resume(ARGV[1],ARGV[2],
+                                        replay: replay, env: env) do |pid|
+      puts "Resumed as process #{pid}, log in " +
+           File.join(File.expand_path(ARGV[2]),"hruby_simulator.log")
+    end
+    puts "Exited with status #{status}"
+    exit(status)
+  when "quit" then
+    raise HELP unless ARGV.size == 2
+    HDLRuby::Checkpoint.quit(ARGV[1])
+  else
+    raise HELP
+  end
+rescue => error
+  puts error
+  exit(1)
+end
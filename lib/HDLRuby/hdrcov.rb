@@ -0,0 +1,63 @@
+require "HDLRuby/hruby_coverage.rb"
+
+HELP = <<~HELP
+Usage: hdrcov <command> <arguments>
+  merge <output coverage file name> <input coverage file names>
+  report <coverage file name>
+  uncovered <coverage file name>
+  activity <coverage file name> [number of signals]
+HELP
+
+if ARGV[0] == "--help" then
+  puts HELP
+  exit
+end
+
+begin
+  case ARGV[0]
+  when "merge" then
+    raise HELP unless ARGV.size >= 3
+    if ARGV[2..-1].include?(ARGV[1]) then
+      raise "Error: the output file is also an input file."
+    end
+    reports = ARGV[2..-1].map { |name| HDLRuby::Coverage.load(name) }
+    HDLRuby::Coverage.save(HDLRuby::Coverage.merge(reports),ARGV[1])
+  when "report" then
+    raise HELP unless ARGV.size == 2
+    report = HDLRuby::Coverage.load(ARGV[1])
+    covered, total = HDLRuby::Coverage.toggle_coverage(report)
+    behs = report["behaviors"]
+    active = behs.count { |beh| beh["activations"] > 0 }
+    puts "Runs: #{report["runs"]}, simulated time: #{report["time"]}ps"
+    puts "Toggle coverage: #{covered}/#{total} bits " +
+         "(#{total > 0 ? (covered*100.0/total).round(2) : 100}%)"
+    puts "Behavior coverage: #{active}/#{behs.size} activated " +
+         "(#{behs.empty? ? 100 : (active*100.0/behs.size).round(2)}%)"
+  when "uncovered" then
+    raise HELP unless ARGV.size == 2
+    report = HDLRuby::Coverage.load(ARGV[1])
+    report["signals"].each do |sig|
+      bits = sig["width"].times.reject do |i|
+        HDLRuby::Coverage.toggled?(sig,i)
+      end
+      next if bits.empty?
+      puts "signal #{sig["name"]}: bits #{bits.join(",")} not toggled both ways"
+    end
+    report["behaviors"].each do |beh|
+      puts "behavior #{beh["name"]}: never activated" if beh["activations"] == 0
+    end
+  when "activity" then
+    raise HELP unless ARGV.size == 2 || ARGV.size == 3
+    report = HDLRuby::Coverage.load(ARGV[1])
+    activities = HDLRuby::Coverage.activities(report).sort_by { |_,a| -a }
+    activities = activities.first(ARGV[2].to_i) if ARGV[2]
+    activities.each do |name,activity|
+      puts "#{name}: #{activity.round(6)} toggles/ns"
+    end
+  else
+    raise HELP
+  end
+rescue => error
+  puts error
+  exit(1)
+end
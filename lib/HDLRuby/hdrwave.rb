@@ -0,0 +1,54 @@
+require "HDLRuby/hruby_wave.rb"
+
+HELP = <<~HELP
+Usage: hdrwave <command> <arguments>
+  build <input vcd or hbw file name> <output store file name>
+  list <store file name>
+  value <store file name> <signal> <time>
+  changes <store file name> <signal> <start time> <stop time>
+  edges <store file name> <signal> <start time> <stop time> [posedge|negedge]
+HELP
+
+if ARGV[0] == "--help" then
+  puts HELP
+  exit
+end
+
+begin
+  case ARGV[0]
+  when "build" then
+    raise HELP unless ARGV.size == 3
+    if ARGV[1] == ARGV[2] then
+      raise "Error: input and output files are identical."
+    end
+    HDLRuby::Wave.convert(ARGV[1],ARGV[2])
+  when "list" then
+    raise HELP unless ARGV.size == 2
+    HDLRuby::Wave::Store.open(ARGV[1]) do |store|
+      store.signals.each { |name| puts "#{name} [#{store.width(name)}]" }
+    end
+  when "value" then
+    raise HELP unless ARGV.size == 4
+    HDLRuby::Wave::Store.open(ARGV[1]) do |store|
+      puts store.value_at(ARGV[2],ARGV[3].to_i) || "none"
+    end
+  when "changes" then
+    raise HELP unless ARGV.size == 5
+    HDLRuby::Wave::Store.open(ARGV[1]) do |store|
+      store.changes(ARGV[2],ARGV[3].to_i,ARGV[4].to_i).each do |time,value|
+        puts "#{time} #{value}"
+      end
+    end
+  when "edges" then
+    raise HELP unless ARGV.size == 5 || ARGV.size == 6
+    edge = ARGV[5] == "negedge" ? :negedge : :posedge
+    HDLRuby::Wave::Store.open(ARGV[1]) do |store|
+      puts store.edges(ARGV[2],ARGV[3].to_i,ARGV[4].to_i,edge)
+    end
+  else
+    raise HELP
+  end
+rescue => error
+  puts error
+  exit(1)
+end
@@ -0,0 +1,53 @@
+require "socket"
+
+##
+# Library for resuming the checkpoints taken by the simulators with the
+# --checkpoint option.
+#
+# A checkpoint is a paused copy of the simulation waiting for requests on
+# a Unix socket. Each request is a line:
+#  - "resume <directory> [replay <file>] [env <name>=<value>]..." runs the
+#    rest of the simulation from the checkpoint, writing its outputs and
+#    its log in the directory, and replies "started <pid>" then
+#    "exited <status>" once the run is over.
+#  - "quit" ends the checkpoint.
+########################################################################
+module HDLRuby
+    module Checkpoint
+
+        ## Resumes the checkpoint listening on +socket+, writing the
+        #  outputs into +dir+, replaying the +replay+ VCD file instead of
+        #  the original stimulus if any, and with the +env+ environment
+        #  variables for the programs.
+        #  Yields the process id of the continuation if a block is given.
+        #  Returns the exit status of the continuation.
+        def self.resume(socket, dir, replay: nil, env: {})
+            request = "resume #{File.expand_path(dir)}"
+            request << " replay #{File.expand_path(replay)}" if replay
+            env.each { |name,value| request << " env #{name}=#{value}" }
+            if request =~ /\n/ || request.split(" ").size !=
+                    2 + (replay ? 2 : 0) + env.size*2 then
+                raise "Spaces or new lines are not allowed in the arguments."
+            end
+            UNIXSocket.open(socket) do |sock|
+                sock.puts(request)
+                started = sock.gets
+                unless started && started.start_with?("started ") then
+                    raise "Cannot resume #{socket}: #{started}"
+                end
+                yield(started.split[1].to_i) if block_given?
+                exited = sock.gets
+                raise "Checkpoint #{socket} lost." unless exited
+                return exited.split[1].to_i
+            end
+        end
+
+        ## Ends the checkpoint listening on +socket+.
+        def self.quit(socket)
+            UNIXSocket.open(socket) do |sock|
+                sock.puts("quit")
+                sock.gets
+            end
+        end
+    end
+end
@@ -0,0 +1,99 @@
+require "json"
+
+##
+# Library for processing the coverage files generated by the simulators
+# with the --coverage option.
+#
+# A coverage file is a JSON object giving the number of runs, the total
+# simulated time, and:
+#  - for each signal its full name, width, number of value changes and
+#    the numbers of rising and falling toggles of each bit (lsb first).
+#  - for each behavior or code its full name and number of activations.
+########################################################################
+module HDLRuby
+    module Coverage
+
+        ## Loads the coverage file +filename+.
+        def self.load(filename)
+            report = JSON.parse(File.read(filename))
+            unless report["format"] == "hdlruby-coverage" then
+                raise "Not a coverage file: #{filename}."
+            end
+            return report
+        end
+
+        ## Saves the coverage +report+ to file +filename+.
+        def self.save(report, filename)
+            File.open(filename,"w") do |file|
+                file << "{\"format\":\"hdlruby-coverage\",\"version\":1,"
+                file << "\"runs\":#{report["runs"]},\"time\":#{report["time"]},"
+                file << "\n\"signals\":["
+                file << report["signals"].map { |s| "\n  " + JSON.generate(s) }.join(",")
+                file << "],\n\"behaviors\":["
+                file << report["behaviors"].map { |b| "\n  " + JSON.generate(b) }.join(",")
+                file << "]}\n"
+            end
+        end
+
+        ## Merges the coverage +reports+ of several runs into a new one.
+        #  The counts of the signals and behaviors with the same names are
+        #  added.
+        def self.merge(reports)
+            signals = {}
+            behaviors = {}
+            reports.each do |report|
+                report["signals"].each do |sig|
+                    prev = signals[sig["name"]]
+                    unless prev then
+                        signals[sig["name"]] = sig.dup
+                        next
+                    end
+                    if prev["width"] != sig["width"] then
+                        raise "Width mismatch for signal #{sig["name"]}."
+                    end
+                    prev["changes"] += sig["changes"]
+                    prev["rises"] = prev["rises"].zip(sig["rises"]).map(&:sum)
+                    prev["falls"] = prev["falls"].zip(sig["falls"]).map(&:sum)
+                end
+                report["behaviors"].each do |beh|
+                    prev = behaviors[beh["name"]]
+                    if prev then
+                        prev["activations"] += beh["activations"]
+                    else
+                        behaviors[beh["name"]] = beh.dup
+                    end
+                end
+            end
+            return { "format" => "hdlruby-coverage", "version" => 1,
+                     "runs" => reports.sum { |report| report["runs"] },
+                     "time" => reports.sum { |report| report["time"] },
+                     "signals" => signals.values,
+                     "behaviors" => behaviors.values }
+        end
+
+        ## Tells if bit +i+ of signal coverage +sig+ toggled both ways.
+        def self.toggled?(sig, i)
+            return sig["rises"][i] > 0 && sig["falls"][i] > 0
+        end
+
+        ## Computes the toggle coverage of +report+ as the numbers of bits
+        #  that toggled both ways and of bits.
+        def self.toggle_coverage(report)
+            covered = total = 0
+            report["signals"].each do |sig|
+                total += sig["width"]
+                covered += sig["width"].times.count { |i| toggled?(sig,i) }
+            end
+            return covered, total
+        end
+
+        ## Computes the activity of each signal of +report+ as its number
+        #  of bit toggles per ns.
+        def self.activities(report)
+            time = report["time"] > 0 ? report["time"] / 1000.0 : 1.0
+            return report["signals"].map do |sig|
+                [sig["name"], (sig["rises"].sum + sig["falls"].sum) / time]
+            end
+        end
+    end
+end
@@ -0,0 +1,165 @@
+require 'digest'
+require 'etc'
+require 'fileutils'
+
+module HDLRuby::Low
+
+
+##
+# Incremental compilation of the standalone C simulator of HDLRuby
+#
+########################################################################
+
+    ##
+    # Compiles the standalone C simulator: the simulator core is built once
+    # into a static library, and the C files generated for the design (one
+    # per systemT) are compiled in parallel into object files that are
+    # kept in a cache, so that only the files whose content changed are
+    # compiled again.
+    # The library and the object files are identified by the hash of their
+    # sources, of the headers they can include and of the compiler options.
+    # NOTE: the object files are evicted from the least recently used one
+    # when the total size of the cache exceeds its limit.
+    class CSimBuilder
+
+        ## Creates a new builder with compiler +cc+ for the simulator core
+        #  whose sources are in +simdir+, keeping the compiled files in
+        #  +cachedir+ whose total size is limited to +max_size+ bytes.
+        #  +cflags+ and +libs+ are the compile options and the libraries
+        #  to link with, +opt+ the optimization level of both the core and
+        #  the design, and +jobs+ the number of parallel compilations.
+        def initialize(cc, simdir, cachedir, cflags: [], libs: [],
+                       opt: "-O3", jobs: nil, max_size: 256*1024*1024)
+            @cc = cc
+            @simdir = File.expand_path(simdir)
+            @cachedir = File.expand_path(cachedir)
+            @cflags = [opt, *cflags]
+            @libs = libs
+            @jobs = jobs || Etc.nprocessors
+            @max_size = max_size.to_i
+            @ar = ENV["AR"] || "ar"
+            FileUtils.mkdir_p(File.join(@cachedir,"obj"))
+        end
+
+        ## The names of the C files of the simulator core.
+        def core_sources
+            sources = Dir.glob("*.c", base: @simdir).sort
+            if sources.empty? then
+                raise "Could not find the sources of the simulator core in #{@simdir}."
+            end
+            return sources
+        end
+
+        ## Builds the library of the simulator core if not already built.
+        #  Returns its path.
+        def build_core
+            hash = self.digest(*core_sources.map { |f| File.join(@simdir,f) },
+                               *Dir.glob(File.join(@simdir,"*.h")).sort)
+            lib = File.join(@cachedir,"core-#{hash}","libhruby_sim.a")
+            return lib if File.file?(lib)
+            HDLRuby.show "Building the simulator core library..."
+            dir = File.dirname(lib)
+            FileUtils.mkdir_p(dir)
+            objs = core_sources.map do |f|
+                [ File.join(@simdir,f), File.join(dir,f.sub(/\.c$/,".o")) ]
+            end
+            self.compile_all(objs)
+            # Create the library under another name first so that the
+            # concurrent builds never see a partial one.
+            tmp = lib + ".#{Process.pid}.tmp"
+            unless Kernel.system(@ar,"rcs",tmp,*objs.map { |_,o| o }) then
+                raise "Could not create the simulator core library #{lib}."
+            end
+            File.rename(tmp,lib)
+            return lib
+        end
+
+        ## Compiles the C files +sources+ of the design whose generated
+        #  headers are +headers+, reusing the object files of the
+        #  unchanged ones.
+        #  Returns the paths of the object files.
+        def build_design(sources, headers = [])
+            hdrs = headers.sort + Dir.glob(File.join(@simdir,"*.h")).sort
+            objs = sources.map do |src|
+                [ src, File.join(@cachedir,"obj",
+                                 self.digest(src,*hdrs) + ".o") ]
+            end
+            todo = objs.reject { |_,obj| File.file?(obj) }
+            # Update the access time of the reused ones for the eviction.
+            FileUtils.touch((objs - todo).map { |_,obj| obj })
+            HDLRuby.show "Compiling #{todo.size} of #{objs.size} C files " +
+                         "of the design..."
+            self.compile_all(todo)
+            return objs.map { |_,obj| obj }
+        end
+
+        ## Links the object files +objs+ with the simulator core library
+        #  +lib+ into executable +target+.
+        def link(objs, lib, target)
+            unless Kernel.system(@cc,*@cflags,"-o",target,*objs,lib,*@libs) then
+                raise "Could not link the simulator #{target}."
+            end
+            self.evict
+        end
+
+        ## Compiles the list of [source, object] +objs+ with up to
+        #  @jobs parallel compilations.
+        def compile_all(objs)
+            queue = Queue.new
+            objs.each { |obj| queue << obj }
+            failed = []
+            [@jobs,objs.size].min.times.map do
+                Thread.new do
+                    while (job = queue.pop(true) rescue nil) do
+                        src, obj = job
+                        failed << src unless self.compile(src,obj)
+                    end
+                end
+            end.each(&:join)
+            unless failed.empty? then
+                raise "Could not compile #{failed.join(", ")}."
+            end
+        end
+
+        ## Compiles +src+ into +obj+.
+        #  Returns true on success.
+        def compile(src, obj)
+            tmp = obj + ".#{Process.pid}.tmp"
+            unless Kernel.system(@cc,*@cflags,"-I",@simdir,
+                                 "-c",src,"-o",tmp) then
+                return false
+            end
+            File.rename(tmp,obj)
+            return true
+        end
+
+        ## Computes the hash identifying the compilation of +files+.
+        def digest(*files)
+            digest = Digest::SHA256.new
+            digest << [@cc, @cflags, HDLRuby::VERSION].inspect
+            files.each { |file| digest << File.binread(file) }
+            return digest.hexdigest
+        end
+
+        ## Removes all the compiled files of the cache.
+        def invalidate
+            FileUtils.rm_rf(Dir.glob(File.join(@cachedir,"{core-*,obj/*.o}")))
+        end
+
+        ## Removes the least recently used object files of the design until
+        #  the total size of the cache is within its limit.
+        def evict
+            entries = Dir.glob(File.join(@cachedir,"obj","*.o")).map do |path|
+                [path, File.size(path), File.mtime(path)]
+            end
+            size = entries.sum { |_,sz,_| sz }
+            entries.sort_by! { |_,_,time| time }
+            entries.each do |path,sz,_|
+                break if size <= @max_size
+                File.delete(path)
+                size -= sz
+            end
+        end
+    end
+
+end
@@ -0,0 +1,205 @@
+require "zlib"
+
+##
+# Library for reading the HDLRuby binary waveform (HBW) files generated
+# by the simulator and converting them to VCD.
+#
+# See ext/hruby_sim/hruby_sim_hbw.c for the description of the format.
+########################################################################
+module HDLRuby
+    module HBW
+
+        ## Describes a signal declared in a HBW file.
+        Signal = Struct.new(:id, :width, :path)
+
+        ## Reads a HBW file.
+        class Reader
+
+            # The declared signals indexed by id.
+            attr_reader :signals
+
+            ## Creates a new reader from +io+.
+            def initialize(io)
+                @io = io
+                @io.binmode
+                unless @io.read(4) == "HBW1" then
+                    raise "Not a HBW file."
+                end
+                @signals = {}
+                loop do
+                    case @io.getbyte
+                    when "V".ord then
+                        id = read_varint
+                        width = read_varint
+                        path = (read_varint+1).times.map { read_string }
+                        @signals[id] = Signal.new(id, width, path)
+                    when "E".ord then
+                        break
+                    else
+                        raise "Invalid HBW declaration."
+                    end
+                end
+            end
+
+            ## Iterates over the blocks of changes, each one being given as
+            #  an array of [time, id, value] sorted by time, where the value
+            #  is a string of bits msb first.
+            def each_block
+                return to_enum(:each_block) unless block_given?
+                start = 0
+                while @io.getbyte == "B".ord do
+                    start += read_varint
+                    read_varint # The duration.
+                    encoding = read_varint
+                    raw_size = read_varint
+                    payload = decode_payload(encoding,
+                                             @io.read(read_varint), raw_size)
+                    yield(decode_changes(payload, start))
+                end
+            end
+
+            private
+
+            ## Reads a varint from the file.
+            def read_varint
+                num = 0
+                shift = 0
+                loop do
+                    byte = @io.getbyte
+                    raise "Truncated HBW file." unless byte
+                    num |= (byte & 0x7F) << shift
+                    return num if byte < 0x80
+                    shift += 7
+                end
+            end
+
+            ## Reads a string from the file.
+            def read_string
+                return @io.read(read_varint).force_encoding("UTF-8")
+            end
+
+            ## Decodes a block +payload+ encoded with +encoding+.
+            def decode_payload(encoding, payload, raw_size)
+                case encoding
+                when 0 then
+                    return payload
+                when 1 then
+                    payload = Zlib::Inflate.inflate(payload)
+                    unless payload.bytesize == raw_size then
+                        raise "Corrupted HBW block."
+                    end
+                    return payload
+                else
+                    raise "Unknown HBW block encoding: #{encoding}."
+                end
+            end
+
+            ## Decodes the changes of a +payload+ of a block starting at
+            #  time +start+.
+            def decode_changes(payload, start)
+                pos = 0
+                # Varint decoder within the payload.
+                varint = proc do
+                    num = 0
+                    shift = 0
+                    loop do
+                        byte = payload.getbyte(pos)
+                        pos += 1
+                        num |= (byte & 0x7F) << shift
+                        break if byte < 0x80
+                        shift += 7
+                    end
+                    num
+                end
+                changes = []
+                varint.().times do
+                    id = varint.()
+                    num = varint.()
+                    varint.() # The size of the changes.
+                    width = @signals[id] ? @signals[id].width : 1
+                    time = start
+                    num.times do
+                        delta = varint.()
+                        time += delta >> 1
+                        if delta & 1 == 1 then
+                            # Four-state value.
+                            value = payload[pos,width].reverse
+                            pos += width
+                        else
+                            # Two-state value.
+                            size = (width+7)/8
+                            value = payload[pos,size].unpack1("b*")[0,width]
+                            value = value.reverse
+                            pos += size
+                        end
+                        changes << [time, id, value]
+                    end
+                end
+                # Sort by time keeping the order of the signals.
+                return changes.each_with_index.sort_by do |(time,_,_),i|
+                    [time,i]
+                end.map(&:first)
+            end
+        end
+
+
+        ## Converts a HDLRuby name to a VCD name.
+        def self.vcd_name(name)
+            return name.gsub(":","$")
+        end
+
+        ## Converts a signal id to a VCD identifier.
+        def self.vcd_id(id)
+            str = ""
+            loop do
+                str << ((id % 94) + 33).chr
+                id /= 94
+                break if id == 0
+            end
+            return str
+        end
+
+        ## Converts the HBW file read from +input+ to VCD written to
+        #  +output+.
+        def self.to_vcd(input, output)
+            reader = Reader.new(input)
+            # The header.
+            output << "$date\n   #{Time.now.strftime("%d %m %Y %H:%M")}\n$end\n"
+            output << "$version\n   Generated from HDLRuby simulator\n$end\n"
+            output << "$timescale 1ps $end\n"
+            # The hierarchy: rebuild it from the paths of the signals.
+            tree = {}
+            reader.signals.each_value do |sig|
+                node = sig.path[0..-2].reduce(tree) { |n,name| n[name] ||= {} }
+                (node[:vars] ||= []) << sig
+            end
+            declare = proc do |node|
+                (node[:vars] || []).each do |sig|
+                    output << "$var wire #{sig.width} #{vcd_id(sig.id)} " +
+                              "#{vcd_name(sig.path[-1])} $end\n"
+                end
+                node.each do |name,sub|
+                    next if name == :vars
+                    output << "$scope module #{vcd_name(name)} $end\n"
+                    declare.(sub)
+                    output << "$upscope $end\n"
+                end
+            end
+            declare.(tree)
+            output << "$enddefinitions $end\n"
+            # The changes.
+            cur = nil
+            reader.each_block do |changes|
+                changes.each do |time, id, value|
+                    output << "##{time}\n" if time != cur
+                    cur = time
+                    if value.size > 1 then
+                        output << "b#{value} #{vcd_id(id)}\n"
+                    else
+                        output << "#{value}#{vcd_id(id)}\n"
+                    end
+                end
+            end
+        end
+    end
+end
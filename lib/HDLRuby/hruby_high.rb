@@ -1655,8 +1655,11 @@ module HDLRuby::High
             self.each_systemI do |systemI|
                 # puts "Filling with systemI=#{systemI.name}"
                 systemI_low = scopeL.add_systemI(systemI.to_low)
-                # Also add the eigen system to the list of local systems.
-                scopeL.add_systemT(systemI_low.systemT)
+                # Also add the eigen system to the list of local systems,
+                # unless already added for an identical instance.
+                unless systemI_low.systemT.parent then
+                    scopeL.add_systemT(systemI_low.systemT)
+                end
             end
             # Grouped ones.
             self.each_groupI do |name,systemIs|
@@ -1667,8 +1670,11 @@ module HDLRuby::High
                     systemI.name = name.to_s + "[#{i}]"
                     # And convert it to low
                     systemI_low = scopeL.add_systemI(systemI.to_low())
-                    # Also add the eigen system to the list of local systems.
-                    scopeL.add_systemT(systemI_low.systemT)
+                    # Also add the eigen system to the list of local systems,
+                    # unless already added for an identical instance.
+                    unless systemI_low.systemT.parent then
+                        scopeL.add_systemT(systemI_low.systemT)
+                    end
                 }
             end
             # Adds the programs.
@@ -2647,6 +2653,11 @@ module HDLRuby::High
             # puts "to_low with #{self} (#{self.name}) #{self.systemT}"
             # Converts the system of the instance to HDLRuby::Low
             systemTL = self.systemT.to_low
+            # Share it with the identical instances if required, unless
+            # the instance can be reconfigured.
+            if self.each_systemT.count == 1 then
+                systemTL = High.share_systemT(systemTL)
+            end
             # Creates the resulting HDLRuby::Low instance
             systemIL = HDLRuby::Low::SystemI.new(High.names_create(name),
                                              systemTL)
@@ -2982,6 +2993,21 @@ module HDLRuby::High
             # self.properties[:high2low] = delayL
             return delayL
         end
+
+        # Gives the delay in ps like the C simulator does.
+        def to_rcps
+            delay = self.value.to_i
+            case self.unit.to_s[0]
+            when "f" then return delay / 1000
+            when "p" then return delay
+            when "n" then return delay * 1000
+            when "u" then return delay * 1000000
+            when "m" then return delay * 1000000000
+            when "s" then return delay * 1000000000000
+            else
+                raise AnyError, "Invalid delay unit: #{self.unit}"
+            end
+        end
     end
 
     ##
@@ -3030,6 +3056,17 @@ module HDLRuby::High
         end
     end
 
+    ## 
+    # Describes a timed dump switch statement: not synthesizable!
+    class TimeDump < Low::TimeDump
+        include HStatement
+
+        # Converts the dump switch statement to HDLRuby::Low.
+        def to_low
+            return HDLRuby::Low::TimeDump.new(self.on)
+        end
+    end
+
 
 
     ##
@@ -4304,6 +4341,18 @@ module HDLRuby::High
             end
         end
 
+        # Sets the hexadecimal text memory image file +filename+ to load
+        # into the signal at simulation start.
+        def readmemh(filename)
+            self.load_image(filename,:h)
+        end
+
+        # Sets the binary text memory image file +filename+ to load into
+        # the signal at simulation start.
+        def readmemb(filename)
+            self.load_image(filename,:b)
+        end
+
         # Converts to a new reference.
         def to_ref
             return RefObject.new(this,self)
@@ -4331,6 +4380,7 @@ module HDLRuby::High
             # return HDLRuby::Low::SignalI.new(name,self.type.to_low)
             valueL = self.value ? self.value.to_low : nil
             signalIL = HDLRuby::Low::SignalI.new(name,self.type.to_low,valueL)
+            signalIL.load_image(*self.memory_image) if self.memory_image
             @low_object = signalIL
             # Recurse on the sub signals if any.
             self.each_signal do |sig|
@@ -4637,6 +4687,16 @@ module HDLRuby::High
         def terminate
             self.add_statement(TimeTerminate.new)
         end
+
+        # Switches on the waveform dump of the simulation.
+        def dumpon
+            self.add_statement(TimeDump.new(true))
+        end
+
+        # Switches off the waveform dump of the simulation.
+        def dumpoff
+            self.add_statement(TimeDump.new(false))
+        end
     end
 
 
@@ -5695,6 +5755,33 @@ module HDLRuby::High
     end
 
 
+    # Methods for sharing the system types of identical instances
+
+    # The low system types shared among the instances by structure key,
+    # nil if not sharing.
+    @shared_systemTs = nil
+
+    # Enables or disables the sharing of the low system types among the
+    # structurally identical instances.
+    #
+    # NOTE: the C simulator requires each instance to have its own system
+    # type: the shared ones are copied after the transformation passes
+    # (see HDLRuby::Low::SystemT#unshare!).
+    def self.share_systemTs=(enable)
+        require 'HDLRuby/hruby_low_share' if enable
+        @shared_systemTs = enable ? {} : nil
+    end
+
+    # Gets the low system type to use in place of +systemTL+: when sharing,
+    # the first one converted with the same structure.
+    def self.share_systemT(systemTL)
+        return systemTL unless @shared_systemTs
+        key = systemTL.structure_key
+        return systemTL unless key
+        return @shared_systemTs[key] ||= systemTL
+    end
+
+
 
 
     # Standard vector types.
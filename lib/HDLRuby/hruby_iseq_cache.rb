@@ -0,0 +1,90 @@
+require 'fileutils'
+
+module HDLRuby
+
+
+##
+# Cache of the compiled Ruby files of HDLRuby
+#
+########################################################################
+
+    ##
+    # Keeps the instruction sequences of the Ruby files of HDLRuby once
+    # compiled, so that the next runs load them directly instead of parsing
+    # and compiling these files again.
+    # An entry is valid as long as its file keeps the same size and
+    # modification time, and the Ruby interpreter the same version.
+    # NOTE: only the files of the library of HDLRuby are cached, not the
+    # ones of the designs.
+    module ISeqCache
+
+        ## The directory of the library of HDLRuby.
+        ROOT = File.expand_path("..",__dir__) + "/"
+
+        ## The directory of the cache, nil if disabled.
+        @dir = nil
+
+        ## The default directory of the cache.
+        def self.default_dir
+            base = ENV["XDG_CACHE_HOME"] || File.join(Dir.home,".cache")
+            return File.join(base,"hdlruby","iseq")
+        rescue ArgumentError
+            # No home directory, no cache.
+            return nil
+        end
+
+        ## Enables the cache in directory +dir+, or disables it if +dir+ is
+        #  nil or empty.
+        def self.enable(dir = ISeqCache.default_dir)
+            @dir = (dir && !dir.empty?) ? File.expand_path(dir) : nil
+        end
+
+        ## The directory of the cache, nil if disabled.
+        def self.dir
+            return @dir
+        end
+
+        ## Gets the instruction sequence of Ruby file +path+ from the cache,
+        #  compiling and storing it if missing or outdated.
+        #  Returns nil if +path+ is not to cache or in case of error, so that
+        #  Ruby loads it the usual way.
+        def self.load(path)
+            return nil unless @dir && path.start_with?(ROOT)
+            stat = File.stat(path)
+            key = "#{RUBY_DESCRIPTION}|#{stat.mtime.to_r}|#{stat.size}\n"
+            entry = File.join(@dir,path.tr("/\\:","%%%") + ".bin")
+            if File.file?(entry) then
+                data = File.binread(entry)
+                if data.start_with?(key) then
+                    return RubyVM::InstructionSequence.load_from_binary(
+                        data.byteslice(key.bytesize..-1))
+                end
+            end
+            iseq = RubyVM::InstructionSequence.compile_file(path)
+            # Write to a temporary file first so that the concurrent
+            # runs never see a partial entry.
+            FileUtils.mkdir_p(@dir)
+            tmp = entry + ".#{Process.pid}.tmp"
+            File.binwrite(tmp,key + iseq.to_binary)
+            File.rename(tmp,entry)
+            return iseq
+        rescue SyntaxError, StandardError
+            # Let Ruby load the file (and report its errors if any).
+            return nil
+        end
+    end
+
+end
+
+
+# Hook the loading of the Ruby files, unless not supported by the
+# interpreter or already hooked (e.g., by bootsnap).
+if defined?(RubyVM::InstructionSequence) &&
+   !RubyVM::InstructionSequence.respond_to?(:load_iseq) then
+    class << RubyVM::InstructionSequence
+        ## Called by Ruby for loading the file at +path+.
+        def load_iseq(path)
+            return HDLRuby::ISeqCache.load(path)
+        end
+    end
+end
@@ -492,9 +492,15 @@ module HDLRuby::Low
         # Iterates over the systemT deeply if any.
         #
         # Returns an enumerator if no ruby block is given.
-        def each_systemT_deep(&ruby_block)
+        #
+        # NOTE: a systemT shared by several instances is iterated only
+        # once, +visited+ containing the ones already iterated.
+        def each_systemT_deep(visited = {}.compare_by_identity, &ruby_block)
             # No ruby block? Return an enumerator.
             return to_enum(:each_systemT_deep) unless ruby_block
+            # Already iterated?
+            return if visited.key?(self)
+            visited[self] = true
             # A ruby block? First apply it to current.
             ruby_block.call(self)
             # And recurse on the systemT accessible through the instances.
@@ -502,7 +508,7 @@ module HDLRuby::Low
                 scope.each_systemI do |systemI|
                     # systemI.systemT.each_systemT_deep(&ruby_block)
                     systemI.each_systemT do |systemT|
-                        systemT.each_systemT_deep(&ruby_block)
+                        systemT.each_systemT_deep(visited,&ruby_block)
                     end
                 end
             end
@@ -512,16 +518,23 @@ module HDLRuby::Low
         # to ensure the refered elements are processed first.
         #
         # Returns an enumerator if no ruby block is given.
-        def each_systemT_deep_ref(&ruby_block)
+        #
+        # NOTE: a systemT shared by several instances is iterated only
+        # once, +visited+ containing the ones already iterated.
+        def each_systemT_deep_ref(visited = {}.compare_by_identity,
+                                  &ruby_block)
             # No ruby block? Return an enumerator.
             return to_enum(:each_systemT_deep_ref) unless ruby_block
+            # Already iterated?
+            return if visited.key?(self)
+            visited[self] = true
             # A ruby block? 
             # Recurse on the systemT accessible through the instances.
             self.scope.each_scope_deep do |scope|
                 scope.each_systemI do |systemI|
                     # systemI.systemT.each_systemT_deep(&ruby_block)
                     systemI.each_systemT do |systemT|
-                        systemT.each_systemT_deep_ref(&ruby_block)
+                        systemT.each_systemT_deep_ref(visited,&ruby_block)
                     end
                 end
             end
@@ -2679,6 +2692,10 @@ module HDLRuby::Low
         # The initial value of the signal if any.
         attr_reader :value
 
+        # The memory image file loaded into the signal at simulation start
+        # if any, given as a [filename, format] pair.
+        attr_reader :memory_image
+
         # Creates a new signal named +name+ typed as +type+.
         # If +val+ is provided, it will be the initial value of the
         # signal.
@@ -2710,6 +2727,18 @@ module HDLRuby::Low
             false
         end
 
+        # Sets the memory image file +filename+ to load into the signal at
+        # simulation start, with +format+ among :h (hexadecimal text like
+        # $readmemh), :b (binary text like $readmemb) and :raw (binary
+        # words in little-endian byte order).
+        # NOTE: the elements of the signal are filled from index 0.
+        def load_image(filename, format = :h)
+            unless [:h, :b, :raw].include?(format) then
+                raise AnyError, "Invalid memory image format: #{format}."
+            end
+            @memory_image = [ filename.to_s, format ]
+        end
+
         # Adds sub signal +sig+
         def add_signal(sig)
             # puts "add sub=#{sig.name} in signal=#{self}"
@@ -2781,7 +2810,9 @@ module HDLRuby::Low
 
         # Clones (deeply)
         def clone
-            return SignalI.new(self.name,self.type)
+            res = SignalI.new(self.name,self.type)
+            res.load_image(*self.memory_image) if self.memory_image
+            return res
         end
     end
 
@@ -4596,6 +4627,85 @@ module HDLRuby::Low
     end
 
 
+    ## 
+    # Describes a timed dump switch statement: not synthesizable!
+    class TimeDump < Statement
+
+        # Tells if the dump is switched on (true) or off (false).
+        attr_reader :on
+
+        # Creates a new timed dump switch statement that switches the
+        # waveform dump +on+ or off.
+        def initialize(on)
+            super()
+            @on = on ? true : false
+        end
+
+        # Iterates over each object deeply.
+        #
+        # Returns an enumerator if no ruby block is given.
+        def each_deep(&ruby_block)
+            # No ruby block? Return an enumerator.
+            return to_enum(:each_deep) unless ruby_block
+            # A ruby block? First apply it to current.
+            ruby_block.call(self)
+            # And that's all.
+        end
+
+        # Iterates over all the nodes.
+        def each_node(&ruby_block)
+            # No ruby block? Return an enumerator.
+            return to_enum(:each_node) unless ruby_block
+            # A ruby block?
+            # Nothing to do anyway.
+        end
+
+        # Iterates over all the nodes deeply.
+        def each_node_deep(&ruby_block)
+            # No ruby block? Return an enumerator.
+            return to_enum(:each_node_deep) unless ruby_block
+            # A ruby block?
+            # Apply of current node.
+            ruby_block.call(self)
+            # And that's all.
+        end
+
+        # Iterates over all the statements deeply.
+        def each_statement_deep(&ruby_block)
+            # No ruby block? Return an enumerator.
+            return to_enum(:each_statement_deep) unless ruby_block
+            # A ruby block?
+            # Apply of current node.
+            ruby_block.call(self)
+            # And that's all.
+        end
+
+        # Iterates over all the blocks contained in the current block.
+        def each_block_deep(&ruby_block)
+            # No ruby block? Return an enumerator.
+            return to_enum(:each_block_deep) unless ruby_block
+            # A ruby block?
+            # Nothing to do anyway.
+        end
+
+        # Comparison for hash: structural comparison.
+        def eql?(obj)
+            return false unless obj.is_a?(TimeDump)
+            return @on == obj.on
+        end
+
+        # Hash function.
+        def hash
+            return [TimeDump,@on].hash
+        end
+
+        # Clones the TimeDump (deeply)
+        def clone
+            return TimeDump.new(@on)
+        end
+    end
+
+
 
 
     ## 
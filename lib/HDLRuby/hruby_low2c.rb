@@ -81,6 +81,8 @@ module HDLRuby::Low
         # end
 
         @@hdrobj2c = {}
+        @@name_space = ""               # The prefix of the new names.
+        @@name_counts = Hash.new(0)     # The number of names by prefix.
 
         ## Generates a uniq name for an object.
         def self.obj_name(obj)
@@ -89,12 +91,27 @@ module HDLRuby::Low
             unless oname then
                 # name = obj.respond_to?(:name) ? "_#{self.c_name(obj.name)}" : ""
                 # oname = "_c#{@@hdrobj2c.size}#{name}"
-                oname = "_" << @@hdrobj2c.size.to_s(36)
+                count = @@name_counts[@@name_space]
+                @@name_counts[@@name_space] = count + 1
+                oname = "_" << @@name_space << count.to_s(36)
                 @@hdrobj2c[id] = oname
             end
             return oname
         end
 
+        ## Generates the new names while executing +ruby_block+ with
+        #  +prefix+, so that they do not depend on the names generated
+        #  outside of it.
+        #  NOTE: used for generating the C files of the systemTs
+        #  independently, e.g., in parallel.
+        def self.with_name_space(prefix)
+            prev = @@name_space
+            @@name_space = prefix.to_s
+            return yield
+        ensure
+            @@name_space = prev
+        end
+
         ## Generates the name of a makeer for an object.
         def self.make_name(obj)
             return "make#{Low2C.obj_name(obj)}"
@@ -129,7 +146,31 @@ module HDLRuby::Low
 
         ## Generates the main for making the objects of +objs+ and
         #  for starting the simulation and including the files from +hnames+
-        def self.main(name,init_visualizer,top,objs,hnames)
+        #  The dump can be restricted to the signals matching +include+
+        #  patterns and not matching +exclude+ ones, and to a time +window+.
+        #  The output files are compressed with gzip if +compression+ gives
+        #  a level and a number of threads.
+        #  The value changes of the +replay+ VCD files are replayed on the
+        #  signals matching the +replay_signals+ patterns (by default the
+        #  input ports).
+        #  The signals matching the +golden_signals+ patterns (by default
+        #  all) are checked against the +golden+ VCD files.
+        #  The coverage is saved to the +coverage+ file if any.
+        #  The simulation is profiled if +profile+ is given as the name of
+        #  the folded stacks file and the sampling period.
+        #  The runtime metrics are written to +metrics+ if given as the
+        #  destination and the period in seconds.
+        #  The checkpoints are enabled if +checkpoint+ is given as the
+        #  directory of their sockets and the times when to take them.
+        #  The state of the signals is saved as given by +snapshot+ (the
+        #  file and the time, nil for the end) and restored from the
+        #  +restore+ file if any.
+        def self.main(name,init_visualizer,top,objs,hnames,
+                      include: nil, exclude: nil, window: nil,
+                      compression: nil, replay: nil, replay_signals: nil,
+                      golden: nil, golden_signals: nil, coverage: nil,
+                      profile: nil, metrics: nil, checkpoint: nil,
+                      snapshot: nil, restore: nil)
             res = Low2C.includes(*hnames)
             res << "int main(int argc, char* argv[]) {\n"
             # Build the objects.
@@ -138,6 +179,63 @@ module HDLRuby::Low
             res << "   top_system = " << Low2C.obj_name(top) << ";\n"
             # Enable it.
             res << "   set_enable_system(top_system,1);\n"
+            # Configure the dump.
+            (include || []).each do |pattern|
+                res << "   dump_include(#{pattern.inspect});\n"
+            end
+            (exclude || []).each do |pattern|
+                res << "   dump_exclude(#{pattern.inspect});\n"
+            end
+            if window then
+                res << "   dump_window(#{window[0]}ULL," +
+                       "#{window[1] ? "#{window[1]}ULL" : "~0ULL"});\n"
+            end
+            # Configure the compression of the output.
+            if compression then
+                res << "   output_compression(#{compression[0]}," +
+                       "#{compression[1]});\n"
+            end
+            # Configure the stimulus replay.
+            (replay || []).each do |filename|
+                res << "   replay_file(#{filename.inspect});\n"
+            end
+            (replay_signals || []).each do |pattern|
+                res << "   replay_include(#{pattern.inspect});\n"
+            end
+            # Configure the check against golden traces.
+            (golden || []).each do |filename|
+                res << "   golden_file(#{filename.inspect});\n"
+            end
+            (golden_signals || []).each do |pattern|
+                res << "   golden_include(#{pattern.inspect});\n"
+            end
+            # Configure the coverage collection.
+            if coverage then
+                res << "   coverage_file(#{coverage.inspect});\n"
+            end
+            # Configure the runtime metrics.
+            if metrics then
+                res << "   metrics_output(#{metrics[0].inspect},#{metrics[1].to_f});\n"
+            end
+            # Configure the snapshots.
+            if snapshot then
+                res << "   snapshot_output(#{snapshot[0].inspect}," +
+                       "#{snapshot[1] ? "#{snapshot[1]}ULL" : "~0ULL"});\n"
+            end
+            if restore then
+                res << "   snapshot_input(#{restore.inspect});\n"
+            end
+            # Configure the checkpoints.
+            if checkpoint then
+                res << "   checkpoint_dir(#{checkpoint[0].inspect});\n"
+                checkpoint[1].each do |time|
+                    res << "   checkpoint_at(#{time}ULL);\n"
+                end
+            end
+            # Configure the profiling.
+            if profile then
+                res << "   profile_enable(#{File.expand_path(profile[0]).inspect},#{profile[1].to_i});\n"
+            end
             # Starts the simulation.
             res<< "   hruby_sim_core(\"#{name}\",#{init_visualizer},-1);\n"
             # Close the main.
@@ -711,6 +809,12 @@ module HDLRuby::Low
             # Set the behavior as inactive. */
             res << " " * (level+1)*3
             res << "behavior->activated = 0;\n"
+            res << " " * (level+1)*3
+            res << "behavior->activations = 0;\n"
+            res << " " * (level+1)*3
+            res << "behavior->profile_time = 0;\n"
+            res << " " * (level+1)*3
+            res << "behavior->profile_samples = 0;\n"
 
             # Tells if the behavior is timed or not.
             res << " " * (level+1)*3
@@ -877,9 +981,6 @@ module HDLRuby::Low
     class SignalI
         ## Extends the SignalI class with generation of C text.
 
-        # The id of a signal in the simulator.
-        @@signal_id = 0
-
         ## Generates the C text for an access to the signal.
         #  +level+ is the hierachical level of the object.
         # def to_c_signal(level = 0)
@@ -927,8 +1028,11 @@ module HDLRuby::Low
             res << "SignalI signalI = malloc(sizeof(SignalIS));\n"
             res << " " * (level+1)*3
             res << "signalI->kind = SIGNALI;\n";
-            res << "signalI->id = #{@@signal_id};\n"
-            @@signal_id = @@signal_id+1;
+            res << "signalI->id = make_signal_id();\n"
+            res << " " * (level+1)*3
+            res << "signalI->dump = 1;\n"
+            res << " " * (level+1)*3
+            res << "signalI->check = 0;\n"
 
             # Sets the global variable of the signal.
             res << "\n"
@@ -989,6 +1093,16 @@ module HDLRuby::Low
                 self.value.to_c_expr(res,level+2)
                 res << ",signalI->f_value);\n"
             end
+            if self.memory_image then
+                # There is a memory image to load, the path being expanded
+                # since the simulator runs in the output directory.
+                file, format = self.memory_image
+                res << " " * (level+1)*3
+                res << "load_memory_image(signalI,"
+                res << "\"#{Low2C.c_string(File.expand_path(file))}\","
+                res << { h: "MEM_HEX", b: "MEM_BIN", raw: "MEM_RAW" }[format]
+                res << ");\n"
+            end
 
             # Initially the signal can be overwritten by anything.
             res << " " * (level+1)*3
@@ -1249,6 +1363,12 @@ module HDLRuby::Low
             # Set the code as inactive. */
             res << " " * (level+1)*3
             res << "code->activated = 0;\n"
+            res << " " * (level+1)*3
+            res << "code->activations = 0;\n"
+            res << " " * (level+1)*3
+            res << "code->profile_time = 0;\n"
+            res << " " * (level+1)*3
+            res << "code->profile_samples = 0;\n"
 
             # Add the events and register the code as activable
             # on them.
@@ -1550,6 +1670,16 @@ module HDLRuby::Low
         end
     end
 
+    class TimeDump
+        ## Extends the TimeDump class with generation of C text.
+
+        # Generates the C text of the equivalent HDLRuby code.
+        # +level+ is the hierachical level of the object.
+        def to_c(res,level = 0)
+            res << (" " * (level*3)) << "dump_switch(#{self.on ? 1 : 0});\n"
+        end
+    end
+
 
     class Configure
         ## Extends the Configure class with generation of C text.
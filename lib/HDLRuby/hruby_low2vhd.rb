@@ -539,6 +539,11 @@ module HDLRuby::Low
                     end
                 end
                 res << ";\n"
+                if inner.memory_image then
+                    warn("**Warning**: memory image #{inner.memory_image[0]} " +
+                         "of #{inner.name} is not supported in VHDL, it is " +
+                         "ignored.")
+                end
             end
 
             # Generate the architecture's content.
@@ -950,6 +955,18 @@ module HDLRuby::Low
             return " " * (level*3) + "finish;\n"
         end
     end
+
+    class TimeDump
+        ## Extends the TimeDump class with generation of HDLRuby::High text.
+
+        # Generates the text of the equivalent HDLRuby::High code.
+        # +vars+ is the list of the variables and
+        # +level+ is the hierachical level of the object.
+        # NOTE: VHDL has no dump control, keep it as a comment.
+        def to_vhdl(vars,level = 0)
+            return " " * (level*3) + "-- #{self.on ? "dumpon" : "dumpoff"}\n"
+        end
+    end
   
 
     class If
@@ -87,6 +87,17 @@ module HDLRuby::Low
         end
     end
 
+    class TimeDump
+        ## Extends the TimeDump class with functionality for converting
+        #  booleans in assignments to select operators.
+
+        # Converts booleans in assignments to select operators.
+        def boolean_in_assign2select!
+            # Nothing to do.
+            return self
+        end
+    end
+
     
     class If
         ## Extends the If class with functionality for converting booleans
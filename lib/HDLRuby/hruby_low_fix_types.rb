@@ -129,6 +129,16 @@ module HDLRuby::Low
         end
     end
 
+    class TimeDump
+        ## Extends the TimeDump class with fixing of types and constants.
+
+        # Explicit the types conversions in the statement.
+        def explicit_types!
+            # Nothing to do.
+            return self
+        end
+    end
+
 
 
     
@@ -98,6 +98,11 @@ module HDLRuby::Low
     class Scope
         ## Makes Scope mutable.
 
+        # Sets the +name+.
+        def set_name!(name)
+            @name = name.to_sym
+        end
+
         # Maps on the local types.
         def map_types!(&ruby_block)
             @types.map(&ruby_block)
@@ -0,0 +1,183 @@
+require 'digest'
+require 'HDLRuby'
+require 'HDLRuby/hruby_low_mutable'
+
+
+module HDLRuby::Low
+
+
+##
+# Identifies the structure of the system types for sharing the identical
+# ones among the instances.
+#
+########################################################################
+
+
+    ## The instance variables that are not part of the structure.
+    STRUCTURE_EXCLUDED = [ :@parent, :@interface, :@hdr_id ]
+
+    ## Adds the structure of +obj+ within system type +top+ to +digest+.
+    #  +visited+ gives the indexes of the objects already added, so that
+    #  the objects referred to several times are added only once.
+    #  Returns false if +obj+ includes an object whose structure is
+    #  unknown.
+    def self.structure_digest(obj, digest, top, visited)
+        case obj
+        when NilClass, TrueClass, FalseClass, Numeric, Symbol, String,
+             HDLRuby::BitString then
+            digest << obj.class.name << obj.to_s.inspect
+            return true
+        when Range then
+            digest << "Range"
+            return structure_digest(obj.begin,digest,top,visited) &&
+                   structure_digest(obj.end,digest,top,visited)
+        when Array then
+            digest << "["
+            obj.each do |elem|
+                return false unless structure_digest(elem,digest,top,visited)
+            end
+            digest << "]"
+            return true
+        when Hash then
+            digest << "{"
+            obj.each_pair do |key,value|
+                return false unless structure_digest(key,digest,top,visited)
+                return false unless structure_digest(value,digest,top,visited)
+            end
+            digest << "}"
+            return true
+        end
+        # Only the objects of HDLRuby::Low are known.
+        return false unless obj.class.name.start_with?("HDLRuby::Low::")
+        # The system types of the instances are identified by themselves:
+        # they are already shared when their instances are identical.
+        if obj.is_a?(SystemT) && !obj.equal?(top) then
+            digest << "SystemT#{obj.object_id}"
+            return true
+        end
+        # An object already added is referred to by its index.
+        if visited.key?(obj) then
+            digest << "^#{visited[obj]}"
+            return true
+        end
+        visited[obj] = visited.size
+        digest << obj.class.name << "("
+        obj.instance_variables.each do |var|
+            next if STRUCTURE_EXCLUDED.include?(var)
+            # The name of the system type is not part of its structure,
+            # nor the one of its top scope that is the same by convention.
+            if var == :@name && (obj.equal?(top) || obj.equal?(top.scope)) then
+                next
+            end
+            # The system types local to a scope are the ones of its
+            # instances, that are identified through the instances.
+            next if var == :@systemTs && obj.is_a?(Scope)
+            digest << var.to_s
+            value = obj.instance_variable_get(var)
+            return false unless structure_digest(value,digest,top,visited)
+        end
+        digest << ")"
+        return true
+    end
+
+    ## Tells if +obj+ is inside system type +top+.
+    def self.structure_inside?(obj, top)
+        while obj.respond_to?(:parent) do
+            return true if obj.equal?(top)
+            obj = obj.parent
+        end
+        return false
+    end
+
+    ## Copies deeply +obj+ within system type +top+: the objects of
+    #  HDLRuby::Low inside +top+ are copied, the other ones (e.g., the
+    #  system types of the instances or the global types) are kept.
+    #  +copies+ gives the copies of the objects already copied.
+    def self.structure_copy(obj, top, copies)
+        return copies[obj] if copies.key?(obj)
+        case obj
+        when Array then
+            copy = copies[obj] = obj.dup
+            copy.map! { |elem| structure_copy(elem,top,copies) }
+            return copy
+        when Hash then
+            copy = copies[obj] = obj.dup
+            copy.clear
+            obj.each_pair do |key,value|
+                copy[structure_copy(key,top,copies)] =
+                    structure_copy(value,top,copies)
+            end
+            return copy
+        end
+        return obj unless obj.class.name.start_with?("HDLRuby::Low::")
+        return obj if obj.is_a?(SystemT) && !obj.equal?(top)
+        return obj unless structure_inside?(obj,top)
+        copy = copies[obj] = obj.dup
+        obj.instance_variables.each do |var|
+            value = obj.instance_variable_get(var)
+            copy.instance_variable_set(var,structure_copy(value,top,copies))
+        end
+        return copy
+    end
+
+
+    class SystemT
+        ## Extends the SystemT class with the identification of its
+        #  structure.
+
+        ## Computes the key identifying the structure of the system type,
+        #  its name apart: two system types with the same key can be used
+        #  in place of one another.
+        #  Returns nil if the system type includes objects whose structure
+        #  is unknown, i.e., it cannot be shared.
+        def structure_key
+            digest = Digest::SHA256.new
+            visited = {}.compare_by_identity
+            return nil unless Low.structure_digest(self,digest,self,visited)
+            return digest.digest
+        end
+
+        ## Gives its own copy of the system types shared by several
+        #  instances to each of these instances, deeply, for the
+        #  simulators that require each instance to have its own signals.
+        #  +visited+ contains the system types already met.
+        def unshare!(visited = {}.compare_by_identity)
+            visited[self] = true
+            self.scope.each_scope_deep do |scope|
+                scope.each_systemI do |systemI|
+                    systemT = systemI.systemT
+                    # NOTE: the systems of reconfigurable instances are
+                    # never shared.
+                    if visited.key?(systemT) then
+                        # Shared, copy it under a new name made from the
+                        # instance like for the systems of the instances.
+                        copy = Low.structure_copy(systemT,systemT,
+                                                  {}.compare_by_identity)
+                        name = HDLRuby.uniq_name(systemI.name.to_s + ":T")
+                        copy.set_name!(name)
+                        copy.scope.set_name!(name)
+                        copy.no_parent!
+                        scope.add_systemT(copy)
+                        systemI.unshare_systemT!(copy)
+                    end
+                    systemI.each_systemT do |sys|
+                        sys.unshare!(visited) unless visited.key?(sys)
+                    end
+                end
+            end
+        end
+    end
+
+
+    class SystemI
+        ## Extends the SystemI class with the unsharing of its system type.
+
+        ## Replaces the (single) system type of the instance by its own
+        #  copy +systemT+.
+        def unshare_systemT!(systemT)
+            self.set_systemT(systemT)
+            @systemTs = [ systemT ]
+        end
+    end
+
+end
@@ -195,6 +195,17 @@ module HDLRuby::Low
         end
     end
 
+    class TimeDump
+        ## Extends the TimeDump class with functionality for converting
+        #  select expressions to case statements.
+
+        # Extract the Select expressions.
+        def extract_selects!
+            # Nothing to extract.
+            return []
+        end
+    end
+
     
     class If
         ## Extends the If class with functionality for converting select
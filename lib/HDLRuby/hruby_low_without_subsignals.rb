@@ -166,6 +166,17 @@ module HDLRuby::Low
             return self
         end
     end
+
+    class TimeDump
+        ## Extends the TimeDump class with functionality for decomposing
+        #  the hierachical signals in the statements.
+
+        # Decompose the hierarchical signals in the statements.
+        def signal2subs!
+            # Nothing to do.
+            return self
+        end
+    end
     
 
     class If
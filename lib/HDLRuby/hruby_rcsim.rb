@@ -2,6 +2,7 @@ require 'set'
 require 'HDLRuby'
 require 'hruby_high_fullname'
 require 'hruby_sim/hruby_sim'
+require 'hruby_rcsim_buffer'
 
 require 'rubyHDL'
 
@@ -74,7 +75,87 @@ module HDLRuby::High
     end
 
 
-    RCSim = RCSimCinterface
+    ## The builder of the C objects used by the to_rcsim methods: by
+    #  default the C interface itself, building each object with its own
+    #  call, or a RCSimBuffer while serializing a whole model for building
+    #  it with a single call.
+    module RCSim
+        CPorts = RCSimCinterface::CPorts
+
+        @builder = RCSimCinterface
+        @buffered = true
+
+        class << self
+            ## The current builder.
+            attr_reader :builder
+            ## Tells if the whole models are built from a buffer (default),
+            #  otherwise their objects are built one by one.
+            attr_accessor :buffered
+            ## Tells if the last buffer built is to be kept (for caching).
+            attr_accessor :keep_buffer
+            ## The last buffer built if kept.
+            attr_reader :last_buffer
+        end
+
+        # Forward the methods of the C interface to the current builder,
+        # as straight code since they are called for each object.
+        RCSimCinterface.singleton_methods.each do |meth|
+            args = RCSimCinterface.method(meth).arity.times.map { |i| "a#{i}" }
+            module_eval <<-CODE, __FILE__, __LINE__ + 1
+                def self.#{meth}(#{args.join(",")})
+                    @builder.#{meth}(#{args.join(",")})
+                end
+            CODE
+        end
+
+        ## Tells if a buffered build is to start: if enabled and not
+        #  already serializing.
+        def self.buffer?
+            return @buffered && @builder == RCSimCinterface
+        end
+
+        ## Serializes the C objects generated by +blk+ into a buffer and
+        #  builds them with a single call.
+        #  Returns the C object of the node returned by +blk+.
+        def self.build_buffered(&blk)
+            buffer = RCSimBuffer.new
+            @builder = buffer
+            begin
+                node = blk.call
+            ensure
+                @builder = RCSimCinterface
+            end
+            @last_buffer = buffer if @keep_buffer
+            return buffer.build(node)
+        end
+
+        ## Gives the C object of +obj+ to +blk+ once built: immediately
+        #  when building object by object, otherwise after the build of
+        #  the buffer.
+        def self.bind(obj,&blk)
+            if @builder.is_a?(RCSimBuffer) then
+                @builder.bind(obj,&blk)
+            else
+                blk.call(obj)
+            end
+        end
+
+        ## Sets the C object of +obj+ as the port +sym+ of the C programs.
+        def self.port(sym,obj)
+            if @builder.is_a?(RCSimBuffer) then
+                @builder.port(sym,obj)
+            else
+                CPorts[sym] = obj
+            end
+        end
+
+        ## Tells that the model being serialized depends on Ruby code
+        #  executed while generating it, so that it cannot be rebuilt from
+        #  its buffer alone.
+        def self.uncacheable
+            @builder.cacheable = false if @builder.is_a?(RCSimBuffer)
+        end
+    end
 
 
     
@@ -88,6 +169,154 @@ module HDLRuby::High
         RCSim.rcsim_main(top.rcsystemT,outpath +"/" + name,outmode)
     end
 
+    ## Prunes the behaviors and connections of top system +top+ that
+    #  cannot affect any observable sink, for simulating without output
+    #  (mute mode).
+    #  The sinks are the timed behaviors, the behaviors including a print
+    #  or a terminate, the software programs, the ports of +top+ and the
+    #  signals probed explicitly, i.e., whose hierarchical name below
+    #  +top+ (e.g., "cnt" or "my_adder.x") or the one of one of their
+    #  enclosing instances or scopes matches one of the glob patterns of
+    #  +probes+.
+    #  NOTE: must be called before to_rcsim, the pruned objects are then
+    #        not generated.
+    #  Returns the list of the pruned behaviors and connections.
+    def self.rcsim_prune(top, probes = [])
+        # Gives the signal to consider for a reference: the top of the
+        # signal hierarchy.
+        sig_of = proc do |obj|
+            obj = obj.parent while obj.parent.is_a?(SignalI)
+            obj
+        end
+        # Gives the signal of an event or port reference +ref+, going
+        # through its indexes and ranges, nil if unknown.
+        base_of = proc do |ref|
+            ref = ref.ref while ref.is_a?(RefIndex) || ref.is_a?(RefRange)
+            if ref.is_a?(RefObject) && ref.object.is_a?(SignalI) then
+                sig_of.(ref.object)
+            else
+                nil
+            end
+        end
+        # Tells if signal +sig+ of the scope at hierarchical name +path+
+        # (list of names) is probed explicitly.
+        probed = proc do |sig,path|
+            names = path + [ sig.name.to_s ]
+            (1..names.size).any? do |last|
+                name = names[0...last].join(".")
+                probes.any? { |pattern| File.fnmatch?(pattern,name) }
+            end
+        end
+        # Gets the signals referenced inside +node+.
+        refs_of = proc do |node|
+            node.each_node_deep.select do |n|
+                n.is_a?(RefObject) && n.object.is_a?(SignalI)
+            end.map { |n| sig_of.(n.object) }
+        end
+        # Gets the base signals of left value +ref+, nil if unknown.
+        bases_of = proc do |ref|
+            case ref
+            when RefConcat
+                bases = ref.each_ref.map { |sub| bases_of.(sub) }
+                bases.include?(nil) ? nil : bases.flatten
+            when RefIndex, RefRange
+                bases_of.(ref.ref)
+            when RefObject
+                ref.object.is_a?(SignalI) ? [ sig_of.(ref.object) ] : nil
+            else
+                nil
+            end
+        end
+
+        # Collect the nodes (behaviors and connections) with the signals
+        # they read and write, and seed the observable signals from the
+        # sinks.
+        nodes = []
+        writers = Hash.new {|h,k| h[k] = [] }
+        observed = Set.new
+        top.each_input  { |sig| observed << sig }
+        top.each_output { |sig| observed << sig }
+        top.each_inout  { |sig| observed << sig }
+        visit = proc do |scope,path|
+            scope.each_behavior do |beh|
+                reads = refs_of.(beh.block) + beh.each_event.map do |ev|
+                    base_of.(ev.ref)
+                end.compact
+                writes = beh.block.each_node_deep.select do |n|
+                    n.is_a?(Transmit)
+                end.map { |n| bases_of.(n.left) }
+                if beh.is_a?(TimeBehavior) || writes.include?(nil) ||
+                   beh.block.each_node_deep.any? do |n|
+                       n.is_a?(Print) || n.is_a?(TimeTerminate)
+                   end then
+                    # Sink behavior.
+                    observed.merge(reads)
+                else
+                    writes.flatten!
+                    nodes << [beh, reads, writes]
+                    writes.each { |sig| writers[sig] << nodes[-1] }
+                end
+            end
+            scope.each_connection do |cnx|
+                reads  = refs_of.(cnx)
+                writes = bases_of.(cnx.left)
+                unless writes then
+                    # Unknown target, keep the connection.
+                    observed.merge(reads)
+                    next
+                end
+                # Inout connections work both way.
+                writes += reads if reads.any? do |sig|
+                    sig.parent.is_a?(SystemT) and
+                    sig.parent.each_inout.any? {|e| e.equal?(sig) }
+                end
+                nodes << [cnx, reads, writes]
+                writes.each { |sig| writers[sig] << nodes[-1] }
+            end
+            unless probes.empty? then
+                scope.each_signal do |sig|
+                    observed << sig if probed.(sig,path)
+                end
+                scope.parent.each_signal do |sig|
+                    observed << sig if probed.(sig,path)
+                end if scope.parent.is_a?(SystemT)
+            end
+            scope.each_program do |prog|
+                prog.each_actport do |ev|
+                    sig = base_of.(ev.ref)
+                    observed << sig if sig
+                end
+                prog.each_inport  { |sym,sig| observed << sig_of.(sig) }
+                prog.each_arrayport { |sym,sig| observed << sig_of.(sig) }
+            end
+            scope.each_scope { |sub| visit.(sub,path + [sub.name.to_s]) }
+            scope.each_systemI do |sysI|
+                sysI.each_systemT do |sys|
+                    visit.(sys.scope,path + [sysI.name.to_s])
+                end
+            end
+        end
+        visit.(top.scope,[])
+
+        # Propagate the observability backward from the sinks.
+        needed = Set.new
+        todo = observed.to_a
+        until todo.empty? do
+            writers[todo.pop].each do |node|
+                next if needed.include?(node[0])
+                needed << node[0]
+                node[1].each do |sig|
+                    todo << sig if observed.add?(sig)
+                end
+            end
+        end
+
+        # Mark the remaining nodes as pruned.
+        pruned = nodes.map(&:first).reject { |node| needed.include?(node) }
+        pruned.each { |node| node.rcpruned = true }
+        return pruned
+    end
+
 
 
     class SystemT
@@ -97,8 +326,15 @@ module HDLRuby::High
 
         # Generate the C description of the systemT.
         # +rcowner+ is the owner if any.
+        # NOTE: without owner, the whole model is serialized and built
+        # with a single call, unless RCSim.buffered is false.
         def to_rcsim(rcowner = nil)
             # puts "to_rcsim for systemT=#{self.name}(#{self})"
+            if !rcowner && RCSim.buffer? then
+                # Serialize and build the whole model.
+                @rcsystemT = RCSim.build_buffered { self.to_rcsim }
+                return @rcsystemT
+            end
             # Create the systemT C object.
             @rcsystemT = RCSim.rcsim_make_systemT(self.name.to_s)
             # Sets the owner if any.
@@ -188,9 +424,19 @@ module HDLRuby::High
             end
 
             # Create and add the behaviors and connections.
-            rcbehs = self.each_behavior.map {|beh| beh.to_rcsim(subowner)} # +
+            # NOTE: the timed behaviors that are clock idioms are lowered
+            # to clock generators of the simulator instead.
+            rcclocks = []
+            self.each_behavior do |beh|
+                next if beh.rcpruned || !beh.is_a?(TimeBehavior)
+                rcclocks << beh if beh.to_rcclock
+            end
+            rcbehs = self.each_behavior.reject do |beh|
+                beh.rcpruned || rcclocks.include?(beh)
+            end.map {|beh| beh.to_rcsim(subowner)} # +
                 # self.each_connection.map {|cxt| cxt.to_rcsim(subowner) }
             self.each_connection do |cnx|
+                next if cnx.rcpruned
                 if !cnx.right.is_a?(RefObject) then
                     rcbehs << cnx.to_rcsim(subowner)
                 else
@@ -303,6 +549,9 @@ module HDLRuby::High
 
         attr_reader :rcbehavior
 
+        # Tells if the behavior is pruned from the simulation.
+        attr_accessor :rcpruned
+
         # Add sub leaf events from +sig+ of +type+.
         def add_sub_events(type,sig)
             if sig.each_signal.any? then
@@ -400,6 +649,157 @@ module HDLRuby::High
     class TimeBehavior
         ## Extends the TimeBehavior class for hybrid Ruby-C simulation.
         include RCSimBehavior
+
+        # The number of loop iterations symbolically executed for
+        # recognizing a clock.
+        RCCLOCK_ITERATIONS = 6
+
+        # Tries to lower the behavior to a clock generator of the C
+        # simulator.
+        # Returns true if the behavior has been lowered, false otherwise.
+        #
+        # NOTE: the recognized idiom is a sequence of waits and constant
+        # transmits to a single bit signal, optionally followed by a repeat
+        # loop of waits and constant or inverting transmits to the same
+        # signal, with at most one transmit per time step and resulting
+        # in a regular waveform.
+        def to_rcclock
+            stmnts = rcclock_flatten(self.block)
+            return false unless stmnts
+            # Split the initial sequence from the loop.
+            if stmnts[-1].is_a?(TimeRepeat) then
+                repeat = stmnts.pop
+                body = rcclock_flatten(repeat.statement)
+                return false unless body
+                number = repeat.number
+                return false unless number.is_a?(::Integer)
+            else
+                body = []
+                number = 0
+            end
+            return false if (stmnts+body).any? {|s| s.is_a?(TimeRepeat) }
+            # Get the driven signal.
+            trans = (stmnts+body).select {|s| s.is_a?(Transmit) }
+            return false if trans.empty?
+            sig = trans[0].left
+            return false unless sig.is_a?(RefObject)
+            sig = sig.object
+            return false unless sig.is_a?(SignalI) && sig.rcsignalI
+            return false unless sig.type.width == 1
+            return false unless trans.all? do |t|
+                t.left.is_a?(RefObject) && t.left.object.equal?(sig)
+            end
+            # Symbolically execute the behavior for getting its edges.
+            state = [ 0, rcclock_level(sig.value,sig,nil), nil ]
+            edges = []
+            return false unless rcclock_run(stmnts,sig,state,edges)
+            counts = []
+            iter = number < 0 ? RCCLOCK_ITERATIONS :
+                                [number,RCCLOCK_ITERATIONS].min
+            iter.times do
+                start = state[0]
+                return false unless rcclock_run(body,sig,state,edges)
+                # Empty loop iterations would run forever.
+                return false if state[0] == start && number < 0
+                counts << edges.size
+            end
+            return false if edges.size < 3
+            # Compute the number of edges, the loop iterations settle
+            # after the first one.
+            if number < 0 || number > RCCLOCK_ITERATIONS then
+                per = counts[-1] - counts[-2]
+                return false unless counts.each_cons(2).drop(1).all? do |c0,c1|
+                    c1 - c0 == per
+                end
+                return false if per == 0 && number < 0
+                total = number < 0 ? -1 :
+                    edges.size + (number-RCCLOCK_ITERATIONS)*per
+            else
+                total = edges.size
+            end
+            # Check the waveform is regular and compute the high and low
+            # durations.
+            high = low = nil
+            edges.each_cons(2) do |(t0,l0),(t1,l1)|
+                if l0 == 1 then
+                    high ||= t1 - t0
+                    return false unless high == t1 - t0
+                else
+                    low ||= t1 - t0
+                    return false unless low == t1 - t0
+                end
+            end
+            # Create the clock C object.
+            RCSim.rcsim_make_clock(sig.rcsignalI, high+low, high,
+                                   edges[0][0], edges[0][1], total)
+            return true
+        end
+
+        private
+
+        # Flattens the statements of +blk+ if they can be part of a clock
+        # idiom, otherwise returns nil.
+        def rcclock_flatten(blk)
+            return nil unless blk.each_inner.none?
+            res = []
+            blk.each_statement do |stmnt|
+                case stmnt
+                when Block
+                    sub = rcclock_flatten(stmnt)
+                    return nil unless sub
+                    res.concat(sub)
+                when TimeWait, Transmit, TimeRepeat
+                    res << stmnt
+                else
+                    return nil
+                end
+            end
+            return res
+        end
+
+        # Gets the level resulting from the transmit of +expr+ to +sig+
+        # whose current level is +level+, nil if unknown.
+        def rcclock_level(expr,sig,level)
+            case expr
+            when Value
+                content = expr.content
+                if content.is_a?(::Integer) then
+                    return content == 0 || content == 1 ? content : nil
+                end
+                content = content.to_s
+                return content =~ /\A0*[01]\z/ ? content[-1].to_i : nil
+            when Unary
+                return nil unless expr.operator == :~ && level
+                child = expr.child
+                return nil unless child.is_a?(RefObject)
+                return child.object.equal?(sig) ? 1 - level : nil
+            else
+                return nil
+            end
+        end
+
+        # Symbolically executes +stmnts+ driving +sig+ from +state+
+        # (time in ps, level and time of the last transmit) and adds the
+        # resulting edges to +edges+.
+        # Returns false if the statements are not a clock idiom.
+        def rcclock_run(stmnts,sig,state,edges)
+            stmnts.each do |stmnt|
+                if stmnt.is_a?(TimeWait) then
+                    state[0] += stmnt.delay.to_rcps
+                else
+                    # Glitches are not supported.
+                    return false if state[2] == state[0]
+                    state[2] = state[0]
+                    level = rcclock_level(stmnt.right,sig,state[1])
+                    return false unless level
+                    if level != state[1] then
+                        edges << [state[0],level]
+                        state[1] = level
+                    end
+                end
+            end
+            return true
+        end
     end
 
 
@@ -449,6 +849,11 @@ module HDLRuby::High
                 RCSim.rcsim_set_signal_value(@rcsignalI,self.value.to_rcsim)
             end
 
+            # Load the memory image if any.
+            if self.memory_image then
+                RCSim.rcsim_load_memory_image(@rcsignalI,*self.memory_image)
+            end
+
             return @rcsignalI
         end
     end
@@ -556,6 +961,7 @@ module HDLRuby::High
 
             # Create the software interface.
             if self.language == :ruby then
+                RCSim.uncacheable
                 # Loads the code files.
                 self.each_code do |code|
                   if code.is_a?(Proc)
@@ -566,15 +972,21 @@ module HDLRuby::High
                 end
                 # Add the input ports.
                 self.each_inport do |sym, sig|
-                    RubyHDL.inport(sym,sig.rcsignalI)
+                    RCSim.bind(sig.rcsignalI) do |rcsig|
+                        RubyHDL.inport(sym,rcsig)
+                    end
                 end
                 # Add the output ports.
                 self.each_outport do |sym, sig|
-                    RubyHDL.outport(sym,sig.rcsignalI)
+                    RCSim.bind(sig.rcsignalI) do |rcsig|
+                        RubyHDL.outport(sym,rcsig)
+                    end
                 end
                 # Add the array ports.
                 self.each_arrayport do |sym, sig|
-                    RubyHDL.arrayport(sym,sig.rcsignalI)
+                    RCSim.bind(sig.rcsignalI) do |rcsig|
+                        RubyHDL.arrayport(sym,rcsig)
+                    end
                 end
             elsif self.language == :c then
                 # Loads the code file: only the last one remains.
@@ -599,15 +1011,15 @@ module HDLRuby::High
                 end
                 # Add the input ports.
                 self.each_inport do |sym, sig|
-                    RCSim::CPorts[sym] = sig.rcsignalI
+                    RCSim.port(sym,sig.rcsignalI)
                 end
                 # Add the output ports.
                 self.each_outport do |sym, sig|
-                    RCSim::CPorts[sym] = sig.rcsignalI
+                    RCSim.port(sym,sig.rcsignalI)
                 end
                 # Add the array ports.
                 self.each_arrayport do |sym, sig|
-                    RCSim::CPorts[sym] = sig.rcsignalI
+                    RCSim.port(sym,sig.rcsignalI)
                 end
             end
 
@@ -677,6 +1089,19 @@ module HDLRuby::High
         end
     end
 
+    class TimeDump
+        ## Extends the TimeDump class for hybrid Ruby-C simulation.
+        attr_reader :rcstatement
+
+        # Generate the C description of the dump switch.
+        def to_rcsim
+            # Create the dump switch C object.
+            @rcstatement = RCSim.rcsim_make_timeDump(self.on ? 1 : 0)
+
+            return @rcstatement
+        end
+    end
+
     class Configure
         ## Extends the Configure class for hybrid Ruby-C simulation.
         attr_reader :rcstatement
@@ -735,11 +1160,6 @@ module HDLRuby::High
     end
 
 
-    class Delay
-        ## Extends the Delay class for hybrid Ruby-C simulation.
-        # Nothing to do.
-    end
-
     class TimeWait
         ## Extends the TimeWait class for hybrid Ruby-C simulation.
         attr_reader :rcstatement
@@ -826,6 +1246,9 @@ module HDLRuby::High
         ## Extends the Connection class for hybrid Ruby-C simulation.
         attr_reader :rcbehavior
 
+        # Tells if the connection is pruned from the simulation.
+        attr_accessor :rcpruned
+
         # Add recursively any event to +rcevs+ for activativing the 
         # connection from signal +sig+ attached to +rcbehavior+
         def self.add_rcevents(sig,rcevs,rcbehavior)
@@ -0,0 +1,212 @@
+module HDLRuby::High
+
+
+##
+# Serializer of the models for the hybrid Ruby-C simulator of HDLRuby
+#
+########################################################################
+
+    ##
+    # Records the calls to the builder methods of the C interface
+    # (rcsim_get_type_*, rcsim_make_*, rcsim_add_*, rcsim_set_* and
+    # rcsim_load_*) into a compact binary buffer, so that the C objects of
+    # a whole model are built with a single call to rcsim_build_from_buffer
+    # instead of one call per object.
+    # The created objects are replaced by the indexes of their nodes
+    # (starting from 1), that are given to the methods recording the
+    # following calls.
+    # NOTE: the format of the buffer is described in hruby_rcsim_build.c.
+    class RCSimBuffer
+
+        ## The version of the format of the buffer.
+        VERSION = 1
+
+        ## The recorded methods in the order of their operation codes, with
+        #  the kinds of their arguments and if they create a node.
+        #  The kinds of arguments are:
+        #  :n for a node, :o for a node or nil, :u for an unsigned integer,
+        #  :i for a signed integer, :b for a boolean, :s for a string, :y
+        #  for a symbol, :p for an operator and :l for a list of nodes.
+        OPERATIONS = [
+            [ :rcsim_get_type_bit,           [],                 true  ],
+            [ :rcsim_get_type_signed,        [],                 true  ],
+            [ :rcsim_get_type_vector,        [:n,:u],            true  ],
+            [ :rcsim_make_systemT,           [:s],               true  ],
+            [ :rcsim_make_scope,             [:s],               true  ],
+            [ :rcsim_make_behavior,          [:b],               true  ],
+            [ :rcsim_make_event,             [:y,:n],            true  ],
+            [ :rcsim_make_signal,            [:s,:n],            true  ],
+            [ :rcsim_make_systemI,           [:s,:n],            true  ],
+            [ :rcsim_make_code,              [:s,:s],            true  ],
+            [ :rcsim_load_c,                 [:n,:s,:s],         false ],
+            [ :rcsim_make_transmit,          [:n,:n],            true  ],
+            [ :rcsim_make_print,             [],                 true  ],
+            [ :rcsim_make_timeWait,          [:y,:i],            true  ],
+            [ :rcsim_make_timeRepeat,        [:i,:n],            true  ],
+            [ :rcsim_make_timeTerminate,     [],                 true  ],
+            [ :rcsim_make_timeDump,          [:i],               true  ],
+            [ :rcsim_make_clock,             [:n,:u,:u,:u,:i,:i],true  ],
+            [ :rcsim_make_hif,               [:n,:n,:o],         true  ],
+            [ :rcsim_make_hcase,             [:n,:o],            true  ],
+            [ :rcsim_make_block,             [:y],               true  ],
+            [ :rcsim_make_value_numeric,     [:n,:i],            true  ],
+            [ :rcsim_make_value_bitstring,   [:n,:s],            true  ],
+            [ :rcsim_make_cast,              [:n,:n],            true  ],
+            [ :rcsim_make_unary,             [:n,:p,:n],         true  ],
+            [ :rcsim_make_binary,            [:n,:p,:n,:n],      true  ],
+            [ :rcsim_make_select,            [:n,:n],            true  ],
+            [ :rcsim_make_concat,            [:n,:y],            true  ],
+            [ :rcsim_make_refConcat,         [:n,:y],            true  ],
+            [ :rcsim_make_refIndex,          [:n,:n,:n],         true  ],
+            [ :rcsim_make_refRange,          [:n,:n,:n,:n],      true  ],
+            [ :rcsim_make_stringE,           [:s],               true  ],
+            [ :rcsim_add_systemT_inputs,     [:n,:l],            false ],
+            [ :rcsim_add_systemT_outputs,    [:n,:l],            false ],
+            [ :rcsim_add_systemT_inouts,     [:n,:l],            false ],
+            [ :rcsim_add_scope_inners,       [:n,:l],            false ],
+            [ :rcsim_add_scope_behaviors,    [:n,:l],            false ],
+            [ :rcsim_add_scope_systemIs,     [:n,:l],            false ],
+            [ :rcsim_add_scope_codes,        [:n,:l],            false ],
+            [ :rcsim_add_scope_scopes,       [:n,:l],            false ],
+            [ :rcsim_add_behavior_events,    [:n,:l],            false ],
+            [ :rcsim_add_code_events,        [:n,:l],            false ],
+            [ :rcsim_add_systemI_systemTs,   [:n,:l],            false ],
+            [ :rcsim_add_signal_signals,     [:n,:l],            false ],
+            [ :rcsim_add_print_args,         [:n,:l],            false ],
+            [ :rcsim_add_hif_noifs,          [:n,:l,:l],         false ],
+            [ :rcsim_add_hcase_whens,        [:n,:l,:l],         false ],
+            [ :rcsim_add_block_inners,       [:n,:l],            false ],
+            [ :rcsim_add_block_statements,   [:n,:l],            false ],
+            [ :rcsim_add_select_choices,     [:n,:l],            false ],
+            [ :rcsim_add_concat_expressions, [:n,:l],            false ],
+            [ :rcsim_add_refConcat_refs,     [:n,:l],            false ],
+            [ :rcsim_set_owner,              [:n,:n],            false ],
+            [ :rcsim_set_systemT_scope,      [:n,:n],            false ],
+            [ :rcsim_set_behavior_block,     [:n,:n],            false ],
+            [ :rcsim_set_signal_value,       [:n,:n],            false ],
+            [ :rcsim_load_memory_image,      [:n,:s,:y],         false ]
+        ]
+
+        ## The codes of the operators, as computed by sym_to_char in
+        #  hruby_rcsim_build.c.
+        OPERATOR_CODES = Hash.new do |codes,op|
+            str = op.to_s
+            codes[op] = (str[0].ord + (str[1] || "\0").ord*2) & 255
+        end
+
+        ## Creates a new empty buffer.
+        def initialize
+            @ops = []        # The codes and the arguments of the operations.
+            @num_nodes = 0   # The number of created nodes.
+            @strings = {}    # The indexes of the strings.
+            @types = {}      # The nodes of the vector types by base.
+            @bindings = []   # The nodes to bind to their C objects.
+            @ports = {}      # The nodes of the ports of the C programs.
+            @cacheable = true
+        end
+
+        ## The number of created nodes.
+        attr_reader :num_nodes
+
+        ## The node of the top object once built.
+        attr_reader :node
+
+        ## The nodes of the ports of the C programs by name.
+        attr_reader :ports
+
+        ## Tells if the model can be rebuilt from the buffer alone, i.e.,
+        #  without executing any Ruby code (cleared by the Ruby programs).
+        attr_accessor :cacheable
+
+        ## The Ruby code encoding an argument +arg+ of +kind+.
+        def self.encode(kind,arg)
+            case kind
+            when :n, :o then "(#{arg} || 0)"
+            when :u     then "(#{arg} = #{arg}.to_i) & 0xFFFFFFFF, #{arg} >> 32"
+            when :i     then "(#{arg} = (#{arg} = #{arg}.to_i) < 0 ? " +
+                             "-2*#{arg}-1 : 2*#{arg}) & 0xFFFFFFFF, #{arg} >> 32"
+            when :b     then "(#{arg} ? 1 : 0)"
+            when :s     then "(@strings[#{arg} = #{arg}.to_s] ||= @strings.size)"
+            when :y     then "#{arg}.to_s.ord"
+            when :p     then "OPERATOR_CODES[#{arg}]"
+            when :l     then "#{arg}.size, *#{arg}"
+            end
+        end
+
+        # Define the recording methods: they are generated as straight
+        # code since they are called for each object of the model.
+        OPERATIONS.each_with_index do |(meth,kinds,creates),code|
+            args = kinds.each_index.map { |i| "a#{i}" }
+            codes = [ code.to_s ] + kinds.each_with_index.map do |kind,i|
+                encode(kind,args[i])
+            end
+            class_eval <<-CODE, __FILE__, __LINE__ + 1
+                def #{meth}(#{args.join(",")})
+                    @ops.push(#{codes.join(",")})
+                    #{creates ? "@num_nodes += 1" : args[0] || "nil"}
+                end
+            CODE
+        end
+
+        # The types are shared, record them only once.
+        alias_method :record_type_bit,    :rcsim_get_type_bit
+        alias_method :record_type_signed, :rcsim_get_type_signed
+        alias_method :record_type_vector, :rcsim_get_type_vector
+
+        def rcsim_get_type_bit
+            @type_bit ||= record_type_bit
+        end
+
+        def rcsim_get_type_signed
+            @type_signed ||= record_type_signed
+        end
+
+        def rcsim_get_type_vector(base,num)
+            (@types[base] ||= {})[num] ||= record_type_vector(base,num)
+        end
+
+        ## Requests the C object of +node+ when built, giving it to +blk+.
+        def bind(node,&blk)
+            @bindings << [node,blk]
+        end
+
+        ## Requests the C object of +node+ when built as the port +sym+ of
+        #  the C programs.
+        def port(sym,node)
+            @ports[sym] = node
+        end
+
+        ## Gets the content of the buffer as a binary string.
+        def to_s
+            buf = "HDRB".b
+            buf << [VERSION, @num_nodes, @strings.size].pack("V*")
+            @strings.each_key do |str|
+                buf << [str.bytesize].pack("V") << str.b << "\0"
+            end
+            return buf << @ops.pack("V*")
+        end
+
+        ## Builds the C objects with a single call, calling the bindings.
+        #  Returns the C object of +node+.
+        def build(node)
+            @node = node
+            objs = RCSimBuffer.build(self.to_s, node,
+                                     @bindings.map(&:first), @ports)
+            @bindings.each_with_index { |(_,blk),i| blk.(objs[i]) }
+            return objs[-1]
+        end
+
+        ## Builds the C objects from the binary content +data+ of a buffer,
+        #  setting the ports of the C programs from +ports+.
+        #  Returns the C objects of +nodes+ followed by the one of +node+.
+        def self.build(data, node, nodes = [], ports = {})
+            objs = RCSimCinterface.rcsim_build_from_buffer(data,
+                                         [*nodes, *ports.values, node])
+            ports.each_key.with_index do |sym,i|
+                RCSimCinterface::CPorts[sym] = objs[nodes.size+i]
+            end
+            return objs.first(nodes.size) << objs[-1]
+        end
+    end
+
+end
@@ -0,0 +1,187 @@
+require 'digest'
+require 'fileutils'
+
+module HDLRuby::High
+
+
+##
+# Cache of the models for the hybrid Ruby-C simulator of HDLRuby
+#
+########################################################################
+
+    ##
+    # Stores the serialized models of the simulator on disk, so that a
+    # design that did not change since its last simulation is built
+    # directly from its buffer without parsing nor transforming it again.
+    # An entry is identified by a key computed from the content of the top
+    # file and the parameters of the compilation, and is valid as long as
+    # the files it was built from did not change and the environment
+    # variables read by the description still have the same values.
+    # NOTE: the entries are evicted from the least recently used one when
+    # the total size of the cache exceeds its limit.
+    class RCSimCache
+
+        ## The version of the format of the entries.
+        VERSION = 2
+
+        ## The extension of the entry files.
+        EXT = ".hdrm"
+
+        ## Creates a new cache in directory +dir+ whose total size is limited
+        #  to +max_size+ bytes.
+        def initialize(dir, max_size = 256*1024*1024)
+            @dir = dir.to_s
+            @max_size = max_size.to_i
+            FileUtils.mkdir_p(@dir)
+        end
+
+        ## The directory of the cache.
+        attr_reader :dir
+
+        ## Computes the key of a model from the content of file +top_file+
+        #  and the parameters +params+ of its compilation.
+        def key(top_file, *params)
+            digest = Digest::SHA256.new
+            digest << [VERSION, RCSimBuffer::VERSION, HDLRuby::VERSION,
+                       RUBY_VERSION, File.expand_path(top_file),
+                       *params].inspect
+            digest << File.binread(top_file)
+            return digest.hexdigest
+        end
+
+        ## Gets the entry of +key+ as a hash with the content of the buffer
+        #  (:data), the node of the top system (:node) and the nodes of the
+        #  ports of the C programs (:ports).
+        #  Returns nil if there is no such entry or if one of the files it
+        #  was built from changed.
+        def fetch(key)
+            path = self.path(key)
+            return nil unless File.file?(path)
+            entry = File.open(path,"rb") { |f| Marshal.load(f) }
+            unless entry.is_a?(Hash) && entry[:version] == VERSION then
+                return nil
+            end
+            entry[:files].each do |file,hash|
+                unless File.file?(file) && RCSimCache.digest(file) == hash then
+                    return nil
+                end
+            end
+            entry[:env].each do |name,value|
+                return nil unless ENV[name] == value
+            end
+            # Update the access time for the eviction.
+            FileUtils.touch(path)
+            return entry
+        rescue StandardError
+            # Unreadable entry, consider it as missing.
+            return nil
+        end
+
+        ## Stores +buffer+ whose top system is +node+ as the entry of +key+,
+        #  built from +files+ with the environment variables +env+ (a hash
+        #  of their names and values, nil if the whole environment was read).
+        #  Returns false if the model cannot be cached.
+        def store(key, files, buffer, node, env = {})
+            return false unless buffer.cacheable && env
+            entry = { version: VERSION, node: node, ports: buffer.ports,
+                      files: files.map { |file| File.expand_path(file) }.
+                             uniq.map { |file| [file,RCSimCache.digest(file)] },
+                      env: env, data: buffer.to_s }
+            # Write to a temporary file first so that the concurrent
+            # simulations never see a partial entry.
+            path = self.path(key)
+            tmp = path + ".#{Process.pid}.tmp"
+            File.open(tmp,"wb") { |f| Marshal.dump(entry,f) }
+            File.rename(tmp,path)
+            self.evict
+            return true
+        end
+
+        ## Removes all the entries of the cache.
+        def invalidate
+            Dir.glob(File.join(@dir,"*" + EXT)).each do |path|
+                File.delete(path)
+            end
+        end
+
+        ## Removes the least recently used entries until the total size of
+        #  the cache is within its limit.
+        def evict
+            entries = Dir.glob(File.join(@dir,"*" + EXT)).map do |path|
+                [path, File.size(path), File.mtime(path)]
+            end
+            size = entries.sum { |_,sz,_| sz }
+            entries.sort_by! { |_,_,time| time }
+            entries.each do |path,sz,_|
+                break if size <= @max_size
+                File.delete(path)
+                size -= sz
+            end
+        end
+
+        ## The path of the entry file of +key+.
+        def path(key)
+            return File.join(@dir,key + EXT)
+        end
+
+        ## Computes the digest of the content of +file+.
+        def self.digest(file)
+            return Digest::SHA256.file(file).hexdigest
+        end
+
+
+        ##
+        # Records the accesses to ENV, since the descriptions parameterized
+        # by environment variables produce different models from the same
+        # files.
+        module EnvWatch
+            # The accesses to one variable.
+            [:[], :fetch, :key?, :has_key?, :include?, :member?].each do |m|
+                define_method(m) do |name, *args, &blk|
+                    RCSimCache.env_names << name.to_s if RCSimCache.env_names
+                    super(name, *args, &blk)
+                end
+            end
+
+            # The accesses to the whole environment.
+            [:to_h, :to_hash, :to_a, :each, :each_pair, :each_key,
+             :each_value, :keys, :values, :values_at, :select, :filter,
+             :reject, :slice, :assoc, :key, :value?, :has_value?,
+             :inspect].each do |m|
+                define_method(m) do |*args, &blk|
+                    RCSimCache.env_all = true if RCSimCache.env_names
+                    super(*args, &blk)
+                end
+            end
+        end
+
+        class << self
+            ## The names of the environment variables read since the last
+            #  watch_env, nil if not watching.
+            attr_reader :env_names
+
+            ## Tells if the whole environment was read since the last
+            #  watch_env.
+            attr_accessor :env_all
+        end
+
+        ## Starts recording the environment variables that are read.
+        def self.watch_env
+            unless ENV.singleton_class.include?(EnvWatch) then
+                ENV.singleton_class.prepend(EnvWatch)
+            end
+            @env_names = []
+            @env_all = false
+        end
+
+        ## Stops recording the environment variables and returns the hash
+        #  of the names and values of the ones that were read, or nil if the
+        #  whole environment was read.
+        def self.unwatch_env
+            names, @env_names = @env_names, nil
+            return nil if @env_all || !names
+            return names.uniq.map { |name| [name, ENV[name]] }.to_h
+        end
+    end
+
+end
@@ -99,8 +99,11 @@ module HDLRuby::High
                 @sig_exec.clear
                 @sig_active.uniq! {|sig| sig.object_id }
                 # puts "@sig_active.size=#{@sig_active.size}"
-                # Compute the nearest next time stamp.
-                @time = (@timed_behaviors.min {|b0,b1|  b0.time <=> b1.time }).time
+                # Compute the nearest next time stamp, if any timed behavior
+                # is still running.
+                unless @timed_behaviors.empty? then
+                    @time = (@timed_behaviors.min {|b0,b1|  b0.time <=> b1.time }).time
+                end
             end
             # puts "@time=#{@time}"
             # Display the time
@@ -904,6 +907,22 @@ module HDLRuby::High
         end
     end
 
+    ##
+    # Describes a timed dump switch statement.
+    # NOTE: the Ruby simulator does not support dump selection, so
+    # the statement has no effect.
+    class TimeDump
+        ## Initialize the simulation for system +systemT+.
+        def init_sim(systemT)
+            @sim = systemT
+        end
+
+        ## Executes the statement.
+        def execute(mode)
+            # Nothing to do.
+        end
+    end
+
 
     ## 
     # Describes a block.
@@ -383,6 +383,26 @@ module HDLRuby::High
     end
 
 
+    class TimeDump
+        # Enhance the TimeDump class with VCD support.
+
+        ## Shows the hierarchy of the variables.
+        def show_hierarchy(vcdout)
+            # By default: nothing to do.
+        end
+
+        ## Gets the VCD variables with their long name.
+        def get_vars_with_fullname(vars_with_fullname = {})
+            # By default: nothing to do
+        end
+
+        ## Gets the VCD variables with their id string.
+        def get_vars_with_idstr(vars_with_idstr = {})
+            # By default: nothing to do
+        end
+    end
+
+
     ## Module adding show_hierarchy to block objects.
     module BlockHierarchy
         ## Shows the hierarchy of the variables.
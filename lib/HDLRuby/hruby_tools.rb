@@ -1,4 +1,5 @@
 require 'set'
+require 'etc'
 
 
 module HDLRuby
@@ -81,4 +82,40 @@ module HDLRuby
         puts(*args) if @@verbosity > 2
     end
 
+
+    # Executes +ruby_block+ on each element of +objs+ and its index,
+    # spreading them over up to +jobs+ forked processes (by default, one
+    # per processor), or sequentially if fork is not supported.
+    # NOTE: the block is executed in the forked processes, so that its only
+    # effects are its outputs (e.g., the files it writes).
+    def self.each_in_parallel(objs, jobs = nil, &ruby_block)
+        jobs = [jobs || Etc.nprocessors, objs.size].min
+        if jobs <= 1 || !Process.respond_to?(:fork) then
+            objs.each_with_index(&ruby_block)
+            return
+        end
+        $stdout.flush
+        $stderr.flush
+        pids = jobs.times.map do |job|
+            Process.fork do
+                status = 0
+                begin
+                    objs.each_with_index do |obj,i|
+                        ruby_block.call(obj,i) if i % jobs == job
+                    end
+                rescue Exception => e
+                    warn(e.full_message)
+                    status = 1
+                end
+                $stdout.flush
+                $stderr.flush
+                Process.exit!(status)
+            end
+        end
+        failed = pids.count { |pid| !Process.wait2(pid)[1].success? }
+        if failed > 0 then
+            raise "#{failed} of the #{jobs} generation processes failed."
+        end
+    end
+
 end
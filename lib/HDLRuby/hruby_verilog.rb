@@ -253,6 +253,15 @@ module HDLRuby::Low
         end
     end
 
+    class TimeDump
+        ## Enhances TimeDump with generation of verilog code.
+
+        # Converts the dump switch to Verilog code.
+        def to_verilog(spc = 3)
+            return "#{" " * spc}#{self.on ? "$dumpon" : "$dumpoff"};"
+        end
+    end
+
 
     class Block
         ## Enhances Block with generation of verilog code.
@@ -2126,6 +2135,10 @@ module HDLRuby::Low
             self.each_inner do |inner|
                 # regs << inner.to_verilog if inner.value
                 HDLRuby::Low::VERILOG_REGS << inner.to_verilog if inner.value
+                # The memories loaded from an image are also registers.
+                if inner.memory_image then
+                    HDLRuby::Low::VERILOG_REGS << inner.to_verilog
+                end
             end
             # Actual NOT...
             # # And the array types signals.
@@ -2439,6 +2452,24 @@ module HDLRuby::Low
                 codeC << "   end\n"
             end
 
+            # Generate the code for loading the memory images.
+            images = self.each_inner.select { |inner| inner.memory_image }
+            if images.any? then
+                codeC << "\n   initial begin\n"
+                images.each do |inner|
+                    file, format = inner.memory_image
+                    if format == :raw then
+                        warn("**Warning**: raw memory image #{file} of " +
+                             "#{inner.name} is not supported in Verilog HDL, " +
+                             "it is ignored.")
+                        next
+                    end
+                    codeC << "      $readmem#{format}(" +
+                             "\"#{Low.v_string(file)}\",#{inner.to_verilog});\n"
+                end
+                codeC << "   end\n"
+            end
+
             # Conclusion.
             codeC << "\nendmodule"
 
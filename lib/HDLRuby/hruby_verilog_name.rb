@@ -30,6 +30,18 @@ module HDLRuby::Verilog
       return vname
   end
 
+  # Gets a copy of the current table of the converted names.
+  def self.names
+      return @@hdr2verilog.clone
+  end
+
+  # Sets the table of the converted names to a copy of +names+.
+  # NOTE: used for generating each file from the same table, so that its
+  # converted names do not depend on the other files.
+  def self.names=(names)
+      @@hdr2verilog = names.clone
+  end
+
   #puts ref
 
 end
@@ -4853,6 +4853,16 @@ class HDLRuby::Low::TimeTerminate
 end
 
 
+class HDLRuby::Low::TimeDump
+  # Converts the dump switch to a Viz flow node under +parent+.
+  def to_viz_node(parent)
+    node = HDLRuby::Viz::Node.new(:print,parent)
+    HDLRuby::Viz::Node.new(:string,node,self.on ? "dumpon" : "dumpoff")
+    return node
+  end
+end
+
+
 class HDLRuby::Low::Delay
   # Converts the transmit to a Viz flow node under +parent+.
   def to_viz_node(parent)
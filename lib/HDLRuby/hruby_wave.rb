@@ -0,0 +1,513 @@
+require "json"
+require "zlib"
+require "HDLRuby/hruby_hbw.rb"
+
+##
+# Library for converting the waveforms generated by the simulators (VCD
+# or HBW files) into an indexed columnar store, and for querying it.
+#
+# The store (HWS file) is organized as follows, all the integers being
+# 64-bit little-endian:
+#  - the magic string "HWS1" followed by the offset of the directory.
+#  - the columns of each signal, split into chunks of about CHUNK_SIZE
+#    bytes written as soon as they are full, each chunk having, aligned
+#    on 8 bytes:
+#    * the times of its value changes, sorted (they are the time index).
+#    * its values, with a fixed size per signal: (width+7)/8 bytes lsb
+#      first for the "bits" encoding used when all the values of the chunk
+#      are two-state, or width characters msb first for the "chars"
+#      encoding.
+#    * for single-bit signals, the cumulative numbers of rising and of
+#      falling edges at each change, counted from the first chunk.
+#  - the directory as a JSON object giving the timescale, the end time and
+#    for each signal its full names, width, number of changes and chunks.
+#    A chunk is described by the index of its first change, its first
+#    time, its number of changes, its encoding and its offsets.
+#    Signals sharing their values share their columns.
+#
+# A query reads only the directory, does a binary search in the chunks
+# then in the time column of a chunk and reads the values it needs, so
+# that it never scans the file.
+########################################################################
+module HDLRuby
+    module Wave
+
+        ## The size of the chunks of the columns (in bytes): the values of a
+        #  signal are written to the store once they reach it, so that the
+        #  memory used for building a store is bounded.
+        CHUNK_SIZE = 65536
+
+        ## Describes the columns of a signal in a store.
+        Column = Struct.new(:names, :width, :count, :chunks)
+
+        ## Describes a chunk of the columns of a signal in a store.
+        Chunk = Struct.new(:start, :first, :count, :encoding,
+                           :times, :values, :rises, :falls)
+
+        ## Builds a store from value changes.
+        class Writer
+
+            ## Creates a new writer of a store to +output+ for waveforms
+            #  whose time unit is +timescale+.
+            def initialize(output, timescale = "1ps")
+                @output = output
+                @output.binmode
+                @output.write("HWS1" + [0].pack("Q<"))
+                @pos = 12
+                @timescale = timescale
+                @columns = []
+                @end_time = 0
+            end
+
+            ## Adds a signal of +width+ bits named +names+, returns its
+            #  column number.
+            def add_signal(names, width)
+                # The times and the values of the current chunk are
+                # accumulated packed, the edges are counted across chunks.
+                @columns << { names: names, width: width, count: 0,
+                              chunks: [], times: "".b, values: "".b,
+                              last: -1, previous: nil, rise: 0, fall: 0 }
+                return @columns.size-1
+            end
+
+            ## Sets the value of column +col+ to +value+ (string of bits,
+            #  msb first) at +time+.
+            def change(col, time, value)
+                column = @columns[col]
+                width = column[:width]
+                value = Wave.extend_value(value, width)[-width..-1]
+                if column[:last] == time then
+                    # Same time, only the last value is kept.
+                    column[:values][-width..-1] = value
+                else
+                    if column[:times].bytesize +
+                       column[:values].bytesize >= CHUNK_SIZE then
+                        flush(column)
+                    end
+                    column[:times] << [time].pack("Q<")
+                    column[:values] << value
+                    column[:last] = time
+                end
+                @end_time = time if time > @end_time
+            end
+
+            ## Sets the end time of the waveform.
+            def end_time=(time)
+                @end_time = time if time > @end_time
+            end
+
+            ## Writes the remaining chunks and the directory, completing
+            #  the store.
+            def close
+                @columns.each { |column| flush(column) }
+                align
+                directory = @columns.map do |column|
+                    { names: column[:names], width: column[:width],
+                      count: column[:count], chunks: column[:chunks] }
+                end
+                @output.write(JSON.generate({ timescale: @timescale,
+                                              end_time: @end_time,
+                                              signals: directory }))
+                # Set the offset of the directory.
+                @output.seek(4)
+                @output.write([@pos].pack("Q<"))
+            end
+
+            private
+
+            ## Pads the output to 8 bytes.
+            def align
+                pad = (8 - @pos % 8) % 8
+                @output.write("\0" * pad)
+                @pos += pad
+            end
+
+            ## Writes +data+ aligned, returns its offset.
+            def put(data)
+                align
+                offset = @pos
+                @output.write(data)
+                @pos += data.bytesize
+                return offset
+            end
+
+            ## Writes the current chunk of +column+ if not empty.
+            def flush(column)
+                times = column[:times]
+                return if times.empty?
+                width = column[:width]
+                values = column[:values]
+                count = times.bytesize / 8
+                chunk = { start: column[:count], first: times.unpack1("Q<"),
+                          count: count }
+                chunk[:times] = put(times)
+                if values.match?(/[^01]/) then
+                    chunk[:encoding] = "chars"
+                    chunk[:values] = put(values)
+                else
+                    chunk[:encoding] = "bits"
+                    chunk[:values] = put(count.times.map do |i|
+                        [values[i*width,width].reverse].pack("b*")
+                    end.join)
+                end
+                if width == 1 then
+                    # Cumulative edge counts.
+                    rises, falls = [], []
+                    values.each_char do |value|
+                        previous = column[:previous]
+                        if previous then
+                            column[:rise] += 1 if value == "1" && previous != "1"
+                            column[:fall] += 1 if value == "0" && previous != "0"
+                        end
+                        rises << column[:rise]
+                        falls << column[:fall]
+                        column[:previous] = value
+                    end
+                    chunk[:rises] = put(rises.pack("Q<*"))
+                    chunk[:falls] = put(falls.pack("Q<*"))
+                end
+                column[:chunks] << chunk
+                column[:count] += count
+                column[:times] = "".b
+                column[:values] = "".b
+            end
+        end
+
+
+        ## Queries a store.
+        class Store
+
+            # The time unit of the store.
+            attr_reader :timescale
+
+            # The time of the end of the waveform.
+            attr_reader :end_time
+
+            ## Opens the store file +filename+, and closes it after
+            #  executing the block if any.
+            def self.open(filename)
+                store = Store.new(File.open(filename,"rb"))
+                return store unless block_given?
+                begin
+                    return yield(store)
+                ensure
+                    store.close
+                end
+            end
+
+            ## Creates a new store reading +io+.
+            def initialize(io)
+                @io = io
+                @io.binmode
+                unless @io.pread(4,0) == "HWS1" then
+                    raise "Not a HWS file."
+                end
+                offset = @io.pread(8,4).unpack1("Q<")
+                directory = JSON.parse(@io.pread(@io.size-offset,offset))
+                @timescale = directory["timescale"]
+                @end_time = directory["end_time"]
+                @columns = {}
+                directory["signals"].each do |entry|
+                    chunks = entry["chunks"].map do |chunk|
+                        Chunk.new(*Chunk.members.map { |m| chunk[m.to_s] })
+                    end
+                    column = Column.new(entry["names"], entry["width"],
+                                        entry["count"], chunks)
+                    column.names.each { |name| @columns[name] = column }
+                end
+            end
+
+            ## Closes the store.
+            def close
+                @io.close
+            end
+
+            ## Gets the names of the signals.
+            def signals
+                return @columns.keys
+            end
+
+            ## Gets the width of signal +name+.
+            def width(name)
+                return column(name).width
+            end
+
+            ## Gets the value of signal +name+ at +time+ as a string of bits
+            #  msb first, nil if not set yet.
+            def value_at(name, time)
+                column = column(name)
+                idx = count_until(column, time)
+                return idx == 0 ? nil : value(column, idx-1)
+            end
+
+            ## Gets the changes of signal +name+ from +start+ to +stop+
+            #  included, as an array of [time, value].
+            def changes(name, start, stop)
+                column = column(name)
+                first = count_until(column, start-1)
+                last = count_until(column, stop)
+                return [] if last <= first
+                times = []
+                column.chunks.each do |chunk|
+                    from = [first, chunk.start].max
+                    to = [last, chunk.start + chunk.count].min
+                    next if from >= to
+                    times.concat(@io.pread((to-from)*8, chunk.times +
+                                           (from-chunk.start)*8).unpack("Q<*"))
+                end
+                return times.each_with_index.map do |time,i|
+                    [time, value(column, first+i)]
+                end
+            end
+
+            ## Counts the +edge+ (:posedge or :negedge) of single-bit signal
+            #  +name+ from +start+ to +stop+ included.
+            def edges(name, start, stop, edge = :posedge)
+                column = column(name)
+                unless column.width == 1 then
+                    raise "Edges are only defined for single-bit signals."
+                end
+                count = proc do |idx|
+                    next 0 if idx == 0
+                    chunk = chunk_of(column, idx-1)
+                    offset = edge == :posedge ? chunk.rises : chunk.falls
+                    @io.pread(8,offset+(idx-1-chunk.start)*8).unpack1("Q<")
+                end
+                return count.(count_until(column, stop)) -
+                       count.(count_until(column, start-1))
+            end
+
+            private
+
+            ## Gets the column of signal +name+.
+            def column(name)
+                column = @columns[name]
+                raise "Unknown signal: #{name}." unless column
+                return column
+            end
+
+            ## Gets the number of changes of +column+ until +time+ included,
+            #  by binary search in the chunks then in the time column of the
+            #  last chunk starting before +time+.
+            def count_until(column, time)
+                return 0 if time < 0
+                num = column.chunks.bsearch_index { |c| c.first > time }
+                num ||= column.chunks.size
+                return 0 if num == 0
+                chunk = column.chunks[num-1]
+                low, high = 0, chunk.count
+                while low < high do
+                    mid = (low + high) / 2
+                    if @io.pread(8,chunk.times+mid*8).unpack1("Q<") <= time
+                        low = mid + 1
+                    else
+                        high = mid
+                    end
+                end
+                return chunk.start + low
+            end
+
+            ## Gets the chunk of +column+ including the change number +idx+.
+            def chunk_of(column, idx)
+                num = column.chunks.bsearch_index { |c| c.start > idx }
+                return column.chunks[(num || column.chunks.size)-1]
+            end
+
+            ## Reads the value number +idx+ of +column+.
+            def value(column, idx)
+                width = column.width
+                chunk = chunk_of(column, idx)
+                idx -= chunk.start
+                if chunk.encoding == "bits" then
+                    size = (width+7)/8
+                    data = @io.pread(size,chunk.values + idx*size)
+                    return data.unpack1("b*")[0,width].reverse
+                else
+                    return @io.pread(width,chunk.values + idx*width)
+                end
+            end
+        end
+
+
+        ## Reads a gzip file as a stream, inflating it on the fly: the files
+        #  generated by the simulators may be made of several gzip members.
+        class GzipStream
+
+            ## Creates a new stream reading the gzip file +io+.
+            def initialize(io)
+                @io = io
+                rewind
+            end
+
+            ## Sets the binary mode (the stream is always binary).
+            def binmode
+                return self
+            end
+
+            ## Restarts reading from the beginning of the file.
+            def rewind
+                @io.rewind
+                @gz = Zlib::GzipReader.new(@io)
+            end
+
+            ## Reads at most +len+ bytes, nil at the end of the file.
+            def read(len)
+                data = "".b
+                while @gz && data.bytesize < len do
+                    chunk = @gz.read(len - data.bytesize)
+                    if chunk && !chunk.empty? then
+                        data << chunk
+                    else
+                        next_member
+                    end
+                end
+                return (data.empty? && len > 0) ? nil : data
+            end
+
+            ## Reads a byte, nil at the end of the file.
+            def getbyte
+                data = read(1)
+                return data && data.getbyte(0)
+            end
+
+            ## Iterates over the lines of the file.
+            def each_line
+                rest = nil
+                while @gz do
+                    @gz.each_line do |line|
+                        # A line may span two members.
+                        line = rest + line if rest
+                        rest = nil
+                        if line.end_with?("\n") then
+                            yield(line)
+                        else
+                            rest = line
+                        end
+                    end
+                    next_member
+                end
+                yield(rest) if rest
+            end
+
+            private
+
+            ## Goes to the next member of the file, if any.
+            def next_member
+                unused = @gz.unused
+                @gz.finish
+                @io.seek(-unused.bytesize,IO::SEEK_CUR) if unused
+                @gz = @io.eof? ? nil : Zlib::GzipReader.new(@io)
+            end
+        end
+
+        ## Extends +value+ (msb first) to +width+ bits like in VCD files.
+        def self.extend_value(value, width)
+            return value if value.size >= width
+            fill = value[0] == "1" ? "0" : value[0]
+            return fill * (width - value.size) + value
+        end
+
+        ## Gets a readable version of +input+, uncompressed if it is a
+        #  gzip file.
+        def self.uncompress(input)
+            input.binmode
+            magic = input.read(2)
+            input.rewind
+            return input unless magic == "\x1F\x8B".b
+            return GzipStream.new(input)
+        end
+
+        ## Converts the VCD read from +input+ to a store written to
+        #  +output+.
+        def self.from_vcd(input, output)
+            writer = nil
+            timescale = "1ps"
+            ids = {}
+            names = {}
+            widths = {}
+            scopes = []
+            time = 0
+            input.each_line do |line|
+                line.strip!
+                next if line.empty?
+                if writer then
+                    # The value changes.
+                    case line[0]
+                    when "#" then
+                        time = line[1..-1].to_i
+                        writer.end_time = time
+                    when "b", "B" then
+                        value, id = line[1..-1].split(" ")
+                        writer.change(ids[id], time, value.downcase) if ids[id]
+                    when "r", "R" then
+                        # Real values are not supported.
+                    when "0", "1", "x", "X", "z", "Z" then
+                        id = line[1..-1]
+                        writer.change(ids[id], time, line[0].downcase) if ids[id]
+                    end
+                    # $dumpvars and similar keywords are ignored.
+                    next
+                end
+                # The header.
+                words = line.split(" ")
+                case words[0]
+                when "$timescale" then
+                    timescale = words[1..-1].join if words[1] != "$end"
+                when "$scope" then
+                    scopes << words[2]
+                when "$upscope" then
+                    scopes.pop
+                when "$var" then
+                    width, id = words[2].to_i, words[3]
+                    name = (scopes + [words[4]]).join(".")
+                    # Signals declared with the same id are aliases.
+                    (names[id] ||= []) << name
+                    widths[id] = width
+                when "$enddefinitions" then
+                    writer = Writer.new(output,timescale)
+                    names.each do |id,aliases|
+                        ids[id] = writer.add_signal(aliases,widths[id])
+                    end
+                end
+            end
+            raise "Invalid VCD file." unless writer
+            writer.close
+        end
+
+        ## Converts the HBW file read from +input+ to a store written to
+        #  +output+.
+        def self.from_hbw(input, output)
+            reader = HBW::Reader.new(input)
+            writer = Writer.new(output,"1ps")
+            cols = {}
+            reader.signals.each_value do |sig|
+                # Named like in the VCD files.
+                name = sig.path.map { |n| HBW.vcd_name(n) }.join(".")
+                cols[sig.id] = writer.add_signal([name], sig.width)
+            end
+            reader.each_block do |changes|
+                changes.each do |time, id, value|
+                    writer.change(cols[id], time, value) if cols[id]
+                end
+            end
+            writer.close
+        end
+
+        ## Converts the waveform file +input+ (VCD or HBW, possibly
+        #  compressed) to the store file +output+.
+        def self.convert(input, output)
+            File.open(input,"rb") do |file|
+                src = Wave.uncompress(file)
+                File.open(output,"wb") do |dst|
+                    if src.read(4) == "HBW1" then
+                        src.rewind
+                        Wave.from_hbw(src, dst)
+                    else
+                        src.rewind
+                        Wave.from_vcd(src, dst)
+                    end
+                end
+            end
+        end
+    end
+end
@@ -4,7 +4,9 @@ module HDLRuby::High::Std
     # - 'widthA': address bit width
     # - 'widthD': data bit width
     # - 'size':   the size of the memory.
-    system :bram do |widthA, widthD, size = nil|
+    # - 'image':  the memory image file (or [file, format] pair) loaded at
+    #             simulation start, if any.
+    system :bram do |widthA, widthD, size = nil, image = nil|
         # Process size if required.
         size = 2**widthA unless size
         # puts "widthA=#{widthA} widthD=#{widthD} size=#{size}"
@@ -16,6 +18,7 @@ module HDLRuby::High::Std
         [widthD].output :dout
 
         bit[widthD][-size].inner mem: [ :"_b#{"0"*widthD}".to_value ] * size
+        mem.load_image(*image) if image
 
         par(clk.negedge) do
             hif(rwb == 0) { mem[addr] <= din }
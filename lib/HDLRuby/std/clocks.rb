@@ -11,6 +11,39 @@ module HDLRuby::High::Std
         @@__clocks_rst = rst
     end
 
+    # Create a free-running clock generator driving +clk+ with +period+ and
+    # +duty+ as duration of the high level (half of the period by default),
+    # whose first edge sets +clk+ to +start+ after +phase+.
+    # NOTE: the hybrid Ruby-C simulator lowers the generator to a native
+    # clock of the simulation engine.
+    def make_clock_generator(clk, period, duty = nil, phase = nil, start = 1)
+        # Convert the durations to ps.
+        period = period.to_rcps
+        duty = duty ? duty.to_rcps : period / 2
+        phase = phase ? phase.to_rcps : 0
+        unless duty > 0 && duty < period then
+            raise AnyError, "Invalid duty cycle for clock generator: #{duty}"
+        end
+        start = start == 0 ? 0 : 1
+        # The duration of the first level.
+        first = start == 1 ? duty : period - duty
+
+        # Enters the current system
+        HDLRuby::High.cur_system.open do
+            timed do
+                !phase.ps if phase > 0
+                clk <= start
+                repeat do
+                    !first.ps
+                    clk <= ~clk
+                    !(period-first).ps
+                    clk <= ~clk
+                end
+            end
+        end
+        return clk
+    end
+
     # Create a clock inverted every +times+ occurence of an +event+.
     def make_clock(event, times)
         clock = nil # The resulting clock
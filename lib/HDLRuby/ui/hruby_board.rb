@@ -232,6 +232,13 @@ Content-Type: text/html
     display: inline-block;
   }
 
+  .metrics {
+    font-size: 12px;
+    font-family: monospace;
+    color: #d0d0d0;
+    margin-top: 4px;
+  }
+
   .name {
     font-size: 20px;
     font-family: "Lucida Console", "Courier New", monospace;
@@ -644,6 +651,7 @@ Content-Type: text/html
   <div id="cartouche" class="title">
   Name of the FPGA board
   </div>
+  <div id="metrics" class="metrics"></div>
 </div>
 <br>
 
@@ -652,6 +660,7 @@ Content-Type: text/html
 <script>
   // Access to the components of the UI.
   const cartouche = document.getElementById("cartouche");
+  const metrics   = document.getElementById("metrics");
   const panel     = document.getElementById("panel");
 
   // The current time stamp.
@@ -947,8 +956,26 @@ Content-Type: text/html
     xhttp.send();
   }
 
+  // Display the throughput of the simulator if available.
+  function hruby_metrics() {
+    let xhttp = new XMLHttpRequest();
+    xhttp.onreadystatechange = function() {
+      if (this.readyState == 4 && this.status == 200 &&
+          this.responseText.startsWith('{')) {
+        const m = JSON.parse(this.responseText);
+        metrics.innerHTML = 'time: ' + m.time + 'ps, ' +
+          Math.round(m.events_per_s) + ' events/s, ' +
+          Math.round(m.executions_per_s) + ' behaviors/s, ' +
+          Math.round(m.rss / 1048576) + 'MB';
+      }
+    };
+    xhttp.open("GET", "metrics", true);
+    xhttp.send();
+  }
+
   // First call of synchronisation.
   hruby_sync();
+  setInterval(function() { hruby_metrics(); }, 1000);
 
   // Moved to the Ruby constructor to allow setting the time intervals.
   // // Then periodic synchronize.
@@ -1252,9 +1279,36 @@ HTMLRESPONSE
       RubyHDL.send(@elements[id].hwrite,val)
     end
 
+    # Generate the runtime metrics of the simulator as a JSON response
+    # with the throughput since the previous request, empty if not
+    # available.
+    def metrics_response
+      unless defined?(RCSimCinterface) &&
+             RCSimCinterface.respond_to?(:rcsim_get_metrics) then
+        return UI_response
+      end
+      metrics = RCSimCinterface.rcsim_get_metrics
+      last = @last_metrics || { wall: 0.0, time: 0, events: 0,
+                                deltas: 0, executions: 0 }
+      @last_metrics = metrics
+      elapsed = metrics[:wall] - last[:wall]
+      elapsed = 1e-9 if elapsed <= 0
+      res = metrics.dup
+      [:time, :events, :deltas, :executions].each do |key|
+        res[:"#{key}_per_s"] = (metrics[key] - last[key]) / elapsed
+      end
+      # NOTE: json is not required since it defines Kernel#j that would
+      # hide the signals named j of the designs, and the metrics are all
+      # numbers.
+      return UI_response + "{" +
+        res.map { |key,value| "\"#{key}\":#{value}" }.join(",") + "}"
+    end
+
     # Generate a response to a request to the server.
     def make_response(request)
       # puts "request=#{request}"
+      # The metrics are requested independently of the UI.
+      return self.metrics_response if request == "metrics"
       if (@first) then
         @first = false
         # First or re-connection, generate the UI.